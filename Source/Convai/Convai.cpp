@@ -4,6 +4,9 @@
 #include "Developer/Settings/Public/ISettingsModule.h"
 #include "UObject/UObjectGlobals.h"
 #include "UObject/Package.h"
+#include "ConvaiLocalService.h"
+#include "Misc/CommandLine.h"
+#include "Misc/Parse.h"
 
 IMPLEMENT_MODULE(Convai, Convai);
 
@@ -22,10 +25,21 @@ void Convai::StartupModule()
 			LOCTEXT("RuntimeSettingsDescription", "Configure Convai settings"),
 			ConvaiSettings);
 	}
+
+#if !UE_BUILD_SHIPPING
+	// Lets headless load tests start the stand-in service with the process, e.g. -ConvaiLocalService="Port=50051 DelayMs=300"
+	FString LocalServiceParams;
+	if (FParse::Value(FCommandLine::Get(), TEXT("ConvaiLocalService="), LocalServiceParams, false) || FParse::Param(FCommandLine::Get(), TEXT("ConvaiLocalService")))
+	{
+		FConvaiLocalService::Get().Start(FConvaiLocalService::ParseOptions(LocalServiceParams));
+	}
+#endif
 }
 
 void Convai::ShutdownModule()
 {
+	FConvaiLocalService::Get().Stop();
+
 	if (ISettingsModule* SettingsModule = FModuleManager::GetModulePtr<ISettingsModule>("Settings"))
 	{
 		SettingsModule->UnregisterSettings("Project", "Plugins", "Convai");
@@ -6,6 +6,15 @@
 #include "Modules/ModuleManager.h"
 #include "Convai.generated.h"
 
+UENUM()
+enum class EConvaiCompletionQueuePolicy : uint8
+{
+	/* Assign each new stream to the next completion queue in turn */
+	RoundRobin		UMETA(DisplayName = "Round Robin"),
+	/* Assign each new stream to the completion queue with the fewest assigned streams */
+	LeastLoaded		UMETA(DisplayName = "Least Loaded")
+};
+
 UCLASS(config = Engine, defaultconfig)
 class CONVAI_API UConvaiSettings : public UObject
 {
@@ -17,6 +26,13 @@ public:
 	{
 		API_Key = "";
 		EnableNewActionSystem = false;
+		NumCompletionQueues = 2;
+		NumChannels = 2;
+		KeepAliveIntervalSecs = 30;
+		CompletionQueuePolicy = EConvaiCompletionQueuePolicy::LeastLoaded;
+		AudioUplinkFrameMs = 40;
+		MaxAudioUplinkFramesPerWrite = 5;
+		AudioUplinkBackpressureMs = 1000;
 	}
 	/* API Key Issued from the website */
 	UPROPERTY(Config, EditAnywhere, Category = "Convai API")
@@ -41,6 +57,34 @@ public:
 	UPROPERTY(Config, EditAnywhere, AdvancedDisplay, Category = "Convai API")
 	bool AllowInsecureConnection;
 
+	/* Number of gRPC completion queues, each polled by its own thread */
+	UPROPERTY(Config, EditAnywhere, AdvancedDisplay, Category = "Convai API", meta = (ClampMin = "1", ClampMax = "16"))
+	int32 NumCompletionQueues;
+
+	/* Number of gRPC channels, each with its own HTTP/2 connection, that streams are spread across */
+	UPROPERTY(Config, EditAnywhere, AdvancedDisplay, Category = "Convai API", meta = (ClampMin = "1", ClampMax = "16"))
+	int32 NumChannels;
+
+	/* Interval of HTTP/2 keepalive pings that keep idle connections warm, 0 disables keepalive */
+	UPROPERTY(Config, EditAnywhere, AdvancedDisplay, Category = "Convai API", meta = (ClampMin = "0"))
+	float KeepAliveIntervalSecs;
+
+	/* How new streams are distributed across the gRPC completion queues */
+	UPROPERTY(Config, EditAnywhere, AdvancedDisplay, Category = "Convai API")
+	EConvaiCompletionQueuePolicy CompletionQueuePolicy;
+
+	/* Duration of the audio frames the mic audio is packed into before being sent, 0 sends whatever is available each write */
+	UPROPERTY(Config, EditAnywhere, AdvancedDisplay, Category = "Convai API", meta = (ClampMin = "0", ClampMax = "500"))
+	int32 AudioUplinkFrameMs;
+
+	/* Maximum number of audio frames coalesced into a single stream write, larger backlogs are sent over several writes */
+	UPROPERTY(Config, EditAnywhere, AdvancedDisplay, Category = "Convai API", meta = (ClampMin = "1", ClampMax = "50"))
+	int32 MaxAudioUplinkFramesPerWrite;
+
+	/* Amount of unsent mic audio after which the uplink is reported as falling behind */
+	UPROPERTY(Config, EditAnywhere, AdvancedDisplay, Category = "Convai API", meta = (ClampMin = "100"))
+	int32 AudioUplinkBackpressureMs;
+
 	/* Extra Parameters (Used for debugging) */
 	UPROPERTY(Config, EditAnywhere, AdvancedDisplay, Category = "Convai API")
 	FString ExtraParams;
@@ -6,11 +6,16 @@
 
 DEFINE_LOG_CATEGORY(ConvaiAudioLog);
 
+namespace
+{
+	// Two seconds of stereo audio at 48k SR, allocated once so the device callback never allocates
+	constexpr uint32 CaptureRingCapacity = 2 * 2 * 48000;
+}
 
 namespace Audio
 {
 	FConvaiAudioCaptureSynth::FConvaiAudioCaptureSynth()
-		: NumSamplesEnqueued(0)
+		: AudioCaptureData(CaptureRingCapacity)
 		, bInitialized(false)
 		, bIsCapturing(false)
 	{
@@ -74,28 +79,15 @@ namespace Audio
 		bool bSuccess = true;
 		if (!AudioCapture.IsStreamOpen())
 		{
-			FOnCaptureFunction OnCapture = [this](const float* AudioData, int32 NumFrames, int32 NumChannels, int32 SampleRate, double StreamTime, bool bOverFlow)
+			FOnCaptureFunction OnCaptureFunction = [this](const float* AudioData, int32 NumFrames, int32 NumChannels, int32 SampleRate, double StreamTime, bool bOverFlow)
 			{
-				int32 NumSamples = NumChannels * NumFrames;
-
-				FScopeLock Lock(&CaptureCriticalSection);
-
-				if (bIsCapturing)
-				{
-					// Append the audio memory to the capture data buffer
-					int32 Index = AudioCaptureData.AddUninitialized(NumSamples);
-					float* AudioCaptureDataPtr = AudioCaptureData.GetData();
-					FMemory::Memcpy(&AudioCaptureDataPtr[Index], AudioData, NumSamples * sizeof(float));
-				}
+				OnCapture(AudioData, NumFrames, NumChannels, bOverFlow);
 			};
 
-			// Prepare the audio buffer memory for 2 seconds of stereo audio at 48k SR to reduce chance for allocation in callbacks
-			AudioCaptureData.Reserve(2 * 2 * 48000);
-
 			FAudioCaptureDeviceParams Params = FAudioCaptureDeviceParams();
 
 			// Start the stream here to avoid hitching the audio render thread. 
-			if (AudioCapture.OpenCaptureStream(Params, MoveTemp(OnCapture), 1024))
+			if (AudioCapture.OpenCaptureStream(Params, MoveTemp(OnCaptureFunction), 1024))
 			{
 				AudioCapture.StartStream();
 			}
@@ -112,28 +104,15 @@ namespace Audio
 		bool bSuccess = true;
 		if (!AudioCapture.IsStreamOpen())
 		{
-			FOnCaptureFunction OnCapture = [this](const float* AudioData, int32 NumFrames, int32 NumChannels, int32 SampleRate, double StreamTime, bool bOverFlow)
+			FOnCaptureFunction OnCaptureFunction = [this](const float* AudioData, int32 NumFrames, int32 NumChannels, int32 SampleRate, double StreamTime, bool bOverFlow)
 			{
-				int32 NumSamples = NumChannels * NumFrames;
-
-				FScopeLock Lock(&CaptureCriticalSection);
-
-				if (bIsCapturing)
-				{
-					// Append the audio memory to the capture data buffer
-					int32 Index = AudioCaptureData.AddUninitialized(NumSamples);
-					float* AudioCaptureDataPtr = AudioCaptureData.GetData();
-					FMemory::Memcpy(&AudioCaptureDataPtr[Index], AudioData, NumSamples * sizeof(float));
-				}
+				OnCapture(AudioData, NumFrames, NumChannels, bOverFlow);
 			};
 
-			// Prepare the audio buffer memory for 2 seconds of stereo audio at 48k SR to reduce chance for allocation in callbacks
-			AudioCaptureData.Reserve(2 * 2 * 48000);
-
 			FAudioCaptureDeviceParams Params = FAudioCaptureDeviceParams();
 			Params.DeviceIndex = DeviceIndex;
 			// Start the stream here to avoid hitching the audio render thread. 
-			if (AudioCapture.OpenCaptureStream(Params, MoveTemp(OnCapture), 1024))
+			if (AudioCapture.OpenCaptureStream(Params, MoveTemp(OnCaptureFunction), 1024))
 			{
 				AudioCapture.StartStream();
 			}
@@ -145,6 +124,31 @@ namespace Audio
 		return bSuccess;
 	}
 
+	void FConvaiAudioCaptureSynth::OnCapture(const float* AudioData, int32 NumFrames, int32 NumChannels, bool bOverFlow)
+	{
+		if (bOverFlow)
+		{
+			NumDeviceOverflows.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		const int32 NumSamples = NumChannels * NumFrames;
+		if (!bIsCapturing.load(std::memory_order_acquire) || !AudioData || NumSamples <= 0)
+		{
+			return;
+		}
+
+		// All or nothing, so the ring only ever holds whole frames
+		if (AudioCaptureData.NumFree() < uint32(NumSamples))
+		{
+			NumOverflows.fetch_add(1, std::memory_order_relaxed);
+			SamplesDropped.fetch_add(NumSamples, std::memory_order_relaxed);
+			return;
+		}
+
+		AudioCaptureData.Write(AudioData, uint32(NumSamples));
+		SamplesCaptured.fetch_add(NumSamples, std::memory_order_relaxed);
+	}
+
 	void FConvaiAudioCaptureSynth::CloseStream()
 	{
 		if (AudioCapture.IsStreamOpen())
@@ -155,13 +159,12 @@ namespace Audio
 
 	bool FConvaiAudioCaptureSynth::StartCapturing()
 	{
-		FScopeLock Lock(&CaptureCriticalSection);
-
-		AudioCaptureData.Reset();
+		// Called from the reading side, the device callback does not write while not capturing
+		AudioCaptureData.Empty();
 
 		check(AudioCapture.IsStreamOpen());
 
-		bIsCapturing = true;
+		bIsCapturing.store(true, std::memory_order_release);
 		return true;
 	}
 
@@ -169,8 +172,7 @@ namespace Audio
 	{
 		check(AudioCapture.IsStreamOpen());
 		check(AudioCapture.IsCapturing());
-		FScopeLock Lock(&CaptureCriticalSection);
-		bIsCapturing = false;
+		bIsCapturing.store(false, std::memory_order_release);
 	}
 
 	void FConvaiAudioCaptureSynth::AbortCapturing()
@@ -186,13 +188,22 @@ namespace Audio
 
 	bool FConvaiAudioCaptureSynth::IsCapturing() const
 	{
-		return bIsCapturing;
+		return bIsCapturing.load(std::memory_order_acquire);
 	}
 
-	int32 FConvaiAudioCaptureSynth::GetNumSamplesEnqueued()
+	int32 FConvaiAudioCaptureSynth::GetNumSamplesEnqueued() const
 	{
-		FScopeLock Lock(&CaptureCriticalSection);
-		return AudioCaptureData.Num();
+		return int32(AudioCaptureData.Num());
+	}
+
+	FConvaiAudioCaptureSynthStats FConvaiAudioCaptureSynth::GetStats() const
+	{
+		FConvaiAudioCaptureSynthStats Stats;
+		Stats.SamplesCaptured = SamplesCaptured.load(std::memory_order_relaxed);
+		Stats.NumOverflows = NumOverflows.load(std::memory_order_relaxed);
+		Stats.SamplesDropped = SamplesDropped.load(std::memory_order_relaxed);
+		Stats.NumDeviceOverflows = NumDeviceOverflows.load(std::memory_order_relaxed);
+		return Stats;
 	}
 
 	FAudioCapture* FConvaiAudioCaptureSynth::GetAudioCapture()
@@ -202,22 +213,34 @@ namespace Audio
 
 	bool FConvaiAudioCaptureSynth::GetAudioData(TArray<float>& OutAudioData)
 	{
-		FScopeLock Lock(&CaptureCriticalSection);
-
-		int32 CaptureDataSamples = AudioCaptureData.Num();
+		const int32 CaptureDataSamples = int32(AudioCaptureData.Num());
 		if (CaptureDataSamples > 0)
 		{
 			// Append the capture audio to the output buffer
 			int32 OutIndex = OutAudioData.AddUninitialized(CaptureDataSamples);
-			float* OutDataPtr = OutAudioData.GetData();
-			FMemory::Memcpy(&OutDataPtr[OutIndex], AudioCaptureData.GetData(), CaptureDataSamples * sizeof(float));
-
-			// Reset the capture data buffer since we copied the audio out
-			AudioCaptureData.Reset();
+			AudioCaptureData.Read(OutAudioData.GetData() + OutIndex, uint32(CaptureDataSamples));
 			return true;
 		}
 		return false;
 	}
+
+	int32 FConvaiAudioCaptureSynth::PeekAudioData(const float*& OutFirst, int32& OutFirstNum, const float*& OutSecond, int32& OutSecondNum)
+	{
+		uint32 FirstNum;
+		uint32 SecondNum;
+		const uint32 NumSamples = AudioCaptureData.PeekRead(OutFirst, FirstNum, OutSecond, SecondNum);
+		OutFirstNum = int32(FirstNum);
+		OutSecondNum = int32(SecondNum);
+		return int32(NumSamples);
+	}
+
+	void FConvaiAudioCaptureSynth::ConsumeAudioData(int32 NumSamples)
+	{
+		if (NumSamples > 0)
+		{
+			AudioCaptureData.Commit(uint32(NumSamples));
+		}
+	}
 };
 
 UConvaiAudioCaptureComponent::UConvaiAudioCaptureComponent(const FObjectInitializer& ObjectInitializer)
@@ -226,11 +249,9 @@ UConvaiAudioCaptureComponent::UConvaiAudioCaptureComponent(const FObjectInitiali
 	bSuccessfullyInitialized = false;
 	bIsCapturing = false;
 	CapturedAudioDataSamples = 0;
-	ReadSampleIndex = 0;
 	bIsDestroying = false;
 	bIsNotReadyForForFinishDestroy = false;
 	bIsStreamOpen = false;
-	CaptureAudioData.Reserve(2 * 48000 * 5);
 	SelectedDeviceIndex = -1;
 }
 
@@ -360,8 +381,6 @@ Audio::FConvaiAudioCaptureSynth* UConvaiAudioCaptureComponent::GetCaptureSynth()
 void UConvaiAudioCaptureComponent::OnBeginGenerate()
 {
 	CapturedAudioDataSamples = 0;
-	ReadSampleIndex = 0;
-	CaptureAudioData.Reset();
 
 	if (!bIsStreamOpen)
 	{
@@ -376,7 +395,6 @@ void UConvaiAudioCaptureComponent::OnBeginGenerate()
 		// Don't allow this component to be destroyed until the stream is closed again
 		bIsNotReadyForForFinishDestroy = true;
 		FramesSinceStarting = 0;
-		ReadSampleIndex = 0;
 	}
 
 }
@@ -406,39 +424,20 @@ int32 UConvaiAudioCaptureComponent::OnGenerateAudio(float* OutAudio, int32 NumSa
 
 	if (CapturedAudioDataSamples > 0 || CaptureSynth.GetNumSamplesEnqueued() > 1024)
 	{
-		// Check if we need to read more audio data from capture synth
-		if (ReadSampleIndex + NumSamples > CaptureAudioData.Num())
-		{
-			// but before we do, copy off the remainder of the capture audio data buffer if there's data in it
-			int32 SamplesLeft = FMath::Max(0, CaptureAudioData.Num() - ReadSampleIndex);
-			if (SamplesLeft > 0)
-			{
-				float* CaptureDataPtr = CaptureAudioData.GetData();
-				FMemory::Memcpy(OutAudio, &CaptureDataPtr[ReadSampleIndex], SamplesLeft * sizeof(float));
-
-				// Track samples generated
-				OutputSamplesGenerated += SamplesLeft;
-			}
-
-			// Get another block of audio from the capture synth
-			CaptureAudioData.Reset();
-			CaptureSynth.GetAudioData(CaptureAudioData);
-
-			// Reset the read sample index since we got a new buffer of audio data
-			ReadSampleIndex = 0;
-		}
-
-		// note it's possible we didn't get any more audio in our last attempt to get it
-		if (CaptureAudioData.Num() > 0)
-		{
-			// Compute samples to copy
-			int32 NumSamplesToCopy = FMath::Min(NumSamples - OutputSamplesGenerated, CaptureAudioData.Num() - ReadSampleIndex);
-
-			float* CaptureDataPtr = CaptureAudioData.GetData();
-			FMemory::Memcpy(&OutAudio[OutputSamplesGenerated], &CaptureDataPtr[ReadSampleIndex], NumSamplesToCopy * sizeof(float));
-			ReadSampleIndex += NumSamplesToCopy;
-			OutputSamplesGenerated += NumSamplesToCopy;
-		}
+		// Copy straight out of the capture ring, the device callback keeps writing behind the samples we read
+		const float* FirstData;
+		const float* SecondData;
+		int32 FirstNum;
+		int32 SecondNum;
+		CaptureSynth.PeekAudioData(FirstData, FirstNum, SecondData, SecondNum);
+
+		const int32 NumFromFirst = FMath::Min(NumSamples, FirstNum);
+		const int32 NumFromSecond = FMath::Min(NumSamples - NumFromFirst, SecondNum);
+		FMemory::Memcpy(OutAudio, FirstData, NumFromFirst * sizeof(float));
+		FMemory::Memcpy(OutAudio + NumFromFirst, SecondData, NumFromSecond * sizeof(float));
+
+		OutputSamplesGenerated = NumFromFirst + NumFromSecond;
+		CaptureSynth.ConsumeAudioData(OutputSamplesGenerated);
 
 		CapturedAudioDataSamples += OutputSamplesGenerated;
 	}
@@ -9,6 +9,8 @@
 #include "VisionInterface.h"
 #include "Math/UnrealMathUtility.h"
 #include "ConvaiUtils.h"
+#include "ConvaiPlaybackClock.h"
+#include "AudioDevice.h"
 
 // THIRD_PARTY_INCLUDES_START
 #include "opus.h"
@@ -30,6 +32,12 @@
 //#define NUM_OPUS_FRAMES_PER_SEC 50
 #define NUM_OPUS_FRAMES_PER_SEC 50
 
+/** Lowest voice pre-roll the jitter buffer can shrink to on good connections */
+#define MIN_LIPSYNC_PREROLL_SECS 0.05f
+
+/** Rate the voice is rendered at when there is no audio device to ask */
+#define DEFAULT_VOICE_OUTPUT_SAMPLE_RATE 48000
+
 #define OPUS_CHECK_CTL(Category, CTL) \
 	if (ErrCode != OPUS_OK) \
 	{ \
@@ -39,11 +47,43 @@
 
 DEFINE_LOG_CATEGORY(ConvaiAudioStreamerLog);
 
+namespace
+{
+	// For audio the streamer does not own, reads the format from the wav header if there is one
+	FConvaiPCMChunkRef CopyVoiceChunk(uint8* VoiceData, uint32 VoiceDataSize, bool ContainsHeaderData, uint32 SampleRate, uint32 NumChannels)
+	{
+		if (ContainsHeaderData)
+		{
+			// Parse Wav header
+			FWaveModInfo WaveInfo;
+			FString ErrorReason;
+			if (WaveInfo.ReadWaveInfo(VoiceData, VoiceDataSize, &ErrorReason))
+			{
+				SampleRate = *WaveInfo.pSamplesPerSec;
+				NumChannels = *WaveInfo.pChannels;
+			}
+			else
+			{
+				UE_LOG(ConvaiAudioStreamerLog, Warning, TEXT("PlayVoiceData: Failed to parse wav header, reason: %s"), *ErrorReason);
+			}
+
+			// Play only the PCM data which start after 44 bytes
+			const uint32 HeaderSize = FMath::Min<uint32>(VoiceDataSize, 44);
+			VoiceData += HeaderSize;
+			VoiceDataSize -= HeaderSize;
+		}
+
+		return FConvaiPCMChunk::CreateCopy(VoiceData, VoiceDataSize, SampleRate, NumChannels);
+	}
+}
+
 UConvaiAudioStreamer::UConvaiAudioStreamer(const FObjectInitializer& ObjectInitializer)
 	: Super(ObjectInitializer)
 {
 	PrimaryComponentTick.bCanEverTick = true;
 	bAutoActivate = true;
+
+	PlaybackClock = MakeShared<FConvaiPlaybackClock, ESPMode::ThreadSafe>();
 }
 
 void UConvaiAudioStreamer::BroadcastVoiceDataToClients_Implementation(TArray<uint8> const& EncodedVoiceData, uint32 SampleRate, uint32 NumChannels, uint32 SizeBeforeEncode)
@@ -107,140 +147,64 @@ bool UConvaiAudioStreamer::ShouldMuteGlobal()
 }
 
 void UConvaiAudioStreamer::PlayVoiceSynced(uint8* VoiceData, uint32 VoiceDataSize, bool ContainsHeaderData, uint32 SampleRate, uint32 NumChannels)
+{
+	PlayVoiceSynced(CopyVoiceChunk(VoiceData, VoiceDataSize, ContainsHeaderData, SampleRate, NumChannels));
+}
+
+void UConvaiAudioStreamer::PlayVoiceSynced(const FConvaiPCMChunkRef& VoiceChunk)
 {
 	// if ReplicateVoiceToNetwork is true then just play the voice data right away to avoid the lipsync cutoff issue
-	if (!SupportsLipSync() || ConvaiLipSyncExtended == nullptr || !ConvaiLipSyncExtended->RequiresPreGeneratedFaceData() || ReplicateVoiceToNetwork)
+	if (!SupportsLipSync() || ConvaiLipSyncExtended == nullptr || !ConvaiLipSyncExtended->RequiresPreGeneratedFaceData() || FaceDataSkipped || ReplicateVoiceToNetwork)
 	{
-		PlayVoiceData(VoiceData, VoiceDataSize, ContainsHeaderData, SampleRate, NumChannels);
+		PlayVoiceData(VoiceChunk);
 		return;
 	}
 
-	if (ContainsHeaderData)
-	{
-		VoiceDataSize -= 44;
-	}
-
-	float AudioDuration = UConvaiUtils::CalculateAudioDuration(VoiceDataSize, NumChannels, SampleRate, 2);
-	ConvaiAudioChunk AudioChunk = ConvaiAudioChunk(TArray<uint8>(VoiceData, VoiceDataSize), AudioDuration, NumChannels, SampleRate, 2);
+	ConvaiAudioChunk AudioChunk = ConvaiAudioChunk(VoiceChunk);
+	JitterBuffer.OnAudioArrived(AudioChunk.AudioDuration);
 	DataBuffer.Enqueue(AudioChunk);
 
-	UE_LOG(ConvaiAudioStreamerLog, Warning, TEXT("PlayVoiceSynced: Added Audio Chunk - Audio Duration: %f"), AudioDuration);
+	UE_LOG(ConvaiAudioStreamerLog, Warning, TEXT("PlayVoiceSynced: Added Audio Chunk - Audio Duration: %f"), AudioChunk.AudioDuration);
 
 	//if (!IsTalking)
 	//	PauseLipSync();
 }
 
 void UConvaiAudioStreamer::PlayVoiceData(uint8* VoiceData, uint32 VoiceDataSize, bool ContainsHeaderData, uint32 SampleRate, uint32 NumChannels)
+{
+	PlayVoiceData(CopyVoiceChunk(VoiceData, VoiceDataSize, ContainsHeaderData, SampleRate, NumChannels));
+}
+
+void UConvaiAudioStreamer::PlayVoiceData(const FConvaiPCMChunkRef& VoiceChunk)
 {
 	if (IsVoiceCurrentlyFading())
 		StopVoice();
 	ResetVoiceFade();
 
-	uint32 PCM_DataSize = VoiceDataSize;
-
-	if (ContainsHeaderData)
-	{
-		// Parse Wav header
-		FWaveModInfo WaveInfo;
-		FString ErrorReason;
-		bool ParseSuccess = WaveInfo.ReadWaveInfo(VoiceData, VoiceDataSize, &ErrorReason);
-		// Set the number of channels and sample rate for the first time reading from the stream
-		if (ParseSuccess)
-		{
-			// Validate that the world exists
-			if (!IsValid(GetWorld()))
-				return;
-
-			SampleRate = *WaveInfo.pSamplesPerSec;
-			NumChannels = *WaveInfo.pChannels;
-			PCM_DataSize = *WaveInfo.pWaveDataSize;
-		}
-		else if (!ParseSuccess)
-		{
-			UE_LOG(ConvaiAudioStreamerLog, Warning, TEXT("PlayVoiceData: Failed to parse wav header, reason: %s"), *ErrorReason);
-		}
-	}
-
-
-	AsyncTask(ENamedThreads::GameThread, [this, PCM_DataSize, SampleRate]
-	{
-		if (!IsValid(GetWorld()))
-		{
-			UE_LOG(ConvaiAudioStreamerLog, Warning, TEXT("PlayVoiceData: GetWorld() is Invalid!"));
-			return;
-		}
-
-		// TODO (Mohamed): take number of channels in consideration when calculating the duration
-		// Duration = PCM Data Size / (Sample Rate * Bytes per sample)
-		float NewAudioDuration = float(PCM_DataSize) / float(SampleRate * 2);
-
-		float CurrentRemainingAudioDuration = GetWorld()->GetTimerManager().GetTimerRemaining(AudioFinishedTimerHandle);
-		if (CurrentRemainingAudioDuration < 0)
-			CurrentRemainingAudioDuration = 0; // Can never be less than zero
-
-		//if (CurrentRemainingAudioDuration == 0)
-		//	NewAudioDuration -= 0.1; // Hacky way - Reduce the duration by a small amount so that the OnAudioFinished would be called early and this will cause no gap between voice chunks
-
-		// New Duration = Remaining Duration + New Duration
-		float TotalAudioDuration = CurrentRemainingAudioDuration + NewAudioDuration;
-
-		GetWorld()->GetTimerManager().SetTimer(AudioFinishedTimerHandle, this, &UConvaiAudioStreamer::onAudioFinished, TotalAudioDuration, false);
-	});
-
-	if (!IsValid(SoundWaveProcedural))
+	if (!VoiceSource.IsValid())
 		return;
 
-	// TODO (Mohamed) : Needs further testing, especially when sample rate or NumChannels changes
-	// Check that SoundWaveProcedural is valid and able to play input sample rate and channels
-	if (SoundWaveProcedural->GetSampleRateForCurrentPlatform() != SampleRate || SoundWaveProcedural->NumChannels != NumChannels)
-	{
-		//if (IsValid(SoundWaveProcedural)) // Destroy SoundWaveProcedural if it is valid
-		//	SoundWaveProcedural->ConditionalBeginDestroy();
-
-		SoundWaveProcedural->SetSampleRate(SampleRate);
-		SoundWaveProcedural->NumChannels = NumChannels;
-		SoundWaveProcedural->Duration = INDEFINITELY_LOOPING_DURATION;
-		SoundWaveProcedural->SoundGroup = SOUNDGROUP_Voice;
-		SoundWaveProcedural->bLooping = false;
-		SoundWaveProcedural->bProcedural = true;
-		SoundWaveProcedural->Pitch = 1.0f;
-		SoundWaveProcedural->Volume = 1.0f;
-		SoundWaveProcedural->AttenuationSettings = nullptr;
-		SoundWaveProcedural->bDebug = true;
-		SoundWaveProcedural->VirtualizationMode = EVirtualizationMode::PlayWhenSilent;
-
-		UE_LOG(ConvaiAudioStreamerLog, Log, TEXT("New SampleRate: %d"), SampleRate);
-		UE_LOG(ConvaiAudioStreamerLog, Log, TEXT("New Channels: %d"), NumChannels);
-
-		AsyncTask(ENamedThreads::GameThread, [this]
-		{
-			SetSound(SoundWaveProcedural);
-			Play();
-		});
-	}
-
-	if (ContainsHeaderData)
-	{
-		// Play only the PCM data which start after 44 bytes
-		VoiceData += 44;
-		VoiceDataSize -= 44;
-	}
-
-	SoundWaveProcedural->QueueAudio(VoiceData, VoiceDataSize);
+	// Any sample rate and channel count is converted to the rate the voice is rendered at, the sound keeps playing
+	// The talk starts and finishes in UpdateVoicePlayback as the audio renderer plays what is queued here
+	VoiceSource->QueueAudio(VoiceChunk->GetSamples(), VoiceChunk->GetNumFrames(), VoiceChunk->GetSampleRate(), VoiceChunk->GetNumChannels());
+	MarkLatency(EConvaiLatencySpan::FirstAudioQueued);
 
+	if (IsInGameThread() && GetAudioDevice() && !IsPlaying())
+		Play();
 
-	if (!IsTalking)
+	// Only the caller that switches IsTalking on starts the talk, the game thread may be finishing the previous one
+	if (!IsTalking.exchange(true))
 	{
-		onAudioStarted();
-		IsTalking = true;
+		TalkingStartSeconds = PlaybackClock->GetLastQueuedStartSeconds();
+		TalkStartPending = true;
 	}
 
 	// Does the lipsync component require the blendshapes/Visemes to be sent to it
 	if (ConvaiLipSyncExtended && ConvaiLipSyncExtended->RequiresPreGeneratedFaceData())
 		return;
 	else
-		// Lipsync component process the audio data to generate the lipsync
-		PlayLipSync(VoiceData, VoiceDataSize, SampleRate, NumChannels);
+		// Lipsync component process the audio data to generate the lipsync, it only reads the data
+		PlayLipSync(const_cast<uint8*>(VoiceChunk->GetData()), VoiceChunk->GetNumBytes(), VoiceChunk->GetSampleRate(), VoiceChunk->GetNumChannels());
 }
 
 void UConvaiAudioStreamer::ForcePlayVoice(USoundWave* VoiceToPlay)
@@ -248,7 +212,7 @@ void UConvaiAudioStreamer::ForcePlayVoice(USoundWave* VoiceToPlay)
 	int32 SampleRate;
 	int32 NumChannels;
 	TArray<uint8> PCMData = UConvaiUtils::ExtractPCMDataFromSoundWave(VoiceToPlay, SampleRate, NumChannels);
-	PlayVoiceData(PCMData.GetData(), PCMData.Num(), false, SampleRate, NumChannels);
+	PlayVoiceData(FConvaiPCMChunk::Create(MoveTemp(PCMData), 0, SampleRate, NumChannels));
 }
 
 void UConvaiAudioStreamer::StopVoice()
@@ -261,13 +225,43 @@ void UConvaiAudioStreamer::StopVoice()
 
 	if (!IsTalking && DataBuffer.IsEmpty())
 		return;
-	if (SoundWaveProcedural)
-		SoundWaveProcedural->ResetAudio();
+	if (VoiceSource.IsValid())
+		VoiceSource->Reset();
 	
 	bIsQueuingLipsync = true;
 	StopLipSync();
 	onAudioFinished();
-	ClearAudioFinishedTimer();
+}
+
+void UConvaiAudioStreamer::BeginVoiceResponse()
+{
+	JitterBuffer.BeginSession();
+	if (VoiceSource.IsValid())
+		VoiceSource->BeginStream();
+
+	// The encoder stream starts over, nothing of the last response may bleed into this one
+	EncoderResampler.Reset();
+	EncoderResamplerHasTail = false;
+}
+
+void UConvaiAudioStreamer::EndVoiceResponse()
+{
+	JitterBuffer.OnEndOfResponse();
+	if (VoiceSource.IsValid())
+		VoiceSource->EndStream();
+
+	// Send the end of the response the resampler still holds back, only if the encoder was fed through it
+	if (EncoderResamplerHasTail)
+	{
+		EncoderResamplerHasTail = false;
+
+		TArray<int16> Tail;
+		EncoderResampler.Flush(Tail);
+		if (ReplicateVoiceToNetwork && EncoderSampleRate == EncoderResampler.GetOutputSampleRate() && EncoderNumChannels == 1)
+		{
+			AudioDataBuffer.Append((const uint8*)Tail.GetData(), Tail.Num() * sizeof(int16));
+		}
+	}
 }
 
 void UConvaiAudioStreamer::PauseVoice()
@@ -275,7 +269,6 @@ void UConvaiAudioStreamer::PauseVoice()
 	if (bIsPaused)
 		return;
 
-	GetWorld()->GetTimerManager().PauseTimer(AudioFinishedTimerHandle);
 	SetPaused(true);
 	IsTalking = false;
 }
@@ -285,10 +278,6 @@ void UConvaiAudioStreamer::ResumeVoice()
 	if (!bIsPaused)
 		return;
 
-	AsyncTask(ENamedThreads::GameThread, [this]
-	{
-		GetWorld()->GetTimerManager().UnPauseTimer(AudioFinishedTimerHandle);
-	});
 	SetPaused(false);
 }
 
@@ -303,7 +292,7 @@ void UConvaiAudioStreamer::StopVoiceWithFade(float InVoiceFadeOutDuration)
 		return;
 	}
 
-	float CurrentRemainingAudioDuration = GetWorld()->GetTimerManager().GetTimerRemaining(AudioFinishedTimerHandle);
+	float CurrentRemainingAudioDuration = PlaybackClock->GetRemainingSeconds();
 	TotalVoiceFadeOutTime = FMath::Min(InVoiceFadeOutDuration, CurrentRemainingAudioDuration);
 	RemainingVoiceFadeOutTime = TotalVoiceFadeOutTime;
 
@@ -313,15 +302,15 @@ void UConvaiAudioStreamer::StopVoiceWithFade(float InVoiceFadeOutDuration)
 
 void UConvaiAudioStreamer::ResetVoiceFade()
 {
-	if (IsValid(SoundWaveProcedural))
-		SoundWaveProcedural->Volume = 1.0f;
+	if (IsValid(VoiceSoundWave))
+		VoiceSoundWave->Volume = 1.0f;
 	TotalVoiceFadeOutTime = 0;
 	RemainingVoiceFadeOutTime = 0;
 }
 
 void UConvaiAudioStreamer::UpdateVoiceFade(float DeltaTime)
 {
-	if (!IsVoiceCurrentlyFading() || !IsValid(SoundWaveProcedural))
+	if (!IsVoiceCurrentlyFading() || !IsValid(VoiceSoundWave))
 		return;
 	RemainingVoiceFadeOutTime -= DeltaTime;
 	if (RemainingVoiceFadeOutTime <= 0)
@@ -330,7 +319,7 @@ void UConvaiAudioStreamer::UpdateVoiceFade(float DeltaTime)
 		return;
 	}
 	float AudioVolume = RemainingVoiceFadeOutTime / TotalVoiceFadeOutTime;
-	SoundWaveProcedural->Volume = AudioVolume;
+	VoiceSoundWave->Volume = AudioVolume;
 }
 
 bool UConvaiAudioStreamer::IsVoiceCurrentlyFading()
@@ -338,14 +327,46 @@ bool UConvaiAudioStreamer::IsVoiceCurrentlyFading()
 	return (TotalVoiceFadeOutTime > 0 && IsTalking);
 }
 
-void UConvaiAudioStreamer::ClearAudioFinishedTimer()
+void UConvaiAudioStreamer::UpdateVoicePlayback(float DeltaTime)
 {
-	if (!IsValid(GetWorld()))
-	{
-		UE_LOG(ConvaiAudioStreamerLog, Warning, TEXT("ClearAudioFinishedTimer: GetWorld() is Invalid!"));
+	if (!VoiceSource.IsValid())
+		return;
+
+	VoiceSource->Pump();
+
+	if (!IsTalking || bIsPaused)
 		return;
+
+	if (GetAudioDevice())
+	{
+		// The sound renders silence between talks, it only needs starting once or after something stopped it
+		if (!IsPlaying())
+			Play();
+	}
+	else
+	{
+		// Nothing renders the voice without an audio device, e.g. on dedicated servers or with -nosound, so play it out against the game time
+		VoiceSource->ConsumeWithoutAudioDevice(DeltaTime);
+	}
+
+	if (TalkStartPending && PlaybackClock->GetPlayedSeconds() > TalkingStartSeconds)
+	{
+		TalkStartPending = false;
+		onAudioStarted();
+	}
+
+	if (!VoiceSource->HasPendingAudio())
+	{
+		// Only a voice that ran dry by itself can be an underrun, not one that was stopped
+		if (DataBuffer.IsEmpty())
+			JitterBuffer.OnPlayoutDrained();
+		onAudioFinished();
 	}
-	GetWorld()->GetTimerManager().ClearTimer(AudioFinishedTimerHandle);
+}
+
+FConvaiVoiceSourceStats UConvaiAudioStreamer::GetVoiceStats() const
+{
+	return VoiceSource.IsValid() ? VoiceSource->GetStats() : FConvaiVoiceSourceStats();
 }
 
 // Not used
@@ -394,6 +415,8 @@ bool UConvaiAudioStreamer::SetLipSyncComponent(UActorComponent* LipSyncComponent
 	{
 		ConvaiLipSync = Cast<IConvaiLipSyncInterface>(LipSyncComponent);
 		ConvaiLipSyncExtended = Cast<IConvaiLipSyncExtendedInterface>(LipSyncComponent);
+		if (ConvaiLipSyncExtended)
+			ConvaiLipSyncExtended->ConvaiSetPlaybackClock(PlaybackClock);
 		ConvaiLipSync->OnVisemesDataReady.BindUObject(this, &UConvaiAudioStreamer::OnVisemesReadyCallback);
 		return true;
 	}
@@ -465,7 +488,23 @@ void UConvaiAudioStreamer::BeginPlay()
 	bAutoActivate = true;
 	bAlwaysPlay = true;
 
-	SoundWaveProcedural = NewObject<USoundWaveProcedural>();
+	// The voice is converted to the device rate when queued, so the sound wave is set up once and never restarted
+	const int32 OutputSampleRate = GetAudioDevice() ? int32(GetAudioDevice()->GetSampleRate()) : DEFAULT_VOICE_OUTPUT_SAMPLE_RATE;
+	VoiceSource = MakeShared<FConvaiVoiceSource, ESPMode::ThreadSafe>(OutputSampleRate, PlaybackClock);
+
+	VoiceSoundWave = NewObject<UConvaiVoiceSoundWave>();
+	VoiceSoundWave->SetVoiceSource(VoiceSource);
+	VoiceSoundWave->SetSampleRate(OutputSampleRate);
+	VoiceSoundWave->NumChannels = 1;
+	VoiceSoundWave->Duration = INDEFINITELY_LOOPING_DURATION;
+	VoiceSoundWave->SoundGroup = SOUNDGROUP_Voice;
+	VoiceSoundWave->bLooping = false;
+	VoiceSoundWave->bProcedural = true;
+	VoiceSoundWave->Pitch = 1.0f;
+	VoiceSoundWave->Volume = 1.0f;
+	VoiceSoundWave->AttenuationSettings = nullptr;
+	VoiceSoundWave->VirtualizationMode = EVirtualizationMode::PlayWhenSilent;
+	SetSound(VoiceSoundWave);
 
 	if (ConvaiLipSync == nullptr)
 		FindFirstLipSyncComponent();
@@ -480,6 +519,8 @@ void UConvaiAudioStreamer::TickComponent(float DeltaTime, ELevelTick TickType, F
 
 	UpdateVoiceFade(DeltaTime);
 
+	UpdateVoicePlayback(DeltaTime);
+
 	int32 BytesPerFrame = EncoderFrameSize * EncoderNumChannels * sizeof(opus_int16);
 	if (AudioDataBuffer.Num() >= BytesPerFrame && Encoder)
 	{
@@ -521,7 +562,7 @@ void UConvaiAudioStreamer::DestroyOpus()
 void UConvaiAudioStreamer::PlayLipSyncWithPreGeneratedDataSynced(FAnimationSequence& FaceSequence)
 {
 	// Play the lipsync right away as a workaround for lipsync issue on multiplayer
-	if (!SupportsLipSync() || ConvaiLipSyncExtended == nullptr || !ConvaiLipSyncExtended->RequiresPreGeneratedFaceData() || ReplicateVoiceToNetwork)
+	if (!SupportsLipSync() || ConvaiLipSyncExtended == nullptr || !ConvaiLipSyncExtended->RequiresPreGeneratedFaceData() || FaceDataSkipped || ReplicateVoiceToNetwork)
 		PlayLipSyncWithPreGeneratedData(FaceSequence);
 
 	CurrentChunkFrameCounter++;
@@ -529,6 +570,7 @@ void UConvaiAudioStreamer::PlayLipSyncWithPreGeneratedDataSynced(FAnimationSeque
 	if (FaceSequence.AnimationFrames.Num() == 0)
 		return;
 
+	JitterBuffer.OnFaceArrived(FaceSequence.Duration);
 
 	int32 CurrentFrameIndex = FaceSequence.AnimationFrames[0].FrameIndex;
 
@@ -568,7 +610,7 @@ void UConvaiAudioStreamer::PlayLipSyncWithPreGeneratedDataSynced(FAnimationSeque
 
 		if (DataBuffer.IsEmptyLipSync())
 		{
-			UE_LOG(ConvaiAudioStreamerLog, Log, TEXT("PlayLipSyncWithPreGeneratedDataSynced: Trying to Enqueue while DataBuffer.IsEmptyLipSync() - IsTalking = %s - bIsPaused = %s"), IsTalking ? TEXT("true") : TEXT("false"), bIsPaused ? TEXT("true") : TEXT("false"));
+			UE_LOG(ConvaiAudioStreamerLog, Log, TEXT("PlayLipSyncWithPreGeneratedDataSynced: Trying to Enqueue while DataBuffer.IsEmptyLipSync() - IsTalking = %s - bIsPaused = %s"), IsTalking.load() ? TEXT("true") : TEXT("false"), bIsPaused ? TEXT("true") : TEXT("false"));
 		}
 
 		DataBuffer.EnqueueLipSync(FaceSequence, false);
@@ -706,6 +748,7 @@ void UConvaiAudioStreamer::AddPCMDataToSend(TArray<uint8> PCMDataToAdd,
 											bool ContainsHeaderData,
                                             uint32 InSampleRate,
                                             uint32 InNumChannels) {
+	int32 HeaderSize = 0;
 	if (ContainsHeaderData)
 	{
 		// Parse Wav header
@@ -717,7 +760,7 @@ void UConvaiAudioStreamer::AddPCMDataToSend(TArray<uint8> PCMDataToAdd,
 		{
 			InSampleRate = *WaveInfo.pSamplesPerSec;
 			InNumChannels = *WaveInfo.pChannels;
-			PCMDataToAdd.RemoveAt(0, 44); // Remove the header bytes 
+			HeaderSize = 44; // Skipped by the chunk rather than removed from the array
 		}
 		else if (!ParseSuccess)
 		{
@@ -725,24 +768,35 @@ void UConvaiAudioStreamer::AddPCMDataToSend(TArray<uint8> PCMDataToAdd,
 		}
 	}
 
-	InNumChannels = FMath::Max((int)InNumChannels, 1);
+	AddPCMChunkToSend(FConvaiPCMChunk::Create(MoveTemp(PCMDataToAdd), HeaderSize, InSampleRate, InNumChannels));
+}
 
-	TArray<int16> OutConverted;
-	
-	if (ReplicateVoiceToNetwork && (InNumChannels > 1 || InSampleRate > 24000))
-	{
-		UConvaiUtils::ResampleAudio(InSampleRate, 24000, InNumChannels, true, (int16*)PCMDataToAdd.GetData(), PCMDataToAdd.Num()/2, OutConverted);
-		InSampleRate = 24000;
-		InNumChannels = 1;
-	}
-	else
-	{
-		OutConverted = TArray<int16>((int16*)PCMDataToAdd.GetData(), PCMDataToAdd.Num()/2);
-	}
+void UConvaiAudioStreamer::AddPCMChunkToSend(const FConvaiPCMChunkRef& PCMChunk)
+{
+	uint32 InSampleRate = PCMChunk->GetSampleRate();
+	uint32 InNumChannels = PCMChunk->GetNumChannels();
 
 	// Send it over to the encoder if we are to stream the voice audio to other clients
 	if (ReplicateVoiceToNetwork)
 	{
+		TArray<int16> OutConverted;
+		const int16* EncoderInput = PCMChunk->GetSamples();
+		int32 EncoderInputSamples = PCMChunk->GetNumFrames() * PCMChunk->GetNumChannels();
+
+		if (InNumChannels > 1 || InSampleRate > 24000)
+		{
+			if (EncoderResampler.GetInputSampleRate() != InSampleRate || EncoderResampler.GetOutputSampleRate() != 24000)
+			{
+				EncoderResampler.Init(InSampleRate, 24000);
+			}
+			EncoderResampler.Process(EncoderInput, PCMChunk->GetNumFrames(), InNumChannels, OutConverted);
+			EncoderResamplerHasTail = true;
+			EncoderInput = OutConverted.GetData();
+			EncoderInputSamples = OutConverted.Num();
+			InSampleRate = 24000;
+			InNumChannels = 1;
+		}
+
 		// Check that encoder is valid and able to encode the input sample rate and channels
 		if (InSampleRate != EncoderSampleRate || InNumChannels != EncoderNumChannels)
 		{
@@ -751,23 +805,64 @@ void UConvaiAudioStreamer::AddPCMDataToSend(TArray<uint8> PCMDataToAdd,
 			InitEncoder(InSampleRate, InNumChannels, EAudioEncodeHint::VoiceEncode_Voice);
 			UE_LOG(ConvaiAudioStreamerLog, Log, TEXT("Initialized Encoder with SampleRate:%d and Channels:%d"), EncoderSampleRate, EncoderNumChannels);
 		}
-		AudioDataBuffer.Append((uint8*)OutConverted.GetData(), OutConverted.Num()*2);
+		AudioDataBuffer.Append((const uint8*)EncoderInput, EncoderInputSamples * sizeof(int16));
 	}
 	else if (!ShouldMuteLocal())
 	{
 		// Just play it locally
-		PlayVoiceSynced((uint8*)OutConverted.GetData(), OutConverted.Num()*2, false, InSampleRate, InNumChannels);
+		PlayVoiceSynced(PCMChunk);
 	}
 }
 
 void UConvaiAudioStreamer::onAudioStarted()
 {
 	AsyncTask(ENamedThreads::GameThread, [this] {
+		MarkLatency(EConvaiLatencySpan::StartedTalking);
+		CommitLatencyTrace();
 		OnStartedTalking.Broadcast();
 		});
 	
 }
 
+void UConvaiAudioStreamer::BeginLatencyTrace(const FString& CharacterID, const FString& SessionID)
+{
+	CommitLatencyTrace();
+
+	FScopeLock Lock(&LatencyTraceSection);
+	LatencyTrace = MakeShared<FConvaiTurnTrace, ESPMode::ThreadSafe>(CharacterID, SessionID);
+}
+
+FConvaiTurnTracePtr UConvaiAudioStreamer::GetLatencyTrace()
+{
+	FScopeLock Lock(&LatencyTraceSection);
+	return LatencyTrace;
+}
+
+void UConvaiAudioStreamer::MarkLatency(EConvaiLatencySpan Span)
+{
+	if (FConvaiTurnTracePtr Trace = GetLatencyTrace())
+	{
+		Trace->Mark(Span);
+	}
+}
+
+void UConvaiAudioStreamer::CommitLatencyTrace(const FConvaiTurnTrace* OnlyIfCurrent)
+{
+	FConvaiTurnTracePtr Trace;
+	{
+		FScopeLock Lock(&LatencyTraceSection);
+		if (OnlyIfCurrent && LatencyTrace.Get() != OnlyIfCurrent)
+			return;
+		Trace = MoveTemp(LatencyTrace);
+	}
+
+	if (Trace.IsValid())
+	{
+		LastLatencyTrace = Trace->ToLatencyTrace();
+		FConvaiLatencyTracer::Get().Submit(LastLatencyTrace);
+	}
+}
+
 void UConvaiAudioStreamer::onAudioFinished()
 {
 	UE_LOG(ConvaiAudioStreamerLog, Log, TEXT("onAudioFinished"));
@@ -789,12 +884,17 @@ void UConvaiAudioStreamer::onAudioFinished()
 			else
 			{
 				UE_LOG(ConvaiAudioStreamerLog, Log, TEXT("onAudioFinished: Pausing Voice and Lipsync"));
+				JitterBuffer.OnFaceUnderrun();
 				PauseVoice();
 				StopLipSync();
 			}
 		//});
 	}
 
+	// Keeps the talking events paired when the voice is stopped before its first sample was played
+	if (TalkStartPending.exchange(false))
+		onAudioStarted();
+
 	AsyncTask(ENamedThreads::GameThread, [this] {
 		OnFinishedTalking.Broadcast();
 	});
@@ -807,7 +907,8 @@ bool UConvaiAudioStreamer::PlayNextAudioInQueue()
 		return false;
 	ConvaiAudioChunk NextAudioChunk;
 	DataBuffer.Dequeue(NextAudioChunk);
-	PlayVoiceData(NextAudioChunk.AudioData.GetData(), NextAudioChunk.AudioData.Num(), false, NextAudioChunk.SampleRate, NextAudioChunk.NumChannels);
+	if (NextAudioChunk.AudioData.IsValid())
+		PlayVoiceData(NextAudioChunk.AudioData.ToSharedRef());
 	UE_LOG(ConvaiAudioStreamerLog, Log, TEXT("PlayNextAudioInQueue - Duration: %f - Chunks Remaining: %d"), NextAudioChunk.AudioDuration, DataBuffer.NumAudioChunks);
 	return true;
 }
@@ -828,9 +929,8 @@ bool UConvaiAudioStreamer::PlayAvailableAudioAndLipSync()
 	if (DataBuffer.IsEmpty() || DataBuffer.IsEmptyLipSync())
 		return false;
 
-	TArray<uint8> MergedVoiceData;
-	uint32 NumChannels;
-	uint32 SampleRate;
+	// Queued one after the other instead of merged, the voice source appends them anyway
+	TArray<FConvaiPCMChunkRef, TInlineAllocator<16>> MergedVoiceChunks;
 	float AudioDuration = 0;
 	int AudioChunks = 0;
 
@@ -841,11 +941,9 @@ bool UConvaiAudioStreamer::PlayAvailableAudioAndLipSync()
 	{
 
 		ConvaiAudioChunk NextAudioChunk;
-		if (DataBuffer.Dequeue(NextAudioChunk))
+		if (DataBuffer.Dequeue(NextAudioChunk) && NextAudioChunk.AudioData.IsValid())
 		{
-			MergedVoiceData.Append(NextAudioChunk.AudioData);
-			NumChannels = NextAudioChunk.NumChannels;
-			SampleRate = NextAudioChunk.SampleRate;
+			MergedVoiceChunks.Add(NextAudioChunk.AudioData.ToSharedRef());
 			AudioDuration += NextAudioChunk.AudioDuration;
 			AudioChunks++;
 		}
@@ -859,13 +957,14 @@ bool UConvaiAudioStreamer::PlayAvailableAudioAndLipSync()
 		}
 	}
 
-	if (MergedVoiceData.Num() == 0 && MergedLipSyncData.AnimationFrames.Num() == 0)
+	if (MergedVoiceChunks.Num() == 0 && MergedLipSyncData.AnimationFrames.Num() == 0)
 	{
 		return false;
 	}
 	else
 	{
-		PlayVoiceData(MergedVoiceData.GetData(), MergedVoiceData.Num(), false, SampleRate, NumChannels);
+		for (const FConvaiPCMChunkRef& VoiceChunk : MergedVoiceChunks)
+			PlayVoiceData(VoiceChunk);
 		PlayLipSyncWithPreGeneratedData(MergedLipSyncData);
 		UE_LOG(ConvaiAudioStreamerLog, Log, TEXT("Play Available Audio and LipSync - Audio Duration: %f - Audio Chunks: %d - LipSync Duration: %f - LipSync Chunks: %d - Audio Chunks Remaining: %d - LipSync Chunks Remaining: %d"), AudioDuration, AudioChunks, MergedLipSyncData.Duration, LipSyncChunks, DataBuffer.NumAudioChunks, DataBuffer.NumLipSyncChunks);
 		return true;
@@ -900,6 +999,7 @@ bool UConvaiAudioStreamer::HasSufficentLipsyncFrames(float& InSyncTimeRemaining)
 			{
 				LipSyncThresholdSecs = UConvaiSettingsUtils::GetParamValueAsFloat("LipSyncThresholdSecs", LipSyncThresholdSecs) ? LipSyncThresholdSecs : 0.7f;
 				LipSyncThresholdSecs = LipSyncThresholdSecs < 0 ? 0 : LipSyncThresholdSecs;
+				JitterBuffer.SetPreRollLimits(FMath::Min(MIN_LIPSYNC_PREROLL_SECS, LipSyncThresholdSecs), LipSyncThresholdSecs);
 			}
 			if (VoiceTimeFactor < 0)
 			{
@@ -908,9 +1008,12 @@ bool UConvaiAudioStreamer::HasSufficentLipsyncFrames(float& InSyncTimeRemaining)
 			}
 
 
-			if (RemainingLipSyncTime > LipSyncThresholdSecs || (RemainingLipSyncTime >= RemainingVoiceTime * VoiceTimeFactor))
+			// Sized from the arrival jitter of this character's responses, LipSyncThresholdSecs is only the upper bound
+			const float PreRollSecs = JitterBuffer.GetPreRollSecs();
+
+			if (RemainingLipSyncTime > PreRollSecs || (RemainingLipSyncTime >= RemainingVoiceTime * VoiceTimeFactor))
 			{
-				if (DataBuffer.LastLipSyncChunkDuration > LipSyncThresholdSecs || DataBuffer.LastLipSyncChunkDuration >= DataBuffer.LastAudioChunkDuration * VoiceTimeFactor)
+				if (DataBuffer.LastLipSyncChunkDuration > PreRollSecs || DataBuffer.LastLipSyncChunkDuration >= DataBuffer.LastAudioChunkDuration * VoiceTimeFactor)
 				{
 					InSyncTimeRemaining = DataBuffer.TotalBufferedLipSyncDuration;
 				}
@@ -0,0 +1,962 @@
+// Copyright 2022 Convai Inc. All Rights Reserved.
+
+#include "ConvaiBenchmark.h"
+#include "ConvaiChatbotComponent.h"
+#include "ConvaiPlayerComponent.h"
+#include "ConvaiFaceSync.h"
+#include "ConvaiFaceSyncSubsystem.h"
+#include "ConvaiLocalService.h"
+#include "ConvaiPCMChunk.h"
+#include "ConvaiDefinitions.h"
+#include "ConvaiSpscRingBuffer.h"
+#include "ConvaiResampler.h"
+#include "ConvaiSubsystem.h"
+#include "ConvaiUtils.h"
+#include "SampleBuffer.h"
+#include "RingBuffer.h"
+#include "Async/Async.h"
+#include "../Convai.h"
+#include "Engine/World.h"
+#include "Engine/Engine.h"
+#include "GameFramework/Actor.h"
+#include "TimerManager.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformTime.h"
+#include "HAL/PlatformMemory.h"
+#include "Misc/Parse.h"
+#include "UObject/Package.h"
+#include "HAL/MemoryBase.h"
+#include "HAL/PlatformTLS.h"
+#include <string>
+
+DEFINE_LOG_CATEGORY(ConvaiBenchmarkLog);
+
+const FString UConvaiBenchmark::BenchmarkCharacterID = TEXT("convai-benchmark");
+
+UConvaiBenchmark* UConvaiBenchmark::RunningBenchmark = nullptr;
+
+namespace
+{
+	const TCHAR* BenchmarkPrompts[] = {
+		TEXT("Hello there, who are you?"),
+		TEXT("What can you tell me about this place?"),
+		TEXT("Can you help me find the way out?"),
+		TEXT("Thank you, goodbye."),
+	};
+
+	// Time between two polls of the pairs, short enough not to skew turn times noticeably
+	constexpr float BenchmarkTickInterval = 0.01f;
+
+	float Percentile(const TArray<float>& Sorted, float Fraction)
+	{
+		if (Sorted.Num() == 0)
+		{
+			return 0;
+		}
+		return Sorted[FMath::Clamp(FMath::CeilToInt(Fraction * Sorted.Num()) - 1, 0, Sorted.Num() - 1)];
+	}
+
+	/**
+	 * Forwards to the engine allocator and counts the allocations made by one thread, so a benchmark can count its own heap traffic
+	 * while the rest of the engine keeps allocating. Never destroyed, another thread may still be inside it after it is swapped out.
+	 */
+	class FConvaiCountingMalloc final : public FMalloc
+	{
+	public:
+		void Begin()
+		{
+			check(IsInGameThread() && GMalloc != this);
+			NumAllocations = 0;
+			CountedThreadId = FPlatformTLS::GetCurrentThreadId();
+			Inner = GMalloc;
+			GMalloc = this;
+		}
+
+		int64 End()
+		{
+			check(GMalloc == this);
+			// Inner stays set for the threads that picked this allocator up before the swap
+			GMalloc = Inner;
+			CountedThreadId = 0;
+			return NumAllocations;
+		}
+
+		virtual void* Malloc(SIZE_T Count, uint32 Alignment) override
+		{
+			CountAllocation(Count);
+			return Inner->Malloc(Count, Alignment);
+		}
+
+		virtual void* Realloc(void* Original, SIZE_T Count, uint32 Alignment) override
+		{
+			CountAllocation(Count);
+			return Inner->Realloc(Original, Count, Alignment);
+		}
+
+		virtual void Free(void* Original) override { Inner->Free(Original); }
+		virtual SIZE_T QuantizeSize(SIZE_T Count, uint32 Alignment) override { return Inner->QuantizeSize(Count, Alignment); }
+		virtual bool GetAllocationSize(void* Original, SIZE_T& SizeOut) override { return Inner->GetAllocationSize(Original, SizeOut); }
+		virtual void Trim(bool bTrimThreadCaches) override { Inner->Trim(bTrimThreadCaches); }
+		virtual void SetupTLSCachesOnCurrentThread() override { Inner->SetupTLSCachesOnCurrentThread(); }
+		virtual void ClearAndDisableTLSCachesOnCurrentThread() override { Inner->ClearAndDisableTLSCachesOnCurrentThread(); }
+		virtual bool IsInternallyThreadSafe() const override { return Inner->IsInternallyThreadSafe(); }
+		virtual const TCHAR* GetDescriptiveName() override { return TEXT("ConvaiCountingMalloc"); }
+
+	private:
+		void CountAllocation(SIZE_T Size)
+		{
+			if (Size > 0 && FPlatformTLS::GetCurrentThreadId() == CountedThreadId)
+			{
+				NumAllocations++;
+			}
+		}
+
+		FMalloc* Inner = nullptr;
+		uint32 CountedThreadId = 0;
+		int64 NumAllocations = 0;
+	};
+
+	FConvaiCountingMalloc& GetCountingMalloc()
+	{
+		static FConvaiCountingMalloc* CountingMalloc = new FConvaiCountingMalloc();
+		return *CountingMalloc;
+	}
+
+	// Spread over a long duration so no component runs out of frames while being measured
+	FAnimationSequence MakeFaceSyncBenchmarkSequence(EConvaiFaceCurveSet CurveSet)
+	{
+		constexpr int32 NumFrames = 100;
+
+		FAnimationSequence Sequence;
+		Sequence.AnimationFrames.SetNum(NumFrames);
+		for (int32 Index = 0; Index < NumFrames; Index++)
+		{
+			FAnimationFrame& Frame = Sequence.AnimationFrames[Index];
+			Frame.FrameIndex = Index;
+			Frame.InitCurveSet(CurveSet);
+			for (float& Value : Frame.CurveValues)
+			{
+				Value = FMath::FRand();
+			}
+		}
+		Sequence.Duration = 600;
+		Sequence.FrameRate = 100;
+		return Sequence;
+	}
+}
+
+FString FConvaiBenchmarkResults::ToString() const
+{
+	FString Result = FString::Printf(TEXT("Pairs: %d | Turns: %d (%d timed out) | Duration: %.1f s | Throughput: %.2f turns/s | CPU: %.1f ms/turn | Peak Memory: %.1f MB (+%.1f MB) | Turn p50/p95/p99: %.0f/%.0f/%.0f ms"),
+		NumPairs,
+		NumTurnsCompleted,
+		NumTurnsTimedOut,
+		DurationSeconds,
+		TurnsPerSecond,
+		CpuMsPerTurn,
+		PeakUsedPhysicalMB,
+		PeakGrowthMB,
+		TurnP50Ms,
+		TurnP95Ms,
+		TurnP99Ms);
+
+	for (const FConvaiLatencySpanStats& Stats : LatencyStats)
+	{
+		Result += FString::Printf(TEXT("\n\t%s p50/p95: %.0f/%.0f ms (%d samples)"), LexToString(Stats.Span), Stats.P50Ms, Stats.P95Ms, Stats.NumSamples);
+	}
+	return Result;
+}
+
+UConvaiBenchmark* UConvaiBenchmark::StartConvaiBenchmark(UObject* WorldContextObject, int32 NumPairs, int32 TurnsPerPair, bool InVoiceResponse, float InTurnTimeoutSeconds)
+{
+	if (IsValid(RunningBenchmark))
+	{
+		UE_LOG(ConvaiBenchmarkLog, Warning, TEXT("StartConvaiBenchmark: A benchmark is already running"));
+		return nullptr;
+	}
+
+	UWorld* World = GEngine->GetWorldFromContextObject(WorldContextObject, EGetWorldErrorMode::LogAndReturnNull);
+	if (!World)
+	{
+		UE_LOG(ConvaiBenchmarkLog, Warning, TEXT("StartConvaiBenchmark: Could not get the world"));
+		return nullptr;
+	}
+
+	UConvaiBenchmark* Benchmark = NewObject<UConvaiBenchmark>();
+	if (!Benchmark->Begin(World, NumPairs, TurnsPerPair, InVoiceResponse, InTurnTimeoutSeconds))
+	{
+		return nullptr;
+	}
+	return Benchmark;
+}
+
+void UConvaiBenchmark::StopConvaiBenchmark()
+{
+	if (IsValid(RunningBenchmark))
+	{
+		RunningBenchmark->Finish();
+	}
+}
+
+bool UConvaiBenchmark::Begin(UWorld* World, int32 NumPairs, int32 TurnsPerPair, bool InVoiceResponse, float InTurnTimeoutSeconds)
+{
+	NumPairs = FMath::Max(NumPairs, 1);
+	TurnsPerPair = FMath::Max(TurnsPerPair, 1);
+	VoiceResponse = InVoiceResponse;
+	TurnTimeoutSeconds = FMath::Max(InTurnTimeoutSeconds, 1.f);
+	WorldPtr = World;
+
+	const FString URL = Convai::Get().GetConvaiSettings()->CustomURL;
+	UE_LOG(ConvaiBenchmarkLog, Log, TEXT("Starting benchmark | Pairs: %d | Turns per pair: %d | Voice Response: %s | Server: %s | Local Service: %s"),
+		NumPairs,
+		TurnsPerPair,
+		*FString(VoiceResponse ? "True" : "False"),
+		*FString(URL.IsEmpty() ? "Default" : URL),
+		*FString(FConvaiLocalService::Get().IsRunning() ? FConvaiLocalService::Get().GetAddress() : "Not Running"));
+
+	for (int32 i = 0; i < NumPairs; i++)
+	{
+		FActorSpawnParameters SpawnParams;
+		SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+		AActor* Actor = World->SpawnActor<AActor>(AActor::StaticClass(), FTransform::Identity, SpawnParams);
+		if (!IsValid(Actor))
+		{
+			UE_LOG(ConvaiBenchmarkLog, Warning, TEXT("Begin: Could not spawn the actor of pair %d"), i);
+			continue;
+		}
+
+		UConvaiChatbotComponent* Chatbot = NewObject<UConvaiChatbotComponent>(Actor);
+		Actor->SetRootComponent(Chatbot);
+		Chatbot->RegisterComponent();
+
+		UConvaiPlayerComponent* Player = NewObject<UConvaiPlayerComponent>(Actor);
+		Player->SetupAttachment(Chatbot);
+		Player->RegisterComponent();
+		Player->PlayerName = FString::Printf(TEXT("Player %d"), i);
+
+		// Set after registration so BeginPlay does not fetch the character details from the backend
+		Chatbot->CharacterID = BenchmarkCharacterID;
+		Chatbot->CharacterName = FString::Printf(TEXT("Character %d"), i);
+
+		Actors.Add(Actor);
+		Chatbots.Add(Chatbot);
+		Players.Add(Player);
+
+		FPairState& State = PairStates.AddDefaulted_GetRef();
+		State.TurnsLeft = TurnsPerPair;
+	}
+
+	if (PairStates.Num() == 0)
+	{
+		return false;
+	}
+
+	FConvaiLatencyTracer::Get().Reset();
+	FConvaiPCMChunk::ResetStats();
+
+	const FPlatformMemoryStats MemoryStats = FPlatformMemory::GetStats();
+	StartUsedPhysical = MemoryStats.UsedPhysical;
+	PeakUsedPhysical = MemoryStats.UsedPhysical;
+	StartTime = FPlatformTime::Seconds();
+	LastSampleTime = StartTime;
+	FPlatformTime::GetCPUTime(); // Starts a new measurement interval
+
+	Running = true;
+	RunningBenchmark = this;
+	AddToRoot();
+
+	World->GetTimerManager().SetTimer(TickTimerHandle, FTimerDelegate::CreateUObject(this, &UConvaiBenchmark::Tick), BenchmarkTickInterval, true);
+	return true;
+}
+
+void UConvaiBenchmark::Tick()
+{
+	if (!Running)
+	{
+		return;
+	}
+
+	SampleUsage();
+
+	const double Now = FPlatformTime::Seconds();
+	bool AllDone = true;
+
+	for (int32 i = 0; i < PairStates.Num(); i++)
+	{
+		FPairState& State = PairStates[i];
+		UConvaiChatbotComponent* Chatbot = Chatbots[i];
+		UConvaiPlayerComponent* Player = Players[i];
+		if (!IsValid(Chatbot) || !IsValid(Player))
+		{
+			continue;
+		}
+
+		if (State.InTurn)
+		{
+			const bool Active = Chatbot->IsInConversation();
+			State.SeenActive |= Active;
+
+			if (State.SeenActive && !Active)
+			{
+				TurnTimesMs.Add(float((Now - State.TurnStartTime) * 1000.0));
+				State.InTurn = false;
+			}
+			else if (Now - State.TurnStartTime > TurnTimeoutSeconds)
+			{
+				UE_LOG(ConvaiBenchmarkLog, Warning, TEXT("Turn of pair %d timed out after %.1f s"), i, TurnTimeoutSeconds);
+				Chatbot->InterruptSpeech(0);
+				NumTurnsTimedOut++;
+				State.InTurn = false;
+			}
+		}
+
+		if (!State.InTurn && State.TurnsLeft > 0)
+		{
+			State.TurnsLeft--;
+			State.InTurn = true;
+			State.SeenActive = false;
+			State.TurnStartTime = Now;
+			Player->SendText(Chatbot, BenchmarkPrompts[State.TurnsLeft % UE_ARRAY_COUNT(BenchmarkPrompts)], nullptr, false, VoiceResponse, false, false);
+		}
+
+		AllDone &= !State.InTurn && State.TurnsLeft == 0;
+	}
+
+	if (AllDone)
+	{
+		Finish();
+	}
+}
+
+void UConvaiBenchmark::SampleUsage()
+{
+	const double Now = FPlatformTime::Seconds();
+
+	// Relative to one core, 250% means two and a half cores were busy over the last interval
+	CpuSeconds += FPlatformTime::GetCPUTime().CPUTimePctRelative / 100.0 * (Now - LastSampleTime);
+	LastSampleTime = Now;
+
+	PeakUsedPhysical = FMath::Max<uint64>(PeakUsedPhysical, FPlatformMemory::GetStats().UsedPhysical);
+}
+
+void UConvaiBenchmark::Finish()
+{
+	if (!Running)
+	{
+		return;
+	}
+
+	SampleUsage();
+	Running = false;
+
+	if (UWorld* World = WorldPtr.Get())
+	{
+		World->GetTimerManager().ClearTimer(TickTimerHandle);
+	}
+
+	FConvaiBenchmarkResults Results;
+	Results.NumPairs = PairStates.Num();
+	Results.NumTurnsCompleted = TurnTimesMs.Num();
+	Results.NumTurnsTimedOut = NumTurnsTimedOut;
+	Results.DurationSeconds = float(FPlatformTime::Seconds() - StartTime);
+	Results.TurnsPerSecond = Results.DurationSeconds > 0 ? Results.NumTurnsCompleted / Results.DurationSeconds : 0;
+	Results.CpuMsPerTurn = Results.NumTurnsCompleted > 0 ? float(CpuSeconds * 1000.0 / Results.NumTurnsCompleted) : 0;
+	Results.PeakUsedPhysicalMB = float(PeakUsedPhysical / (1024.0 * 1024.0));
+	Results.PeakGrowthMB = float((double(PeakUsedPhysical) - double(StartUsedPhysical)) / (1024.0 * 1024.0));
+
+	TurnTimesMs.Sort();
+	Results.TurnP50Ms = Percentile(TurnTimesMs, 0.50f);
+	Results.TurnP95Ms = Percentile(TurnTimesMs, 0.95f);
+	Results.TurnP99Ms = Percentile(TurnTimesMs, 0.99f);
+
+	FConvaiLatencyTracer::Get().GetStats(BenchmarkCharacterID, Results.LatencyStats);
+
+	UE_LOG(ConvaiBenchmarkLog, Log, TEXT("Benchmark finished | %s"), *Results.ToString());
+	UE_LOG(ConvaiBenchmarkLog, Log, TEXT("Voice chunks | %s"), *FConvaiPCMChunk::GetStats().ToString());
+
+	for (AActor* Actor : Actors)
+	{
+		if (IsValid(Actor))
+		{
+			Actor->Destroy();
+		}
+	}
+	Actors.Reset();
+	Chatbots.Reset();
+	Players.Reset();
+	PairStates.Reset();
+
+	if (RunningBenchmark == this)
+	{
+		RunningBenchmark = nullptr;
+	}
+	RemoveFromRoot();
+
+	OnFinished.Broadcast(Results);
+}
+
+float UConvaiBenchmark::RunFaceSyncBenchmark(int32 NumFaces, int32 NumTicks, bool Blendshapes, bool WithBlendshapeMap, bool Batched)
+{
+	NumFaces = FMath::Max(NumFaces, 1);
+	NumTicks = FMath::Max(NumTicks, 1);
+
+	const FAnimationSequence Sequence = MakeFaceSyncBenchmarkSequence(Blendshapes ? EConvaiFaceCurveSet::ARKit : EConvaiFaceCurveSet::Visemes);
+
+	TArray<UConvaiFaceSyncComponent*> Faces;
+	Faces.Reserve(NumFaces);
+	for (int32 Index = 0; Index < NumFaces; Index++)
+	{
+		UConvaiFaceSyncComponent* Face = NewObject<UConvaiFaceSyncComponent>(GetTransientPackage());
+		Face->AddToRoot();
+		Face->ToggleBlendshapeOrViseme = Blendshapes;
+		Face->ConvaiProcessLipSyncAdvanced(nullptr, 0, 0, 0, Sequence);
+
+		// Warm up so buffer allocations are not measured
+		Face->EvaluateLipSync();
+		Faces.Add(Face);
+	}
+
+	const double StartTime = FPlatformTime::Seconds();
+	for (int32 Tick = 0; Tick < NumTicks; Tick++)
+	{
+		if (Batched)
+		{
+			UConvaiFaceSyncSubsystem::EvaluateFaceSyncs(Faces);
+		}
+
+		for (UConvaiFaceSyncComponent* Face : Faces)
+		{
+			if (!Batched)
+			{
+				Face->EvaluateLipSync();
+			}
+			if (WithBlendshapeMap)
+			{
+				Face->ConvaiGetFaceBlendshapes();
+			}
+		}
+	}
+	const double ElapsedSeconds = FPlatformTime::Seconds() - StartTime;
+
+	for (UConvaiFaceSyncComponent* Face : Faces)
+	{
+		Face->ConvaiStopLipSync();
+		Face->RemoveFromRoot();
+	}
+
+	return float(ElapsedSeconds * 1000000.0 / (double(NumFaces) * NumTicks));
+}
+
+float UConvaiBenchmark::RunRingBufferBenchmark(int32 ChunkBytes, int32 NumChunks, bool SpscRing)
+{
+	ChunkBytes = FMath::Clamp<int32>(ChunkBytes, 1, ConvaiConstants::VoiceCaptureRingBufferCapacity);
+	NumChunks = FMath::Max(NumChunks, 1);
+
+	TArray<uint8> Chunk;
+	Chunk.SetNumUninitialized(ChunkBytes);
+	for (int32 Index = 0; Index < ChunkBytes; Index++)
+	{
+		Chunk[Index] = uint8(Index);
+	}
+
+	// Sized once like the chatbot's send buffer, which keeps its allocation between ticks
+	TArray<uint8> Consumed;
+	Consumed.Reserve(ChunkBytes);
+
+	double ElapsedSeconds = 0;
+	uint64 Checksum = 0;
+	if (SpscRing)
+	{
+		TConvaiSpscRingBuffer<uint8> Ring(ConvaiConstants::VoiceCaptureRingBufferCapacity, EConvaiRingOverflowPolicy::DropNew);
+
+		const double StartTime = FPlatformTime::Seconds();
+		for (int32 Iteration = 0; Iteration < NumChunks; Iteration++)
+		{
+			Ring.Enqueue(Chunk.GetData(), ChunkBytes);
+
+			const uint8* First;
+			const uint8* Second;
+			uint32 FirstLength;
+			uint32 SecondLength;
+			const uint32 Length = Ring.PeekRead(First, FirstLength, Second, SecondLength);
+			Consumed.Reset();
+			Consumed.Append(First, FirstLength);
+			Consumed.Append(Second, SecondLength);
+			Ring.Commit(Length);
+			Checksum += Consumed.Last();
+		}
+		ElapsedSeconds = FPlatformTime::Seconds() - StartTime;
+	}
+	else
+	{
+		TRingBuffer<uint8> Ring(ConvaiConstants::VoiceCaptureRingBufferCapacity);
+
+		const double StartTime = FPlatformTime::Seconds();
+		for (int32 Iteration = 0; Iteration < NumChunks; Iteration++)
+		{
+			Ring.Enqueue(Chunk.GetData(), ChunkBytes);
+
+			const uint32 Length = Ring.RingDataUsage();
+			Consumed.SetNumUninitialized(Length, false);
+			Ring.Dequeue(Consumed.GetData(), Length);
+			Checksum += Consumed.Last();
+		}
+		ElapsedSeconds = FPlatformTime::Seconds() - StartTime;
+	}
+
+	UE_LOG(ConvaiBenchmarkLog, Verbose, TEXT("RunRingBufferBenchmark: Checksum %llu"), Checksum);
+	return float(ElapsedSeconds * 1000000000.0 / NumChunks);
+}
+
+float UConvaiBenchmark::RunSpscRingThreadedBenchmark(int32 ChunkBytes, int32 NumChunks)
+{
+	ChunkBytes = FMath::Clamp<int32>(ChunkBytes, 1, ConvaiConstants::VoiceCaptureRingBufferCapacity);
+	NumChunks = FMath::Max(NumChunks, 1);
+
+	TConvaiSpscRingBuffer<uint8> Ring(ConvaiConstants::VoiceCaptureRingBufferCapacity, EConvaiRingOverflowPolicy::Block);
+
+	TArray<uint8> Chunk;
+	Chunk.SetNumZeroed(ChunkBytes);
+
+	TArray<uint8> Consumed;
+	Consumed.Reserve(ConvaiConstants::VoiceCaptureRingBufferCapacity);
+
+	const uint64 TotalBytes = uint64(ChunkBytes) * NumChunks;
+	const double StartTime = FPlatformTime::Seconds();
+
+	TFuture<void> Producer = Async(EAsyncExecution::Thread, [&Ring, &Chunk, ChunkBytes, NumChunks]()
+	{
+		for (int32 Iteration = 0; Iteration < NumChunks; Iteration++)
+		{
+			Ring.Enqueue(Chunk.GetData(), ChunkBytes);
+		}
+	});
+
+	uint64 BytesRead = 0;
+	while (BytesRead < TotalBytes)
+	{
+		const uint8* First;
+		const uint8* Second;
+		uint32 FirstLength;
+		uint32 SecondLength;
+		const uint32 Length = Ring.PeekRead(First, FirstLength, Second, SecondLength);
+		if (Length == 0)
+		{
+			FPlatformProcess::Yield();
+			continue;
+		}
+
+		Consumed.Reset();
+		Consumed.Append(First, FirstLength);
+		Consumed.Append(Second, SecondLength);
+		Ring.Commit(Length);
+		BytesRead += Length;
+	}
+
+	Producer.Wait();
+	const double ElapsedSeconds = FPlatformTime::Seconds() - StartTime;
+
+	UE_LOG(ConvaiBenchmarkLog, Verbose, TEXT("RunSpscRingThreadedBenchmark: Producer waited %llu times for room"), Ring.GetNumOverflows());
+	return ElapsedSeconds > 0 ? float(TotalBytes / (1024.0 * 1024.0) / ElapsedSeconds) : 0;
+}
+
+float UConvaiBenchmark::RunResamplerBenchmark(int32 InputSampleRate, int32 OutputSampleRate, int32 NumChannels, int32 ChunkMs, int32 NumChunks, bool Polyphase)
+{
+	InputSampleRate = FMath::Max(InputSampleRate, 1);
+	OutputSampleRate = FMath::Max(OutputSampleRate, 1);
+	NumChannels = FMath::Max(NumChannels, 1);
+	NumChunks = FMath::Max(NumChunks, 1);
+
+	const int32 NumFrames = FMath::Max(InputSampleRate * ChunkMs / 1000, 1);
+
+	TArray<int16> Chunk;
+	Chunk.SetNumUninitialized(NumFrames * NumChannels);
+	for (int16& Sample : Chunk)
+	{
+		Sample = int16(FMath::RandRange(-8192, 8191));
+	}
+
+	TArray<int16> Converted;
+	FConvaiResampler Resampler(InputSampleRate, OutputSampleRate);
+
+	int64 NumOutput = 0;
+	const double StartTime = FPlatformTime::Seconds();
+	for (int32 Iteration = 0; Iteration < NumChunks; Iteration++)
+	{
+		if (Polyphase)
+		{
+			Resampler.Process(Chunk.GetData(), NumFrames, NumChannels, Converted);
+		}
+		else
+		{
+			UConvaiUtils::ResampleAudio(InputSampleRate, OutputSampleRate, NumChannels, true, Chunk.GetData(), Chunk.Num(), Converted);
+		}
+		NumOutput += Converted.Num();
+	}
+	const double ElapsedSeconds = FPlatformTime::Seconds() - StartTime;
+
+	UE_LOG(ConvaiBenchmarkLog, Verbose, TEXT("RunResamplerBenchmark: %lld output frames"), NumOutput);
+	return float(ElapsedSeconds * 1000000.0 / NumChunks);
+}
+
+float UConvaiBenchmark::RunCaptureConversionBenchmark(int32 InputSampleRate, int32 NumChannels, int32 ChunkMs, int32 NumChunks, bool Fused)
+{
+	InputSampleRate = FMath::Max(InputSampleRate, 1);
+	NumChannels = FMath::Max(NumChannels, 1);
+	NumChunks = FMath::Max(NumChunks, 1);
+
+	const int32 NumFrames = FMath::Max(InputSampleRate * ChunkMs / 1000, 1);
+
+	Audio::AlignedFloatBuffer Chunk;
+	Chunk.SetNumUninitialized(NumFrames * NumChannels);
+	for (float& Sample : Chunk)
+	{
+		Sample = FMath::FRandRange(-0.25f, 0.25f);
+	}
+
+	// Same capacity as the player's ring, emptied after every chunk the way the streaming consumer drains it
+	TConvaiSpscRingBuffer<uint8> Ring(ConvaiConstants::VoiceCaptureRingBufferCapacity);
+	FConvaiResampler Resampler(InputSampleRate, ConvaiConstants::VoiceCaptureSampleRate);
+
+	int64 NumOutputBytes = 0;
+	const double StartTime = FPlatformTime::Seconds();
+	for (int32 Iteration = 0; Iteration < NumChunks; Iteration++)
+	{
+		if (Fused)
+		{
+			uint8* First;
+			uint8* Second;
+			uint32 FirstBytes;
+			uint32 SecondBytes;
+			Ring.PeekWrite(First, FirstBytes, Second, SecondBytes);
+
+			int32 Written = Resampler.Process(Chunk.GetData(), NumFrames, NumChannels, (int16*)First, FirstBytes / sizeof(int16));
+			Written += Resampler.Process(static_cast<const float*>(nullptr), 0, NumChannels, (int16*)Second, SecondBytes / sizeof(int16));
+			Ring.CommitWrite(uint32(Written * sizeof(int16)));
+		}
+		else
+		{
+			Audio::TSampleBuffer<int16> Int16Buffer(Chunk, NumChannels, InputSampleRate);
+			TArray<int16> Converted;
+			Resampler.Process(Int16Buffer.GetData(), Int16Buffer.GetNumFrames(), NumChannels, Converted);
+			Ring.Enqueue((uint8*)Converted.GetData(), uint32(Converted.Num() * sizeof(int16)));
+		}
+		NumOutputBytes += Ring.Num();
+		Ring.Empty();
+	}
+	const double ElapsedSeconds = FPlatformTime::Seconds() - StartTime;
+
+	UE_LOG(ConvaiBenchmarkLog, Verbose, TEXT("RunCaptureConversionBenchmark: %lld output bytes"), NumOutputBytes);
+	return float(ElapsedSeconds * 1000000.0 / NumChunks);
+}
+
+float UConvaiBenchmark::RunProtoArenaBenchmark(int32 NumTurns, int32 WritesPerTurn, int32 ReadsPerTurn, bool Arena, float& OutAllocationsPerTurn)
+{
+	NumTurns = FMath::Max(NumTurns, 1);
+	WritesPerTurn = FMath::Max(WritesPerTurn, 0);
+	ReadsPerTurn = FMath::Max(ReadsPerTurn, 0);
+
+	// 20 ms of 16 kHz mic audio per write and 100 ms of 24 kHz voice per read, the reply is parsed from the wire like the stream does
+	const std::string MicChunk(640, '\1');
+	std::string ReplyBytes;
+	{
+		service::GetResponseResponse Reply;
+		Reply.set_session_id("convai-benchmark-session");
+		Reply.set_interaction_id("convai-benchmark-interaction");
+		Reply.mutable_audio_response()->set_text_data("One sentence of the character's reply.");
+		Reply.mutable_audio_response()->set_audio_data(std::string(4800, '\1'));
+		Reply.mutable_audio_response()->mutable_audio_config()->set_sample_rate_hertz(24000);
+		Reply.SerializeToString(&ReplyBytes);
+	}
+
+	// Builds the config the way OnStreamInit does, sub-messages on the arena or on the heap
+	auto MakeConfig = [](google::protobuf::Arena* MessageArena)
+	{
+		service::GetResponseRequest_GetResponseConfig* Config = google::protobuf::Arena::CreateMessage<service::GetResponseRequest_GetResponseConfig>(MessageArena);
+		service::AudioConfig* Audio = google::protobuf::Arena::CreateMessage<service::AudioConfig>(MessageArena);
+		service::ActionConfig* Actions = google::protobuf::Arena::CreateMessage<service::ActionConfig>(MessageArena);
+		Audio->set_sample_rate_hertz((int32)ConvaiConstants::VoiceCaptureSampleRate);
+		Actions->set_classification("multistep");
+		Actions->add_actions("Move To");
+		Actions->add_actions("Pick Up");
+		Actions->add_actions("Follow");
+		Config->set_api_key("convai-benchmark-api-key");
+		Config->set_character_id("convai-benchmark-character");
+		Config->set_session_id("convai-benchmark-session");
+		Config->set_allocated_audio_config(Audio);
+		Config->set_allocated_action_config(Actions);
+		return Config;
+	};
+
+	int64 Checksum = 0;
+	FConvaiCountingMalloc& CountingMalloc = GetCountingMalloc();
+	CountingMalloc.Begin();
+	const double StartTime = FPlatformTime::Seconds();
+	for (int32 Turn = 0; Turn < NumTurns; Turn++)
+	{
+		if (Arena)
+		{
+			// Per-stream arenas with the data message and the reply recycled like UConvaiGRPCGetResponseProxy does
+			google::protobuf::Arena RequestArena;
+			google::protobuf::Arena ReplyArena;
+			service::GetResponseRequest* Request = google::protobuf::Arena::CreateMessage<service::GetResponseRequest>(&RequestArena);
+			service::GetResponseResponse* Reply = google::protobuf::Arena::CreateMessage<service::GetResponseResponse>(&ReplyArena);
+
+			Request->set_allocated_get_response_config(MakeConfig(&RequestArena));
+
+			service::GetResponseRequest_GetResponseData* ReusableData = nullptr;
+			for (int32 Write = 0; Write < WritesPerTurn; Write++)
+			{
+				if (Request->has_get_response_data())
+				{
+					ReusableData = Request->unsafe_arena_release_get_response_data();
+				}
+				Request->Clear();
+				service::GetResponseRequest_GetResponseData* Data = ReusableData ? ReusableData : google::protobuf::Arena::CreateMessage<service::GetResponseRequest_GetResponseData>(&RequestArena);
+				ReusableData = nullptr;
+				Data->Clear();
+				Data->mutable_audio_data()->assign(MicChunk);
+				Request->unsafe_arena_set_allocated_get_response_data(Data);
+				Checksum += Request->ByteSizeLong();
+			}
+
+			for (int32 Read = 0; Read < ReadsPerTurn; Read++)
+			{
+				if (Read > 0 && Read % ConvaiConstants::ReplyArenaResetInterval == 0)
+				{
+					ReplyArena.Reset();
+					Reply = google::protobuf::Arena::CreateMessage<service::GetResponseResponse>(&ReplyArena);
+				}
+				Reply->Clear();
+				Reply->ParseFromString(ReplyBytes);
+				Checksum += Reply->audio_response().audio_data().size();
+			}
+		}
+		else
+		{
+			// Raw allocations owned by the messages, as the proxy did before the arenas
+			service::GetResponseRequest Request;
+			TUniquePtr<service::GetResponseResponse> Reply = MakeUnique<service::GetResponseResponse>();
+
+			Request.set_allocated_get_response_config(MakeConfig(nullptr));
+
+			for (int32 Write = 0; Write < WritesPerTurn; Write++)
+			{
+				Request.Clear();
+				service::GetResponseRequest_GetResponseData* Data = new service::GetResponseRequest_GetResponseData();
+				Data->set_audio_data(MicChunk);
+				Request.set_allocated_get_response_data(Data);
+				Checksum += Request.ByteSizeLong();
+			}
+
+			for (int32 Read = 0; Read < ReadsPerTurn; Read++)
+			{
+				Reply->ParseFromString(ReplyBytes);
+				Checksum += Reply->audio_response().audio_data().size();
+			}
+		}
+	}
+	const double ElapsedSeconds = FPlatformTime::Seconds() - StartTime;
+	const int64 NumAllocations = CountingMalloc.End();
+
+	UE_LOG(ConvaiBenchmarkLog, Verbose, TEXT("RunProtoArenaBenchmark: Checksum %lld"), Checksum);
+	OutAllocationsPerTurn = float(double(NumAllocations) / NumTurns);
+	return float(ElapsedSeconds * 1000000.0 / NumTurns);
+}
+
+#if !UE_BUILD_SHIPPING
+static FAutoConsoleCommandWithWorldAndArgs ConvaiBenchmarkCommand(
+	TEXT("Convai.Benchmark"),
+	TEXT("Drives chatbot/player pairs through text turns and logs the results. Optional: Pairs= Turns= Voice= Timeout="),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		const FString Params = FString::Join(Args, TEXT(" "));
+
+		int32 NumPairs = 8;
+		int32 TurnsPerPair = 10;
+		bool VoiceResponse = true;
+		float TurnTimeoutSeconds = 30;
+		FParse::Value(*Params, TEXT("Pairs="), NumPairs);
+		FParse::Value(*Params, TEXT("Turns="), TurnsPerPair);
+		FParse::Bool(*Params, TEXT("Voice="), VoiceResponse);
+		FParse::Value(*Params, TEXT("Timeout="), TurnTimeoutSeconds);
+
+		UConvaiBenchmark::StartConvaiBenchmark(World, NumPairs, TurnsPerPair, VoiceResponse, TurnTimeoutSeconds);
+	}));
+
+static FAutoConsoleCommand ConvaiBenchmarkStopCommand(
+	TEXT("Convai.Benchmark.Stop"),
+	TEXT("Stops the running Convai benchmark and logs what was measured so far"),
+	FConsoleCommandDelegate::CreateLambda([]()
+	{
+		UConvaiBenchmark::StopConvaiBenchmark();
+	}));
+
+static FAutoConsoleCommand ConvaiBenchmarkFaceSyncCommand(
+	TEXT("Convai.Benchmark.FaceSync"),
+	TEXT("Logs the per-component tick cost of face sync for 1, 50 and 500 faces. Optional: Faces= Ticks= Blendshapes="),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		const FString Params = FString::Join(Args, TEXT(" "));
+
+		int32 NumFaces = 0;
+		int32 NumTicks = 1000;
+		bool Blendshapes = true;
+		FParse::Value(*Params, TEXT("Faces="), NumFaces);
+		FParse::Value(*Params, TEXT("Ticks="), NumTicks);
+		FParse::Bool(*Params, TEXT("Blendshapes="), Blendshapes);
+
+		TArray<int32> FaceCounts = { 1, 50, 500 };
+		if (NumFaces > 0)
+		{
+			FaceCounts = { NumFaces };
+		}
+
+		for (int32 FaceCount : FaceCounts)
+		{
+			const float TickUs = UConvaiBenchmark::RunFaceSyncBenchmark(FaceCount, NumTicks, Blendshapes);
+			const float TickWithMapUs = UConvaiBenchmark::RunFaceSyncBenchmark(FaceCount, NumTicks, Blendshapes, true);
+			const float BatchedTickUs = UConvaiBenchmark::RunFaceSyncBenchmark(FaceCount, NumTicks, Blendshapes, false, true);
+			UE_LOG(ConvaiBenchmarkLog, Log, TEXT("FaceSync %s | Faces: %d | Ticks: %d | %.3f us/tick per face (%.3f us with the blendshape map) | %.3f ms per frame for all faces, %.3f ms batched"),
+				Blendshapes ? TEXT("Blendshapes") : TEXT("Visemes"),
+				FaceCount,
+				NumTicks,
+				TickUs,
+				TickWithMapUs,
+				TickUs * FaceCount / 1000.f,
+				BatchedTickUs * FaceCount / 1000.f);
+		}
+	}));
+
+static FAutoConsoleCommand ConvaiBenchmarkRingBufferCommand(
+	TEXT("Convai.Benchmark.RingBuffer"),
+	TEXT("Logs the cost of moving mic chunks through the voice capture ring, compared to the TRingBuffer it replaced. Optional: ChunkBytes= Chunks="),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		const FString Params = FString::Join(Args, TEXT(" "));
+
+		// 20 ms of 16 kHz mono 16 bit PCM, about what one tick of mic capture produces
+		int32 ChunkBytes = 640;
+		int32 NumChunks = 100000;
+		FParse::Value(*Params, TEXT("ChunkBytes="), ChunkBytes);
+		FParse::Value(*Params, TEXT("Chunks="), NumChunks);
+
+		const float RingBufferNs = UConvaiBenchmark::RunRingBufferBenchmark(ChunkBytes, NumChunks, false);
+		const float SpscRingNs = UConvaiBenchmark::RunRingBufferBenchmark(ChunkBytes, NumChunks, true);
+		const float ThreadedMBs = UConvaiBenchmark::RunSpscRingThreadedBenchmark(ChunkBytes, NumChunks);
+		UE_LOG(ConvaiBenchmarkLog, Log, TEXT("RingBuffer | Chunk: %d bytes | Chunks: %d | TRingBuffer: %.1f ns/chunk | TConvaiSpscRingBuffer: %.1f ns/chunk | TConvaiSpscRingBuffer across threads: %.1f MB/s"),
+			ChunkBytes,
+			NumChunks,
+			RingBufferNs,
+			SpscRingNs,
+			ThreadedMBs);
+	}));
+
+static FAutoConsoleCommand ConvaiBenchmarkResamplerCommand(
+	TEXT("Convai.Benchmark.Resampler"),
+	TEXT("Logs the per-chunk cost of the streaming polyphase resampler and of UConvaiUtils::ResampleAudio for the mic and voice conversions. Optional: ChunkMs= Chunks="),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		const FString Params = FString::Join(Args, TEXT(" "));
+
+		int32 ChunkMs = 10;
+		int32 NumChunks = 10000;
+		FParse::Value(*Params, TEXT("ChunkMs="), ChunkMs);
+		FParse::Value(*Params, TEXT("Chunks="), NumChunks);
+
+		struct FConversion
+		{
+			int32 InputSampleRate;
+			int32 OutputSampleRate;
+			int32 NumChannels;
+		};
+		const FConversion Conversions[] = {
+			{ 48000, 16000, 2 },
+			{ 44100, 16000, 2 },
+			{ 48000, 24000, 1 },
+		};
+
+		for (const FConversion& Conversion : Conversions)
+		{
+			const float PolyphaseUs = UConvaiBenchmark::RunResamplerBenchmark(Conversion.InputSampleRate, Conversion.OutputSampleRate, Conversion.NumChannels, ChunkMs, NumChunks, true);
+			const float ResampleAudioUs = UConvaiBenchmark::RunResamplerBenchmark(Conversion.InputSampleRate, Conversion.OutputSampleRate, Conversion.NumChannels, ChunkMs, NumChunks, false);
+			UE_LOG(ConvaiBenchmarkLog, Log, TEXT("Resampler | %d Hz x%d to %d Hz | Chunk: %d ms | Chunks: %d | FConvaiResampler: %.2f us/chunk (%.0fx realtime) | ResampleAudio: %.2f us/chunk (%.0fx realtime)"),
+				Conversion.InputSampleRate,
+				Conversion.NumChannels,
+				Conversion.OutputSampleRate,
+				ChunkMs,
+				NumChunks,
+				PolyphaseUs,
+				PolyphaseUs > 0 ? ChunkMs * 1000.f / PolyphaseUs : 0.f,
+				ResampleAudioUs,
+				ResampleAudioUs > 0 ? ChunkMs * 1000.f / ResampleAudioUs : 0.f);
+		}
+	}));
+
+static FAutoConsoleCommand ConvaiBenchmarkCaptureCommand(
+	TEXT("Convai.Benchmark.Capture"),
+	TEXT("Logs the per-chunk cost of converting captured mic audio into the voice capture ring, fused and through the sample buffer copies. Optional: ChunkMs= Chunks="),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		const FString Params = FString::Join(Args, TEXT(" "));
+
+		int32 ChunkMs = 10;
+		int32 NumChunks = 10000;
+		FParse::Value(*Params, TEXT("ChunkMs="), ChunkMs);
+		FParse::Value(*Params, TEXT("Chunks="), NumChunks);
+
+		struct FCaptureFormat
+		{
+			int32 SampleRate;
+			int32 NumChannels;
+		};
+		const FCaptureFormat Formats[] = {
+			{ 48000, 2 },
+			{ 48000, 1 },
+			{ 44100, 2 },
+		};
+
+		for (const FCaptureFormat& Format : Formats)
+		{
+			const float FusedUs = UConvaiBenchmark::RunCaptureConversionBenchmark(Format.SampleRate, Format.NumChannels, ChunkMs, NumChunks, true);
+			const float CopiesUs = UConvaiBenchmark::RunCaptureConversionBenchmark(Format.SampleRate, Format.NumChannels, ChunkMs, NumChunks, false);
+			UE_LOG(ConvaiBenchmarkLog, Log, TEXT("Capture | %d Hz x%d to %d Hz | Chunk: %d ms | Chunks: %d | Fused: %.2f us/chunk | Sample buffer copies: %.2f us/chunk"),
+				Format.SampleRate,
+				Format.NumChannels,
+				ConvaiConstants::VoiceCaptureSampleRate,
+				ChunkMs,
+				NumChunks,
+				FusedUs,
+				CopiesUs);
+		}
+	}));
+
+static FAutoConsoleCommand ConvaiBenchmarkProtoArenaCommand(
+	TEXT("Convai.Benchmark.ProtoArena"),
+	TEXT("Logs the heap allocations and cost per turn of the GetResponse protobuf messages, on per-stream arenas and on the heap. Optional: Turns= Writes= Reads="),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		const FString Params = FString::Join(Args, TEXT(" "));
+
+		// About a 10 second spoken turn, 20 ms mic writes and a 10 second reply in 100 ms reads
+		int32 NumTurns = 100;
+		int32 WritesPerTurn = 500;
+		int32 ReadsPerTurn = 100;
+		FParse::Value(*Params, TEXT("Turns="), NumTurns);
+		FParse::Value(*Params, TEXT("Writes="), WritesPerTurn);
+		FParse::Value(*Params, TEXT("Reads="), ReadsPerTurn);
+
+		float ArenaAllocations = 0;
+		float HeapAllocations = 0;
+		const float ArenaUs = UConvaiBenchmark::RunProtoArenaBenchmark(NumTurns, WritesPerTurn, ReadsPerTurn, true, ArenaAllocations);
+		const float HeapUs = UConvaiBenchmark::RunProtoArenaBenchmark(NumTurns, WritesPerTurn, ReadsPerTurn, false, HeapAllocations);
+		UE_LOG(ConvaiBenchmarkLog, Log, TEXT("ProtoArena | Turns: %d | Writes: %d | Reads: %d | Arena: %.0f allocations, %.1f us per turn | Heap: %.0f allocations, %.1f us per turn"),
+			NumTurns,
+			WritesPerTurn,
+			ReadsPerTurn,
+			ArenaAllocations,
+			ArenaUs,
+			HeapAllocations,
+			HeapUs);
+	}));
+#endif
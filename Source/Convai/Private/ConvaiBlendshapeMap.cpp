@@ -0,0 +1,173 @@
+// Copyright 2022 Convai Inc. All Rights Reserved.
+
+#include "ConvaiBlendshapeMap.h"
+#include "Misc/ScopeLock.h"
+
+namespace
+{
+	// Compiled maps are small, the cache is only flushed to bound it when remaps keep changing at runtime
+	constexpr int32 MaxCachedBlendshapeMaps = 256;
+
+	FCriticalSection CompiledMapsCriticalSection;
+	TMap<uint32, TSharedRef<const FConvaiCompiledBlendshapeMap, ESPMode::ThreadSafe>> CompiledMaps;
+
+	bool ParametersEqual(const FConvaiBlendshapeParameters& A, const FConvaiBlendshapeParameters& B)
+	{
+		return A.TargetNames == B.TargetNames
+			&& A.Multiplyer == B.Multiplyer
+			&& A.Offset == B.Offset
+			&& A.UseOverrideValue == B.UseOverrideValue
+			&& A.IgnoreGlobalModifiers == B.IgnoreGlobalModifiers
+			&& A.OverrideValue == B.OverrideValue
+			&& A.ClampMinValue == B.ClampMinValue
+			&& A.ClampMaxValue == B.ClampMaxValue;
+	}
+}
+
+FConvaiCompiledBlendshapeMap::FConvaiCompiledBlendshapeMap(const TMap<FName, FConvaiBlendshapeParameters>& InBlendshapeMap, TArrayView<const FName> InSourceNames)
+	: BlendshapeMap(InBlendshapeMap)
+	, SourceNames(InSourceNames.GetData(), InSourceNames.Num())
+	, Hash(ComputeHash(InBlendshapeMap, InSourceNames))
+{
+	// Same visiting order as MapBlendshapes so targets come out in the same order with the same merge results
+	TMap<FName, int32> TargetIndices;
+	auto AddOp = [this, &TargetIndices](FOp& Op, FName TargetName)
+	{
+		const int32* ExistingIndex = TargetIndices.Find(TargetName);
+		Op.FirstWrite = ExistingIndex == nullptr;
+		Op.TargetIndex = ExistingIndex ? *ExistingIndex : TargetIndices.Add(TargetName, TargetNames.Add(TargetName));
+		Ops.Add(Op);
+	};
+
+	for (int32 SourceIndex = 0; SourceIndex < SourceNames.Num(); SourceIndex++)
+	{
+		FOp Op;
+		FMemory::Memzero(Op);
+		Op.SourceIndex = SourceIndex;
+
+		const FConvaiBlendshapeParameters* Parameters = BlendshapeMap.Find(SourceNames[SourceIndex]);
+		if (!Parameters)
+		{
+			Op.Type = EOpType::Copy;
+			AddOp(Op, SourceNames[SourceIndex]);
+			continue;
+		}
+
+		Op.Type = Parameters->UseOverrideValue ? EOpType::Override : EOpType::Scale;
+		Op.Multiplier = Parameters->Multiplyer;
+		Op.Offset = Parameters->Offset;
+		Op.ClampMinValue = Parameters->ClampMinValue;
+		Op.ClampMaxValue = Parameters->ClampMaxValue;
+		Op.OverrideValue = Parameters->OverrideValue;
+		Op.IgnoreGlobalModifiers = Parameters->IgnoreGlobalModifiers;
+		for (const FName& TargetName : Parameters->TargetNames)
+		{
+			AddOp(Op, TargetName);
+		}
+	}
+}
+
+uint32 FConvaiCompiledBlendshapeMap::ComputeHash(const TMap<FName, FConvaiBlendshapeParameters>& BlendshapeMap, TArrayView<const FName> SourceNames)
+{
+	uint32 Result = GetTypeHash(SourceNames.Num());
+	for (const FName& SourceName : SourceNames)
+	{
+		Result = HashCombine(Result, GetTypeHash(SourceName));
+	}
+
+	for (const auto& Elem : BlendshapeMap)
+	{
+		const FConvaiBlendshapeParameters& Parameters = Elem.Value;
+		Result = HashCombine(Result, GetTypeHash(Elem.Key));
+		for (const FName& TargetName : Parameters.TargetNames)
+		{
+			Result = HashCombine(Result, GetTypeHash(TargetName));
+		}
+		Result = HashCombine(Result, GetTypeHash(Parameters.Multiplyer));
+		Result = HashCombine(Result, GetTypeHash(Parameters.Offset));
+		Result = HashCombine(Result, GetTypeHash(uint32(Parameters.UseOverrideValue)));
+		Result = HashCombine(Result, GetTypeHash(uint32(Parameters.IgnoreGlobalModifiers)));
+		Result = HashCombine(Result, GetTypeHash(Parameters.OverrideValue));
+		Result = HashCombine(Result, GetTypeHash(Parameters.ClampMinValue));
+		Result = HashCombine(Result, GetTypeHash(Parameters.ClampMaxValue));
+	}
+	return Result;
+}
+
+bool FConvaiCompiledBlendshapeMap::Matches(const TMap<FName, FConvaiBlendshapeParameters>& InBlendshapeMap, TArrayView<const FName> InSourceNames) const
+{
+	if (SourceNames.Num() != InSourceNames.Num() || !CompareItems(SourceNames.GetData(), InSourceNames.GetData(), SourceNames.Num()))
+	{
+		return false;
+	}
+
+	if (BlendshapeMap.Num() != InBlendshapeMap.Num())
+	{
+		return false;
+	}
+
+	for (const auto& Elem : InBlendshapeMap)
+	{
+		const FConvaiBlendshapeParameters* Parameters = BlendshapeMap.Find(Elem.Key);
+		if (!Parameters || !ParametersEqual(*Parameters, Elem.Value))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+TSharedRef<const FConvaiCompiledBlendshapeMap, ESPMode::ThreadSafe> FConvaiCompiledBlendshapeMap::FindOrCompile(const TMap<FName, FConvaiBlendshapeParameters>& BlendshapeMap, TArrayView<const FName> SourceNames)
+{
+	const uint32 Hash = ComputeHash(BlendshapeMap, SourceNames);
+
+	FScopeLock Lock(&CompiledMapsCriticalSection);
+	if (const TSharedRef<const FConvaiCompiledBlendshapeMap, ESPMode::ThreadSafe>* Cached = CompiledMaps.Find(Hash))
+	{
+		// On a collision the newer remap takes the slot
+		if ((*Cached)->Matches(BlendshapeMap, SourceNames))
+		{
+			return *Cached;
+		}
+	}
+
+	if (CompiledMaps.Num() >= MaxCachedBlendshapeMaps)
+	{
+		CompiledMaps.Reset();
+	}
+
+	TSharedRef<const FConvaiCompiledBlendshapeMap, ESPMode::ThreadSafe> Compiled = MakeShared<const FConvaiCompiledBlendshapeMap, ESPMode::ThreadSafe>(BlendshapeMap, SourceNames);
+	CompiledMaps.Add(Hash, Compiled);
+	return Compiled;
+}
+
+void FConvaiCompiledBlendshapeMap::Evaluate(const float* SourceValues, float GlobalMultiplier, float GlobalOffset, float* OutTargetValues) const
+{
+	for (const FOp& Op : Ops)
+	{
+		float Value;
+		switch (Op.Type)
+		{
+		case EOpType::Copy:
+			Value = SourceValues[Op.SourceIndex];
+			break;
+		case EOpType::Override:
+			Value = Op.OverrideValue;
+			break;
+		default:
+			Value = Op.IgnoreGlobalModifiers
+				? Op.Multiplier * SourceValues[Op.SourceIndex] + Op.Offset
+				: Op.Multiplier * SourceValues[Op.SourceIndex] * GlobalMultiplier + Op.Offset + GlobalOffset;
+			Value = Value > Op.ClampMaxValue ? Op.ClampMaxValue : Value;
+			Value = Value < Op.ClampMinValue ? Op.ClampMinValue : Value;
+
+			// If this curve appeared before then keep the higher value
+			if (!Op.FirstWrite)
+			{
+				Value = FMath::Max(Value, OutTargetValues[Op.TargetIndex]);
+			}
+			break;
+		}
+		OutTargetValues[Op.TargetIndex] = Value;
+	}
+}
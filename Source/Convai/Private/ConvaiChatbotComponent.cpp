@@ -7,6 +7,7 @@
 #include "ConvaiActionUtils.h"
 #include "ConvaiUtils.h"
 #include "LipSyncInterface.h"
+#include "ConvaiPlaybackClock.h"
 #include "VisionInterface.h"
 
 #include "Sound/SoundWaveProcedural.h"
@@ -50,6 +51,11 @@ bool UConvaiChatbotComponent::IsInConversation()
 	return ((IsValid(ConvaiGRPCGetResponseProxy) && !ReceivedFinalData) || IsTalking);
 }
 
+bool UConvaiChatbotComponent::IsAudioUplinkBackpressured()
+{
+	return IsValid(ConvaiGRPCGetResponseProxy) && ConvaiGRPCGetResponseProxy->IsUplinkBackpressured();
+}
+
 bool UConvaiChatbotComponent::IsProcessing()
 {
 	if (IsValid(ConvaiGRPCGetResponseProxy) && !ReceivedFinalData)
@@ -72,14 +78,10 @@ bool UConvaiChatbotComponent::GetIsTalking()
 
 float UConvaiChatbotComponent::GetTalkingTimeElapsed()
 {
-	float TimeElapsed = 0;
-	if (IsValid(GetWorld()))
-	{
-		// TODO: Reset DataBuffer.TotalAudioDurationElapsed after response is complete
-		TimeElapsed = DataBuffer.TotalAudioDurationElapsed + GetWorld()->GetTimerManager().GetTimerElapsed(AudioFinishedTimerHandle);
-	}
+	if (!IsTalking)
+		return 0;
 
-	return TimeElapsed;
+	return FMath::Max(float(PlaybackClock->GetPlayedSeconds() - TalkingStartSeconds), 0.0f);
 }
 
 float UConvaiChatbotComponent::GetTalkingTimeRemaining()
@@ -87,8 +89,7 @@ float UConvaiChatbotComponent::GetTalkingTimeRemaining()
 	float TimeRemaing = 0;
 	if (IsValid(GetWorld()))
 	{
-		TimeRemaing = GetWorld()->GetTimerManager().GetTimerRemaining(AudioFinishedTimerHandle);
-		TimeRemaing = TimeRemaing < 0 ? 0 : TimeRemaing;
+		TimeRemaing = PlaybackClock->GetRemainingSeconds();
 		float InSyncTimeRemaining = 0;
 		HasSufficentLipsyncFrames(InSyncTimeRemaining); // Takes into consideration the lipsync time
 		TimeRemaing += InSyncTimeRemaining;
@@ -386,6 +387,9 @@ void UConvaiChatbotComponent::StartGetResponseStream(UConvaiPlayerComponent* InC
 
 	InterruptSpeech(InterruptVoiceFadeOutDuration);
 
+	BeginLatencyTrace(CharacterID, SessionID);
+	BeginVoiceResponse();
+
 	UserText = InputText;
 	TextInput = UserText.Len() > 0;
 	GenerateActions = InGenerateActions;
@@ -401,6 +405,8 @@ void UConvaiChatbotComponent::StartGetResponseStream(UConvaiPlayerComponent* InC
 	}
 	else
 	{
+		// Nothing to wait for from the player
+		MarkLatency(EConvaiLatencySpan::FinishTalking);
 		OnTranscriptionReceived(UserText, true, true);
 	}
 
@@ -471,6 +477,10 @@ void UConvaiChatbotComponent::InvokeTrigger_Internal(FString TriggerName, FStrin
 
 	InterruptSpeech(InterruptVoiceFadeOutDuration);
 
+	BeginLatencyTrace(CharacterID, SessionID);
+	BeginVoiceResponse();
+	MarkLatency(EConvaiLatencySpan::FinishTalking);
+
 	UserText = "";
 	GenerateActions = InGenerateActions;
 	VoiceResponse = InVoiceResponse;
@@ -499,7 +509,7 @@ void UConvaiChatbotComponent::InterruptSpeech(float InVoiceFadeOutDuration)
 			OnTranscriptionReceived(LastTranscription, true, true);
 
 		if (ReceivedFinalData == false)
-			onResponseDataReceived(FString(""), TArray<uint8>(), 0, true);
+			onResponseDataReceived(FString(""), nullptr, 0, true);
 
 		AsyncTask(ENamedThreads::GameThread, [WeakThis = MakeWeakObjectPtr(this)]
 			{
@@ -539,6 +549,45 @@ void UConvaiChatbotComponent::Broadcast_InterruptSpeech_Implementation(float InV
 }
 
 void UConvaiChatbotComponent::Start_GRPC_Request(bool UseOverrideAuthKey, FString OverrideAuthKey, FString OverrideAuthHeader, FString TriggerName, FString TriggerMessage)
+{
+	ReceivedFinalData = false;
+
+	// Create the request proxy
+	FConvaiGRPCGetResponseParams Params;
+	Make_GRPC_Request_Params(Params, GenerateActions, VoiceResponse, UseOverrideAuthKey, OverrideAuthKey, OverrideAuthHeader, true);
+	Params.UserQuery = UserText;
+	Params.TriggerName = TriggerName;
+	Params.TriggerMessage = TriggerMessage;
+	Params.LatencyTrace = GetLatencyTrace();
+
+	// Only the response that starts here decides how its voice waits for face data, a stream prepared ahead of time does not
+	FaceDataSkipped = Params.FaceDataSkipped;
+
+	// Reuse the stream opened ahead of time if it is still usable
+	if (TryAttachPreparedStream(Params))
+	{
+		return;
+	}
+
+	ConvaiGRPCGetResponseProxy = UConvaiGRPCGetResponseProxy::CreateConvaiGRPCGetResponseProxy(this, Params);
+
+	// Bind the needed delegates
+	Bind_GRPC_Request_Delegates();
+
+	// Start the stream
+	ConvaiGRPCGetResponseProxy->Activate();
+}
+
+void UConvaiChatbotComponent::MarkPlayerFinishedTalking(UConvaiPlayerComponent* InConvaiPlayerComponent)
+{
+	// A player that is no longer the one talking to us has no say in the current turn
+	if (InConvaiPlayerComponent != CurrentConvaiPlayerComponent)
+		return;
+
+	MarkLatency(EConvaiLatencySpan::FinishTalking);
+}
+
+void UConvaiChatbotComponent::Make_GRPC_Request_Params(FConvaiGRPCGetResponseParams& OutParams, bool InGenerateActions, bool InVoiceResponse, bool UseOverrideAuthKey, FString OverrideAuthKey, FString OverrideAuthHeader, bool CaptureVision)
 {
 	TPair<FString, FString> AuthHeaderAndKey = UConvaiUtils::GetAuthHeaderAndKey();
 	FString AuthKey = AuthHeaderAndKey.Value;
@@ -549,16 +598,19 @@ void UConvaiChatbotComponent::Start_GRPC_Request(bool UseOverrideAuthKey, FStrin
 
 	bool RequireFaceData = false;
 	bool GeneratesVisemesAsBlendshapes = false;
-	ReceivedFinalData = false;
 	if (ConvaiLipSyncExtended)
 	{
 		RequireFaceData = ConvaiLipSyncExtended->RequiresPreGeneratedFaceData();
 		GeneratesVisemesAsBlendshapes = ConvaiLipSyncExtended->GeneratesVisemesAsBlendshapes();
 	}
-	RequireFaceData = RequireFaceData && VoiceResponse;
+	RequireFaceData = RequireFaceData && InVoiceResponse;
+
+	// Faces too far away to animate do not need the face data, the voice then plays without waiting for it
+	const bool SkipFaceData = RequireFaceData && !ConvaiLipSyncExtended->ConvaiShouldRequestFaceData();
+	RequireFaceData = RequireFaceData && !SkipFaceData;
 
 	FConvaiGRPCVisionParams ConvaiGRPCVisionParams;
-	if (ConvaiVision && ConvaiVision->GetState() == EVisionState::Capturing)
+	if (CaptureVision && ConvaiVision && ConvaiVision->GetState() == EVisionState::Capturing)
 	{
 		bool bCaptureSuccess = ConvaiVision->GetCompressedData(ConvaiGRPCVisionParams.width, ConvaiGRPCVisionParams.height, ConvaiGRPCVisionParams.data);
 
@@ -576,31 +628,213 @@ void UConvaiChatbotComponent::Start_GRPC_Request(bool UseOverrideAuthKey, FStrin
 		}
 	}
 
+	OutParams.CharID = CharacterID;
+	OutParams.VoiceResponse = InVoiceResponse;
+	OutParams.RequireFaceData = RequireFaceData;
+	OutParams.FaceDataSkipped = SkipFaceData;
+	OutParams.GeneratesVisemesAsBlendshapes = GeneratesVisemesAsBlendshapes;
+	OutParams.Narrative_Template_Keys = NarrativeTemplateKeys;
+	OutParams.SessionID = SessionID;
+	OutParams.Environment = Environment;
+	OutParams.GenerateActions = InGenerateActions;
+	OutParams.ConvaiGRPCVisionParams = ConvaiGRPCVisionParams;
+	OutParams.AuthKey = AuthKey;
+	OutParams.AuthHeader = AuthHeader;
+}
+
+namespace
+{
+	bool IsSameObjectEntry(const FConvaiObjectEntry& A, const FConvaiObjectEntry& B)
+	{
+		return A.Name == B.Name && A.Description == B.Description;
+	}
+
+	bool IsSameObjectEntries(const TArray<FConvaiObjectEntry>& A, const TArray<FConvaiObjectEntry>& B)
+	{
+		if (A.Num() != B.Num())
+			return false;
+
+		for (int32 i = 0; i < A.Num(); i++)
+		{
+			if (!IsSameObjectEntry(A[i], B[i]))
+				return false;
+		}
+		return true;
+	}
+
+	// Compares the parts of the environment that end up in the action config
+	bool IsSameEnvironment(const FConvaiEnvironmentDetails& A, const FConvaiEnvironmentDetails& B)
+	{
+		return A.Actions == B.Actions
+			&& IsSameObjectEntries(A.Objects, B.Objects)
+			&& IsSameObjectEntries(A.Characters, B.Characters)
+			&& IsSameObjectEntry(A.MainCharacter, B.MainCharacter)
+			&& IsSameObjectEntry(A.AttentionObject, B.AttentionObject);
+	}
+}
+
+void UConvaiChatbotComponent::PrepareGetResponseStream(UConvaiEnvironment* InEnvironment, bool InGenerateActions, bool InVoiceResponse, float TimeoutSeconds)
+{
+	if (CharacterID.IsEmpty())
+	{
+		UE_LOG(ConvaiChatbotComponentLog, Warning, TEXT("PrepareGetResponseStream: CharacterID is not set"));
+		return;
+	}
+
+	// The stream may never be used, so it is configured from a copy and the environment later requests send stays as it is
+	UConvaiEnvironment* PreparedEnvironment = NewObject<UConvaiEnvironment>(this);
+	if (IsValid(InEnvironment))
+	{
+		PreparedEnvironment->SetFromEnvironment(InEnvironment);
+	}
+	else if (IsValid(Environment))
+	{
+		PreparedEnvironment->SetFromEnvironment(Environment);
+	}
+	else
+	{
+		UE_LOG(ConvaiChatbotComponentLog, Warning, TEXT("PrepareGetResponseStream: Environment is not valid"));
+	}
+
+	FString Error;
+	if (InGenerateActions && !UConvaiActions::ValidateEnvironment(PreparedEnvironment, Error))
+	{
+		UE_LOG(ConvaiChatbotComponentLog, Warning, TEXT("PrepareGetResponseStream: %s"), *Error);
+		InGenerateActions = false;
+	}
 
-	// Create the request proxy
 	FConvaiGRPCGetResponseParams Params;
-	Params.UserQuery = UserText;
-	Params.TriggerName = TriggerName;
-	Params.TriggerMessage = TriggerMessage;
-	Params.CharID = CharacterID;
-	Params.VoiceResponse = VoiceResponse;
-	Params.RequireFaceData = RequireFaceData;
-	Params.GeneratesVisemesAsBlendshapes = GeneratesVisemesAsBlendshapes;
-	Params.Narrative_Template_Keys = NarrativeTemplateKeys;
-	Params.SessionID = SessionID;
-	Params.Environment = Environment;
-	Params.GenerateActions = GenerateActions;
-	Params.ConvaiGRPCVisionParams = ConvaiGRPCVisionParams;
-	Params.AuthKey = AuthKey;
-	Params.AuthHeader = AuthHeader;
+	Make_GRPC_Request_Params(Params, InGenerateActions, InVoiceResponse, false, "", "", false);
+	Params.Environment = PreparedEnvironment;
 
-	ConvaiGRPCGetResponseProxy = UConvaiGRPCGetResponseProxy::CreateConvaiGRPCGetResponseProxy(this, Params);
+	const FConvaiEnvironmentDetails EnvironmentDetails = PreparedEnvironment->ToEnvironmentStruct();
+
+	// Keep the current prepared stream if it already matches, otherwise replace it
+	if (IsValid(PreparedGetResponseProxy) && PreparedGetResponseProxy->CanAttach(Params) && IsSameEnvironment(PreparedEnvironmentDetails, EnvironmentDetails))
+	{
+		UE_LOG(ConvaiChatbotComponentLog, Log, TEXT("PrepareGetResponseStream: Reusing the already prepared stream | Character ID : %s | Session ID : %s"),
+			*CharacterID,
+			*SessionID);
+	}
+	else
+	{
+		DropPreparedStream();
+
+		PreparedEnvironmentDetails = EnvironmentDetails;
+		PreparedGetResponseProxy = UConvaiGRPCGetResponseProxy::CreateConvaiGRPCGetResponseProxy(this, Params);
+		PreparedGetResponseProxy->OnFinish.BindUObject(this, &UConvaiChatbotComponent::OnPreparedStreamClosed);
+		PreparedGetResponseProxy->OnFailure.BindUObject(this, &UConvaiChatbotComponent::OnPreparedStreamClosed);
+		PreparedGetResponseProxy->Prepare();
+	}
+
+	if (UWorld* World = GetWorld())
+	{
+		World->GetTimerManager().SetTimer(PreparedStreamTimerHandle, this, &UConvaiChatbotComponent::CancelPreparedGetResponseStream, FMath::Max(TimeoutSeconds, 0.1f), false);
+	}
+}
+
+void UConvaiChatbotComponent::CancelPreparedGetResponseStream()
+{
+	if (IsValid(PreparedGetResponseProxy))
+	{
+		UE_LOG(ConvaiChatbotComponentLog, Log, TEXT("Dropping unused prepared stream | Character ID : %s | Session ID : %s"),
+			*CharacterID,
+			*SessionID);
+	}
+	DropPreparedStream();
+}
+
+FConvaiLatencyTrace UConvaiChatbotComponent::GetLastLatencyTrace() const
+{
+	return LastLatencyTrace;
+}
+
+void UConvaiChatbotComponent::GetLatencyStats(TArray<FConvaiLatencySpanStats>& OutStats) const
+{
+	FConvaiLatencyTracer::Get().GetStats(CharacterID, OutStats);
+}
+
+bool UConvaiChatbotComponent::HasPreparedGetResponseStream() const
+{
+	return IsValid(PreparedGetResponseProxy);
+}
+
+bool UConvaiChatbotComponent::TryAttachPreparedStream(const FConvaiGRPCGetResponseParams& Params)
+{
+	if (!IsValid(PreparedGetResponseProxy))
+	{
+		return false;
+	}
+
+	FConvaiEnvironmentDetails EnvironmentDetails;
+	if (IsValid(Environment))
+	{
+		EnvironmentDetails = Environment->ToEnvironmentStruct();
+	}
+
+	if (!PreparedGetResponseProxy->CanAttach(Params) || !IsSameEnvironment(PreparedEnvironmentDetails, EnvironmentDetails))
+	{
+		UE_LOG(ConvaiChatbotComponentLog, Log, TEXT("TryAttachPreparedStream: Request settings changed, opening a new stream | Character ID : %s | Session ID : %s"),
+			*CharacterID,
+			*SessionID);
+		DropPreparedStream();
+		return false;
+	}
+
+	if (PreparedStreamTimerHandle.IsValid())
+	{
+		GetWorld()->GetTimerManager().ClearTimer(PreparedStreamTimerHandle);
+		PreparedStreamTimerHandle.Invalidate();
+	}
+
+	PreparedGetResponseProxy->OnFinish.Unbind();
+	PreparedGetResponseProxy->OnFailure.Unbind();
+	ConvaiGRPCGetResponseProxy = PreparedGetResponseProxy;
+	PreparedGetResponseProxy = nullptr;
 
 	// Bind the needed delegates
 	Bind_GRPC_Request_Delegates();
 
-	// Start the stream
-	ConvaiGRPCGetResponseProxy->Activate();
+	// Let the stream start sending the request data
+	ConvaiGRPCGetResponseProxy->Attach(Params);
+	return true;
+}
+
+void UConvaiChatbotComponent::DropPreparedStream()
+{
+	if (PreparedStreamTimerHandle.IsValid())
+	{
+		if (UWorld* World = GetWorld())
+		{
+			World->GetTimerManager().ClearTimer(PreparedStreamTimerHandle);
+		}
+		PreparedStreamTimerHandle.Invalidate();
+	}
+
+	if (PreparedGetResponseProxy)
+	{
+		PreparedGetResponseProxy->OnFinish.Unbind();
+		PreparedGetResponseProxy->OnFailure.Unbind();
+		PreparedGetResponseProxy->Cancel();
+		PreparedGetResponseProxy = nullptr;
+	}
+}
+
+void UConvaiChatbotComponent::OnPreparedStreamClosed()
+{
+	// Called from the gRPC thread when the prepared stream ends before being used
+	AsyncTask(ENamedThreads::GameThread, [WeakThis = MakeWeakObjectPtr(this)]
+		{
+			// Make sure it is still the same stream that closed and not one that was prepared since
+			if (!WeakThis.IsValid() || !IsValid(WeakThis->PreparedGetResponseProxy) || WeakThis->PreparedGetResponseProxy->IsAwaitingAttach())
+			{
+				return;
+			}
+			UE_LOG(ConvaiChatbotComponentLog, Log, TEXT("Prepared stream closed before being used | Character ID : %s | Session ID : %s"),
+				*WeakThis->CharacterID,
+				*WeakThis->SessionID);
+			WeakThis->DropPreparedStream();
+		});
 }
 
 void UConvaiChatbotComponent::Bind_GRPC_Request_Delegates()
@@ -690,7 +924,7 @@ void UConvaiChatbotComponent::Broadcast_onResponseDataReceived_Implementation(co
 {
 	if (!UKismetSystemLibrary::IsServer(this))
 	{
-		onResponseDataReceived(ReceivedText, TArray<uint8>(), 0, IsFinal);
+		onResponseDataReceived(ReceivedText, nullptr, 0, IsFinal);
 	}
 }
 
@@ -736,6 +970,10 @@ void UConvaiChatbotComponent::Broadcast_onEmotionReceived_Implementation(const F
 
 void UConvaiChatbotComponent::OnTranscriptionReceived(FString Transcription, bool IsTranscriptionReady, bool IsFinal)
 {
+	MarkLatency(EConvaiLatencySpan::FirstPartialTranscript);
+	if (IsFinal)
+		MarkLatency(EConvaiLatencySpan::FinalTranscript);
+
 	LastTranscription = Transcription;
 	ReceivedFinalTranscription = IsFinal;
 
@@ -776,8 +1014,13 @@ void UConvaiChatbotComponent::OnTranscriptionReceived(FString Transcription, boo
 	}
 }
 
-void UConvaiChatbotComponent::onResponseDataReceived(const FString ReceivedText, const TArray<uint8>& ReceivedAudio, uint32 SampleRate, bool IsFinal)
+void UConvaiChatbotComponent::onResponseDataReceived(const FString ReceivedText, const FConvaiPCMChunkPtr& ReceivedAudio, uint32 SampleRate, bool IsFinal)
 {
+	if (ReceivedText.Len())
+		MarkLatency(EConvaiLatencySpan::FirstText);
+	if (ReceivedAudio.IsValid())
+		MarkLatency(EConvaiLatencySpan::FirstAudio);
+
 	// Broadcast to clients
 	if (UKismetSystemLibrary::IsServer(this) && ReplicateVoiceToNetwork)
 	{
@@ -795,11 +1038,11 @@ void UConvaiChatbotComponent::onResponseDataReceived(const FString ReceivedText,
 		
 	}
 
-	float ReceieivedAudioDuration = float(ReceivedAudio.Num() - 44) / float(SampleRate * 2); // Assuming 1 channel
+	float ReceieivedAudioDuration = ReceivedAudio.IsValid() ? ReceivedAudio->GetDuration() : 0; // Assuming 1 channel
 
-			if (VoiceResponse && ReceivedAudio.Num() > 0)
+			if (VoiceResponse && ReceivedAudio.IsValid())
 			{
-				AddPCMDataToSend(ReceivedAudio, false, SampleRate, 1); // Should be called in the game thread
+				AddPCMChunkToSend(ReceivedAudio.ToSharedRef()); // Should be called in the game thread
 
 				//FString BasePath = TEXT("F:/Work/Convai/UE_Animation_Dev/TestRecordedAudioChunks");
 				//FString Timestamp = FDateTime::Now().ToString();
@@ -813,7 +1056,7 @@ void UConvaiChatbotComponent::onResponseDataReceived(const FString ReceivedText,
 
 				if (IsRecordingAudio)
 				{
-					RecordedAudio.Append(ReceivedAudio);
+					RecordedAudio.Append(ReceivedAudio->GetData(), ReceivedAudio->GetNumBytes());
 					RecordedAudioSampleRate = SampleRate;
 				}
 			}
@@ -830,7 +1073,7 @@ void UConvaiChatbotComponent::onResponseDataReceived(const FString ReceivedText,
 	}
 	else
 	{
-		AsyncTask(ENamedThreads::GameThread, [this, ReceivedText, ReceivedAudio, SampleRate, IsFinal, ReceieivedAudioDuration]
+		AsyncTask(ENamedThreads::GameThread, [this, ReceivedText, IsFinal, ReceieivedAudioDuration]
 			{
 				// Send text and audio duration to blueprint event
 				OnTextReceivedEvent_V2.Broadcast(this, CurrentConvaiPlayerComponent, CharacterName, ReceivedText, ReceieivedAudioDuration, IsFinal);
@@ -848,6 +1091,9 @@ void UConvaiChatbotComponent::onResponseDataReceived(const FString ReceivedText,
 	{
 		UE_LOG(ConvaiChatbotComponentLog, Log, TEXT("Chatbot Total Received Audio: %f seconds"), TotalReceivedAudioDuration);
 		TotalReceivedAudioDuration = 0;
+
+		// The voice draining from here on is the end of the response, not an underrun
+		EndVoiceResponse();
 	}
 
 	ReceivedFinalData = IsFinal;
@@ -855,6 +1101,7 @@ void UConvaiChatbotComponent::onResponseDataReceived(const FString ReceivedText,
 
 void UConvaiChatbotComponent::OnFaceDataReceived(FAnimationSequence FaceDataAnimation)
 {
+	MarkLatency(EConvaiLatencySpan::FirstFaceData);
 	AddFaceDataToSend(FaceDataAnimation);
 }
 
@@ -1000,6 +1247,18 @@ void UConvaiChatbotComponent::onFinishedReceivingData()
 			*SessionID);
 		Unbind_GRPC_Request_Delegates();
 		ConvaiGRPCGetResponseProxy = nullptr;
+
+		// Without a voice response the turn ends here, otherwise it ends when the character starts talking
+		if (!VoiceResponse)
+		{
+			AsyncTask(ENamedThreads::GameThread, [WeakThis = MakeWeakObjectPtr(this), Trace = GetLatencyTrace()]
+				{
+					if (WeakThis.IsValid() && Trace.IsValid())
+					{
+						WeakThis->CommitLatencyTrace(Trace.Get());
+					}
+				});
+		}
 	}
 }
 
@@ -1164,11 +1423,16 @@ void UConvaiChatbotComponent::TickComponent(float DeltaTime, ELevelTick TickType
 	if (Successful) // If there is mic data to send
 	{
 		// UE_LOG(ConvaiChatbotComponentLog, Log, TEXT("ConvaiChatbotComponentTick:: Succesful consumption of %d bytes"), PlayerInpuAudioBuffer.Num());
-		ConvaiGRPCGetResponseProxy->WriteAudioDataToSend(PlayerInpuAudioBuffer.GetData(), PlayerInpuAudioBuffer.Num(), ThisIsTheLastWrite);
+		// Swaps the buffer into the proxy, we get back an empty one that keeps its allocation
+		ConvaiGRPCGetResponseProxy->WriteAudioDataToSend(PlayerInpuAudioBuffer, ThisIsTheLastWrite);
 	}
 	if (ThisIsTheLastWrite) // If there is no data to send, and we do not expect more mic data to send  
 	{
 		// UE_LOG(ConvaiChatbotComponentLog, Log, TEXT("ConvaiChatbotComponentTick:: FinishWriting"));
+		// The player stamps FinishTalking when it stops, only a player that went away without it is stamped here
+		if (!IsValid(CurrentConvaiPlayerComponent))
+			MarkLatency(EConvaiLatencySpan::FinishTalking);
+		MarkLatency(EConvaiLatencySpan::MicDrained);
 		ConvaiGRPCGetResponseProxy->FinishWriting();
 	}
 
@@ -1197,6 +1461,7 @@ void UConvaiChatbotComponent::BeginDestroy()
 		Environment->OnEnvironmentChanged.Unbind();
 	}
 	Unbind_GRPC_Request_Delegates();
+	DropPreparedStream();
 	Cleanup(true);
 	Super::BeginDestroy();
 }
@@ -9,4 +9,142 @@ const TMap<EEmotionIntensity, float> FConvaiEmotionState::ScoreMultipliers =
 	{EEmotionIntensity::LessIntense, 0.25},
 	{EEmotionIntensity::Basic, 0.6},
 	{EEmotionIntensity::MoreIntense, 1}
-};
\ No newline at end of file
+};
+
+namespace
+{
+	struct FFaceCurveSetTable
+	{
+		TArray<FName> Names;
+
+		// UTF-8 copies of the names so payloads can be matched without creating FNames
+		TArray<TArray<ANSICHAR>> AnsiNames;
+
+		explicit FFaceCurveSetTable(const TArray<FString>& CurveNames)
+		{
+			Names.Reserve(CurveNames.Num());
+			AnsiNames.Reserve(CurveNames.Num());
+			for (const FString& CurveName : CurveNames)
+			{
+				Names.Add(FName(*CurveName));
+				FTCHARToUTF8 Converted(*CurveName);
+				AnsiNames.Emplace(Converted.Get(), Converted.Length());
+			}
+		}
+	};
+
+	const FFaceCurveSetTable* GetFaceCurveSetTable(EConvaiFaceCurveSet CurveSet)
+	{
+		static const FFaceCurveSetTable VisemesTable(ConvaiConstants::VisemeNames);
+		static const FFaceCurveSetTable ARKitTable(ConvaiConstants::BlendShapesNames);
+
+		switch (CurveSet)
+		{
+		case EConvaiFaceCurveSet::Visemes:
+			return &VisemesTable;
+		case EConvaiFaceCurveSet::ARKit:
+			return &ARKitTable;
+		default:
+			return nullptr;
+		}
+	}
+}
+
+const TArray<FName>& FConvaiFaceCurveSet::GetCurveNames(EConvaiFaceCurveSet CurveSet)
+{
+	static const TArray<FName> NoCurves;
+	const FFaceCurveSetTable* Table = GetFaceCurveSetTable(CurveSet);
+	return Table ? Table->Names : NoCurves;
+}
+
+int32 FConvaiFaceCurveSet::FindCurveIndex(EConvaiFaceCurveSet CurveSet, FName CurveName)
+{
+	return GetCurveNames(CurveSet).IndexOfByKey(CurveName);
+}
+
+int32 FConvaiFaceCurveSet::FindCurveIndex(EConvaiFaceCurveSet CurveSet, const ANSICHAR* CurveName, int32 CurveNameLen, int32 Hint)
+{
+	const FFaceCurveSetTable* Table = GetFaceCurveSetTable(CurveSet);
+	if (!Table)
+	{
+		return INDEX_NONE;
+	}
+
+	auto Matches = [Table, CurveName, CurveNameLen](int32 Index)
+	{
+		const TArray<ANSICHAR>& AnsiName = Table->AnsiNames[Index];
+		return AnsiName.Num() == CurveNameLen && FMemory::Memcmp(AnsiName.GetData(), CurveName, CurveNameLen) == 0;
+	};
+
+	// The server sends the curves in the set order, so the hint almost always matches
+	if (Table->AnsiNames.IsValidIndex(Hint) && Matches(Hint))
+	{
+		return Hint;
+	}
+
+	for (int32 Index = 0; Index < Table->AnsiNames.Num(); Index++)
+	{
+		if (Matches(Index))
+		{
+			return Index;
+		}
+	}
+	return INDEX_NONE;
+}
+
+void FAnimationFrame::InitCurveSet(EConvaiFaceCurveSet InCurveSet)
+{
+	CurveSet = InCurveSet;
+	CurveValues.Reset();
+	CurveValues.SetNumZeroed(FConvaiFaceCurveSet::GetCurveNames(InCurveSet).Num());
+}
+
+bool FAnimationFrame::FindCurveValue(FName CurveName, float& OutValue) const
+{
+	const int32 Index = FConvaiFaceCurveSet::FindCurveIndex(CurveSet, CurveName);
+	if (CurveValues.IsValidIndex(Index))
+	{
+		OutValue = CurveValues[Index];
+		return true;
+	}
+
+	if (const float* Value = BlendShapes.Find(CurveName))
+	{
+		OutValue = *Value;
+		return true;
+	}
+	return false;
+}
+
+void FAnimationFrame::SetCurveValue(FName CurveName, float Value)
+{
+	const int32 Index = FConvaiFaceCurveSet::FindCurveIndex(CurveSet, CurveName);
+	if (CurveValues.IsValidIndex(Index))
+	{
+		CurveValues[Index] = Value;
+	}
+	else
+	{
+		BlendShapes.Add(CurveName, Value);
+	}
+}
+
+TMap<FName, float> FAnimationFrame::GetBlendShapes() const
+{
+	if (CurveValues.Num() == 0)
+	{
+		return BlendShapes;
+	}
+
+	const TArray<FName>& CurveNames = FConvaiFaceCurveSet::GetCurveNames(CurveSet);
+	const int32 NumValues = FMath::Min(CurveNames.Num(), CurveValues.Num());
+
+	TMap<FName, float> Result;
+	Result.Reserve(NumValues + BlendShapes.Num());
+	for (int32 Index = 0; Index < NumValues; Index++)
+	{
+		Result.Add(CurveNames[Index], CurveValues[Index]);
+	}
+	Result.Append(BlendShapes);
+	return Result;
+}
@@ -1,13 +1,19 @@
 // Copyright 2022 Convai Inc. All Rights Reserved.
 
 #include "ConvaiFaceSync.h"
+#include "ConvaiFaceSyncSubsystem.h"
+#include "Engine/World.h"
 #include "Misc/ScopeLock.h"
 #include "ConvaiUtils.h"
+#include "ConvaiPlaybackClock.h"
 
 DEFINE_LOG_CATEGORY(ConvaiFaceSyncLog);
 
 namespace
 {
+	// A sequence waiting for its voice is dropped when the voice clock does not move for this many unpaused world seconds, e.g. the voice was never played
+	constexpr double MaxVoiceStallSeconds = 2.0;
+
 	// Helper function: Creates a zero blendshapes map
 	TMap<FName, float> CreateZeroBlendshapes()
 	{
@@ -32,6 +38,29 @@ namespace
 	}
 
 
+	// Helper function: Creates the zero curves of a set, in the set order
+	TArray<float> CreateZeroCurves(EConvaiFaceCurveSet CurveSet)
+	{
+		FAnimationFrame ZeroFrame;
+		ZeroFrame.InitCurveSet(CurveSet);
+		if (CurveSet == EConvaiFaceCurveSet::Visemes)
+		{
+			ZeroFrame.SetCurveValue(FName("sil"), 1);
+		}
+		return ZeroFrame.CurveValues;
+	}
+
+	// Helper function: Per curve weights keeping only the curves whose names are accepted, in the set order
+	TArray<float> CreateCurveMask(EConvaiFaceCurveSet CurveSet, TFunctionRef<bool(const FString&)> KeepCurve)
+	{
+		TArray<float> Mask;
+		for (const FName& CurveName : FConvaiFaceCurveSet::GetCurveNames(CurveSet))
+		{
+			Mask.Add(KeepCurve(CurveName.ToString()) ? 1.0f : 0.0f);
+		}
+		return Mask;
+	}
+
 	float Calculate1DBezierCurve(float t, float P0, float P1, float P2, float P3)
 	{
 		// Make sure t is in the range [0, 1]
@@ -53,6 +82,7 @@ UConvaiFaceSyncComponent::UConvaiFaceSyncComponent()
 {
 	PrimaryComponentTick.bCanEverTick = true;
 	CurrentSequenceTimePassed = 0;
+	CurrentBlendShapesMapDirty = true;
 	//CurrentBlendShapesMap = ZeroBlendshapeFrame;
 }
 
@@ -64,7 +94,25 @@ UConvaiFaceSyncComponent::~UConvaiFaceSyncComponent() // Implement destructor
 void UConvaiFaceSyncComponent::BeginPlay()
 {
 	Super::BeginPlay();
-	CurrentBlendShapesMap = GenerateZeroFrame();
+	CompileCurveSourceMap();
+	SetCurrentFrametoZero();
+	PublishCurveSnapshot();
+
+	// The subsystem picks the LOD, with batching on it also evaluates crowds in parallel and the component tick is unregistered
+	if (UConvaiFaceSyncSubsystem* FaceSyncSubsystem = UConvaiFaceSyncSubsystem::Get(GetWorld()))
+	{
+		FaceSyncSubsystem->RegisterFaceSync(this);
+	}
+}
+
+void UConvaiFaceSyncComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UConvaiFaceSyncSubsystem* FaceSyncSubsystem = UConvaiFaceSyncSubsystem::Get(GetWorld()))
+	{
+		FaceSyncSubsystem->UnregisterFaceSync(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
 }
 
 void UConvaiFaceSyncComponent::TickComponent(float DeltaTime, ELevelTick TickType,
@@ -72,40 +120,101 @@ void UConvaiFaceSyncComponent::TickComponent(float DeltaTime, ELevelTick TickTyp
 {
 	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
 
+	// Coarser LODs are evaluated at their own rate, like in the batched evaluation
+	if (ConsumeEvaluation(FPlatformTime::Seconds()))
+	{
+		EvaluateLipSync();
+	}
+}
+
+void UConvaiFaceSyncComponent::EvaluateLipSync()
+{
+	if (EvaluateCurves())
+	{
+		// Trigger the blueprint event
+		OnVisemesDataReady.ExecuteIfBound();
+	}
+}
+
+bool UConvaiFaceSyncComponent::EvaluateCurves()
+{
 	// Interpolate blendshapes and advance animation sequence
 	if (IsValidSequence(MainSequenceBuffer))
 	{
 		SequenceCriticalSection.Lock();
 
-		// Calculate time passed since ConvaiProcessLipSyncAdvanced was called
-		double CurrentTime = FPlatformTime::Seconds();
+		// Calculate time passed since the sequence started, on the voice playback clock when it follows one
+		double CurrentTime = GetSequenceTime();
 		CurrentSequenceTimePassed = CurrentTime - StartTime;
 
+		// The voice of this sequence has not started playing yet, keep the start so later frames append to it
+		if (CurrentSequenceTimePassed < 0)
+		{
+			// World time stops while the game is paused, a paused voice is not a stalled one
+			const UWorld* World = GetWorld();
+			const double Now = World ? World->GetTimeSeconds() : LastWaitingProgressTime;
+			if (CurrentTime != LastWaitingSequenceTime)
+			{
+				LastWaitingSequenceTime = CurrentTime;
+				LastWaitingProgressTime = Now;
+			}
+			else if (Now - LastWaitingProgressTime > MaxVoiceStallSeconds)
+			{
+				UE_LOG(ConvaiFaceSyncLog, Warning, TEXT("EvaluateCurves: Dropping the face sequence, its voice did not start within %.1f secs"), MaxVoiceStallSeconds);
+				ResetLipSync();
+				SequenceCriticalSection.Unlock();
+				return true;
+			}
+
+			bIsPlaying = true;
+			SequenceCriticalSection.Unlock();
+			return false;
+		}
+
 		if (CurrentSequenceTimePassed > MainSequenceBuffer.Duration)
 		{
-			ConvaiStopLipSync();
+			ResetLipSync();
 			SequenceCriticalSection.Unlock();
-			return;
+			return true;
 		}
 
 		bIsPlaying = true;
 
+		// Too far away to be seen, keep following the sequence so a finer LOD picks it up in time, but leave the face at rest
+		if (FaceLOD == EConvaiFaceLOD::Off)
+		{
+			SequenceCriticalSection.Unlock();
+			if (CurrentCurveValues == GetZeroCurveValues())
+			{
+				return false;
+			}
+			SetCurrentFrametoZero();
+			PublishCurveSnapshot();
+			return true;
+		}
+
+		// The curve set can change with ToggleBlendshapeOrViseme, the buffers are only resized when it does
+		const int32 NumCurves = GetCurveNames().Num();
+		if (CurrentCurveValues.Num() != NumCurves)
+		{
+			SetCurrentFrametoZero();
+		}
+		StartFrameCurves.SetNumUninitialized(NumCurves);
+		EndFrameCurves.SetNumUninitialized(NumCurves);
+
 		// Calculate frame duration and offsets
 		float FrameDuration = MainSequenceBuffer.Duration / MainSequenceBuffer.AnimationFrames.Num();
 		float FrameOffset = FrameDuration * 0.5f;
 		int32 FrameIndex;
 		int32 BufferIndex;
-
-		TMap<FName, float> StartFrame;
-		TMap<FName, float> EndFrame;
 		float Alpha;
 
 		// Choose the current and next BlendShapes
 		if (CurrentSequenceTimePassed <= FrameOffset)
 		{
 			//StartFrame = ZeroBlendshapeFrame;
-			StartFrame = GetCurrentFrame();
-			EndFrame = MainSequenceBuffer.AnimationFrames[0].BlendShapes;
+			FMemory::Memcpy(StartFrameCurves.GetData(), CurrentCurveValues.GetData(), NumCurves * sizeof(float));
+			CopyFrameCurves(MainSequenceBuffer.AnimationFrames[0], EndFrameCurves);
 			Alpha = CurrentSequenceTimePassed / FrameOffset + 0.5;
 			FrameIndex = MainSequenceBuffer.AnimationFrames[0].FrameIndex;
 			BufferIndex = 0;
@@ -113,8 +222,8 @@ void UConvaiFaceSyncComponent::TickComponent(float DeltaTime, ELevelTick TickTyp
 		else if (CurrentSequenceTimePassed >= MainSequenceBuffer.Duration - FrameOffset)
 		{
 			int LastFrameIdx = MainSequenceBuffer.AnimationFrames.Num() - 1;
-			StartFrame = MainSequenceBuffer.AnimationFrames[LastFrameIdx].BlendShapes;
-			EndFrame = GenerateZeroFrame();
+			CopyFrameCurves(MainSequenceBuffer.AnimationFrames[LastFrameIdx], StartFrameCurves);
+			FMemory::Memcpy(EndFrameCurves.GetData(), GetZeroCurveValues().GetData(), NumCurves * sizeof(float));
 			Alpha = (CurrentSequenceTimePassed - (MainSequenceBuffer.Duration - FrameOffset)) / FrameOffset;
 			FrameIndex = MainSequenceBuffer.AnimationFrames[LastFrameIdx].FrameIndex;
 			BufferIndex = LastFrameIdx;
@@ -124,11 +233,15 @@ void UConvaiFaceSyncComponent::TickComponent(float DeltaTime, ELevelTick TickTyp
 			int CurrentFrameIndex = FMath::FloorToInt((CurrentSequenceTimePassed - FrameOffset) / FrameDuration);
 			CurrentFrameIndex = FMath::Min(CurrentFrameIndex, MainSequenceBuffer.AnimationFrames.Num() - 1);
 			int NextFrameIndex = FMath::Min(CurrentFrameIndex + 1, MainSequenceBuffer.AnimationFrames.Num() - 1);
-			StartFrame = MainSequenceBuffer.AnimationFrames[CurrentFrameIndex].BlendShapes;
-			EndFrame = MainSequenceBuffer.AnimationFrames[NextFrameIndex].BlendShapes;
+			CopyFrameCurves(MainSequenceBuffer.AnimationFrames[CurrentFrameIndex], StartFrameCurves);
+			CopyFrameCurves(MainSequenceBuffer.AnimationFrames[NextFrameIndex], EndFrameCurves);
 			Alpha = (CurrentSequenceTimePassed - FrameOffset - (CurrentFrameIndex * FrameDuration)) / FrameDuration;
 
-			Apply_StartEndFrames_PostProcessing(CurrentFrameIndex, NextFrameIndex, Alpha, StartFrame, EndFrame);
+			Apply_StartEndFrames_CurvePostProcessing(CurrentFrameIndex, NextFrameIndex, Alpha, StartFrameCurves, EndFrameCurves);
+			if (bUsesStartEndFramesMapPostProcessing)
+			{
+				ApplyStartEndFramesMapPostProcessing(CurrentFrameIndex, NextFrameIndex, Alpha);
+			}
 
 			FrameIndex = MainSequenceBuffer.AnimationFrames[CurrentFrameIndex].FrameIndex;
 			BufferIndex = CurrentFrameIndex;
@@ -137,23 +250,39 @@ void UConvaiFaceSyncComponent::TickComponent(float DeltaTime, ELevelTick TickTyp
 
 		// UE_LOG(ConvaiFaceSyncLog, Log, TEXT("Evaluate: FrameIndex:%d Alpha: %f FramesLeft: %d"), FrameIndex, Alpha, MainSequenceBuffer.AnimationFrames.Num() - BufferIndex);
 
-		//CurrentBlendShapesMap = StartFrame;
-		CurrentBlendShapesMap = InterpolateFrames(StartFrame, EndFrame, Alpha);
+		InterpolateCurves(StartFrameCurves.GetData(), EndFrameCurves.GetData(), Alpha, CurrentCurveValues.GetData(), NumCurves);
+		CurrentBlendShapesMapDirty = true;
 
-		ApplyPostProcessing();
-
-		// Trigger the blueprint event
-		OnVisemesDataReady.ExecuteIfBound();
+		ApplyFaceLODCurves();
+		ApplyCurvePostProcessing();
+		if (bUsesMapPostProcessing)
+		{
+			ApplyMapPostProcessing();
+		}
+		PublishCurveSnapshot();
+		return true;
 	}
+	return false;
 }
 
 void UConvaiFaceSyncComponent::ConvaiProcessLipSyncAdvanced(uint8* InPCMData, uint32 InPCMDataSize, uint32 InSampleRate, uint32 InNumChannels, FAnimationSequence FaceSequence)
+{
+	AppendSequence(FaceSequence, true);
+}
+
+void UConvaiFaceSyncComponent::ConvaiSetPlaybackClock(TSharedPtr<const FConvaiPlaybackClock, ESPMode::ThreadSafe> InPlaybackClock)
+{
+	FScopeLock ScopeLock(&SequenceCriticalSection);
+	PlaybackClock = InPlaybackClock;
+}
+
+void UConvaiFaceSyncComponent::AppendSequence(const FAnimationSequence& FaceSequence, bool FollowPlaybackClock)
 {
 	SequenceCriticalSection.Lock();
 	MainSequenceBuffer.AnimationFrames.Append(FaceSequence.AnimationFrames);
 	MainSequenceBuffer.Duration += FaceSequence.Duration;
 	MainSequenceBuffer.FrameRate = FaceSequence.FrameRate;
-	CalculateStartingTime();
+	CalculateStartingTime(FollowPlaybackClock);
 	SequenceCriticalSection.Unlock();
 
 	if (IsRecordingLipSync)
@@ -170,9 +299,10 @@ void UConvaiFaceSyncComponent::ConvaiProcessLipSyncSingleFrame(FAnimationFrame F
 	SequenceCriticalSection.Lock();
 	if (!GeneratesVisemesAsBlendshapes())
 	{
-		float* sil = FaceFrame.BlendShapes.Find("sil");
-		if (sil != nullptr && *sil < 0)
+		float sil;
+		if (FaceFrame.FindCurveValue(FName("sil"), sil) && sil < 0)
 		{
+			SequenceCriticalSection.Unlock();
 			ClearMainSequence();
 			Stopping = true;
 			return;
@@ -285,13 +415,13 @@ bool UConvaiFaceSyncComponent::PlayRecordedLipSync(FAnimationSequenceBP Recorded
 	}
 
 	UE_LOG(ConvaiFaceSyncLog, Log, TEXT("Playing Recorded LipSync - Total Frames: %d - Duration: %f"), RecordedLipSync.AnimationSequence.AnimationFrames.Num(), RecordedLipSync.AnimationSequence.Duration);
-	ConvaiProcessLipSyncAdvanced(nullptr, 0, 0, 0, RecordedLipSync.AnimationSequence);
+	AppendSequence(RecordedLipSync.AnimationSequence, false);
 	return true;
 }
 
 bool UConvaiFaceSyncComponent::IsValidSequence(const FAnimationSequence& Sequence)
 {
-	if (Sequence.Duration > 0 && Sequence.AnimationFrames.Num() > 0 && Sequence.AnimationFrames[0].BlendShapes.Num() > 0)
+	if (Sequence.Duration > 0 && Sequence.AnimationFrames.Num() > 0 && Sequence.AnimationFrames[0].NumCurves() > 0)
 		return true;
 	else
 		return false;
@@ -302,10 +432,21 @@ bool UConvaiFaceSyncComponent::IsPlaying()
 	return bIsPlaying;
 }
 
-void UConvaiFaceSyncComponent::CalculateStartingTime()
+void UConvaiFaceSyncComponent::CalculateStartingTime(bool FollowPlaybackClock)
 {
 	if (!bIsPlaying)
-		StartTime = FPlatformTime::Seconds();
+	{
+		SequenceFollowsPlaybackClock = FollowPlaybackClock && PlaybackClock.IsValid();
+
+		// The streamer queues the voice right before its face data, the sequence starts when that voice is heard
+		StartTime = SequenceFollowsPlaybackClock ? PlaybackClock->GetLastQueuedStartSeconds() : FPlatformTime::Seconds();
+		LastWaitingSequenceTime = -1;
+	}
+}
+
+double UConvaiFaceSyncComponent::GetSequenceTime() const
+{
+	return SequenceFollowsPlaybackClock ? PlaybackClock->GetPlayedSeconds() : FPlatformTime::Seconds();
 }
 
 void UConvaiFaceSyncComponent::ClearMainSequence()
@@ -318,23 +459,381 @@ void UConvaiFaceSyncComponent::ClearMainSequence()
 
 TMap<FName, float> UConvaiFaceSyncComponent::InterpolateFrames(const TMap<FName, float>& StartFrame, const TMap<FName, float>& EndFrame, float Alpha)
 {
-	const TArray<FString>& CurveNames = GeneratesVisemesAsBlendshapes() ? ConvaiConstants::BlendShapesNames : ConvaiConstants::VisemeNames;
+	const TArray<FName>& CurveNames = GetCurveNames();
 	TMap<FName, float> Result;
-	for (const auto& CurveName : CurveNames)
+	Result.Reserve(CurveNames.Num());
+	for (const FName& CurveName : CurveNames)
 	{
-		float StartValue = StartFrame.Contains(*CurveName) ? StartFrame[*CurveName] : 0.0;
-		float EndValue = EndFrame.Contains(*CurveName) ? EndFrame[*CurveName] : 0.0;
-		Result.Add(*CurveName, FMath::Lerp(StartValue, EndValue, Alpha));
+		const float* StartValue = StartFrame.Find(CurveName);
+		const float* EndValue = EndFrame.Find(CurveName);
+		Result.Add(CurveName, FMath::Lerp(StartValue ? *StartValue : 0.0f, EndValue ? *EndValue : 0.0f, Alpha));
 	}
 	return Result;
 }
 
-void UConvaiFaceSyncComponent::ConvaiStopLipSync()
+void UConvaiFaceSyncComponent::InterpolateCurves(const float* Start, const float* End, float Alpha, float* Result, int32 Num)
+{
+	const VectorRegister AlphaVector = VectorSetFloat1(Alpha);
+
+	int32 Index = 0;
+	for (; Index + 4 <= Num; Index += 4)
+	{
+		const VectorRegister StartVector = VectorLoad(Start + Index);
+		const VectorRegister EndVector = VectorLoad(End + Index);
+		VectorStore(VectorMultiplyAdd(VectorSubtract(EndVector, StartVector), AlphaVector, StartVector), Result + Index);
+	}
+
+	for (; Index < Num; Index++)
+	{
+		Result[Index] = FMath::Lerp(Start[Index], End[Index], Alpha);
+	}
+}
+
+void UConvaiFaceSyncComponent::CopyFrameCurves(const FAnimationFrame& Frame, TArray<float>& OutCurves)
+{
+	const int32 NumCurves = OutCurves.Num();
+	if (Frame.CurveSet == GetCurveSet() && Frame.CurveValues.Num() == NumCurves)
+	{
+		FMemory::Memcpy(OutCurves.GetData(), Frame.CurveValues.GetData(), NumCurves * sizeof(float));
+		return;
+	}
+
+	// Frames recorded by name or in the other curve set are matched by name, missing curves are zero
+	const TArray<FName>& CurveNames = GetCurveNames();
+	for (int32 Index = 0; Index < NumCurves; Index++)
+	{
+		float Value = 0;
+		Frame.FindCurveValue(CurveNames[Index], Value);
+		OutCurves[Index] = Value;
+	}
+}
+
+const TArray<float>& UConvaiFaceSyncComponent::GetZeroCurveValues()
+{
+	static const TArray<float> ZeroBlendshapeCurves = CreateZeroCurves(EConvaiFaceCurveSet::ARKit);
+	static const TArray<float> ZeroVisemeCurves = CreateZeroCurves(EConvaiFaceCurveSet::Visemes);
+	return GeneratesVisemesAsBlendshapes() ? ZeroBlendshapeCurves : ZeroVisemeCurves;
+}
+
+void UConvaiFaceSyncComponent::SetCurrentFrametoZero()
+{
+	CurrentCurveValues = GetZeroCurveValues();
+	CurrentBlendShapesMapDirty = true;
+}
+
+TMap<FName, float> UConvaiFaceSyncComponent::GetCurrentFrame()
+{
+	// The map is only built when someone asks for it by name, the tick itself works on CurrentCurveValues
+	if (CurrentBlendShapesMapDirty)
+	{
+		const TArray<FName>& CurveNames = GetCurveNames();
+		const int32 NumCurves = FMath::Min(CurveNames.Num(), CurrentCurveValues.Num());
+		CurrentBlendShapesMap.Reset();
+		for (int32 Index = 0; Index < NumCurves; Index++)
+		{
+			CurrentBlendShapesMap.Add(CurveNames[Index], CurrentCurveValues[Index]);
+		}
+		CurrentBlendShapesMapDirty = false;
+	}
+	return CurrentBlendShapesMap;
+}
+
+void UConvaiFaceSyncComponent::ApplyStartEndFramesMapPostProcessing(int CurrentFrameIndex, int NextFrameIndex, float& Alpha)
+{
+	const TArray<FName>& CurveNames = GetCurveNames();
+	const int32 NumCurves = FMath::Min(CurveNames.Num(), StartFrameCurves.Num());
+
+	TMap<FName, float> StartFrame;
+	TMap<FName, float> EndFrame;
+	StartFrame.Reserve(NumCurves);
+	EndFrame.Reserve(NumCurves);
+	for (int32 Index = 0; Index < NumCurves; Index++)
+	{
+		StartFrame.Add(CurveNames[Index], StartFrameCurves[Index]);
+		EndFrame.Add(CurveNames[Index], EndFrameCurves[Index]);
+	}
+
+PRAGMA_DISABLE_DEPRECATION_WARNINGS
+	Apply_StartEndFrames_PostProcessing(CurrentFrameIndex, NextFrameIndex, Alpha, StartFrame, EndFrame);
+PRAGMA_ENABLE_DEPRECATION_WARNINGS
+
+	// Curves added under other names are not part of the curve set and are dropped
+	for (int32 Index = 0; Index < NumCurves; Index++)
+	{
+		StartFrameCurves[Index] = StartFrame.FindRef(CurveNames[Index]);
+		EndFrameCurves[Index] = EndFrame.FindRef(CurveNames[Index]);
+	}
+}
+
+void UConvaiFaceSyncComponent::ApplyMapPostProcessing()
+{
+	GetCurrentFrame();
+
+PRAGMA_DISABLE_DEPRECATION_WARNINGS
+	ApplyPostProcessing();
+PRAGMA_ENABLE_DEPRECATION_WARNINGS
+
+	if (!bUsesMapPostProcessing)
+	{
+		return;
+	}
+
+	// Edits to the map take precedence over the evaluated curves, the map is kept as edited for ConvaiGetFaceBlendshapes
+	const TArray<FName>& CurveNames = GetCurveNames();
+	const int32 NumCurves = FMath::Min(CurveNames.Num(), CurrentCurveValues.Num());
+	for (int32 Index = 0; Index < NumCurves; Index++)
+	{
+		CurrentCurveValues[Index] = CurrentBlendShapesMap.FindRef(CurveNames[Index]);
+	}
+}
+
+void UConvaiFaceSyncComponent::ResetLipSync()
 {
 	bIsPlaying = false;
 	CurrentSequenceTimePassed = 0;
 	ClearMainSequence();
 	SetCurrentFrametoZero();
+	PublishCurveSnapshot();
+}
+
+void UConvaiFaceSyncComponent::ConvaiStopLipSync()
+{
+	ResetLipSync();
 	OnVisemesDataReady.ExecuteIfBound();
 	// UE_LOG(ConvaiFaceSyncLog, Warning, TEXT("Stopping LipSync"));
 }
+
+void UConvaiFaceSyncComponent::PublishCurveSnapshot()
+{
+	const TArray<FName>& CurveNames = GetCurveNames();
+	const int32 NumCurves = FMath::Min(CurveNames.Num(), CurrentCurveValues.Num());
+
+	TArray<FNamedCurveValue>& Snapshot = CurveSnapshot.GetWriteBuffer();
+	Snapshot.Reset();
+
+	if (CurveSourceBlendshapeMap.Num() == 0)
+	{
+		for (int32 Index = 0; Index < NumCurves; Index++)
+		{
+			FNamedCurveValue& Curve = Snapshot.AddDefaulted_GetRef();
+			Curve.Name = CurveNames[Index];
+			Curve.Value = CurrentCurveValues[Index];
+		}
+	}
+	else if (NumCurves == CurveNames.Num())
+	{
+		// Compiled up front, only recompiled here when ToggleBlendshapeOrViseme switched the source curves
+		if (!CompiledCurveSourceMap.IsValid() || CompiledCurveSourceSet != GetCurveSet())
+		{
+			CompileCurveSourceMap();
+		}
+
+		const TArray<FName>& TargetNames = CompiledCurveSourceMap->GetTargetNames();
+		RemappedCurveValues.SetNumUninitialized(TargetNames.Num());
+		CompiledCurveSourceMap->Evaluate(CurrentCurveValues.GetData(), CurveSourceGlobalMultiplier, CurveSourceGlobalOffset, RemappedCurveValues.GetData());
+
+		for (int32 Index = 0; Index < TargetNames.Num(); Index++)
+		{
+			FNamedCurveValue& Curve = Snapshot.AddDefaulted_GetRef();
+			Curve.Name = TargetNames[Index];
+			Curve.Value = RemappedCurveValues[Index];
+		}
+	}
+
+	CurveSnapshot.SwapWriteBuffers();
+}
+
+void UConvaiFaceSyncComponent::SetCurveSourceBlendshapeMap(const TMap<FName, FConvaiBlendshapeParameters>& InBlendshapeMap)
+{
+	CurveSourceBlendshapeMap = InBlendshapeMap;
+	CompileCurveSourceMap();
+}
+
+void UConvaiFaceSyncComponent::CompileCurveSourceMap()
+{
+	CompiledCurveSourceSet = GetCurveSet();
+	CompiledCurveSourceMap.Reset();
+	if (CurveSourceBlendshapeMap.Num() > 0)
+	{
+		CompiledCurveSourceMap = FConvaiCompiledBlendshapeMap::FindOrCompile(CurveSourceBlendshapeMap, FConvaiFaceCurveSet::GetCurveNames(CompiledCurveSourceSet));
+	}
+}
+
+float UConvaiFaceSyncComponent::GetCurveValue_Implementation(FName CurveName) const
+{
+	FScopeLock ScopeLock(&CurveSnapshotReadCriticalSection);
+	if (CurveSnapshot.IsDirty())
+	{
+		CurveSnapshot.SwapReadBuffers();
+	}
+
+	for (const FNamedCurveValue& Curve : CurveSnapshot.Read())
+	{
+		if (Curve.Name == CurveName)
+		{
+			return Curve.Value;
+		}
+	}
+	return 0;
+}
+
+void UConvaiFaceSyncComponent::GetCurves_Implementation(TArray<FNamedCurveValue>& OutCurves) const
+{
+	FScopeLock ScopeLock(&CurveSnapshotReadCriticalSection);
+	if (CurveSnapshot.IsDirty())
+	{
+		CurveSnapshot.SwapReadBuffers();
+	}
+	OutCurves.Append(CurveSnapshot.Read());
+}
+
+void UConvaiFaceSyncComponent::SetFaceLOD(EConvaiFaceLOD InFaceLOD)
+{
+	if (InFaceLOD < FaceLOD)
+	{
+		// Pick up the finer detail right away rather than at the old rate
+		NextEvaluationTime = 0;
+	}
+	FaceLOD = InFaceLOD;
+}
+
+EConvaiFaceLOD UConvaiFaceSyncComponent::ComputeFaceLOD(float ViewDistance, bool RecentlyRendered) const
+{
+	EConvaiFaceLOD NewFaceLOD = EConvaiFaceLOD::Full;
+	if (ViewDistance >= OffLODDistance)
+	{
+		NewFaceLOD = EConvaiFaceLOD::Off;
+	}
+	else if (ViewDistance >= MinimalLODDistance)
+	{
+		NewFaceLOD = EConvaiFaceLOD::Minimal;
+	}
+	else if (ViewDistance >= ReducedLODDistance)
+	{
+		NewFaceLOD = EConvaiFaceLOD::Reduced;
+	}
+
+	if (!RecentlyRendered && NewFaceLOD < OffscreenLOD)
+	{
+		NewFaceLOD = OffscreenLOD;
+	}
+	return NewFaceLOD;
+}
+
+bool UConvaiFaceSyncComponent::ConsumeEvaluation(double Now)
+{
+	if (FaceLOD == EConvaiFaceLOD::Full)
+	{
+		return true;
+	}
+
+	if (Now < NextEvaluationTime)
+	{
+		return false;
+	}
+
+	const float UpdateRate = FaceLOD == EConvaiFaceLOD::Reduced ? ReducedLODUpdateRate : MinimalLODUpdateRate;
+	NextEvaluationTime = Now + 1.0 / FMath::Max(UpdateRate, 1.0f);
+	return true;
+}
+
+void UConvaiFaceSyncComponent::SetEvaluatedBySubsystem(bool InEvaluatedBySubsystem)
+{
+	EvaluatedBySubsystem = InEvaluatedBySubsystem;
+	NextSubsystemTickTime = 0;
+	if (IsRegistered())
+	{
+		RegisterComponentTickFunctions(!EvaluatedBySubsystem);
+	}
+}
+
+bool UConvaiFaceSyncComponent::ConsumeSubsystemTick(double WorldTime)
+{
+	// The tick function keeps its enabled state while unregistered, so SetComponentTickEnabled and Deactivate still apply
+	if (!IsActive() || !PrimaryComponentTick.IsTickFunctionEnabled())
+	{
+		return false;
+	}
+
+	const float TickInterval = GetComponentTickInterval();
+	if (TickInterval > 0)
+	{
+		if (WorldTime < NextSubsystemTickTime)
+		{
+			return false;
+		}
+		NextSubsystemTickTime = WorldTime + TickInterval;
+	}
+	return true;
+}
+
+void UConvaiFaceSyncComponent::RegisterComponentTickFunctions(bool bRegister)
+{
+	// Also covers re-registration of the component while the subsystem evaluates it
+	Super::RegisterComponentTickFunctions(bRegister && !EvaluatedBySubsystem);
+}
+
+void UConvaiFaceSyncComponent::ApplyFaceLODCurves()
+{
+	if (FaceLOD == EConvaiFaceLOD::Full)
+	{
+		return;
+	}
+
+	const bool Minimal = FaceLOD >= EConvaiFaceLOD::Minimal;
+	const int32 NumCurves = CurrentCurveValues.Num();
+
+	if (GetCurveSet() == EConvaiFaceCurveSet::ARKit)
+	{
+		static const TArray<float> ReducedMask = CreateCurveMask(EConvaiFaceCurveSet::ARKit, [](const FString& CurveName)
+		{
+			return CurveName.StartsWith(TEXT("jaw")) || CurveName.StartsWith(TEXT("mouth")) || CurveName.StartsWith(TEXT("tongue"));
+		});
+		static const TArray<float> MinimalMask = CreateCurveMask(EConvaiFaceCurveSet::ARKit, [](const FString& CurveName)
+		{
+			return CurveName == TEXT("jawOpen") || CurveName == TEXT("mouthClose") || CurveName == TEXT("mouthFunnel") || CurveName == TEXT("mouthPucker");
+		});
+
+		const TArray<float>& Mask = Minimal ? MinimalMask : ReducedMask;
+		if (Mask.Num() == NumCurves)
+		{
+			for (int32 Index = 0; Index < NumCurves; Index++)
+			{
+				CurrentCurveValues[Index] *= Mask[Index];
+			}
+		}
+	}
+	else if (Minimal)
+	{
+		// Collapse the visemes into sil, PP, FF, aa, E, oh and ou
+		static const TArray<int32> CollapsedVisemes = []()
+		{
+			const TMap<FString, FString> Collapse = {
+				{ TEXT("TH"), TEXT("FF") },
+				{ TEXT("DD"), TEXT("E") }, { TEXT("kk"), TEXT("E") }, { TEXT("CH"), TEXT("E") }, { TEXT("SS"), TEXT("E") },
+				{ TEXT("nn"), TEXT("E") }, { TEXT("RR"), TEXT("E") }, { TEXT("ih"), TEXT("E") },
+			};
+
+			TArray<int32> Targets;
+			for (const FString& VisemeName : ConvaiConstants::VisemeNames)
+			{
+				const FString* Target = Collapse.Find(VisemeName);
+				Targets.Add(Target ? ConvaiConstants::VisemeNames.IndexOfByKey(*Target) : Targets.Num());
+			}
+			return Targets;
+		}();
+
+		if (CollapsedVisemes.Num() == NumCurves)
+		{
+			for (int32 Index = 0; Index < NumCurves; Index++)
+			{
+				const int32 Target = CollapsedVisemes[Index];
+				if (Target != Index)
+				{
+					CurrentCurveValues[Target] += CurrentCurveValues[Index];
+					CurrentCurveValues[Index] = 0;
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,241 @@
+// Copyright 2022 Convai Inc. All Rights Reserved.
+
+#include "ConvaiFaceSyncSubsystem.h"
+#include "ConvaiFaceSync.h"
+#include "Async/ParallelFor.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "Engine/Level.h"
+#include "Engine/World.h"
+#include "GameFramework/Actor.h"
+#include "GameFramework/PlayerController.h"
+#include "Camera/PlayerCameraManager.h"
+#include "HAL/PlatformTime.h"
+#include "HAL/IConsoleManager.h"
+
+DEFINE_LOG_CATEGORY(ConvaiFaceSyncSubsystemLog);
+
+namespace
+{
+	TAutoConsoleVariable<int32> CVarFaceSyncBatched(
+		TEXT("convai.FaceSync.Batched"),
+		0,
+		TEXT("1 evaluates all the face sync components of a world together in parallel, 0 lets each component evaluate in its own tick. Applies to components that begin play afterwards, face LODs are picked either way.\n")
+		TEXT("Post processing overrides then run on worker threads and Blueprint tick events of the components stop, only enable it when those are thread safe or unused."),
+		ECVF_Default);
+
+	// Below this many components the task dispatch costs more than it saves
+	constexpr int32 MinParallelFaceSyncs = 8;
+
+	// Seconds between two LOD selections, LODs do not need to follow the camera every frame
+	constexpr double FaceLODUpdateInterval = 0.25;
+
+	// Whether the owner was rendered within this many seconds
+	constexpr float FaceLODRenderedTolerance = 0.5f;
+}
+
+void FConvaiFaceSyncTickFunction::ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent)
+{
+	if (Subsystem)
+	{
+		Subsystem->Tick();
+	}
+}
+
+UConvaiFaceSyncSubsystem* UConvaiFaceSyncSubsystem::Get(const UWorld* World)
+{
+	return World ? World->GetSubsystem<UConvaiFaceSyncSubsystem>() : nullptr;
+}
+
+bool UConvaiFaceSyncSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	const UWorld* World = Cast<UWorld>(Outer);
+	return World && World->IsGameWorld();
+}
+
+void UConvaiFaceSyncSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	UWorld* World = GetWorld();
+	TickFunction.Subsystem = this;
+	TickFunction.TickGroup = TG_PrePhysics;
+	TickFunction.bCanEverTick = true;
+	TickFunction.bStartWithTickEnabled = true;
+	TickFunction.bTickEvenWhenPaused = false;
+	if (World && World->PersistentLevel)
+	{
+		TickFunction.RegisterTickFunction(World->PersistentLevel);
+	}
+}
+
+void UConvaiFaceSyncSubsystem::Deinitialize()
+{
+	if (TickFunction.IsTickFunctionRegistered())
+	{
+		TickFunction.UnRegisterTickFunction();
+	}
+	TickFunction.Subsystem = nullptr;
+	FaceSyncs.Reset();
+
+	Super::Deinitialize();
+}
+
+void UConvaiFaceSyncSubsystem::RegisterFaceSync(UConvaiFaceSyncComponent* FaceSync)
+{
+	if (!IsValid(FaceSync) || FaceSyncs.Contains(FaceSync))
+	{
+		return;
+	}
+
+	FaceSyncs.Add(FaceSync);
+
+	// Without batching the component keeps evaluating in its own tick and is only tracked for its LOD
+	if (CVarFaceSyncBatched.GetValueOnGameThread() == 0)
+	{
+		return;
+	}
+	FaceSync->SetEvaluatedBySubsystem(true);
+
+	// Have the meshes animate after the curves are evaluated for the frame
+	if (AActor* Owner = FaceSync->GetOwner())
+	{
+		TArray<USkeletalMeshComponent*> Meshes;
+		Owner->GetComponents(Meshes);
+		for (USkeletalMeshComponent* Mesh : Meshes)
+		{
+			Mesh->PrimaryComponentTick.AddPrerequisite(this, TickFunction);
+		}
+	}
+}
+
+void UConvaiFaceSyncSubsystem::UnregisterFaceSync(UConvaiFaceSyncComponent* FaceSync)
+{
+	if (FaceSyncs.RemoveSingleSwap(FaceSync) == 0 || !FaceSync->IsEvaluatedBySubsystem())
+	{
+		return;
+	}
+	FaceSync->SetEvaluatedBySubsystem(false);
+
+	if (AActor* Owner = FaceSync->GetOwner())
+	{
+		TArray<USkeletalMeshComponent*> Meshes;
+		Owner->GetComponents(Meshes);
+		for (USkeletalMeshComponent* Mesh : Meshes)
+		{
+			Mesh->PrimaryComponentTick.RemovePrerequisite(this, TickFunction);
+		}
+	}
+}
+
+void UConvaiFaceSyncSubsystem::Tick()
+{
+	FaceSyncs.RemoveAllSwap([](const UConvaiFaceSyncComponent* FaceSync) { return !IsValid(FaceSync); });
+	if (FaceSyncs.Num() == 0)
+	{
+		return;
+	}
+
+	const double Now = FPlatformTime::Seconds();
+	if (Now >= NextFaceLODUpdateTime)
+	{
+		UpdateFaceLODs();
+		NextFaceLODUpdateTime = Now + FaceLODUpdateInterval;
+	}
+
+	const UWorld* World = GetWorld();
+	const double WorldTime = World ? World->GetTimeSeconds() : 0;
+
+	DueFaceSyncs.Reset();
+	for (UConvaiFaceSyncComponent* FaceSync : FaceSyncs)
+	{
+		if (FaceSync->IsEvaluatedBySubsystem() && FaceSync->ConsumeSubsystemTick(WorldTime) && FaceSync->ConsumeEvaluation(Now))
+		{
+			DueFaceSyncs.Add(FaceSync);
+		}
+	}
+	EvaluateFaceSyncs(DueFaceSyncs);
+}
+
+void UConvaiFaceSyncSubsystem::UpdateFaceLODs()
+{
+	UWorld* World = GetWorld();
+	if (!World)
+	{
+		return;
+	}
+
+	struct FViewer
+	{
+		FVector Location;
+
+		// Scales distances so they read as distances at 90 degrees, zooming in brings faces closer
+		float DistanceScale;
+	};
+
+	TArray<FViewer, TInlineAllocator<4>> Viewers;
+	for (FConstPlayerControllerIterator It = World->GetPlayerControllerIterator(); It; ++It)
+	{
+		APlayerController* PlayerController = It->Get();
+		if (!PlayerController || !PlayerController->IsLocalController())
+		{
+			continue;
+		}
+
+		FVector Location;
+		FRotator Rotation;
+		PlayerController->GetPlayerViewPoint(Location, Rotation);
+		const float FOV = PlayerController->PlayerCameraManager ? PlayerController->PlayerCameraManager->GetFOVAngle() : 90.f;
+		Viewers.Add({ Location, FMath::Tan(FMath::DegreesToRadians(FMath::Clamp(FOV, 1.f, 170.f) * 0.5f)) });
+	}
+
+	// Nothing renders faces without a local viewer, e.g. on a dedicated server
+	if (Viewers.Num() == 0)
+	{
+		return;
+	}
+
+	for (UConvaiFaceSyncComponent* FaceSync : FaceSyncs)
+	{
+		if (!FaceSync->AutomaticFaceLOD)
+		{
+			continue;
+		}
+
+		const FVector FaceLocation = FaceSync->GetComponentLocation();
+		float ViewDistance = MAX_flt;
+		for (const FViewer& Viewer : Viewers)
+		{
+			ViewDistance = FMath::Min(ViewDistance, float(FVector::Dist(Viewer.Location, FaceLocation)) * Viewer.DistanceScale);
+		}
+
+		const AActor* Owner = FaceSync->GetOwner();
+		const bool RecentlyRendered = !Owner || Owner->WasRecentlyRendered(FaceLODRenderedTolerance);
+		FaceSync->SetFaceLOD(FaceSync->ComputeFaceLOD(ViewDistance, RecentlyRendered));
+	}
+}
+
+void UConvaiFaceSyncSubsystem::EvaluateFaceSyncs(const TArray<UConvaiFaceSyncComponent*>& InFaceSyncs)
+{
+	const int32 NumFaceSyncs = InFaceSyncs.Num();
+	if (NumFaceSyncs == 0)
+	{
+		return;
+	}
+
+	// Written by index from the workers, read back on this thread
+	TArray<uint8, TInlineAllocator<256>> NeedsBroadcast;
+	NeedsBroadcast.SetNumZeroed(NumFaceSyncs);
+
+	ParallelFor(NumFaceSyncs, [&InFaceSyncs, &NeedsBroadcast](int32 Index)
+	{
+		NeedsBroadcast[Index] = InFaceSyncs[Index]->EvaluateCurves();
+	}, NumFaceSyncs < MinParallelFaceSyncs);
+
+	for (int32 Index = 0; Index < NumFaceSyncs; Index++)
+	{
+		if (NeedsBroadcast[Index])
+		{
+			InFaceSyncs[Index]->OnVisemesDataReady.ExecuteIfBound();
+		}
+	}
+}
@@ -13,6 +13,8 @@
 // #include <chrono>   
 #include <string>
 #include "Engine/EngineTypes.h"
+#include "Async/Async.h"
+#include "Misc/Paths.h"
 
 THIRD_PARTY_INCLUDES_START
 #include <grpc++/grpc++.h>
@@ -75,6 +77,8 @@ UConvaiGRPCGetResponseProxy* UConvaiGRPCGetResponseProxy::CreateConvaiGRPCGetRes
 	UConvaiGRPCGetResponseProxy* Proxy = NewObject<UConvaiGRPCGetResponseProxy>();
 	Proxy->WorldPtr = GEngine->GetWorldFromContextObject(WorldContextObject, EGetWorldErrorMode::LogAndReturnNull);
 	Proxy->ConvaiGRPCGetResponseParams = ConvaiGRPCGetResponseParams;
+	Proxy->EnvironmentRef = ConvaiGRPCGetResponseParams.Environment;
+	Proxy->CompletionQueueAffinity = WorldContextObject ? WorldContextObject->GetUniqueID() : 0;
 
 	return Proxy;
 }
@@ -87,7 +91,31 @@ void UConvaiGRPCGetResponseProxy::Activate()
 	OnStreamWriteDoneDelegate = FgRPC_Delegate::CreateUObject(this, &ThisClass::OnStreamWriteDone);
 	OnStreamFinishDelegate = FgRPC_Delegate::CreateUObject(this, &ThisClass::OnStreamFinish);
 
-	reply = std::unique_ptr<service::GetResponseResponse>(new service::GetResponseResponse());
+	request = google::protobuf::Arena::CreateMessage<service::GetResponseRequest>(&RequestArena);
+	reply = google::protobuf::Arena::CreateMessage<service::GetResponseResponse>(&ReplyArena);
+
+	// Play back a captured stream instead of connecting, credentials and the network are not needed
+	const FString ReplayFile = FConvaiStreamReplay::GetReplayFile();
+	if (!ReplayFile.IsEmpty())
+	{
+		Replay = FConvaiStreamReplay::Load(ReplayFile);
+		if (!Replay)
+		{
+			OnFailure.ExecuteIfBound();
+			return;
+		}
+
+		UE_LOG(ConvaiGRPCLog, Log, TEXT("Replaying GetResponse stream from %s | Character ID : %s | Session ID : %s"),
+			*ReplayFile,
+			*ConvaiGRPCGetResponseParams.CharID,
+			*ConvaiGRPCGetResponseParams.SessionID);
+#if ENGINE_MAJOR_VERSION < 5
+		ReplayTickerHandle = FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateUObject(this, &ThisClass::TickReplay));
+#else
+		ReplayTickerHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateUObject(this, &ThisClass::TickReplay));
+#endif
+		return;
+	}
 
 	// Form Validation
 	if (!UConvaiFormValidation::ValidateAuthKey(ConvaiGRPCGetResponseParams.AuthKey) || !(UConvaiFormValidation::ValidateCharacterID(ConvaiGRPCGetResponseParams.CharID)) || !(UConvaiFormValidation::ValidateSessionID(ConvaiGRPCGetResponseParams.SessionID)))
@@ -111,17 +139,18 @@ void UConvaiGRPCGetResponseProxy::Activate()
 		return;
 	}
 
-	// Create a new stub instance
-	stub_ = ConvaiSubsystem->gRPC_Runnable->GetNewStub();
+	// Aquire a shared stub instance from the channel pool
+	gRPC_Client = ConvaiSubsystem->gRPC_Runnable;
+	stub_ = ConvaiSubsystem->gRPC_Runnable->AcquireStub(ChannelIndex);
 	if (!stub_)
 	{
-		UE_LOG(ConvaiGRPCLog, Warning, TEXT("Could not aquire a new stub instance"));
+		UE_LOG(ConvaiGRPCLog, Warning, TEXT("Could not aquire a stub instance"));
 		OnFailure.ExecuteIfBound();
 		return;
 	}
 
-	// Aquire the completion queue instance
-	cq_ = ConvaiSubsystem->gRPC_Runnable->GetCompletionQueue();
+	// Aquire a completion queue instance from the pool, on the same queue as any other running stream of the owner
+	cq_ = ConvaiSubsystem->gRPC_Runnable->AcquireCompletionQueue(CompletionQueueIndex, CompletionQueueAffinity);
 	if (!cq_)
 	{
 		UE_LOG(ConvaiGRPCLog, Warning, TEXT("Got an invalid completion queue instance"));
@@ -159,6 +188,20 @@ void UConvaiGRPCGetResponseProxy::Activate()
 
 	ReceivedFinish = false;
 
+	// Pack the uplink audio into fixed duration frames
+	UConvaiSettings* ConvaiSettings = Convai::Get().GetConvaiSettings();
+	const int32 AudioBytesPerMs = ConvaiConstants::VoiceCaptureSampleRate * sizeof(int16) / 1000;
+	UplinkFrameBytes = FMath::Max(ConvaiSettings->AudioUplinkFrameMs, 0) * AudioBytesPerMs;
+	UplinkMaxWriteBytes = UplinkFrameBytes > 0 ? UplinkFrameBytes * FMath::Max(ConvaiSettings->MaxAudioUplinkFramesPerWrite, 1) : MAX_int32;
+	UplinkBackpressureBytes = FMath::Max(ConvaiSettings->AudioUplinkBackpressureMs, 1) * AudioBytesPerMs;
+
+	const FString RecordDirectory = FConvaiStreamRecorder::GetRecordDirectory();
+	if (!RecordDirectory.IsEmpty())
+	{
+		const FString FileName = FString::Printf(TEXT("GetResponse_%s_%s_%u.cvrs"), *ConvaiGRPCGetResponseParams.CharID, *FDateTime::Now().ToString(TEXT("%Y%m%d-%H%M%S-%s")), GetUniqueID());
+		Recorder = FConvaiStreamRecorder::Create(FPaths::Combine(RecordDirectory, FileName));
+	}
+
 	// Set long timeout for request
 	std::chrono::system_clock::time_point deadline = std::chrono::system_clock::now() + std::chrono::hours(1);
 	client_context.set_deadline(deadline);
@@ -172,15 +215,84 @@ void UConvaiGRPCGetResponseProxy::Activate()
 	*ConvaiGRPCGetResponseParams.SessionID);
 }
 
-void UConvaiGRPCGetResponseProxy::WriteAudioDataToSend(uint8* Buffer, uint32 Length, bool LastWrite)
+void UConvaiGRPCGetResponseProxy::Prepare()
 {
-	LastWriteReceived = LastWrite;
+	{
+		FScopeLock Lock(&AttachSection);
+		AwaitingAttach = true;
+		WriteDeferredUntilAttach = false;
+	}
 
-	m_mutex.Lock();
+	UE_LOG(ConvaiGRPCLog, Log, TEXT("Preparing GetResponse stream | Character ID : %s | Session ID : %s"),
+		*ConvaiGRPCGetResponseParams.CharID,
+		*ConvaiGRPCGetResponseParams.SessionID);
+	Activate();
+}
 
-	AudioBuffer.Append(Buffer, Length);
+bool UConvaiGRPCGetResponseProxy::IsAwaitingAttach() const
+{
+	return AwaitingAttach && !FailAlreadyExecuted && !CalledFinish;
+}
 
-	m_mutex.Unlock();
+bool UConvaiGRPCGetResponseProxy::CanAttach(const FConvaiGRPCGetResponseParams& InParams) const
+{
+	// Everything that goes into the GetResponseConfig has to match, only the user input may differ
+	return IsAwaitingAttach()
+		&& InParams.CharID == ConvaiGRPCGetResponseParams.CharID
+		&& InParams.SessionID == ConvaiGRPCGetResponseParams.SessionID
+		&& InParams.VoiceResponse == ConvaiGRPCGetResponseParams.VoiceResponse
+		&& InParams.RequireFaceData == ConvaiGRPCGetResponseParams.RequireFaceData
+		&& InParams.GeneratesVisemesAsBlendshapes == ConvaiGRPCGetResponseParams.GeneratesVisemesAsBlendshapes
+		&& InParams.GenerateActions == ConvaiGRPCGetResponseParams.GenerateActions
+		&& InParams.AuthKey == ConvaiGRPCGetResponseParams.AuthKey
+		&& InParams.AuthHeader == ConvaiGRPCGetResponseParams.AuthHeader
+		&& InParams.ConvaiGRPCVisionParams.data.Num() == 0
+		&& InParams.Narrative_Template_Keys.OrderIndependentCompareEqual(ConvaiGRPCGetResponseParams.Narrative_Template_Keys);
+}
+
+void UConvaiGRPCGetResponseProxy::Attach(const FConvaiGRPCGetResponseParams& InParams)
+{
+	bool ResumeWriting;
+	{
+		FScopeLock Lock(&AttachSection);
+		ConvaiGRPCGetResponseParams.UserQuery = InParams.UserQuery;
+		ConvaiGRPCGetResponseParams.TriggerName = InParams.TriggerName;
+		ConvaiGRPCGetResponseParams.TriggerMessage = InParams.TriggerMessage;
+		ConvaiGRPCGetResponseParams.LatencyTrace = InParams.LatencyTrace;
+		AwaitingAttach = false;
+		ResumeWriting = WriteDeferredUntilAttach;
+		WriteDeferredUntilAttach = false;
+	}
+
+	UE_LOG(ConvaiGRPCLog, Log, TEXT("Attached to prepared GetResponse stream | Character ID : %s | Session ID : %s"),
+		*ConvaiGRPCGetResponseParams.CharID,
+		*ConvaiGRPCGetResponseParams.SessionID);
+
+	// The configuration write has already completed, carry on with the data
+	if (ResumeWriting)
+	{
+		OnStreamWrite(true);
+	}
+}
+
+void UConvaiGRPCGetResponseProxy::Cancel()
+{
+	ReplayCancelled = true;
+	client_context.TryCancel();
+}
+
+void UConvaiGRPCGetResponseProxy::WriteAudioDataToSend(uint8* Buffer, uint32 Length, bool LastWrite)
+{
+	// A replay has no uplink, nothing would ever drain the mic audio
+	if (Replay)
+		return;
+
+	{
+		FScopeLock Lock(&m_mutex);
+		AudioBuffer.Append(Buffer, Length);
+		LastWriteReceived = LastWrite;
+		UpdateUplinkBackpressure(AudioBuffer.Num());
+	}
 
 	// UE_LOG(ConvaiGRPCLog, Log, TEXT("WriteAudioDataToSend:: InformOnDataReceived = %s"), InformOnDataReceived ? *FString("True") : *FString("False"));
 	if (InformOnDataReceived)
@@ -193,11 +305,46 @@ void UConvaiGRPCGetResponseProxy::WriteAudioDataToSend(uint8* Buffer, uint32 Len
 	}
 }
 
+void UConvaiGRPCGetResponseProxy::WriteAudioDataToSend(TArray<uint8>& InOutAudioData, bool LastWrite)
+{
+	if (Replay)
+	{
+		InOutAudioData.Reset();
+		return;
+	}
+
+	{
+		FScopeLock Lock(&m_mutex);
+		if (AudioBuffer.Num() == 0)
+		{
+			// The writer already took everything, hand over the whole array
+			Swap(AudioBuffer, InOutAudioData);
+		}
+		else
+		{
+			// The writer is still busy with a previous write, queue behind the pending audio
+			AudioBuffer.Append(InOutAudioData);
+		}
+		LastWriteReceived = LastWrite;
+		UpdateUplinkBackpressure(AudioBuffer.Num());
+	}
+	InOutAudioData.Reset();
+
+	if (InformOnDataReceived)
+	{
+		// Reset
+		InformOnDataReceived = false;
+
+		// Inform of new data to send
+		OnStreamWrite(true);
+	}
+}
+
 void UConvaiGRPCGetResponseProxy::FinishWriting()
 {
 	LastWriteReceived = true;
 
-	if (InformOnDataReceived)
+	if (InformOnDataReceived && !Replay)
 	{
 		// Inform of new data to send
 		OnStreamWrite(true);
@@ -210,7 +357,11 @@ void UConvaiGRPCGetResponseProxy::FinishWriting()
 void UConvaiGRPCGetResponseProxy::BeginDestroy()
 {
 	client_context.TryCancel();
-	stub_.reset();
+	ReleasePooledResources();
+
+	// Replay runs on the game thread ticker, unregistering is enough to stop it calling into this object
+	StopReplay();
+
 	UE_LOG(ConvaiGRPCLog, Log,
 		TEXT("Destroying UConvaiGRPCGetResponseProxy... | Character ID : %s | Session ID : %s"),
 		*ConvaiGRPCGetResponseParams.CharID,
@@ -218,6 +369,20 @@ void UConvaiGRPCGetResponseProxy::BeginDestroy()
 	Super::BeginDestroy();
 }
 
+void UConvaiGRPCGetResponseProxy::ReleasePooledResources()
+{
+	const int32 QueueIndex = FPlatformAtomics::InterlockedExchange(&CompletionQueueIndex, INDEX_NONE);
+	const int32 StubChannelIndex = FPlatformAtomics::InterlockedExchange(&ChannelIndex, INDEX_NONE);
+
+	if (TSharedPtr<FgRPCClient> Client = gRPC_Client.Pin())
+	{
+		if (QueueIndex != INDEX_NONE)
+			Client->ReleaseCompletionQueue(QueueIndex, CompletionQueueAffinity);
+		if (StubChannelIndex != INDEX_NONE)
+			Client->ReleaseStub(StubChannelIndex);
+	}
+}
+
 void UConvaiGRPCGetResponseProxy::CallFinish()
 {
 	if (CalledFinish || !stream_handler)
@@ -236,33 +401,66 @@ void UConvaiGRPCGetResponseProxy::CallFinish()
 	stream_handler->Finish(&status, (void*)&OnStreamFinishDelegate);
 }
 
-TArray<uint8> UConvaiGRPCGetResponseProxy::ConsumeFromAudioBuffer(bool& IsThisTheFinalWrite)
+bool UConvaiGRPCGetResponseProxy::ConsumeFromAudioBuffer(bool& IsThisTheFinalWrite)
 {
-	// TODO: (Mohamed) optimize and clean this to reduce number of copying operations to not spend much time in CS, also reserve memory for "output" array before entering
-
-	TArray<uint8> output;
+	// Keep the allocation of the previous send and give it back to the producer through the swap
+	SendAudioBuffer.Reset();
 
 	m_mutex.Lock();
-	//uint32 Length = FMath::Min(AudioBuffer.Num(), (int32)ConvaiConstants::VoiceStreamMaxChunk);
-	uint32 Length = AudioBuffer.Num();
-	if (Length)
-	{
-		output.Append(AudioBuffer.GetData(), Length);
+	const int32 Available = AudioBuffer.Num();
 
-		if (Length == AudioBuffer.Num())
-			AudioBuffer.Empty(AudioBuffer.Max());
-		else
-			AudioBuffer.RemoveAt(0, Length);
+	// Send whole frames only, up to the per write limit, the remainder waits for more audio unless this is the end of the input
+	int32 Length = LastWriteReceived || UplinkFrameBytes <= 0 ? Available : Available - Available % UplinkFrameBytes;
+	Length = FMath::Min(Length, UplinkMaxWriteBytes);
+
+	if (Length == Available)
+	{
+		Swap(AudioBuffer, SendAudioBuffer);
+	}
+	else if (Length > 0)
+	{
+		SendAudioBuffer.Append(AudioBuffer.GetData(), Length);
+		AudioBuffer.RemoveAt(0, Length);
 	}
+
+	IsThisTheFinalWrite = LastWriteReceived && AudioBuffer.Num() == 0;
+	UpdateUplinkBackpressure(AudioBuffer.Num());
 	m_mutex.Unlock();
 
+	return SendAudioBuffer.Num() > 0;
+}
 
-	if (LastWriteReceived && AudioBuffer.Num() == 0)
-		IsThisTheFinalWrite = true;
-	else
-		IsThisTheFinalWrite = false;
+void UConvaiGRPCGetResponseProxy::UpdateUplinkBackpressure(int32 BacklogBytes)
+{
+	// Called with m_mutex held, the producer and the writer both get here and each transition must be seen once and in backlog order
+	UplinkBacklogBytes.Set(BacklogBytes);
 
-	return output;
+	// Use a lower threshold to clear the state so it does not flicker around the limit
+	if (!UplinkBackpressured && BacklogBytes > UplinkBackpressureBytes)
+	{
+		UplinkBackpressured = true;
+		UE_LOG(ConvaiGRPCLog, Warning, TEXT("Audio uplink is falling behind, %d bytes of mic audio are waiting to be sent | Character ID : %s | Session ID : %s"),
+			BacklogBytes,
+			*ConvaiGRPCGetResponseParams.CharID,
+			*ConvaiGRPCGetResponseParams.SessionID);
+	}
+	else if (UplinkBackpressured && BacklogBytes < UplinkBackpressureBytes / 2)
+	{
+		UplinkBackpressured = false;
+		UE_LOG(ConvaiGRPCLog, Log, TEXT("Audio uplink caught up | Character ID : %s | Session ID : %s"),
+			*ConvaiGRPCGetResponseParams.CharID,
+			*ConvaiGRPCGetResponseParams.SessionID);
+	}
+}
+
+bool UConvaiGRPCGetResponseProxy::IsUplinkBackpressured() const
+{
+	return UplinkBackpressured;
+}
+
+int32 UConvaiGRPCGetResponseProxy::GetUplinkBacklogMs() const
+{
+	return UplinkBacklogBytes.GetValue() / (ConvaiConstants::VoiceCaptureSampleRate * sizeof(int16) / 1000);
 }
 
 void UConvaiGRPCGetResponseProxy::LogAndEcecuteFailure(FString FuncName)
@@ -332,7 +530,7 @@ void UConvaiGRPCGetResponseProxy::OnStreamInit(bool ok)
 	FScopeLock Lock(&GPRCInitSection);
 
 	// Create Action Configuration
-	ActionConfig* action_config = new ActionConfig();
+	ActionConfig* action_config = google::protobuf::Arena::CreateMessage<ActionConfig>(&RequestArena);
 	FString MainCharacter;
 	if (ConvaiGRPCGetResponseParams.GenerateActions && IsValid(ConvaiGRPCGetResponseParams.Environment))
 	{
@@ -393,7 +591,7 @@ void UConvaiGRPCGetResponseProxy::OnStreamInit(bool ok)
 	}
 
 	// Create Audio Configuration
-	AudioConfig* audio_config = new AudioConfig();
+	AudioConfig* audio_config = google::protobuf::Arena::CreateMessage<AudioConfig>(&RequestArena);
 	audio_config->set_sample_rate_hertz((int32)ConvaiConstants::VoiceCaptureSampleRate);
 	audio_config->set_enable_facial_data(ConvaiGRPCGetResponseParams.RequireFaceData);
 	audio_config->set_disable_audio(!ConvaiGRPCGetResponseParams.VoiceResponse);
@@ -405,7 +603,7 @@ void UConvaiGRPCGetResponseProxy::OnStreamInit(bool ok)
 	}
 
 	// Create the config object that holds Audio and Action configs
-	GetResponseRequest_GetResponseConfig* getResponseConfig = new GetResponseRequest_GetResponseConfig();
+	GetResponseRequest_GetResponseConfig* getResponseConfig = google::protobuf::Arena::CreateMessage<GetResponseRequest_GetResponseConfig>(&RequestArena);
 
 	if (ConvaiGRPCGetResponseParams.AuthHeader == ConvaiConstants::Auth_Token_Header)
 	{
@@ -458,8 +656,8 @@ void UConvaiGRPCGetResponseProxy::OnStreamInit(bool ok)
 	// Create Vision Configuration
 	if (ConvaiGRPCGetResponseParams.ConvaiGRPCVisionParams.data.Num() > 0)
 	{
-		VisionInput* vision_input = new VisionInput();;
-		VisionInput_ImageData* vision_input_image_data = new VisionInput_ImageData();
+		VisionInput* vision_input = google::protobuf::Arena::CreateMessage<VisionInput>(&RequestArena);
+		VisionInput_ImageData* vision_input_image_data = google::protobuf::Arena::CreateMessage<VisionInput_ImageData>(&RequestArena);
 		vision_input_image_data->set_width(ConvaiGRPCGetResponseParams.ConvaiGRPCVisionParams.width);
 		vision_input_image_data->set_height(ConvaiGRPCGetResponseParams.ConvaiGRPCVisionParams.height);
 		vision_input_image_data->set_data(ConvaiGRPCGetResponseParams.ConvaiGRPCVisionParams.data.GetData(), ConvaiGRPCGetResponseParams.ConvaiGRPCVisionParams.data.Num());
@@ -468,12 +666,20 @@ void UConvaiGRPCGetResponseProxy::OnStreamInit(bool ok)
 	}
 
 	// Set the config object in the request object to be passed to the API
-	request.Clear();
-	request.set_allocated_get_response_config(getResponseConfig);
+	request->Clear();
+	request->set_allocated_get_response_config(getResponseConfig);
 
+	if (Recorder)
+	{
+		// Keep the credentials out of the capture
+		service::GetResponseRequest ScrubbedRequest(*request);
+		ScrubbedRequest.mutable_get_response_config()->clear_api_key();
+		ScrubbedRequest.mutable_get_response_config()->clear_api_auth_token();
+		Recorder->Record(EConvaiStreamRecordType::Request, &ScrubbedRequest);
+	}
 
 	// Do a write task
-	stream_handler->Write(request, (void*)&(OnStreamWriteDelegate));
+	stream_handler->Write(*request, (void*)&(OnStreamWriteDelegate));
 	UE_LOG(ConvaiGRPCLog, Log,
 		TEXT("Initial Stream Write | Character ID : %s | Session ID : %s"),
 		*ConvaiGRPCGetResponseParams.CharID,
@@ -481,7 +687,7 @@ void UConvaiGRPCGetResponseProxy::OnStreamInit(bool ok)
 
 
 	// Do a read task
-	stream_handler->Read(reply.get(), (void*)&OnStreamReadDelegate);
+	stream_handler->Read(reply, (void*)&OnStreamReadDelegate);
 	UE_LOG(ConvaiGRPCLog, Log,
 		TEXT("Initial Stream Read | Character ID : %s | Session ID : %s"),
 		*ConvaiGRPCGetResponseParams.CharID,
@@ -506,11 +712,29 @@ void UConvaiGRPCGetResponseProxy::OnStreamWrite(bool ok)
 	if (CalledFinish)
 		return;
 
+	{
+		// Hold the data until the prepared stream gets attached to a request
+		FScopeLock Lock(&AttachSection);
+		if (AwaitingAttach)
+		{
+			WriteDeferredUntilAttach = true;
+			return;
+		}
+	}
+
 	// UE_LOG(ConvaiGRPCLog, Log, TEXT("OnStreamWriteBegin"));
 
+	// The previous write has completed and was serialized when issued, so take its data message back to reuse it
+	if (request->has_get_response_data())
+	{
+		ReusableResponseData = request->unsafe_arena_release_get_response_data();
+	}
+
 	// Clear the request data to make it ready to hold the new data we are going to send
-	request.Clear();
-	GetResponseRequest_GetResponseData* get_response_data = new GetResponseRequest_GetResponseData();
+	request->Clear();
+	GetResponseRequest_GetResponseData* get_response_data = ReusableResponseData ? ReusableResponseData : google::protobuf::Arena::CreateMessage<GetResponseRequest_GetResponseData>(&RequestArena);
+	ReusableResponseData = nullptr;
+	get_response_data->Clear();
 
 	bool IsThisTheFinalWrite;
 
@@ -529,7 +753,7 @@ void UConvaiGRPCGetResponseProxy::OnStreamWrite(bool ok)
 	else if (ConvaiGRPCGetResponseParams.TriggerName.Len() || ConvaiGRPCGetResponseParams.TriggerMessage.Len()) // If there is a trigger message
 	{
 		// Add in the trigger data
-		TriggerConfig* triggerConfig = new TriggerConfig();
+		TriggerConfig* triggerConfig = google::protobuf::Arena::CreateMessage<TriggerConfig>(&RequestArena);
 		triggerConfig->set_trigger_name(TCHAR_TO_UTF8(*ConvaiGRPCGetResponseParams.TriggerName));
 		triggerConfig->set_trigger_message(TCHAR_TO_UTF8(*ConvaiGRPCGetResponseParams.TriggerMessage));
 		get_response_data->set_allocated_trigger_data(triggerConfig);
@@ -544,11 +768,11 @@ void UConvaiGRPCGetResponseProxy::OnStreamWrite(bool ok)
 	else // Normal voice data
 	{
 		// Try to consume the next chunk of mic data
-		uint8* Buffer = nullptr;
-		TArray<uint8> Data = ConsumeFromAudioBuffer(IsThisTheFinalWrite);
-
-		if (!Data.Num())
+		if (!ConsumeFromAudioBuffer(IsThisTheFinalWrite))
 		{
+			// Keep the data message for the next write
+			ReusableResponseData = get_response_data;
+
 			if (IsThisTheFinalWrite)
 			{
 				// Tell the server that we have finished writing
@@ -556,6 +780,10 @@ void UConvaiGRPCGetResponseProxy::OnStreamWrite(bool ok)
 					*ConvaiGRPCGetResponseParams.CharID,
 					*ConvaiGRPCGetResponseParams.SessionID);
 				stream_handler->WritesDone((void*)&OnStreamWriteDoneDelegate); UE_LOG(ConvaiGRPCLog, Log, TEXT("On Stream Write Done Writing"));
+				if (Recorder)
+					Recorder->Record(EConvaiStreamRecordType::WritesDone);
+				if (ConvaiGRPCGetResponseParams.LatencyTrace)
+					ConvaiGRPCGetResponseParams.LatencyTrace->Mark(EConvaiLatencySpan::WritesDone);
 			}
 			else
 			{
@@ -568,33 +796,40 @@ void UConvaiGRPCGetResponseProxy::OnStreamWrite(bool ok)
 		}
 		else
 		{
-			// Load the audio data to the request
-			get_response_data->set_audio_data(Data.GetData(), Data.Num()); // UE_LOG(ConvaiGRPCLog, Log, TEXT("OnStreamWrite: Sending %d bytes"), DataLen);
+			// Load the audio data to the request, the string keeps its capacity across writes
+			get_response_data->mutable_audio_data()->assign((const char*)SendAudioBuffer.GetData(), SendAudioBuffer.Num()); // UE_LOG(ConvaiGRPCLog, Log, TEXT("OnStreamWrite: Sending %d bytes"), DataLen);
 		}
 
-		NumberOfAudioBytesSent += Data.Num();
+		NumberOfAudioBytesSent += SendAudioBuffer.Num();
+		if (ConvaiGRPCGetResponseParams.LatencyTrace)
+			ConvaiGRPCGetResponseParams.LatencyTrace->MarkLatest(EConvaiLatencySpan::LastAudioWritten);
 	}
 	// Prepare the request
-	request.set_allocated_get_response_data(get_response_data);
+	request->unsafe_arena_set_allocated_get_response_data(get_response_data);
 
 	//#if ConvaiDebugMode
-	//    FString DebugString(request.DebugString().c_str());
+	//    FString DebugString(request->DebugString().c_str());
 	//    UE_LOG(ConvaiGRPCLog, Warning, TEXT("request: %s"), *DebugString);
 	//#endif 
 
+	if (Recorder)
+		Recorder->Record(EConvaiStreamRecordType::Request, request);
+
 	if (IsThisTheFinalWrite)
 	{
 		// Send the data and tell the server that this is the last piece of data
 		UE_LOG(ConvaiGRPCLog, Log, TEXT("Calling Stream WriteLast | Character ID : %s | Session ID : %s"),
 			*ConvaiGRPCGetResponseParams.CharID,
 			*ConvaiGRPCGetResponseParams.SessionID);
-		stream_handler->WriteLast(request, grpc::WriteOptions(), (void*)&OnStreamWriteDoneDelegate);
+		stream_handler->WriteLast(*request, grpc::WriteOptions(), (void*)&OnStreamWriteDoneDelegate);
+		if (ConvaiGRPCGetResponseParams.LatencyTrace)
+			ConvaiGRPCGetResponseParams.LatencyTrace->Mark(EConvaiLatencySpan::WritesDone);
 	}
 	else
 	{
 		// Do a normal send of the data
 		//UE_LOG(ConvaiGRPCLog, Log, TEXT("stream_handler->Write"));
-		stream_handler->Write(request, (void*)&OnStreamWriteDelegate);
+		stream_handler->Write(*request, (void*)&OnStreamWriteDelegate);
 	}
 
 }
@@ -649,6 +884,9 @@ void UConvaiGRPCGetResponseProxy::OnStreamRead(bool ok)
 		return;
 	}
 
+	if (Recorder)
+		Recorder->Record(EConvaiStreamRecordType::Response, reply);
+
 	bool IsFinalResponse = reply->audio_response().end_of_response();
 
 	// Grab the session ID
@@ -692,15 +930,14 @@ void UConvaiGRPCGetResponseProxy::OnStreamRead(bool ok)
 		// Convert UTF8 to UTF16 FString
 		FString text_string = UConvaiUtils::FUTF8ToFString(text_string_std.c_str());
 
-		// Grab bot audio
-		::std::string audio_data = reply->audio_response().audio_data();
-		TArray<uint8> VoiceData;
+		// Grab bot audio, the string is moved out of the reply so the chunk owns it without a copy
+		FConvaiPCMChunkPtr VoiceData;
 		float SampleRate = 0;
 		if (reply->audio_response().audio_data().length() > 46)
 		{
-			VoiceData = TArray<uint8>(reinterpret_cast<const uint8*>(audio_data.data() + 46), audio_data.length() - 46);
 			SampleRate = reply->audio_response().audio_config().sample_rate_hertz();
-			UE_LOG(ConvaiGRPCLog, Log, TEXT("Received Audio Chunk: %f secs | Character ID : % s | Session ID : % s"), float(audio_data.length()) / (SampleRate * 2.0),
+			VoiceData = FConvaiPCMChunk::Create(MoveTemp(*reply->mutable_audio_response()->mutable_audio_data()), 46, SampleRate, 1);
+			UE_LOG(ConvaiGRPCLog, Log, TEXT("Received Audio Chunk: %f secs | Character ID : % s | Session ID : % s"), VoiceData->GetDuration(),
 				*ConvaiGRPCGetResponseParams.CharID,
 				*ConvaiGRPCGetResponseParams.SessionID);
 		}
@@ -714,11 +951,12 @@ void UConvaiGRPCGetResponseProxy::OnStreamRead(bool ok)
 
 			if (HasBlendshapesData && ConvaiGRPCGetResponseParams.GeneratesVisemesAsBlendshapes)
 			{
-				std::string FaceBlendshapeData = reply->audio_response().blendshapes_data().blendshape_data();
-				if (FaceBlendshapeData.size() > 0)
+				const std::string& FaceBlendshapeData = reply->audio_response().blendshapes_data().blendshape_data();
+				if (FaceBlendshapeData.size() > 0 && !UConvaiUtils::ParseBlendShapeData(FaceBlendshapeData.data(), int32(FaceBlendshapeData.size()), FaceDataAnimation.AnimationFrames))
 				{
-					FString FaceData_string = UConvaiUtils::FUTF8ToFString(FaceBlendshapeData.c_str());
-					FaceDataAnimation.AnimationFrames = UConvaiUtils::ParseJsonToBlendShapeData(FaceData_string);
+					UE_LOG(ConvaiGRPCLog, Warning, TEXT("Could not parse the blendshape data | Character ID : %s | Session ID : %s"),
+						*ConvaiGRPCGetResponseParams.CharID,
+						*ConvaiGRPCGetResponseParams.SessionID);
 				}
 			}
 			//else if (HasBlendshapesFrame && ConvaiGRPCGetResponseParams.GeneratesVisemesAsBlendshapes)
@@ -794,37 +1032,26 @@ void UConvaiGRPCGetResponseProxy::OnStreamRead(bool ok)
 			//}
 			else if (HasVisemes && !ConvaiGRPCGetResponseParams.GeneratesVisemesAsBlendshapes)
 			{
-				auto Visemes = reply->audio_response().visemes_data().visemes();
+				const auto& Visemes = reply->audio_response().visemes_data().visemes();
 
 				if (Visemes.sil() >= 0)
 				{
+					// Same order as ConvaiConstants::VisemeNames
 					FAnimationFrame AnimationFrame;
-					AnimationFrame.BlendShapes.Add("sil", Visemes.sil());
-					AnimationFrame.BlendShapes.Add("PP", Visemes.pp());
-					AnimationFrame.BlendShapes.Add("FF", Visemes.ff());
-					AnimationFrame.BlendShapes.Add("TH", Visemes.th());
-					AnimationFrame.BlendShapes.Add("DD", Visemes.dd());
-					AnimationFrame.BlendShapes.Add("kk", Visemes.kk());
-					AnimationFrame.BlendShapes.Add("CH", Visemes.ch());
-					AnimationFrame.BlendShapes.Add("SS", Visemes.ss());
-					AnimationFrame.BlendShapes.Add("nn", Visemes.nn());
-					AnimationFrame.BlendShapes.Add("RR", Visemes.rr());
-					AnimationFrame.BlendShapes.Add("aa", Visemes.aa());
-					AnimationFrame.BlendShapes.Add("E", Visemes.e());
-					AnimationFrame.BlendShapes.Add("ih", Visemes.ih());
-					AnimationFrame.BlendShapes.Add("oh", Visemes.oh());
-					AnimationFrame.BlendShapes.Add("ou", Visemes.ou());
-					FaceDataAnimation.AnimationFrames.Add(AnimationFrame);
+					AnimationFrame.CurveSet = EConvaiFaceCurveSet::Visemes;
+					AnimationFrame.CurveValues = { Visemes.sil(), Visemes.pp(), Visemes.ff(), Visemes.th(), Visemes.dd(),
+						Visemes.kk(), Visemes.ch(), Visemes.ss(), Visemes.nn(), Visemes.rr(),
+						Visemes.aa(), Visemes.e(), Visemes.ih(), Visemes.oh(), Visemes.ou() };
+					FaceDataAnimation.AnimationFrames.Add(MoveTemp(AnimationFrame));
 					FaceDataAnimation.Duration += 0.01;
 					FaceDataAnimation.FrameRate = 100;
 				}
 				//UE_LOG(ConvaiGRPCLog, Log, TEXT("GetResponse FaceData: %s"), *AnimationFrame.ToString());
 			}
 
-			if (VoiceData.Num() > 0 && FaceDataAnimation.Duration == 0)
+			if (VoiceData.IsValid() && FaceDataAnimation.Duration == 0)
 			{
-				float FaceDataDuration = float(VoiceData.Num() - 44) / float(SampleRate * 2); // Assuming 1 channel
-				FaceDataAnimation.Duration = FaceDataDuration;
+				FaceDataAnimation.Duration = VoiceData->GetDuration(); // Assuming 1 channel
 			}
 
 			if (FaceDataAnimation.AnimationFrames.Num() > 0 && FaceDataAnimation.Duration > 0)
@@ -850,8 +1077,7 @@ void UConvaiGRPCGetResponseProxy::OnStreamRead(bool ok)
 		}
 		if (reply->audio_response().has_blendshapes_data())
 		{
-			FString BlendshapesData = UConvaiUtils::FUTF8ToFString(reply->audio_response().blendshapes_data().blendshape_data().c_str());
-			UE_LOG(ConvaiGRPCLog, Log, TEXT("BlendshapesData: %s"), *BlendshapesData);
+			UE_LOG(ConvaiGRPCLog, Verbose, TEXT("BlendshapesData: %s"), *UConvaiUtils::FUTF8ToFString(reply->audio_response().blendshapes_data().blendshape_data().c_str()));
 		}
 
 		// Broadcast the audio and text
@@ -920,15 +1146,29 @@ void UConvaiGRPCGetResponseProxy::OnStreamRead(bool ok)
 #endif 
 	}
 
+	// Every read allocates its response sub-messages on the reply arena, so recycle it once in a while to bound its size.
+	// No read is pending at this point so the reply can be recreated safely
+	if (++ReadsSinceReplyArenaReset >= ConvaiConstants::ReplyArenaResetInterval)
+	{
+		ReadsSinceReplyArenaReset = 0;
+		NumReplyArenaResets++;
+		ReplyArena.Reset();
+		reply = google::protobuf::Arena::CreateMessage<service::GetResponseResponse>(&ReplyArena);
+	}
+
 	// Initiate another read task
 	reply->Clear();
-	if (!ReceivedFinish)
-		stream_handler->Read(reply.get(), (void*)&OnStreamReadDelegate);
+	if (!ReceivedFinish && stream_handler) // There is no stream when replaying, TickReplay on the core ticker feeds the replies
+		stream_handler->Read(reply, (void*)&OnStreamReadDelegate);
 }
 
 void UConvaiGRPCGetResponseProxy::OnStreamFinish(bool ok)
 {
 	ReceivedFinish = true;
+	ReleasePooledResources();
+
+	if (Recorder)
+		Recorder->RecordFinish(status.error_code());
 
 	if (!ok || !status.ok())
 	{
@@ -941,13 +1181,115 @@ void UConvaiGRPCGetResponseProxy::OnStreamFinish(bool ok)
 		TEXT("On Stream Finish | Character ID : %s | Session ID : %s"),
 		*ConvaiGRPCGetResponseParams.CharID,
 		*ConvaiGRPCGetResponseParams.SessionID);
+
+	// Heap traffic of the protobuf messages for this turn, used to budget memory per conversation
+	UE_LOG(ConvaiGRPCLog, Log,
+		TEXT("Stream arenas | Request: %llu bytes allocated, %llu used | Reply: %llu bytes allocated, %d resets | Audio bytes sent: %u | Character ID : %s | Session ID : %s"),
+		(uint64)RequestArena.SpaceAllocated(),
+		(uint64)RequestArena.SpaceUsed(),
+		(uint64)ReplyArena.SpaceAllocated(),
+		NumReplyArenaResets,
+		NumberOfAudioBytesSent,
+		*ConvaiGRPCGetResponseParams.CharID,
+		*ConvaiGRPCGetResponseParams.SessionID);
 #endif 
 
 
 	OnFinish.ExecuteIfBound();
 }
 
+bool UConvaiGRPCGetResponseProxy::TickReplay(float DeltaTime)
+{
+	if (ReplayCancelled)
+	{
+		ReplayTickerHandle.Reset();
+		return false;
+	}
+
+	// A prepared stream only gets its response once the user input is attached
+	if (IsAwaitingAttach())
+	{
+		return true;
+	}
+
+	const double Now = FPlatformTime::Seconds();
+	if (ReplayStartTime < 0)
+	{
+		ReplayStartTime = Now;
+	}
+
+	const float Speed = FConvaiStreamReplay::GetReplaySpeed();
+	int32 FinishStatusCode = grpc::StatusCode::OK;
+
+	for (; ReplayRecordIndex < Replay->Records.Num(); ReplayRecordIndex++)
+	{
+		const FConvaiStreamRecord& Record = Replay->Records[ReplayRecordIndex];
+		if (Record.Type == EConvaiStreamRecordType::Request || Record.Type == EConvaiStreamRecordType::WritesDone)
+		{
+			continue;
+		}
+
+		// Keep the recorded pacing, the rest is delivered on a later tick
+		if (Speed > 0 && Now < ReplayStartTime + Record.Time / Speed)
+		{
+			return true;
+		}
+
+		if (Record.Type == EConvaiStreamRecordType::Finish)
+		{
+			if (Record.Length >= 4)
+			{
+				FMemory::Memcpy(&FinishStatusCode, Replay->GetPayload(Record), sizeof(FinishStatusCode));
+				FinishStatusCode = INTEL_ORDER32(FinishStatusCode);
+			}
+			break;
+		}
+
+		if (!reply->ParseFromArray(Replay->GetPayload(Record), Record.Length))
+		{
+			UE_LOG(ConvaiGRPCLog, Warning, TEXT("TickReplay: Skipping a response that could not be parsed | Character ID : %s | Session ID : %s"),
+				*ConvaiGRPCGetResponseParams.CharID,
+				*ConvaiGRPCGetResponseParams.SessionID);
+			continue;
+		}
+
+		OnStreamRead(true);
+		if (ReplayCancelled)
+		{
+			ReplayTickerHandle.Reset();
+			return false;
+		}
+	}
+
+	ReplayTickerHandle.Reset();
+	ReplayRecordIndex = Replay->Records.Num();
 
+	ReceivedFinish = true;
+	if (FinishStatusCode != grpc::StatusCode::OK)
+	{
+		status = grpc::Status(grpc::StatusCode(FinishStatusCode), "Replayed stream failure");
+		LogAndEcecuteFailure("TickReplay");
+		return false;
+	}
+
+	// Same end of stream path as a live stream, without a stream handler it goes straight to OnFinish
+	OnStreamRead(false);
+	return false;
+}
+
+void UConvaiGRPCGetResponseProxy::StopReplay()
+{
+	ReplayCancelled = true;
+	if (ReplayTickerHandle.IsValid())
+	{
+#if ENGINE_MAJOR_VERSION < 5
+		FTicker::GetCoreTicker().RemoveTicker(ReplayTickerHandle);
+#else
+		FTSTicker::GetCoreTicker().RemoveTicker(ReplayTickerHandle);
+#endif
+		ReplayTickerHandle.Reset();
+	}
+}
 
 
 UConvaiGRPCSubmitFeedbackProxy* UConvaiGRPCSubmitFeedbackProxy::CreateConvaiGRPCSubmitFeedbackProxy(UObject* WorldContextObject, FString InteractionID, bool ThumbsUp, FString FeedbackText)
@@ -988,17 +1330,18 @@ void UConvaiGRPCSubmitFeedbackProxy::Activate()
 		return;
 	}
 
-	// Create a new stub instance
-	stub_ = ConvaiSubsystem->gRPC_Runnable->GetNewStub();
+	// Aquire a shared stub instance from the channel pool
+	gRPC_Client = ConvaiSubsystem->gRPC_Runnable;
+	stub_ = ConvaiSubsystem->gRPC_Runnable->AcquireStub(ChannelIndex);
 	if (!stub_)
 	{
-		UE_LOG(ConvaiGRPCFeedBackLog, Warning, TEXT("Could not aquire a new stub instance"));
+		UE_LOG(ConvaiGRPCFeedBackLog, Warning, TEXT("Could not aquire a stub instance"));
 		LogAndEcecuteFailure("Activate");
 		return;
 	}
 
-	// Aquire the completion queue instance
-	cq_ = ConvaiSubsystem->gRPC_Runnable->GetCompletionQueue();
+	// Aquire a completion queue instance from the pool
+	cq_ = ConvaiSubsystem->gRPC_Runnable->AcquireCompletionQueue(CompletionQueueIndex);
 	if (!cq_)
 	{
 		UE_LOG(ConvaiGRPCFeedBackLog, Warning, TEXT("Got an invalid completion queue instance"));
@@ -1048,6 +1391,8 @@ void UConvaiGRPCSubmitFeedbackProxy::Activate()
 
 void UConvaiGRPCSubmitFeedbackProxy::OnStreamFinish(bool ok)
 {
+	ReleasePooledResources();
+
 	if (!ok || !status.ok())
 	{
 		LogAndEcecuteFailure("OnStreamFinish");
@@ -1074,7 +1419,7 @@ void UConvaiGRPCSubmitFeedbackProxy::OnStreamFinish(bool ok)
 void UConvaiGRPCSubmitFeedbackProxy::BeginDestroy()
 {
 	client_context.TryCancel();
-	stub_.reset();
+	ReleasePooledResources();
 	FString ThumbsUpString = ThumbsUp ? "True" : "False";
 	UE_LOG(ConvaiGRPCFeedBackLog, Log,
 	TEXT("On Stream Finish | Interaction ID : %s | Feedback Text : %s | ThumbsUp: %s"),
@@ -1084,6 +1429,20 @@ void UConvaiGRPCSubmitFeedbackProxy::BeginDestroy()
 	Super::BeginDestroy();
 }
 
+void UConvaiGRPCSubmitFeedbackProxy::ReleasePooledResources()
+{
+	const int32 QueueIndex = FPlatformAtomics::InterlockedExchange(&CompletionQueueIndex, INDEX_NONE);
+	const int32 StubChannelIndex = FPlatformAtomics::InterlockedExchange(&ChannelIndex, INDEX_NONE);
+
+	if (TSharedPtr<FgRPCClient> Client = gRPC_Client.Pin())
+	{
+		if (QueueIndex != INDEX_NONE)
+			Client->ReleaseCompletionQueue(QueueIndex);
+		if (StubChannelIndex != INDEX_NONE)
+			Client->ReleaseStub(StubChannelIndex);
+	}
+}
+
 void UConvaiGRPCSubmitFeedbackProxy::LogAndEcecuteFailure(FString FuncName)
 {
 	FString ThumbsUpString = ThumbsUp ? "True" : "False";
@@ -0,0 +1,159 @@
+// Copyright 2022 Convai Inc. All Rights Reserved.
+
+#include "ConvaiJitterBuffer.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/ScopeLock.h"
+
+DEFINE_LOG_CATEGORY(ConvaiJitterBufferLog);
+
+namespace
+{
+	// Headroom over the worst lateness of a clean response
+	constexpr float LatenessHeadroom = 1.25f;
+
+	// Share of the pre-roll kept after a clean response that needed less
+	constexpr float PreRollDecay = 0.8f;
+
+	// Growth of the pre-roll on an underrun
+	constexpr float UnderrunGrowth = 1.5f;
+	constexpr float UnderrunMinStepSecs = 0.1f;
+
+	// Gain of the jitter estimator, from RFC 3550
+	constexpr float JitterGain = 1.0f / 16.0f;
+}
+
+void FConvaiJitterBuffer::SetPreRollLimits(float InMinPreRollSecs, float InMaxPreRollSecs)
+{
+	FScopeLock Lock(&CriticalSection);
+	MaxPreRollSecs = FMath::Max(InMaxPreRollSecs, 0.0f);
+	MinPreRollSecs = FMath::Clamp(InMinPreRollSecs, 0.0f, MaxPreRollSecs);
+	PreRollSecs = FMath::Clamp(PreRollSecs, MinPreRollSecs, MaxPreRollSecs);
+}
+
+void FConvaiJitterBuffer::BeginSession()
+{
+	FScopeLock Lock(&CriticalSection);
+
+	if (SessionStartTime >= 0)
+	{
+		if (!SessionHadUnderrun)
+		{
+			const float NeededSecs = SessionPeakLatenessSecs * LatenessHeadroom;
+			PreRollSecs = FMath::Clamp(FMath::Max(NeededSecs, PreRollSecs * PreRollDecay), MinPreRollSecs, MaxPreRollSecs);
+		}
+
+		Stats.LastPeakLatenessSecs = SessionPeakLatenessSecs;
+		Stats.NumSessions++;
+
+		UE_LOG(ConvaiJitterBufferLog, Verbose, TEXT("Session %d: PeakLateness: %.3f PreRoll: %.3f AudioJitter: %.3f FaceJitter: %.3f FaceUnderruns: %d AudioUnderruns: %d"),
+			Stats.NumSessions, SessionPeakLatenessSecs, PreRollSecs, AudioTrack.JitterSecs, FaceTrack.JitterSecs, Stats.NumFaceUnderruns, Stats.NumAudioUnderruns);
+	}
+
+	SessionStartTime = -1;
+	SessionPeakLatenessSecs = 0;
+	SessionHadUnderrun = false;
+	PlayoutDrained = false;
+	SessionEnded = false;
+
+	// The jitter estimates carry over, only the schedule restarts
+	for (FArrivalTrack* Track : { &AudioTrack, &FaceTrack })
+	{
+		Track->LastArrivalTime = -1;
+		Track->LastMediaTime = 0;
+		Track->MediaTime = 0;
+	}
+}
+
+void FConvaiJitterBuffer::OnAudioArrived(float Duration)
+{
+	FScopeLock Lock(&CriticalSection);
+	const double Now = FPlatformTime::Seconds();
+
+	if (SessionStartTime < 0)
+	{
+		SessionStartTime = Now;
+	}
+
+	if (PlayoutDrained)
+	{
+		PlayoutDrained = false;
+		SessionHadUnderrun = true;
+		Stats.NumAudioUnderruns++;
+		RaisePreRoll(FMath::Max(PreRollSecs * UnderrunGrowth, PreRollSecs + UnderrunMinStepSecs));
+	}
+
+	OnArrived(AudioTrack, Duration, Now);
+}
+
+void FConvaiJitterBuffer::OnFaceArrived(float Duration)
+{
+	FScopeLock Lock(&CriticalSection);
+	OnArrived(FaceTrack, Duration, FPlatformTime::Seconds());
+}
+
+void FConvaiJitterBuffer::OnFaceUnderrun()
+{
+	FScopeLock Lock(&CriticalSection);
+	SessionHadUnderrun = true;
+	Stats.NumFaceUnderruns++;
+	RaisePreRoll(FMath::Max(PreRollSecs * UnderrunGrowth, PreRollSecs + UnderrunMinStepSecs));
+}
+
+void FConvaiJitterBuffer::OnPlayoutDrained()
+{
+	FScopeLock Lock(&CriticalSection);
+	PlayoutDrained = SessionStartTime >= 0 && !SessionEnded;
+}
+
+void FConvaiJitterBuffer::OnEndOfResponse()
+{
+	FScopeLock Lock(&CriticalSection);
+	SessionEnded = true;
+	PlayoutDrained = false;
+}
+
+float FConvaiJitterBuffer::GetPreRollSecs() const
+{
+	FScopeLock Lock(&CriticalSection);
+	return PreRollSecs;
+}
+
+FConvaiJitterStats FConvaiJitterBuffer::GetStats() const
+{
+	FScopeLock Lock(&CriticalSection);
+	FConvaiJitterStats Result = Stats;
+	Result.PreRollSecs = PreRollSecs;
+	Result.AudioJitterSecs = AudioTrack.JitterSecs;
+	Result.FaceJitterSecs = FaceTrack.JitterSecs;
+	return Result;
+}
+
+void FConvaiJitterBuffer::OnArrived(FArrivalTrack& Track, float Duration, double Now)
+{
+	if (Track.LastArrivalTime >= 0)
+	{
+		// Difference between the arrival spacing and the media spacing of two consecutive chunks
+		const double Transit = (Now - Track.LastArrivalTime) - (Track.MediaTime - Track.LastMediaTime);
+		Track.JitterSecs += (float(FMath::Abs(Transit)) - Track.JitterSecs) * JitterGain;
+	}
+
+	// How long after its start was due the chunk arrived, if the voice had started with no pre-roll
+	if (SessionStartTime >= 0)
+	{
+		const float LatenessSecs = float(Now - SessionStartTime - Track.MediaTime);
+		if (LatenessSecs > SessionPeakLatenessSecs)
+		{
+			SessionPeakLatenessSecs = LatenessSecs;
+			RaisePreRoll(LatenessSecs);
+		}
+	}
+
+	Track.LastArrivalTime = Now;
+	Track.LastMediaTime = Track.MediaTime;
+	Track.MediaTime += FMath::Max(Duration, 0.0f);
+}
+
+void FConvaiJitterBuffer::RaisePreRoll(float Secs)
+{
+	PreRollSecs = FMath::Clamp(FMath::Max(PreRollSecs, Secs), MinPreRollSecs, MaxPreRollSecs);
+}
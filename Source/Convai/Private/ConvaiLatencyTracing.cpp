@@ -0,0 +1,177 @@
+// Copyright 2022 Convai Inc. All Rights Reserved.
+
+#include "ConvaiLatencyTracing.h"
+#include "ConvaiDefinitions.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/ScopeLock.h"
+#include "ProfilingDebugging/CsvProfiler.h"
+#include "ProfilingDebugging/MiscTrace.h"
+
+DEFINE_LOG_CATEGORY(ConvaiLatencyLog);
+
+CSV_DEFINE_CATEGORY(Convai, true);
+
+const TCHAR* LexToString(EConvaiLatencySpan Span)
+{
+	switch (Span)
+	{
+	case EConvaiLatencySpan::FinishTalking:				return TEXT("FinishTalking");
+	case EConvaiLatencySpan::MicDrained:				return TEXT("MicDrained");
+	case EConvaiLatencySpan::LastAudioWritten:			return TEXT("LastAudioWritten");
+	case EConvaiLatencySpan::WritesDone:				return TEXT("WritesDone");
+	case EConvaiLatencySpan::FirstPartialTranscript:	return TEXT("FirstPartialTranscript");
+	case EConvaiLatencySpan::FinalTranscript:			return TEXT("FinalTranscript");
+	case EConvaiLatencySpan::FirstText:					return TEXT("FirstText");
+	case EConvaiLatencySpan::FirstAudio:				return TEXT("FirstAudio");
+	case EConvaiLatencySpan::FirstFaceData:				return TEXT("FirstFaceData");
+	case EConvaiLatencySpan::FirstAudioQueued:			return TEXT("FirstAudioQueued");
+	case EConvaiLatencySpan::StartedTalking:			return TEXT("StartedTalking");
+	default:											return TEXT("Unknown");
+	}
+}
+
+FConvaiTurnTrace::FConvaiTurnTrace(const FString& InCharacterID, const FString& InSessionID)
+	: CharacterID(InCharacterID)
+	, SessionID(InSessionID)
+	, StartTime(FPlatformTime::Seconds())
+{
+	for (std::atomic<double>& SpanTime : SpanTimes)
+	{
+		SpanTime.store(-1.0, std::memory_order_relaxed);
+	}
+}
+
+void FConvaiTurnTrace::Mark(EConvaiLatencySpan Span)
+{
+	const double Elapsed = FPlatformTime::Seconds() - StartTime;
+	double Expected = -1.0;
+	if (SpanTimes[(int32)Span].compare_exchange_strong(Expected, Elapsed, std::memory_order_relaxed))
+	{
+		TRACE_BOOKMARK(TEXT("Convai %s %s"), *CharacterID, LexToString(Span));
+	}
+}
+
+void FConvaiTurnTrace::MarkLatest(EConvaiLatencySpan Span)
+{
+	SpanTimes[(int32)Span].store(FPlatformTime::Seconds() - StartTime, std::memory_order_relaxed);
+}
+
+FConvaiLatencyTrace FConvaiTurnTrace::ToLatencyTrace() const
+{
+	FConvaiLatencyTrace Trace;
+	Trace.CharacterID = CharacterID;
+	Trace.SessionID = SessionID;
+
+	const double FinishTalkingTime = SpanTimes[(int32)EConvaiLatencySpan::FinishTalking].load(std::memory_order_relaxed);
+	for (int32 i = 0; i < (int32)EConvaiLatencySpan::Count; i++)
+	{
+		const double SpanTime = SpanTimes[i].load(std::memory_order_relaxed);
+		if (SpanTime < 0)
+		{
+			continue;
+		}
+
+		Trace.SpansMs.Add((EConvaiLatencySpan)i, float(SpanTime * 1000.0));
+
+		// Partial transcripts can arrive while the player is still talking, those have no response latency
+		if (FinishTalkingTime >= 0 && SpanTime >= FinishTalkingTime && i != (int32)EConvaiLatencySpan::FinishTalking)
+		{
+			Trace.SinceFinishTalkingMs.Add((EConvaiLatencySpan)i, float((SpanTime - FinishTalkingTime) * 1000.0));
+		}
+	}
+	return Trace;
+}
+
+FConvaiLatencyTracer& FConvaiLatencyTracer::Get()
+{
+	static FConvaiLatencyTracer Instance;
+	return Instance;
+}
+
+void FConvaiLatencyTracer::Submit(const FConvaiLatencyTrace& Trace)
+{
+	// Aggregate the talking time on its own and everything else from FinishTalking, so long utterances do not skew the response latency
+	TMap<EConvaiLatencySpan, float> AggregatedSpansMs = Trace.SinceFinishTalkingMs;
+	if (const float* TalkingMs = Trace.SpansMs.Find(EConvaiLatencySpan::FinishTalking))
+	{
+		AggregatedSpansMs.Add(EConvaiLatencySpan::FinishTalking, *TalkingMs);
+	}
+
+	{
+		FScopeLock Lock(&CriticalSection);
+		TArray<TArray<float>>& CharacterSamples = Samples.FindOrAdd(Trace.CharacterID);
+		CharacterSamples.SetNum((int32)EConvaiLatencySpan::Count);
+
+		for (const TPair<EConvaiLatencySpan, float>& Span : AggregatedSpansMs)
+		{
+			TArray<float>& SpanSamples = CharacterSamples[(int32)Span.Key];
+			if (SpanSamples.Num() >= ConvaiConstants::LatencyStatsWindow)
+			{
+				SpanSamples.RemoveAt(0);
+			}
+			SpanSamples.Add(Span.Value);
+		}
+	}
+
+#if CSV_PROFILER
+	for (const TPair<EConvaiLatencySpan, float>& Span : AggregatedSpansMs)
+	{
+		FCsvProfiler::RecordCustomStat(FName(LexToString(Span.Key)), CSV_CATEGORY_INDEX(Convai), Span.Value, ECsvCustomStatOp::Set);
+	}
+#endif
+
+	FString SpansString;
+	for (const TPair<EConvaiLatencySpan, float>& Span : AggregatedSpansMs)
+	{
+		SpansString += FString::Printf(TEXT(" | %s: %.1f ms"), LexToString(Span.Key), Span.Value);
+	}
+	UE_LOG(ConvaiLatencyLog, Log, TEXT("Turn latency since finish talking%s | Character ID : %s | Session ID : %s"),
+		*SpansString,
+		*Trace.CharacterID,
+		*Trace.SessionID);
+}
+
+void FConvaiLatencyTracer::GetStats(const FString& CharacterID, TArray<FConvaiLatencySpanStats>& OutStats) const
+{
+	OutStats.Reset();
+
+	FScopeLock Lock(&CriticalSection);
+	const TArray<TArray<float>>* CharacterSamples = Samples.Find(CharacterID);
+	if (!CharacterSamples)
+	{
+		return;
+	}
+
+	for (int32 i = 0; i < CharacterSamples->Num(); i++)
+	{
+		TArray<float> Sorted = (*CharacterSamples)[i];
+		if (Sorted.Num() == 0)
+		{
+			continue;
+		}
+		Sorted.Sort();
+
+		FConvaiLatencySpanStats Stats;
+		Stats.Span = (EConvaiLatencySpan)i;
+		Stats.NumSamples = Sorted.Num();
+		Stats.P50Ms = Sorted[FMath::Clamp(FMath::CeilToInt(0.50f * Sorted.Num()) - 1, 0, Sorted.Num() - 1)];
+		Stats.P95Ms = Sorted[FMath::Clamp(FMath::CeilToInt(0.95f * Sorted.Num()) - 1, 0, Sorted.Num() - 1)];
+		OutStats.Add(Stats);
+	}
+}
+
+void FConvaiLatencyTracer::Reset()
+{
+	FScopeLock Lock(&CriticalSection);
+	Samples.Reset();
+}
+
+void UConvaiLatencyTracing::GetLatencyStats(FString CharacterID, TArray<FConvaiLatencySpanStats>& OutStats)
+{
+	FConvaiLatencyTracer::Get().GetStats(CharacterID, OutStats);
+}
+
+void UConvaiLatencyTracing::ResetLatencyStats()
+{
+	FConvaiLatencyTracer::Get().Reset();
+}
@@ -0,0 +1,412 @@
+// Copyright 2022 Convai Inc. All Rights Reserved.
+
+#include "ConvaiLocalService.h"
+#include "ConvaiSubsystem.h"
+#include "ConvaiDefinitions.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformProcess.h"
+#include "Misc/Parse.h"
+#include "Misc/ScopeLock.h"
+#include <string>
+#include <chrono>
+
+THIRD_PARTY_INCLUDES_START
+#include <grpc++/grpc++.h>
+THIRD_PARTY_INCLUDES_END
+
+DEFINE_LOG_CATEGORY(ConvaiLocalServiceLog);
+
+using grpc::ServerContext;
+using grpc::ServerReaderWriter;
+using grpc::Status;
+using grpc::StatusCode;
+
+using ::service::GetResponseRequest;
+using ::service::GetResponseResponse;
+using ::service::GetResponseResponse_AudioResponse;
+using ::service::HelloRequest;
+using ::service::HelloResponse;
+using ::service::FeedbackRequest;
+using ::service::FeedbackResponse;
+using ::service::FaceModel;
+
+namespace
+{
+	const char* SyntheticWords[] = { "This", "is", "a", "synthetic", "response", "from", "the", "local", "Convai", "service." };
+	const char* SyntheticBlendshapes[] = { "jawOpen", "mouthClose", "mouthFunnel", "mouthPucker", "mouthSmileLeft", "mouthSmileRight" };
+
+	void AppendLittleEndian(std::string& Out, uint32 Value, int32 NumBytes)
+	{
+		for (int32 i = 0; i < NumBytes; i++)
+		{
+			Out.push_back(char((Value >> (8 * i)) & 0xFF));
+		}
+	}
+
+	// 16-bit mono PCM behind a 44 byte RIFF header, the same layout the live service sends
+	void MakeWavChunk(std::string& Out, int32 SampleRate, int32 NumSamples, int32 ChunkIndex)
+	{
+		const uint32 DataSize = uint32(NumSamples) * 2;
+
+		Out.clear();
+		Out.reserve(44 + DataSize);
+		Out.append("RIFF");
+		AppendLittleEndian(Out, 36 + DataSize, 4);
+		Out.append("WAVEfmt ");
+		AppendLittleEndian(Out, 16, 4);
+		AppendLittleEndian(Out, 1, 2); // PCM
+		AppendLittleEndian(Out, 1, 2); // Mono
+		AppendLittleEndian(Out, SampleRate, 4);
+		AppendLittleEndian(Out, SampleRate * 2, 4);
+		AppendLittleEndian(Out, 2, 2);
+		AppendLittleEndian(Out, 16, 2);
+		Out.append("data");
+		AppendLittleEndian(Out, DataSize, 4);
+
+		const float Frequency = 180.f + 20.f * (ChunkIndex % 4);
+		for (int32 i = 0; i < NumSamples; i++)
+		{
+			const float Sample = 0.2f * FMath::Sin(2.f * PI * Frequency * float(i) / float(SampleRate));
+			AppendLittleEndian(Out, uint16(int16(Sample * 32767.f)), 2);
+		}
+	}
+
+	// Same JSON layout UConvaiUtils::ParseBlendShapeData expects
+	std::string MakeBlendshapesJson(int32 FirstFrameIndex, int32 NumFrames)
+	{
+		FString Json = TEXT("[");
+		for (int32 Frame = 0; Frame < NumFrames; Frame++)
+		{
+			const int32 FrameIndex = FirstFrameIndex + Frame;
+			Json += FString::Printf(TEXT("%s{\"FrameIndex\":%d,\"BlendShapes\":["), Frame ? TEXT(",") : TEXT(""), FrameIndex);
+			for (int32 Shape = 0; Shape < UE_ARRAY_COUNT(SyntheticBlendshapes); Shape++)
+			{
+				const float Score = 0.5f + 0.5f * FMath::Sin(0.3f * FrameIndex + Shape);
+				Json += FString::Printf(TEXT("%s{\"name\":\"%s\",\"score\":%.3f}"), Shape ? TEXT(",") : TEXT(""), UTF8_TO_TCHAR(SyntheticBlendshapes[Shape]), Score);
+			}
+			Json += TEXT("]}");
+		}
+		Json += TEXT("]");
+		return std::string(TCHAR_TO_UTF8(*Json));
+	}
+
+	void FillVisemes(::service::Viseme* Visemes, int32 FrameIndex)
+	{
+		const float Open = 0.5f + 0.5f * FMath::Sin(0.3f * FrameIndex);
+		Visemes->set_sil(1.f - Open);
+		Visemes->set_aa(Open);
+		Visemes->set_oh(0.5f * Open);
+		Visemes->set_pp(0.1f * (FrameIndex % 3));
+	}
+
+	/** Synchronous implementation, every stream is served on a thread of the gRPC server pool */
+	class FConvaiLocalServiceImpl final : public ::service::ConvaiService::Service
+	{
+	public:
+		explicit FConvaiLocalServiceImpl(const FConvaiLocalServiceOptions& InOptions)
+			: Options(InOptions)
+		{
+		}
+
+		Status Hello(ServerContext* context, const HelloRequest* request, HelloResponse* response) override
+		{
+			response->set_message("Hello " + request->name());
+			return Status::OK;
+		}
+
+		Status SubmitFeedback(ServerContext* context, const FeedbackRequest* request, FeedbackResponse* response) override
+		{
+			response->set_feedback_response("Feedback received for interaction " + request->interaction_id());
+			return Status::OK;
+		}
+
+		Status GetResponse(ServerContext* context, ServerReaderWriter<GetResponseResponse, GetResponseRequest>* stream) override
+		{
+			GetResponseRequest Request;
+			if (!stream->Read(&Request) || !Request.has_get_response_config())
+			{
+				return Status(StatusCode::INVALID_ARGUMENT, "The first message must carry the GetResponse config");
+			}
+
+			const ::service::GetResponseRequest_GetResponseConfig& Config = Request.get_response_config();
+			std::string SessionID = Config.session_id();
+			if (SessionID.empty() || SessionID == "-1")
+			{
+				SessionID = TCHAR_TO_UTF8(*FGuid::NewGuid().ToString(EGuidFormats::DigitsWithHyphens));
+			}
+			const bool SendAudio = !Config.audio_config().disable_audio();
+			const bool SendFaceData = SendAudio && Config.audio_config().enable_facial_data();
+			const bool SendBlendshapes = Config.audio_config().face_model() == FaceModel::FACE_MODEL_PHONEMES_MODEL_NAME;
+			std::string Action;
+			if (Options.SendActions && Config.has_action_config() && Config.action_config().actions_size() > 0)
+			{
+				Action = Config.action_config().actions(0);
+			}
+
+			GetResponseResponse Response;
+			Response.set_session_id(SessionID);
+			Response.set_interaction_id(TCHAR_TO_UTF8(*FGuid::NewGuid().ToString(EGuidFormats::DigitsWithHyphens)));
+			if (!stream->Write(Response))
+			{
+				return Status(StatusCode::CANCELLED, "Client went away");
+			}
+
+			// Consume the user input, echoing partial transcripts for audio the way the live service does
+			std::string UserQuery;
+			int64 AudioBytes = 0;
+			int32 NumAudioMessages = 0;
+			while (stream->Read(&Request))
+			{
+				if (!Request.has_get_response_data())
+				{
+					continue;
+				}
+
+				const ::service::GetResponseRequest_GetResponseData& Data = Request.get_response_data();
+				if (Data.has_text_data())
+				{
+					UserQuery = Data.text_data();
+				}
+				else if (Data.has_trigger_data())
+				{
+					UserQuery = Data.trigger_data().trigger_name().empty() ? Data.trigger_data().trigger_message() : Data.trigger_data().trigger_name();
+				}
+				else if (Data.has_audio_data())
+				{
+					AudioBytes += Data.audio_data().size();
+					if (++NumAudioMessages % 10 == 0)
+					{
+						Response.Clear();
+						Response.mutable_user_query()->set_text_data(FormatAudioTranscript(AudioBytes));
+						Response.mutable_user_query()->set_is_final(false);
+						stream->Write(Response);
+					}
+				}
+			}
+
+			if (UserQuery.empty())
+			{
+				UserQuery = FormatAudioTranscript(AudioBytes);
+			}
+
+			Response.Clear();
+			Response.mutable_user_query()->set_text_data(UserQuery);
+			Response.mutable_user_query()->set_is_final(true);
+			Response.mutable_user_query()->set_end_of_response(true);
+			if (!stream->Write(Response))
+			{
+				return Status(StatusCode::CANCELLED, "Client went away");
+			}
+
+			if (!SleepUnlessCancelled(context, Options.FirstResponseDelayMs))
+			{
+				return Status(StatusCode::CANCELLED, "Client went away");
+			}
+
+			const int32 SamplesPerChunk = Options.SampleRate * Options.AudioChunkMs / 1000;
+			int32 FaceFrameIndex = 0;
+			for (int32 Chunk = 0; Chunk < Options.NumChunks; Chunk++)
+			{
+				if (SendFaceData && !SendBlendshapes)
+				{
+					// Visemes only carry a single frame per message
+					for (int32 Frame = 0; Frame < Options.FaceFramesPerChunk; Frame++)
+					{
+						Response.Clear();
+						FillVisemes(Response.mutable_audio_response()->mutable_visemes_data()->mutable_visemes(), FaceFrameIndex++);
+						stream->Write(Response);
+					}
+				}
+
+				Response.Clear();
+				GetResponseResponse_AudioResponse* AudioResponse = Response.mutable_audio_response();
+				AudioResponse->set_text_data(std::string(SyntheticWords[Chunk % UE_ARRAY_COUNT(SyntheticWords)]) + " ");
+				if (SendAudio)
+				{
+					MakeWavChunk(*AudioResponse->mutable_audio_data(), Options.SampleRate, SamplesPerChunk, Chunk);
+					AudioResponse->mutable_audio_config()->set_sample_rate_hertz(Options.SampleRate);
+				}
+				if (SendFaceData && SendBlendshapes)
+				{
+					AudioResponse->mutable_blendshapes_data()->set_blendshape_data(MakeBlendshapesJson(FaceFrameIndex, Options.FaceFramesPerChunk));
+					FaceFrameIndex += Options.FaceFramesPerChunk;
+				}
+
+				if (!stream->Write(Response) || !SleepUnlessCancelled(context, Options.ChunkIntervalMs))
+				{
+					return Status(StatusCode::CANCELLED, "Client went away");
+				}
+			}
+
+			if (!Action.empty())
+			{
+				Response.Clear();
+				Response.mutable_action_response()->set_action(Action);
+				stream->Write(Response);
+			}
+
+			Response.Clear();
+			Response.set_session_id(SessionID);
+			Response.mutable_audio_response()->set_end_of_response(true);
+			stream->Write(Response);
+
+			FConvaiLocalService::Get().OnStreamServed();
+			return Status::OK;
+		}
+
+	private:
+		std::string FormatAudioTranscript(int64 AudioBytes) const
+		{
+			const float Seconds = float(AudioBytes) / float(ConvaiConstants::VoiceCaptureSampleRate * 2);
+			return std::string(TCHAR_TO_UTF8(*FString::Printf(TEXT("Synthetic transcript of %.1f seconds of audio"), Seconds)));
+		}
+
+		static bool SleepUnlessCancelled(ServerContext* context, int32 DelayMs)
+		{
+			// Sleep in small steps so shutdown and client cancellation are noticed quickly
+			for (int32 Remaining = DelayMs; Remaining > 0; Remaining -= 10)
+			{
+				if (context->IsCancelled())
+				{
+					return false;
+				}
+				FPlatformProcess::Sleep(FMath::Min(Remaining, 10) / 1000.f);
+			}
+			return !context->IsCancelled();
+		}
+
+		const FConvaiLocalServiceOptions Options;
+	};
+}
+
+struct FConvaiLocalService::FImpl
+{
+	explicit FImpl(const FConvaiLocalServiceOptions& InOptions)
+		: ServiceImpl(InOptions)
+	{
+	}
+
+	FConvaiLocalServiceImpl ServiceImpl;
+	std::unique_ptr<grpc::Server> Server;
+	int32 BoundPort = 0;
+};
+
+FConvaiLocalService& FConvaiLocalService::Get()
+{
+	static FConvaiLocalService Instance;
+	return Instance;
+}
+
+FConvaiLocalService::~FConvaiLocalService()
+{
+	Stop();
+}
+
+bool FConvaiLocalService::Start(const FConvaiLocalServiceOptions& InOptions)
+{
+	FScopeLock Lock(&CriticalSection);
+
+	if (Impl)
+	{
+		UE_LOG(ConvaiLocalServiceLog, Warning, TEXT("Start: Local service is already running on %s"), *FString::Printf(TEXT("localhost:%d"), Impl->BoundPort));
+		return false;
+	}
+
+	Options = InOptions;
+	Options.NumChunks = FMath::Max(Options.NumChunks, 1);
+	Options.SampleRate = FMath::Max(Options.SampleRate, 8000);
+	Options.AudioChunkMs = FMath::Max(Options.AudioChunkMs, 10);
+	Options.FaceFramesPerChunk = FMath::Max(Options.FaceFramesPerChunk, 1);
+
+	TUniquePtr<FImpl> NewImpl = MakeUnique<FImpl>(Options);
+
+	const std::string Address = "localhost:" + std::to_string(Options.Port);
+	grpc::ServerBuilder Builder;
+	Builder.AddListeningPort(Address, grpc::InsecureServerCredentials(), &NewImpl->BoundPort);
+	Builder.RegisterService(&NewImpl->ServiceImpl);
+	NewImpl->Server = Builder.BuildAndStart();
+
+	if (!NewImpl->Server || NewImpl->BoundPort == 0)
+	{
+		UE_LOG(ConvaiLocalServiceLog, Warning, TEXT("Start: Could not listen on %s"), UTF8_TO_TCHAR(Address.c_str()));
+		return false;
+	}
+
+	Impl = MoveTemp(NewImpl);
+	NumStreamsServed.Reset();
+
+	UE_LOG(ConvaiLocalServiceLog, Log, TEXT("Local service listening on localhost:%d | First Response Delay: %d ms | Chunk Interval: %d ms | Chunks: %d | Audio Chunk: %d ms"),
+		Impl->BoundPort,
+		Options.FirstResponseDelayMs,
+		Options.ChunkIntervalMs,
+		Options.NumChunks,
+		Options.AudioChunkMs);
+	return true;
+}
+
+void FConvaiLocalService::Stop()
+{
+	FScopeLock Lock(&CriticalSection);
+
+	if (!Impl)
+	{
+		return;
+	}
+
+	// Streams still sleeping between chunks notice the cancellation within a few milliseconds
+	Impl->Server->Shutdown(std::chrono::system_clock::now() + std::chrono::seconds(1));
+	Impl->Server->Wait();
+	Impl.Reset();
+
+	UE_LOG(ConvaiLocalServiceLog, Log, TEXT("Local service stopped after serving %d streams"), NumStreamsServed.GetValue());
+}
+
+bool FConvaiLocalService::IsRunning() const
+{
+	FScopeLock Lock(&CriticalSection);
+	return Impl.IsValid();
+}
+
+FString FConvaiLocalService::GetAddress() const
+{
+	FScopeLock Lock(&CriticalSection);
+	return Impl ? FString::Printf(TEXT("localhost:%d"), Impl->BoundPort) : FString();
+}
+
+FConvaiLocalServiceOptions FConvaiLocalService::ParseOptions(const FString& Params)
+{
+	FConvaiLocalServiceOptions ParsedOptions;
+	FParse::Value(*Params, TEXT("Port="), ParsedOptions.Port);
+	FParse::Value(*Params, TEXT("DelayMs="), ParsedOptions.FirstResponseDelayMs);
+	FParse::Value(*Params, TEXT("ChunkMs="), ParsedOptions.ChunkIntervalMs);
+	FParse::Value(*Params, TEXT("Chunks="), ParsedOptions.NumChunks);
+	FParse::Value(*Params, TEXT("AudioChunkMs="), ParsedOptions.AudioChunkMs);
+	FParse::Value(*Params, TEXT("SampleRate="), ParsedOptions.SampleRate);
+	FParse::Value(*Params, TEXT("FaceFrames="), ParsedOptions.FaceFramesPerChunk);
+	FParse::Bool(*Params, TEXT("Actions="), ParsedOptions.SendActions);
+	return ParsedOptions;
+}
+
+FConvaiLocalServiceOptions FConvaiLocalService::GetOptions() const
+{
+	FScopeLock Lock(&CriticalSection);
+	return Options;
+}
+
+#if !UE_BUILD_SHIPPING
+static FAutoConsoleCommand ConvaiLocalServiceStartCommand(
+	TEXT("Convai.LocalService.Start"),
+	TEXT("Starts the local stand-in Convai service. Optional: Port= DelayMs= ChunkMs= Chunks= AudioChunkMs= SampleRate= FaceFrames= Actions="),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		FConvaiLocalService::Get().Start(FConvaiLocalService::ParseOptions(FString::Join(Args, TEXT(" "))));
+	}));
+
+static FAutoConsoleCommand ConvaiLocalServiceStopCommand(
+	TEXT("Convai.LocalService.Stop"),
+	TEXT("Stops the local stand-in Convai service"),
+	FConsoleCommandDelegate::CreateLambda([]()
+	{
+		FConvaiLocalService::Get().Stop();
+	}));
+#endif
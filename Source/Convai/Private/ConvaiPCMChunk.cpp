@@ -0,0 +1,102 @@
+// Copyright 2022 Convai Inc. All Rights Reserved.
+
+#include "ConvaiPCMChunk.h"
+#include "HAL/IConsoleManager.h"
+#include <atomic>
+
+DEFINE_LOG_CATEGORY(ConvaiPCMChunkLog);
+
+namespace
+{
+	std::atomic<int64> TotalChunks{ 0 };
+	std::atomic<int64> TotalBytesAdopted{ 0 };
+	std::atomic<int64> TotalCopies{ 0 };
+	std::atomic<int64> TotalBytesCopied{ 0 };
+}
+
+FString FConvaiPCMChunkStats::ToString() const
+{
+	return FString::Printf(TEXT("Chunks: %lld | Adopted: %lld bytes | Copies: %lld (%lld bytes) | Copies per chunk: %.2f"),
+		NumChunks, BytesAdopted, NumCopies, BytesCopied, NumChunks > 0 ? double(NumCopies) / NumChunks : 0.0);
+}
+
+FConvaiPCMChunk::FConvaiPCMChunk(std::string&& InStorage, int32 Offset, int32 InSampleRate, int32 InNumChannels)
+	: StringStorage(MoveTemp(InStorage))
+	, SampleRate(FMath::Max(InSampleRate, 0))
+	, NumChannels(FMath::Max(InNumChannels, 1))
+{
+	Offset = FMath::Clamp<int32>(Offset, 0, int32(StringStorage.size()));
+	Data = reinterpret_cast<const uint8*>(StringStorage.data()) + Offset;
+	NumBytes = int32(StringStorage.size()) - Offset;
+
+	TotalChunks.fetch_add(1, std::memory_order_relaxed);
+	TotalBytesAdopted.fetch_add(NumBytes, std::memory_order_relaxed);
+}
+
+FConvaiPCMChunk::FConvaiPCMChunk(TArray<uint8>&& InStorage, int32 Offset, int32 InSampleRate, int32 InNumChannels)
+	: ArrayStorage(MoveTemp(InStorage))
+	, SampleRate(FMath::Max(InSampleRate, 0))
+	, NumChannels(FMath::Max(InNumChannels, 1))
+{
+	Offset = FMath::Clamp(Offset, 0, ArrayStorage.Num());
+	Data = ArrayStorage.GetData() + Offset;
+	NumBytes = ArrayStorage.Num() - Offset;
+
+	TotalChunks.fetch_add(1, std::memory_order_relaxed);
+	TotalBytesAdopted.fetch_add(NumBytes, std::memory_order_relaxed);
+}
+
+FConvaiPCMChunkRef FConvaiPCMChunk::Create(std::string&& InStorage, int32 Offset, int32 InSampleRate, int32 InNumChannels)
+{
+	return MakeShared<FConvaiPCMChunk, ESPMode::ThreadSafe>(MoveTemp(InStorage), Offset, InSampleRate, InNumChannels);
+}
+
+FConvaiPCMChunkRef FConvaiPCMChunk::Create(TArray<uint8>&& InStorage, int32 Offset, int32 InSampleRate, int32 InNumChannels)
+{
+	return MakeShared<FConvaiPCMChunk, ESPMode::ThreadSafe>(MoveTemp(InStorage), Offset, InSampleRate, InNumChannels);
+}
+
+FConvaiPCMChunkRef FConvaiPCMChunk::CreateCopy(const uint8* InData, int32 InNumBytes, int32 InSampleRate, int32 InNumChannels)
+{
+	const int32 CopyBytes = InData ? FMath::Max(InNumBytes, 0) : 0;
+
+	TotalCopies.fetch_add(1, std::memory_order_relaxed);
+	TotalBytesCopied.fetch_add(CopyBytes, std::memory_order_relaxed);
+
+	// Not adopted, the bytes were counted as copied
+	FConvaiPCMChunkRef Chunk = Create(TArray<uint8>(InData, CopyBytes), 0, InSampleRate, InNumChannels);
+	TotalBytesAdopted.fetch_sub(CopyBytes, std::memory_order_relaxed);
+	return Chunk;
+}
+
+FConvaiPCMChunkStats FConvaiPCMChunk::GetStats()
+{
+	FConvaiPCMChunkStats Stats;
+	Stats.NumChunks = TotalChunks.load(std::memory_order_relaxed);
+	Stats.BytesAdopted = TotalBytesAdopted.load(std::memory_order_relaxed);
+	Stats.NumCopies = TotalCopies.load(std::memory_order_relaxed);
+	Stats.BytesCopied = TotalBytesCopied.load(std::memory_order_relaxed);
+	return Stats;
+}
+
+void FConvaiPCMChunk::ResetStats()
+{
+	TotalChunks.store(0, std::memory_order_relaxed);
+	TotalBytesAdopted.store(0, std::memory_order_relaxed);
+	TotalCopies.store(0, std::memory_order_relaxed);
+	TotalBytesCopied.store(0, std::memory_order_relaxed);
+}
+
+#if !UE_BUILD_SHIPPING
+static FAutoConsoleCommand ConvaiPCMStatsCommand(
+	TEXT("Convai.PCMStats"),
+	TEXT("Logs how many voice chunks were created and copied since the last reset. Optional: Reset"),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		UE_LOG(ConvaiPCMChunkLog, Log, TEXT("PCM chunks | %s"), *FConvaiPCMChunk::GetStats().ToString());
+		if (Args.Contains(TEXT("Reset")))
+		{
+			FConvaiPCMChunk::ResetStats();
+		}
+	}));
+#endif
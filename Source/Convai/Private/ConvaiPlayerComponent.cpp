@@ -14,7 +14,6 @@
 #include "ConvaiUtils.h"
 #include "Containers/UnrealString.h"
 #include "Kismet/GameplayStatics.h"
-#include "AudioMixerBlueprintLibrary.h"
 #include "Engine/GameEngine.h"
 #include "Sound/SoundWave.h"
 #include "AudioDevice.h"
@@ -35,28 +34,6 @@ static FAudioDevice* GetAudioDeviceFromWorldContext(const UObject* WorldContextO
 	return ThisWorld->GetAudioDevice().GetAudioDevice();
 }
 
-static Audio::FMixerDevice* GetAudioMixerDeviceFromWorldContext(const UObject* WorldContextObject)
-{
-	if (FAudioDevice* AudioDevice = GetAudioDeviceFromWorldContext(WorldContextObject))
-	{
-#if ENGINE_MAJOR_VERSION == 5 && ENGINE_MINOR_VERSION >= 3
-		bool Found = AudioDevice != nullptr;
-#else
-		bool Found = AudioDevice != nullptr && AudioDevice->IsAudioMixerEnabled();
-#endif
-
-		if (!Found)
-		{
-			return nullptr;
-		}
-		else
-		{
-			return static_cast<Audio::FMixerDevice*>(AudioDevice);
-		}
-	}
-	return nullptr;
-}
-
 UConvaiPlayerComponent::UConvaiPlayerComponent()
 {
 	PrimaryComponentTick.bCanEverTick = true;
@@ -65,7 +42,7 @@ UConvaiPlayerComponent::UConvaiPlayerComponent()
 	PlayerName = "Guest";
 
 	IsInit = false;
-	VoiceCaptureRingBuffer.Init(ConvaiConstants::VoiceCaptureRingBufferCapacity);
+	VoiceCaptureRingBuffer.Init(ConvaiConstants::VoiceCaptureRingBufferCapacity, EConvaiRingOverflowPolicy::DropNew);
 	VoiceCaptureBuffer.Empty(ConvaiConstants::VoiceCaptureBufferSize);
 	UsePixelStreamingMicInput = true;
 
@@ -130,6 +107,8 @@ bool UConvaiPlayerComponent::Init()
 		return false;
 	}
 
+	RegisterSubmixCapture();
+
 	IsInit = true;
 	Token = 0;
 	return true;
@@ -400,47 +379,56 @@ bool UConvaiPlayerComponent::IsPixelStreamingEnabledAndAllowed()
 
 void UConvaiPlayerComponent::UpdateVoiceCapture(float DeltaTime)
 {
-	if (IsRecording || IsStreaming) {
-		RemainingTimeUntilNextUpdate -= DeltaTime;
-		if (RemainingTimeUntilNextUpdate <= 0)
-		{
-			float ExpectedRecordingTime = DeltaTime > TIME_BETWEEN_VOICE_UPDATES_SECS ? DeltaTime : TIME_BETWEEN_VOICE_UPDATES_SECS;
-			FAudioThread::RunCommandOnAudioThread([this, ExpectedRecordingTime]()
-				{
-					StopVoiceChunkCapture();
-					StartVoiceChunkCapture(ExpectedRecordingTime);
-				});
-			RemainingTimeUntilNextUpdate = TIME_BETWEEN_VOICE_UPDATES_SECS;
-		}
-	}
-	else
+	if (IsRecording || IsStreaming)
 	{
-		RemainingTimeUntilNextUpdate = 0;
+		ProcessCapturedVoice();
 	}
 }
 
-void UConvaiPlayerComponent::StartVoiceChunkCapture(float ExpectedRecordingTime)
+void UConvaiPlayerComponent::RegisterSubmixCapture()
 {
-	//GEngine->AddOnScreenDebugMessage(-1, 15.0f, FColor::Yellow, FString::Printf(TEXT("StartVoiceChunkCapture() in VoiceCaptureComp.cpp")));
-	//UE_LOG(LogTemp, Warning, TEXT("StartVoiceChunkCapture() in VoiceCaptureComp.cpp"));
-	UAudioMixerBlueprintLibrary::StartRecordingOutput(this, ExpectedRecordingTime, Cast<USoundSubmix>(AudioCaptureComponent->SoundSubmix));
+	if (SubmixCapture.IsValid())
+	{
+		return;
+	}
+
+	SubmixCapture = MakeShared<FConvaiSubmixCapture, ESPMode::ThreadSafe>();
+	FConvaiSubmixCapture::Register(SubmixCapture.ToSharedRef(), GetAudioDeviceFromWorldContext(this), Cast<USoundSubmix>(AudioCaptureComponent->SoundSubmix));
 }
 
-void UConvaiPlayerComponent::ReadRecordedBuffer(Audio::AlignedFloatBuffer& RecordedBuffer, float& OutNumChannels, float& OutSampleRate)
+void UConvaiPlayerComponent::UnregisterSubmixCapture()
 {
-	if (Audio::FMixerDevice* MixerDevice = GetAudioMixerDeviceFromWorldContext(this))
+	if (!SubmixCapture.IsValid())
 	{
-		// call the thing here.
-		RecordedBuffer = MixerDevice->StopRecording(Cast<USoundSubmix>(AudioCaptureComponent->SoundSubmix), OutNumChannels, OutSampleRate);
+		return;
+	}
 
-		if (RecordedBuffer.Num() == 0)
-		{
-			//UE_LOG(ConvaiPlayerLog, Warning, TEXT("ReadRecordedBuffer: No audio data. Did you call Start Recording Output?"));
-		}
+	USoundSubmix* Submix = IsValid(AudioCaptureComponent) ? Cast<USoundSubmix>(AudioCaptureComponent->SoundSubmix) : nullptr;
+	FConvaiSubmixCapture::Unregister(SubmixCapture.ToSharedRef(), GetAudioDeviceFromWorldContext(this), Submix);
+	SubmixCapture.Reset();
+}
+
+void UConvaiPlayerComponent::StartVoiceCapture()
+{
+	if (!SubmixCapture.IsValid())
+	{
+		UE_LOG(ConvaiPlayerLog, Warning, TEXT("StartVoiceCapture: Submix capture is not registered"));
+		return;
 	}
-	else
+
+	// Whatever the submix still held from before is not part of this capture
+	SubmixCapture->Flush();
+	VoiceCaptureResampler.Reset();
+	SubmixCapture->SetCapturing(true);
+}
+
+void UConvaiPlayerComponent::StopVoiceCapture()
+{
+	ProcessCapturedVoice();
+
+	if (SubmixCapture.IsValid())
 	{
-		UE_LOG(ConvaiPlayerLog, Warning, TEXT("ReadRecordedBuffer: Could not get MixerDevice"));
+		SubmixCapture->SetCapturing(false);
 	}
 }
 
@@ -465,55 +453,133 @@ void UConvaiPlayerComponent::StopAudioCaptureComponent()
 	AudioCaptureComponent->Stop();
 }
 
-void UConvaiPlayerComponent::StopVoiceChunkCapture()
+void UConvaiPlayerComponent::ProcessCapturedVoice()
 {
-	//USoundWave* SoundWaveMic = UAudioMixerBlueprintLibrary::StopRecordingOutput(this, EAudioRecordingExportType::SoundWave, "Convsound", "ConvSound", Cast<USoundSubmix>(AudioCaptureComponent->SoundSubmix));
+	if (!SubmixCapture.IsValid())
+	{
+		return;
+	}
 
-	float NumChannels;
-	float SampleRate;
-	Audio::AlignedFloatBuffer RecordedBuffer = Audio::AlignedFloatBuffer();
+	const int32 NumOverflows = SubmixCapture->GetStats().NumOverflows;
+	if (NumOverflows != LastLoggedCaptureOverflows)
+	{
+		UE_LOG(ConvaiPlayerLog, Warning, TEXT("ProcessCapturedVoice: Microphone capture overflowed %d times, some voice was lost"), NumOverflows - LastLoggedCaptureOverflows);
+		LastLoggedCaptureOverflows = NumOverflows;
+	}
 
-	ReadRecordedBuffer(RecordedBuffer, NumChannels, SampleRate);
-	//NumChannels = 2;
-	//SampleRate = ConvaiConstants::VoiceCaptureSampleRate;
+	// Nothing takes the voice, drop it without reading it out of the capture
+	if (!IsRecording && !IsStreaming)
+	{
+		SubmixCapture->Flush();
+		return;
+	}
 
-	if (RecordedBuffer.Num() == 0)
+	const float* CapturedFirst;
+	const float* CapturedSecond;
+	int32 CapturedFirstSamples;
+	int32 CapturedSecondSamples;
+	int32 NumChannels;
+	int32 SampleRate;
+	const int32 NumCapturedSamples = SubmixCapture->PeekRead(CapturedFirst, CapturedFirstSamples, CapturedSecond, CapturedSecondSamples, NumChannels, SampleRate);
+	if (NumCapturedSamples == 0)
 		return;
 
-	Audio::TSampleBuffer<int16> Int16Buffer = Audio::TSampleBuffer<int16>(RecordedBuffer, NumChannels, SampleRate);
-	TArray<int16> OutConverted;
+	// Downmix, resampling and conversion to 16 bit happen in one pass from the capture ring straight into wherever the voice goes next
+	if (VoiceCaptureResampler.GetInputSampleRate() != SampleRate)
+	{
+		VoiceCaptureResampler.Init(SampleRate, ConvaiConstants::VoiceCaptureSampleRate);
+	}
+
+	const int32 NumOutputFrames = VoiceCaptureResampler.GetNumOutputFrames(NumCapturedSamples / NumChannels);
+
+	// The destination as two spans, where it wraps around the output continues in the second one
+	int16* OutFirst = nullptr;
+	int16* OutSecond = nullptr;
+	int32 OutFirstFrames = 0;
+	int32 OutSecondFrames = 0;
 
-	if (NumChannels > 1 || SampleRate != ConvaiConstants::VoiceCaptureSampleRate)
+	TArray<uint8> VoiceData;
+	int32 RecordingStart = 0;
+	if (IsRecording)
 	{
-		UConvaiUtils::ResampleAudio(SampleRate, ConvaiConstants::VoiceCaptureSampleRate, NumChannels, true, (TArray<int16>)Int16Buffer.GetArrayView(), Int16Buffer.GetNumSamples(), OutConverted);
+		RecordingStart = VoiceCaptureBuffer.AddUninitialized(NumOutputFrames * int32(sizeof(int16)));
+		OutFirst = (int16*)(VoiceCaptureBuffer.GetData() + RecordingStart);
+		OutFirstFrames = NumOutputFrames;
+	}
+	else if (!ReplicateVoiceToNetwork)
+	{
+		// Written in place into the free space of the ring. Both sides only move whole samples, so the spans always start on a sample
+		uint8* First;
+		uint8* Second;
+		uint32 FirstBytes;
+		uint32 SecondBytes;
+		VoiceCaptureRingBuffer.PeekWrite(First, FirstBytes, Second, SecondBytes);
+		OutFirst = (int16*)First;
+		OutFirstFrames = int32(FirstBytes / sizeof(int16));
+		OutSecond = (int16*)Second;
+		OutSecondFrames = int32(SecondBytes / sizeof(int16));
 	}
 	else
 	{
-		OutConverted = (TArray<int16>)Int16Buffer.GetArrayView();
+		VoiceData.SetNumUninitialized(NumOutputFrames * int32(sizeof(int16)));
+		OutFirst = (int16*)VoiceData.GetData();
+		OutFirstFrames = NumOutputFrames;
 	}
-	//OutConverted = (TArray<int16>)Int16Buffer.GetArrayView();
-	//OutConverted = TArray<int16>(Int16Buffer.GetData(), Int16Buffer.GetNumSamples());
 
-	//UE_LOG(ConvaiPlayerLog, Log, TEXT("Int16Buffer.GetNumSamples() %i, NumChannels %f,  SampleRate %f"), Int16Buffer.GetNumSamples(), NumChannels, SampleRate);
-	//UE_LOG(ConvaiPlayerLog, Log, TEXT("OutConverted.Num() %i"), OutConverted.Num());
+	int32 NumWritten = 0;
+	auto Resample = [&](const float* In, int32 NumFrames)
+	{
+		if (NumWritten < OutFirstFrames)
+		{
+			NumWritten += VoiceCaptureResampler.Process(In, NumFrames, NumChannels, OutFirst + NumWritten, OutFirstFrames - NumWritten);
+			if (NumWritten < OutFirstFrames)
+			{
+				return;
+			}
 
-	if (IsRecording)
+			// The input went into the filter, what is still owed continues in the second span
+			In = nullptr;
+			NumFrames = 0;
+		}
+
+		const int32 SecondWritten = NumWritten - OutFirstFrames;
+		NumWritten += VoiceCaptureResampler.Process(In, NumFrames, NumChannels, OutSecond + SecondWritten, OutSecondFrames - SecondWritten);
+	};
+
+	// Read in place over both spans of the capture ring, only a frame its wrap around splits goes through a copy
+	const int32 CapturedFirstFrames = CapturedFirstSamples / NumChannels;
+	const int32 SplitSamples = CapturedFirstSamples - CapturedFirstFrames * NumChannels;
+	Resample(CapturedFirst, CapturedFirstFrames);
+	if (SplitSamples > 0)
 	{
-		VoiceCaptureBuffer.Append((uint8*)OutConverted.GetData(), OutConverted.Num() * sizeof(int16));
-		return;
+		TArray<float, TInlineAllocator<8>> SplitFrame;
+		SplitFrame.Append(CapturedFirst + CapturedFirstFrames * NumChannels, SplitSamples);
+		SplitFrame.Append(CapturedSecond, NumChannels - SplitSamples);
+		Resample(SplitFrame.GetData(), 1);
 	}
+	const int32 SecondOffset = SplitSamples > 0 ? NumChannels - SplitSamples : 0;
+	Resample(CapturedSecond + SecondOffset, (CapturedSecondSamples - SecondOffset) / NumChannels);
+
+	SubmixCapture->Commit(NumCapturedSamples);
 
-	if (!ReplicateVoiceToNetwork)
+	if (IsRecording)
+	{
+		VoiceCaptureBuffer.SetNum(RecordingStart + NumWritten * int32(sizeof(int16)), false);
+	}
+	else if (!ReplicateVoiceToNetwork)
 	{
-		if (IsStreaming)
-			VoiceCaptureRingBuffer.Enqueue((uint8*)OutConverted.GetData(), OutConverted.Num() * sizeof(int16));
+		VoiceCaptureRingBuffer.CommitWrite(uint32(NumWritten * sizeof(int16)));
+
+		// What did not fit is dropped like the ring drops new data, so the next tick does not start out behind
+		VoiceCaptureRingBuffer.CountDropped(uint32(VoiceCaptureResampler.DiscardOutput() * sizeof(int16)));
 
 		onDataReceived_Delegate.ExecuteIfBound();
 	}
 	else
 	{
 		// Stream voice data
-		AddPCMDataToSend(TArray<uint8>((uint8*)OutConverted.GetData(), OutConverted.Num() * sizeof(int16)), false, ConvaiConstants::VoiceCaptureSampleRate, 1);
+		VoiceData.SetNum(NumWritten * int32(sizeof(int16)), false);
+		AddPCMDataToSend(MoveTemp(VoiceData), false, ConvaiConstants::VoiceCaptureSampleRate, 1);
 	}
 }
 
@@ -544,9 +610,7 @@ void UConvaiPlayerComponent::StartRecording()
 	UE_LOG(ConvaiPlayerLog, Log, TEXT("Started Recording "));
 	StartAudioCaptureComponent();    //Start the AudioCaptureComponent
 
-	// reset audio buffers
-	StartVoiceChunkCapture();
-	StopVoiceChunkCapture();
+	StartVoiceCapture();
 	VoiceCaptureBuffer.Empty(ConvaiConstants::VoiceCaptureBufferSize);
 
 	IsRecording = true;
@@ -561,7 +625,7 @@ USoundWave* UConvaiPlayerComponent::FinishRecording()
 	}
 
 	UE_LOG(ConvaiPlayerLog, Log, TEXT("Stopped Recording "));
-	StopVoiceChunkCapture();
+	StopVoiceCapture();
 
 	USoundWave* OutSoundWave = UConvaiUtils::PCMDataToSoundWav(VoiceCaptureBuffer, 1, ConvaiConstants::VoiceCaptureSampleRate);
 	StopAudioCaptureComponent();  //stop the AudioCaptureComponent
@@ -619,9 +683,7 @@ void UConvaiPlayerComponent::StartTalking(
 
 	StartAudioCaptureComponent();    //Start the AudioCaptureComponent
 
-	// reset audio buffers
-	StartVoiceChunkCapture();
-	StopVoiceChunkCapture();
+	StartVoiceCapture();
 
 	IsStreaming = true;
 	VoiceCaptureRingBuffer.Empty();
@@ -645,6 +707,7 @@ void UConvaiPlayerComponent::StartTalking(
 	{
 		bool UseOverrideAuthKey = false;
 		ConvaiChatbotComponent->StartGetResponseStream(this, FString(""), Environment, GenerateActions, VoiceResponse, false, UseOverrideAuthKey, FString(""), FString(""), Token);
+		TalkingToChatbot = ConvaiChatbotComponent;
 	}
 }
 
@@ -656,7 +719,7 @@ void UConvaiPlayerComponent::FinishTalking()
 		return;
 	}
 
-	StopVoiceChunkCapture();
+	StopVoiceCapture();
 	StopAudioCaptureComponent();  //stop the AudioCaptureComponent
 	IsStreaming = false;
 
@@ -668,6 +731,7 @@ void UConvaiPlayerComponent::FinishTalking()
 	{
 		// Invalidate the token by generating a new one
 		GenerateNewToken();
+		MarkChatbotFinishTalking();
 	}
 
 	UE_LOG(ConvaiPlayerLog, Log, TEXT("Finished Talking"));
@@ -713,6 +777,7 @@ void UConvaiPlayerComponent::StartTalkingServer_Implementation(
 		}
 		bool UseOverrideAuthKey = !UseServerAPI_Key;
 		ConvaiChatbotComponent->StartGetResponseStream(this, FString(""), Environment, GenerateActions, VoiceResponse, true, UseOverrideAuthKey, ClientAuthKey, AuthHeader, Token);
+		TalkingToChatbot = ConvaiChatbotComponent;
 	}
 }
 
@@ -720,6 +785,17 @@ void UConvaiPlayerComponent::FinishTalkingServer_Implementation()
 {
 	// Invalidate the token by generating a new one
 	GenerateNewToken();
+	MarkChatbotFinishTalking();
+}
+
+void UConvaiPlayerComponent::MarkChatbotFinishTalking()
+{
+	// Stamped when the player stops, what is still queued of the mic audio drains after this and is part of the measured latency
+	if (UConvaiChatbotComponent* Chatbot = TalkingToChatbot.Get())
+	{
+		Chatbot->MarkPlayerFinishedTalking(this);
+	}
+	TalkingToChatbot.Reset();
 }
 
 void UConvaiPlayerComponent::SendText(UConvaiChatbotComponent* ConvaiChatbotComponent, FString Text, UConvaiEnvironment* Environment, bool GenerateActions, bool VoiceResponse, bool RunOnServer, bool UseServerAPI_Key)
@@ -858,14 +934,35 @@ void UConvaiPlayerComponent::BeginPlay()
 	}
 }
 
+void UConvaiPlayerComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	UnregisterSubmixCapture();
+	IsInit = false;
+
+	Super::EndPlay(EndPlayReason);
+}
+
 bool UConvaiPlayerComponent::ConsumeStreamingBuffer(TArray<uint8>& Buffer)
 {
-	int Datalength = VoiceCaptureRingBuffer.RingDataUsage();
-	if (Datalength <= 0)
+	const uint8* FirstData;
+	const uint8* SecondData;
+	uint32 FirstLength;
+	uint32 SecondLength;
+	const uint32 Datalength = VoiceCaptureRingBuffer.PeekRead(FirstData, FirstLength, SecondData, SecondLength);
+	if (Datalength == 0)
 		return false;
 
-	Buffer.SetNumUninitialized(Datalength, false);
-	VoiceCaptureRingBuffer.Dequeue(Buffer.GetData(), Datalength);
+	// Appended straight from the ring storage, the caller's buffer keeps its allocation
+	Buffer.Append(FirstData, FirstLength);
+	Buffer.Append(SecondData, SecondLength);
+	VoiceCaptureRingBuffer.Commit(Datalength);
+
+	const uint64 NumDropped = VoiceCaptureRingBuffer.GetNumDropped();
+	if (NumDropped != LastLoggedVoiceBytesDropped)
+	{
+		UE_LOG(ConvaiPlayerLog, Warning, TEXT("ConsumeStreamingBuffer: Voice capture buffer was full, %llu bytes of mic data were dropped"), NumDropped - LastLoggedVoiceBytesDropped);
+		LastLoggedVoiceBytesDropped = NumDropped;
+	}
 
 	return true;
 }
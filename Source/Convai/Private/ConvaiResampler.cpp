@@ -0,0 +1,474 @@
+// Copyright 2022 Convai Inc. All Rights Reserved.
+
+#include "ConvaiResampler.h"
+#include "Runtime/Launch/Resources/Version.h"
+#include "Misc/ScopeLock.h"
+#include <type_traits>
+
+DEFINE_LOG_CATEGORY(ConvaiResamplerLog);
+
+/** Polyphase coefficients for one ratio, phase P of NumTaps taps starts at Coefficients[P * NumTaps] */
+struct FConvaiResamplerTable
+{
+	// Output rate over input rate as a reduced fraction, the input is stepped Decimation phases at a time through Interpolation phases
+	int32 Interpolation = 1;
+	int32 Decimation = 1;
+	int32 NumTaps = 1;
+
+	TArray<float> Coefficients;
+};
+
+namespace
+{
+	// Taps per phase when not downsampling, scaled up with the downsampling factor so the transition band keeps its width
+	constexpr int32 BaseTaps = 16;
+	constexpr int32 MaxTaps = 128;
+
+	// Ratios needing more phases than this, e.g. odd device rates, are rounded to the nearest ratio with this many phases
+	constexpr int32 MaxPhases = 1024;
+
+	// Cutoff as a fraction of the lower Nyquist frequency, and the Kaiser window shape, together about 70 dB of stop band rejection
+	constexpr double Rolloff = 0.9;
+	constexpr double KaiserBeta = 7.0;
+
+	// Mic and voice conversions whose tables are built before the first stream needs them
+	const TPair<int32, int32> CommonRates[] = {
+		{ 48000, 16000 },
+		{ 44100, 16000 },
+		{ 48000, 24000 },
+	};
+
+#if ENGINE_MAJOR_VERSION >= 5
+	typedef VectorRegister4Float FConvaiVectorRegister;
+	FORCEINLINE FConvaiVectorRegister ConvaiVectorZero() { return VectorZeroFloat(); }
+#else
+	typedef VectorRegister FConvaiVectorRegister;
+	FORCEINLINE FConvaiVectorRegister ConvaiVectorZero() { return VectorZero(); }
+#endif
+
+	int32 GreatestCommonDivisor(int32 A, int32 B)
+	{
+		while (B != 0)
+		{
+			const int32 Remainder = A % B;
+			A = B;
+			B = Remainder;
+		}
+		return A;
+	}
+
+	// Zeroth order modified Bessel function of the first kind, for the Kaiser window
+	double BesselI0(double X)
+	{
+		double Sum = 1.0;
+		double Term = 1.0;
+		for (int32 K = 1; K < 32; ++K)
+		{
+			Term *= (X / (2.0 * K)) * (X / (2.0 * K));
+			Sum += Term;
+			if (Term < Sum * 1e-12)
+			{
+				break;
+			}
+		}
+		return Sum;
+	}
+
+	TSharedPtr<const FConvaiResamplerTable, ESPMode::ThreadSafe> BuildTable(int32 Interpolation, int32 Decimation)
+	{
+		TSharedPtr<FConvaiResamplerTable, ESPMode::ThreadSafe> Table = MakeShared<FConvaiResamplerTable, ESPMode::ThreadSafe>();
+		Table->Interpolation = Interpolation;
+		Table->Decimation = Decimation;
+
+		if (Interpolation == Decimation)
+		{
+			Table->Coefficients.Add(1.0f);
+			return Table;
+		}
+
+		const double DownsamplingFactor = FMath::Max(1.0, double(Decimation) / Interpolation);
+		const int32 NumTaps = FMath::Min(Align(FMath::CeilToInt(BaseTaps * DownsamplingFactor), 4), MaxTaps);
+		Table->NumTaps = NumTaps;
+
+		// Prototype filter at the interpolated rate, its time axis in input samples
+		const int32 Length = NumTaps * Interpolation;
+		const double Cutoff = 0.5 * Rolloff / DownsamplingFactor;
+		const double Center = (Length - 1) * 0.5;
+		const double WindowScale = 1.0 / BesselI0(KaiserBeta);
+
+		TArray<double> Prototype;
+		Prototype.SetNumUninitialized(Length);
+		for (int32 Index = 0; Index < Length; ++Index)
+		{
+			const double Time = (Index - Center) / Interpolation;
+			const double X = 2.0 * Cutoff * Time;
+			const double Sinc = FMath::Abs(X) < 1e-9 ? 1.0 : FMath::Sin(PI * X) / (PI * X);
+			const double WindowPosition = Length > 1 ? 2.0 * Index / (Length - 1) - 1.0 : 0.0;
+			const double Window = BesselI0(KaiserBeta * FMath::Sqrt(FMath::Max(0.0, 1.0 - WindowPosition * WindowPosition))) * WindowScale;
+			Prototype[Index] = 2.0 * Cutoff * Sinc * Window;
+		}
+
+		// Each phase reversed so it lines up with the input oldest sample first, and normalized to unity gain at DC
+		Table->Coefficients.SetNumUninitialized(NumTaps * Interpolation);
+		for (int32 PhaseIndex = 0; PhaseIndex < Interpolation; ++PhaseIndex)
+		{
+			float* PhaseCoefficients = Table->Coefficients.GetData() + PhaseIndex * NumTaps;
+
+			double Sum = 0;
+			for (int32 Tap = 0; Tap < NumTaps; ++Tap)
+			{
+				Sum += Prototype[PhaseIndex + (NumTaps - 1 - Tap) * Interpolation];
+			}
+
+			const double Gain = FMath::Abs(Sum) > 1e-9 ? 1.0 / Sum : 1.0;
+			for (int32 Tap = 0; Tap < NumTaps; ++Tap)
+			{
+				PhaseCoefficients[Tap] = float(Prototype[PhaseIndex + (NumTaps - 1 - Tap) * Interpolation] * Gain);
+			}
+		}
+
+		return Table;
+	}
+
+	void ReduceRatio(int32 InputSampleRate, int32 OutputSampleRate, int32& OutInterpolation, int32& OutDecimation)
+	{
+		const int32 Divisor = GreatestCommonDivisor(InputSampleRate, OutputSampleRate);
+		OutInterpolation = OutputSampleRate / Divisor;
+		OutDecimation = InputSampleRate / Divisor;
+
+		if (OutInterpolation > MaxPhases)
+		{
+			OutDecimation = FMath::Max(1, FMath::RoundToInt(double(OutDecimation) * MaxPhases / OutInterpolation));
+			OutInterpolation = MaxPhases;
+			UE_LOG(ConvaiResamplerLog, Log, TEXT("Resampling %d Hz to %d Hz with the nearest ratio of %d phases, %d/%d"), InputSampleRate, OutputSampleRate, MaxPhases, OutInterpolation, OutDecimation);
+		}
+	}
+
+	FCriticalSection TableCacheCriticalSection;
+	TMap<uint64, TSharedPtr<const FConvaiResamplerTable, ESPMode::ThreadSafe>> TableCache;
+
+	TSharedPtr<const FConvaiResamplerTable, ESPMode::ThreadSafe> FindOrBuildTable(int32 InputSampleRate, int32 OutputSampleRate)
+	{
+		FScopeLock Lock(&TableCacheCriticalSection);
+
+		auto FindOrAdd = [](int32 InInputSampleRate, int32 InOutputSampleRate)
+		{
+			int32 Interpolation;
+			int32 Decimation;
+			ReduceRatio(InInputSampleRate, InOutputSampleRate, Interpolation, Decimation);
+
+			const uint64 Key = (uint64(uint32(Interpolation)) << 32) | uint32(Decimation);
+			TSharedPtr<const FConvaiResamplerTable, ESPMode::ThreadSafe>& Table = TableCache.FindOrAdd(Key);
+			if (!Table.IsValid())
+			{
+				Table = BuildTable(Interpolation, Decimation);
+			}
+			return Table;
+		};
+
+		if (TableCache.Num() == 0)
+		{
+			for (const TPair<int32, int32>& Rates : CommonRates)
+			{
+				FindOrAdd(Rates.Key, Rates.Value);
+			}
+		}
+
+		return FindOrAdd(InputSampleRate, OutputSampleRate);
+	}
+
+	FORCEINLINE float DotProduct(const float* RESTRICT A, const float* RESTRICT B, int32 Num)
+	{
+		// Two accumulators hide the latency of the multiply-add
+		FConvaiVectorRegister Sum0 = ConvaiVectorZero();
+		FConvaiVectorRegister Sum1 = ConvaiVectorZero();
+
+		int32 Index = 0;
+		for (; Index + 8 <= Num; Index += 8)
+		{
+			Sum0 = VectorMultiplyAdd(VectorLoad(A + Index), VectorLoad(B + Index), Sum0);
+			Sum1 = VectorMultiplyAdd(VectorLoad(A + Index + 4), VectorLoad(B + Index + 4), Sum1);
+		}
+		for (; Index + 4 <= Num; Index += 4)
+		{
+			Sum0 = VectorMultiplyAdd(VectorLoad(A + Index), VectorLoad(B + Index), Sum0);
+		}
+
+		alignas(16) float Lanes[4];
+		VectorStoreAligned(VectorAdd(Sum0, Sum1), Lanes);
+		float Result = (Lanes[0] + Lanes[1]) + (Lanes[2] + Lanes[3]);
+
+		for (; Index < Num; ++Index)
+		{
+			Result += A[Index] * B[Index];
+		}
+		return Result;
+	}
+
+	// Downmixes stereo frames four at a time, split into left and right lanes and summed, returns the number of frames written
+	FORCEINLINE int32 DownmixStereoVectorized(const float* RESTRICT In, float* RESTRICT Mono, int32 NumFrames, float Scale)
+	{
+		const FConvaiVectorRegister ScaleVector = VectorSetFloat1(Scale);
+		int32 Frame = 0;
+		for (; Frame + 4 <= NumFrames; Frame += 4)
+		{
+			const FConvaiVectorRegister First = VectorLoad(In + 2 * Frame);
+			const FConvaiVectorRegister Second = VectorLoad(In + 2 * Frame + 4);
+			const FConvaiVectorRegister Left = VectorShuffle(First, Second, 0, 2, 0, 2);
+			const FConvaiVectorRegister Right = VectorShuffle(First, Second, 1, 3, 1, 3);
+			VectorStore(VectorMultiply(VectorAdd(Left, Right), ScaleVector), Mono + Frame);
+		}
+		return Frame;
+	}
+
+	// PCM16 is converted frame by frame
+	FORCEINLINE int32 DownmixStereoVectorized(const int16* RESTRICT In, float* RESTRICT Mono, int32 NumFrames, float Scale)
+	{
+		return 0;
+	}
+
+	FORCEINLINE int16 FloatToInt16(float Sample)
+	{
+		return int16(FMath::Clamp(FMath::RoundToInt(Sample * 32768.0f), -32768, 32767));
+	}
+}
+
+FConvaiResampler::FConvaiResampler(int32 InInputSampleRate, int32 InOutputSampleRate)
+{
+	Init(InInputSampleRate, InOutputSampleRate);
+}
+
+void FConvaiResampler::Init(int32 InInputSampleRate, int32 InOutputSampleRate)
+{
+	if (InInputSampleRate <= 0 || InOutputSampleRate <= 0)
+	{
+		UE_LOG(ConvaiResamplerLog, Warning, TEXT("Init: Invalid sample rates %d Hz to %d Hz"), InInputSampleRate, InOutputSampleRate);
+		InputSampleRate = 0;
+		OutputSampleRate = 0;
+		Table.Reset();
+		return;
+	}
+
+	if (!Table.IsValid() || InInputSampleRate != InputSampleRate || InOutputSampleRate != OutputSampleRate)
+	{
+		InputSampleRate = InInputSampleRate;
+		OutputSampleRate = InOutputSampleRate;
+		Table = FindOrBuildTable(InputSampleRate, OutputSampleRate);
+	}
+
+	Reset();
+}
+
+void FConvaiResampler::Reset()
+{
+	// Start on silence, the first output lines up with the first input sample on its newest tap
+	Input.Reset();
+	Input.AddZeroed(Table.IsValid() ? Table->NumTaps - 1 : 0);
+	InputPosition = 0;
+	Phase = 0;
+}
+
+int32 FConvaiResampler::GetNumOutputFrames(int32 NumInputFrames) const
+{
+	if (!Table.IsValid())
+	{
+		return 0;
+	}
+
+	// Outputs are produced while the oldest tap plus NumTaps stays within the input, InputPosition + (Phase + N * Decimation) / Interpolation <= Last
+	const int64 Last = int64(Input.Num()) + FMath::Max(NumInputFrames, 0) - Table->NumTaps - InputPosition;
+	if (Last < 0)
+	{
+		return 0;
+	}
+
+	return int32(FMath::DivideAndRoundUp((Last + 1) * Table->Interpolation - Phase, int64(Table->Decimation)));
+}
+
+template<typename SampleType>
+void FConvaiResampler::AddInput(const SampleType* In, int32 NumFrames, int32 NumChannels)
+{
+	const float Scale = (std::is_same<SampleType, int16>::value ? 1.0f / 32768.0f : 1.0f) / NumChannels;
+
+	const int32 Start = Input.AddUninitialized(NumFrames);
+	float* RESTRICT Mono = Input.GetData() + Start;
+
+	if (NumChannels == 1)
+	{
+		for (int32 Frame = 0; Frame < NumFrames; ++Frame)
+		{
+			Mono[Frame] = In[Frame] * Scale;
+		}
+	}
+	else if (NumChannels == 2)
+	{
+		int32 Frame = DownmixStereoVectorized(In, Mono, NumFrames, Scale);
+		for (; Frame < NumFrames; ++Frame)
+		{
+			Mono[Frame] = (float(In[2 * Frame]) + float(In[2 * Frame + 1])) * Scale;
+		}
+	}
+	else
+	{
+		for (int32 Frame = 0; Frame < NumFrames; ++Frame)
+		{
+			float Sum = 0;
+			for (int32 Channel = 0; Channel < NumChannels; ++Channel)
+			{
+				Sum += In[Frame * NumChannels + Channel];
+			}
+			Mono[Frame] = Sum * Scale;
+		}
+	}
+}
+
+template<typename EmitType>
+int32 FConvaiResampler::Filter(int32 MaxOutputFrames, EmitType&& Emit)
+{
+	const int32 NumTaps = Table->NumTaps;
+	const int32 Interpolation = Table->Interpolation;
+	const int32 Decimation = Table->Decimation;
+	const float* Coefficients = Table->Coefficients.GetData();
+	const float* Samples = Input.GetData();
+	const int32 NumSamples = Input.Num();
+
+	int32 Produced = 0;
+	while (Produced < MaxOutputFrames && InputPosition + NumTaps <= NumSamples)
+	{
+		Emit(Produced++, DotProduct(Samples + InputPosition, Coefficients + Phase * NumTaps, NumTaps));
+
+		Phase += Decimation;
+		InputPosition += Phase / Interpolation;
+		Phase %= Interpolation;
+	}
+
+	// Only what the next outputs still reach stays as history, the position may have stepped past the end when downsampling
+	const int32 Consumed = FMath::Min(InputPosition, NumSamples);
+	if (Consumed > 0)
+	{
+		Input.RemoveAt(0, Consumed, false);
+		InputPosition -= Consumed;
+	}
+
+	return Produced;
+}
+
+int32 FConvaiResampler::Process(const float* In, int32 NumFrames, int32 NumChannels, float* Out, int32 MaxOutputFrames)
+{
+	if (!IsInit() || NumChannels <= 0 || (!Out && MaxOutputFrames > 0))
+	{
+		return 0;
+	}
+
+	if (In && NumFrames > 0)
+	{
+		AddInput(In, NumFrames, NumChannels);
+	}
+
+	return Filter(MaxOutputFrames, [Out](int32 Index, float Sample)
+	{
+		Out[Index] = Sample;
+	});
+}
+
+int32 FConvaiResampler::Process(const int16* In, int32 NumFrames, int32 NumChannels, int16* Out, int32 MaxOutputFrames)
+{
+	if (!IsInit() || NumChannels <= 0 || (!Out && MaxOutputFrames > 0))
+	{
+		return 0;
+	}
+
+	if (In && NumFrames > 0)
+	{
+		AddInput(In, NumFrames, NumChannels);
+	}
+
+	return Filter(MaxOutputFrames, [Out](int32 Index, float Sample)
+	{
+		Out[Index] = FloatToInt16(Sample);
+	});
+}
+
+int32 FConvaiResampler::Process(const float* In, int32 NumFrames, int32 NumChannels, int16* Out, int32 MaxOutputFrames)
+{
+	if (!IsInit() || NumChannels <= 0 || (!Out && MaxOutputFrames > 0))
+	{
+		return 0;
+	}
+
+	if (In && NumFrames > 0)
+	{
+		AddInput(In, NumFrames, NumChannels);
+	}
+
+	return Filter(MaxOutputFrames, [Out](int32 Index, float Sample)
+	{
+		Out[Index] = FloatToInt16(Sample);
+	});
+}
+
+int32 FConvaiResampler::Process(const int16* In, int32 NumFrames, int32 NumChannels, float* Out, int32 MaxOutputFrames)
+{
+	if (!IsInit() || NumChannels <= 0 || (!Out && MaxOutputFrames > 0))
+	{
+		return 0;
+	}
+
+	if (In && NumFrames > 0)
+	{
+		AddInput(In, NumFrames, NumChannels);
+	}
+
+	return Filter(MaxOutputFrames, [Out](int32 Index, float Sample)
+	{
+		Out[Index] = Sample;
+	});
+}
+
+int32 FConvaiResampler::DiscardOutput()
+{
+	if (!IsInit())
+	{
+		return 0;
+	}
+
+	const int32 NumDiscarded = GetNumOutputFrames(0);
+	const int64 Steps = int64(Phase) + int64(NumDiscarded) * Table->Decimation;
+	InputPosition += int32(Steps / Table->Interpolation);
+	Phase = int32(Steps % Table->Interpolation);
+
+	const int32 Consumed = FMath::Min(InputPosition, Input.Num());
+	Input.RemoveAt(0, Consumed, false);
+	InputPosition -= Consumed;
+
+	return NumDiscarded;
+}
+
+void FConvaiResampler::Process(const int16* In, int32 NumFrames, int32 NumChannels, TArray<int16>& OutSamples)
+{
+	OutSamples.SetNumUninitialized(GetNumOutputFrames(NumFrames), false);
+	const int32 NumOutput = Process(In, NumFrames, NumChannels, OutSamples.GetData(), OutSamples.Num());
+	OutSamples.SetNum(NumOutput, false);
+}
+
+void FConvaiResampler::Flush(TArray<int16>& OutSamples)
+{
+	OutSamples.Reset();
+	if (!IsInit())
+	{
+		return;
+	}
+
+	// The outputs line up with the middle tap, half a filter of silence brings the last input sample out
+	Input.AddZeroed(Table->NumTaps / 2);
+
+	OutSamples.SetNumUninitialized(GetNumOutputFrames(0), false);
+	int16* Out = OutSamples.GetData();
+	const int32 NumOutput = Filter(OutSamples.Num(), [Out](int32 Index, float Sample)
+	{
+		Out[Index] = FloatToInt16(Sample);
+	});
+	OutSamples.SetNum(NumOutput, false);
+
+	Reset();
+}
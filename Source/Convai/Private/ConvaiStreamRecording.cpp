@@ -0,0 +1,218 @@
+// Copyright 2022 Convai Inc. All Rights Reserved.
+
+#include "ConvaiStreamRecording.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Misc/ScopeLock.h"
+#include "Serialization/Archive.h"
+
+THIRD_PARTY_INCLUDES_START
+#include <google/protobuf/message_lite.h>
+THIRD_PARTY_INCLUDES_END
+
+DEFINE_LOG_CATEGORY(ConvaiStreamRecordingLog);
+
+namespace
+{
+	const uint8 RecordingMagic[4] = { 'C', 'V', 'R', 'S' };
+	constexpr uint32 RecordingVersion = 1;
+	constexpr int32 RecordingHeaderSize = 8;
+	constexpr int32 RecordHeaderSize = 9;
+
+	// Captures kept in memory, the least recently loaded is dropped first
+	constexpr int32 MaxCachedReplays = 4;
+
+	TAutoConsoleVariable<FString> CVarRecordDirectory(
+		TEXT("convai.GetResponse.RecordDirectory"),
+		TEXT(""),
+		TEXT("When set, every GetResponse stream writes its requests and responses to a capture file in this directory."),
+		ECVF_Default);
+
+	TAutoConsoleVariable<FString> CVarReplayFile(
+		TEXT("convai.GetResponse.ReplayFile"),
+		TEXT(""),
+		TEXT("When set, GetResponse streams play back the responses of this capture file instead of connecting to the server."),
+		ECVF_Default);
+
+	TAutoConsoleVariable<float> CVarReplaySpeed(
+		TEXT("convai.GetResponse.ReplaySpeed"),
+		1.f,
+		TEXT("Playback rate of replayed GetResponse streams, 1 keeps the recorded timing and 0 replays as fast as possible."),
+		ECVF_Default);
+
+	void WriteUInt32(uint8* Out, uint32 Value)
+	{
+		Out[0] = uint8(Value);
+		Out[1] = uint8(Value >> 8);
+		Out[2] = uint8(Value >> 16);
+		Out[3] = uint8(Value >> 24);
+	}
+
+	uint32 ReadUInt32(const uint8* In)
+	{
+		return uint32(In[0]) | (uint32(In[1]) << 8) | (uint32(In[2]) << 16) | (uint32(In[3]) << 24);
+	}
+
+	FCriticalSection ReplayCacheSection;
+
+	// Most recently used last
+	TArray<TPair<FString, TSharedPtr<const FConvaiStreamReplay, ESPMode::ThreadSafe>>> ReplayCache;
+}
+
+FString FConvaiStreamRecorder::GetRecordDirectory()
+{
+	return CVarRecordDirectory.GetValueOnAnyThread();
+}
+
+TUniquePtr<FConvaiStreamRecorder> FConvaiStreamRecorder::Create(const FString& FilePath)
+{
+	FArchive* Writer = IFileManager::Get().CreateFileWriter(*FilePath, FILEWRITE_EvenIfReadOnly);
+	if (!Writer)
+	{
+		UE_LOG(ConvaiStreamRecordingLog, Warning, TEXT("Create: Could not create the capture file %s"), *FilePath);
+		return nullptr;
+	}
+
+	uint8 Header[RecordingHeaderSize];
+	FMemory::Memcpy(Header, RecordingMagic, sizeof(RecordingMagic));
+	WriteUInt32(Header + 4, RecordingVersion);
+	Writer->Serialize(Header, sizeof(Header));
+
+	return TUniquePtr<FConvaiStreamRecorder>(new FConvaiStreamRecorder(Writer, FilePath));
+}
+
+FConvaiStreamRecorder::FConvaiStreamRecorder(FArchive* InWriter, const FString& InFilePath)
+	: Writer(InWriter)
+	, FilePath(InFilePath)
+	, LastRecordTime(FPlatformTime::Seconds())
+{
+}
+
+FConvaiStreamRecorder::~FConvaiStreamRecorder()
+{
+	RecordFinish(-1);
+}
+
+void FConvaiStreamRecorder::Record(EConvaiStreamRecordType Type, const google::protobuf::MessageLite* Message)
+{
+	FScopeLock Lock(&CriticalSection);
+	if (!Writer)
+	{
+		return;
+	}
+
+	SerializeBuffer.clear();
+	if (Message)
+	{
+		Message->SerializeToString(&SerializeBuffer);
+	}
+	WriteRecord(Type, reinterpret_cast<const uint8*>(SerializeBuffer.data()), SerializeBuffer.size());
+}
+
+void FConvaiStreamRecorder::RecordFinish(int32 StatusCode)
+{
+	FScopeLock Lock(&CriticalSection);
+	if (!Writer)
+	{
+		return;
+	}
+
+	uint8 Payload[4];
+	WriteUInt32(Payload, uint32(StatusCode));
+	WriteRecord(EConvaiStreamRecordType::Finish, Payload, sizeof(Payload));
+
+	Writer->Close();
+	Writer.Reset();
+
+	UE_LOG(ConvaiStreamRecordingLog, Log, TEXT("Wrote %d records to %s"), NumRecords, *FilePath);
+}
+
+void FConvaiStreamRecorder::WriteRecord(EConvaiStreamRecordType Type, const uint8* Payload, uint32 Length)
+{
+	const double Now = FPlatformTime::Seconds();
+	const uint32 DeltaUs = uint32(FMath::Clamp((Now - LastRecordTime) * 1000000.0, 0.0, double(MAX_uint32)));
+	LastRecordTime = Now;
+
+	uint8 Header[RecordHeaderSize];
+	Header[0] = uint8(Type);
+	WriteUInt32(Header + 1, DeltaUs);
+	WriteUInt32(Header + 5, Length);
+	Writer->Serialize(Header, sizeof(Header));
+	if (Length > 0)
+	{
+		Writer->Serialize(const_cast<uint8*>(Payload), Length);
+	}
+	NumRecords++;
+}
+
+FString FConvaiStreamReplay::GetReplayFile()
+{
+	return CVarReplayFile.GetValueOnAnyThread();
+}
+
+float FConvaiStreamReplay::GetReplaySpeed()
+{
+	return FMath::Max(CVarReplaySpeed.GetValueOnAnyThread(), 0.f);
+}
+
+TSharedPtr<const FConvaiStreamReplay, ESPMode::ThreadSafe> FConvaiStreamReplay::Load(const FString& FilePath)
+{
+	FScopeLock Lock(&ReplayCacheSection);
+	const int32 CachedIndex = ReplayCache.IndexOfByPredicate([&FilePath](const TPair<FString, TSharedPtr<const FConvaiStreamReplay, ESPMode::ThreadSafe>>& Entry) { return Entry.Key == FilePath; });
+	if (CachedIndex != INDEX_NONE)
+	{
+		TPair<FString, TSharedPtr<const FConvaiStreamReplay, ESPMode::ThreadSafe>> Entry = ReplayCache[CachedIndex];
+		ReplayCache.RemoveAt(CachedIndex);
+		ReplayCache.Add(Entry);
+		return Entry.Value;
+	}
+
+	TSharedPtr<FConvaiStreamReplay, ESPMode::ThreadSafe> Replay = MakeShared<FConvaiStreamReplay, ESPMode::ThreadSafe>();
+	if (!FFileHelper::LoadFileToArray(Replay->Data, *FilePath))
+	{
+		UE_LOG(ConvaiStreamRecordingLog, Warning, TEXT("Load: Could not read the capture file %s"), *FilePath);
+		return nullptr;
+	}
+
+	const TArray<uint8>& Data = Replay->Data;
+	if (Data.Num() < RecordingHeaderSize || FMemory::Memcmp(Data.GetData(), RecordingMagic, sizeof(RecordingMagic)) != 0 || ReadUInt32(Data.GetData() + 4) != RecordingVersion)
+	{
+		UE_LOG(ConvaiStreamRecordingLog, Warning, TEXT("Load: %s is not a supported capture file"), *FilePath);
+		return nullptr;
+	}
+
+	double Time = 0;
+	int32 Offset = RecordingHeaderSize;
+	while ((int64)Offset + RecordHeaderSize <= Data.Num())
+	{
+		FConvaiStreamRecord Record;
+		Record.Type = EConvaiStreamRecordType(Data[Offset]);
+		Time += ReadUInt32(Data.GetData() + Offset + 1) / 1000000.0;
+		Record.Time = Time;
+		Record.Length = int32(ReadUInt32(Data.GetData() + Offset + 5));
+		Record.Offset = Offset + RecordHeaderSize;
+
+		// Lengths come from the file, summed in 64 bits so a corrupt one cannot wrap around past the check
+		if (Record.Offset < 0 || Record.Length < 0 || (int64)Record.Offset + Record.Length > Data.Num())
+		{
+			UE_LOG(ConvaiStreamRecordingLog, Warning, TEXT("Load: %s is truncated after %d records"), *FilePath, Replay->Records.Num());
+			break;
+		}
+
+		Replay->Records.Add(Record);
+		Offset = Record.Offset + Record.Length;
+	}
+
+	UE_LOG(ConvaiStreamRecordingLog, Log, TEXT("Loaded %d records spanning %.2f secs from %s"), Replay->Records.Num(), Time, *FilePath);
+
+	// Streams still replaying an evicted capture keep their own reference
+	if (ReplayCache.Num() >= MaxCachedReplays)
+	{
+		ReplayCache.RemoveAt(0);
+	}
+	ReplayCache.Emplace(FilePath, Replay);
+	return Replay;
+}
@@ -0,0 +1,132 @@
+// Copyright 2022 Convai Inc. All Rights Reserved.
+
+#include "ConvaiSubmixCapture.h"
+#include "Sound/SoundSubmix.h"
+
+DEFINE_LOG_CATEGORY(ConvaiSubmixCaptureLog);
+
+namespace
+{
+	// One second of 48 kHz stereo, the game thread drains the ring every tick
+	constexpr uint32 RingCapacitySamples = 48000 * 2;
+}
+
+FConvaiSubmixCapture::FConvaiSubmixCapture()
+	: Ring(RingCapacitySamples)
+{
+}
+
+void FConvaiSubmixCapture::Register(const TSharedRef<FConvaiSubmixCapture, ESPMode::ThreadSafe>& Capture, FAudioDevice* AudioDevice, USoundSubmix* Submix)
+{
+	if (!AudioDevice || !Submix)
+	{
+		UE_LOG(ConvaiSubmixCaptureLog, Warning, TEXT("Register: Audio device or submix is not valid, the microphone will not be captured"));
+		return;
+	}
+
+#if ENGINE_MAJOR_VERSION == 5 && ENGINE_MINOR_VERSION >= 4
+	AudioDevice->RegisterSubmixBufferListener(Capture, *Submix);
+#else
+	AudioDevice->RegisterSubmixBufferListener(&Capture.Get(), Submix);
+#endif
+}
+
+void FConvaiSubmixCapture::Unregister(const TSharedRef<FConvaiSubmixCapture, ESPMode::ThreadSafe>& Capture, FAudioDevice* AudioDevice, USoundSubmix* Submix)
+{
+	Capture->SetCapturing(false);
+
+	if (!AudioDevice || !Submix)
+	{
+		return;
+	}
+
+#if ENGINE_MAJOR_VERSION == 5 && ENGINE_MINOR_VERSION >= 4
+	AudioDevice->UnregisterSubmixBufferListener(Capture, *Submix);
+#else
+	AudioDevice->UnregisterSubmixBufferListener(&Capture.Get(), Submix);
+
+	// The listener is removed by a command on the audio thread, this one runs after it and releases the last reference
+	FAudioThread::RunCommandOnAudioThread([KeepAlive = TSharedPtr<FConvaiSubmixCapture, ESPMode::ThreadSafe>(Capture)]() {});
+#endif
+}
+
+void FConvaiSubmixCapture::SetCapturing(bool bInCapturing)
+{
+	bCapturing.store(bInCapturing, std::memory_order_release);
+}
+
+void FConvaiSubmixCapture::Flush()
+{
+	Ring.Empty();
+}
+
+int32 FConvaiSubmixCapture::PeekRead(const float*& OutFirst, int32& OutFirstSamples, const float*& OutSecond, int32& OutSecondSamples, int32& OutNumChannels, int32& OutSampleRate)
+{
+	OutFirst = nullptr;
+	OutSecond = nullptr;
+	OutFirstSamples = 0;
+	OutSecondSamples = 0;
+
+	OutNumChannels = NumChannels.load(std::memory_order_acquire);
+	OutSampleRate = SampleRate.load(std::memory_order_acquire);
+	if (OutNumChannels <= 0 || OutSampleRate <= 0)
+	{
+		return 0;
+	}
+
+	uint32 FirstSamples;
+	uint32 SecondSamples;
+	const uint32 NumSamples = Ring.PeekRead(OutFirst, FirstSamples, OutSecond, SecondSamples) / OutNumChannels * OutNumChannels;
+
+	// Only complete frames, the spans are cut back to them
+	OutFirstSamples = int32(FMath::Min(FirstSamples, NumSamples));
+	OutSecondSamples = int32(NumSamples) - OutFirstSamples;
+	return int32(NumSamples);
+}
+
+void FConvaiSubmixCapture::Commit(int32 NumSamples)
+{
+	if (NumSamples > 0)
+	{
+		Ring.Commit(uint32(NumSamples));
+	}
+}
+
+FConvaiSubmixCaptureStats FConvaiSubmixCapture::GetStats() const
+{
+	FConvaiSubmixCaptureStats Stats;
+	Stats.SamplesCaptured = SamplesCaptured.load(std::memory_order_relaxed);
+	Stats.NumOverflows = NumOverflows.load(std::memory_order_relaxed);
+	Stats.SamplesDropped = SamplesDropped.load(std::memory_order_relaxed);
+	return Stats;
+}
+
+void FConvaiSubmixCapture::OnNewSubmixBuffer(const USoundSubmix* OwningSubmix, float* AudioData, int32 InNumSamples, int32 InNumChannels, const int32 InSampleRate, double AudioClock)
+{
+	if (!bCapturing.load(std::memory_order_acquire) || !AudioData || InNumSamples <= 0 || InNumChannels <= 0)
+	{
+		return;
+	}
+
+	// All or nothing, a partial buffer would leave the ring out of step with the channel layout
+	if (Ring.NumFree() < uint32(InNumSamples))
+	{
+		NumOverflows.fetch_add(1, std::memory_order_relaxed);
+		SamplesDropped.fetch_add(InNumSamples, std::memory_order_relaxed);
+		return;
+	}
+
+	NumChannels.store(InNumChannels, std::memory_order_release);
+	SampleRate.store(InSampleRate, std::memory_order_release);
+
+	Ring.Write(AudioData, uint32(InNumSamples));
+	SamplesCaptured.fetch_add(InNumSamples, std::memory_order_relaxed);
+}
+
+#if ENGINE_MAJOR_VERSION == 5 && ENGINE_MINOR_VERSION >= 4
+const FString& FConvaiSubmixCapture::GetListenerName() const
+{
+	static const FString ListenerName(TEXT("ConvaiSubmixCapture"));
+	return ListenerName;
+}
+#endif
@@ -194,21 +194,63 @@ namespace
 
 
 
-uint32 FgRPCClient::Run()
+FgRPCCompletionQueueWorker::FgRPCCompletionQueueWorker(int32 InQueueIndex)
+	: QueueIndex(InQueueIndex),
+	bIsRunning(false),
+	TagsProcessed(0),
+	TotalTagCycles(0),
+	MaxTagCycles(0)
+{
+}
+
+FgRPCCompletionQueueWorker::~FgRPCCompletionQueueWorker()
+{
+	Shutdown();
+
+	// Wait for the thread to drain the queue before the queue itself is destroyed
+	Thread.Reset();
+}
+
+void FgRPCCompletionQueueWorker::Start()
+{
+	bIsRunning = true;
+	Thread.Reset(FRunnableThread::Create(this, *FString::Printf(TEXT("gRPC_Stub_%d"), QueueIndex)));
+}
+
+void FgRPCCompletionQueueWorker::Shutdown()
+{
+	if (!bIsRunning)
+	{
+		return;
+	}
+
+	bIsRunning = false;
+	cq_.Shutdown();
+}
+
+uint32 FgRPCCompletionQueueWorker::Run()
 {
     void* got_tag;
     bool ok = false;
-	UE_LOG(ConvaiSubsystemLog, Log, TEXT("Start Run"));
+	UE_LOG(ConvaiSubsystemLog, Log, TEXT("Start Run | Completion Queue: %d"), QueueIndex);
 
-    // Block until the next result is available in the completion queue "cq
-	while (bIsRunning && cq_.Next(&got_tag, &ok)) {
+    // Block until the next result is available in the completion queue "cq"
+	// Keep draining after shutdown so that gRPC can release the pending tags
+	while (cq_.Next(&got_tag, &ok)) {
 		if (got_tag)
 		{
 			FgRPC_Delegate* gRPC_Delegate = static_cast<FgRPC_Delegate*>(got_tag);
 
 			if (bIsRunning)
 			{
+				const uint64 StartCycles = FPlatformTime::Cycles64();
 				gRPC_Delegate->ExecuteIfBound(ok);
+				const uint64 ElapsedCycles = FPlatformTime::Cycles64() - StartCycles;
+
+				TagsProcessed++;
+				TotalTagCycles += ElapsedCycles;
+				if (ElapsedCycles > MaxTagCycles)
+					MaxTagCycles = ElapsedCycles;
 			}
 			else
 			{
@@ -220,59 +262,201 @@ uint32 FgRPCClient::Run()
 			UE_LOG(ConvaiSubsystemLog, Log, TEXT("Bad got_tag"));
 		}
     }
-	UE_LOG(ConvaiSubsystemLog, Log, TEXT("End Run"));
+	UE_LOG(ConvaiSubsystemLog, Log, TEXT("End Run | Completion Queue: %d"), QueueIndex);
 
 	return 0;
 }
 
+CompletionQueue* FgRPCCompletionQueueWorker::GetCompletionQueue()
+{
+	return &cq_;
+}
+
+int32 FgRPCCompletionQueueWorker::GetAssignedStreams() const
+{
+	return AssignedStreams.GetValue();
+}
+
+void FgRPCCompletionQueueWorker::AddStream()
+{
+	AssignedStreams.Increment();
+}
+
+void FgRPCCompletionQueueWorker::RemoveStream()
+{
+	AssignedStreams.Decrement();
+}
+
+FConvaiCompletionQueueStats FgRPCCompletionQueueWorker::GetStats() const
+{
+	FConvaiCompletionQueueStats Stats;
+	Stats.QueueIndex = QueueIndex;
+	Stats.AssignedStreams = AssignedStreams.GetValue();
+	Stats.TagsProcessed = TagsProcessed;
+	Stats.AverageTagLatencyMs = Stats.TagsProcessed ? FPlatformTime::ToMilliseconds64(TotalTagCycles) / Stats.TagsProcessed : 0;
+	Stats.MaxTagLatencyMs = FPlatformTime::ToMilliseconds64(MaxTagCycles);
+	return Stats;
+}
+
 void FgRPCClient::StartStub()
 {
-	OnStateChangeDelegate = FgRPC_Delegate::CreateRaw(this, &FgRPCClient::OnStateChange);
-	CreateChannel();
+	CreateChannels();
+
+	UConvaiSettings* ConvaiSettings = Convai::Get().GetConvaiSettings();
+	const int32 NumCompletionQueues = FMath::Clamp(ConvaiSettings->NumCompletionQueues, 1, 16);
+	CompletionQueuePolicy = ConvaiSettings->CompletionQueuePolicy;
 
 	bIsRunning = true;
-	Thread.Reset(FRunnableThread::Create(this, TEXT("gRPC_Stub")));
+	for (int32 i = 0; i < NumCompletionQueues; i++)
+	{
+		Workers.Add(MakeUnique<FgRPCCompletionQueueWorker>(i));
+		Workers.Last()->Start();
+	}
+
+	UE_LOG(ConvaiSubsystemLog, Log, TEXT("gRPC started %d completion queue(s)"), NumCompletionQueues);
+
+	ConnectChannels();
 }
 
-void FgRPCClient::CreateChannel()
+void FgRPCClient::CreateChannels()
 {
-	UE_LOG(ConvaiSubsystemLog, Log, TEXT("gRPC Creating Channel..."));
-	grpc::ChannelArguments args;
-	args.SetMaxReceiveMessageSize(2147483647);
+	UConvaiSettings* ConvaiSettings = Convai::Get().GetConvaiSettings();
+	const int32 NumChannels = FMath::Clamp(ConvaiSettings->NumChannels, 1, 16);
+	const int32 KeepAliveTimeMs = FMath::Max(0, FMath::RoundToInt(ConvaiSettings->KeepAliveIntervalSecs * 1000));
+	UE_LOG(ConvaiSubsystemLog, Log, TEXT("gRPC Creating %d Channel(s)..."), NumChannels);
 
-	Channel = grpc::CreateCustomChannel(Target, Creds, args);
+	Channels.Reset(NumChannels);
+	for (int32 i = 0; i < NumChannels; i++)
+	{
+		grpc::ChannelArguments args;
+		args.SetMaxReceiveMessageSize(2147483647);
 
-	//Channel->NotifyOnStateChange(grpc_connectivity_state::GRPC_CHANNEL_CONNECTING, std::chrono::system_clock::time_point().max(), &cq_, (void*)&OnStateChangeDelegate);
+		// Channels that share identical arguments also share a subchannel (and its TCP connection),
+		// a local subchannel pool plus a distinct argument forces a dedicated connection per channel
+		args.SetInt(GRPC_ARG_USE_LOCAL_SUBCHANNEL_POOL, 1);
+		args.SetInt("convai.channel_index", i);
+
+		// Keep the connection alive between conversations instead of letting it go idle
+		args.SetInt(GRPC_ARG_CLIENT_IDLE_TIMEOUT_MS, MAX_int32);
+		if (KeepAliveTimeMs > 0)
+		{
+			args.SetInt(GRPC_ARG_KEEPALIVE_TIME_MS, KeepAliveTimeMs);
+			args.SetInt(GRPC_ARG_KEEPALIVE_TIMEOUT_MS, 10000);
+			args.SetInt(GRPC_ARG_KEEPALIVE_PERMIT_WITHOUT_CALLS, 1);
+			args.SetInt(GRPC_ARG_HTTP2_MAX_PINGS_WITHOUT_DATA, 0);
+		}
+
+		// Background reconnection backoff once a connection drops
+		args.SetInt(GRPC_ARG_INITIAL_RECONNECT_BACKOFF_MS, 500);
+		args.SetInt(GRPC_ARG_MIN_RECONNECT_BACKOFF_MS, 500);
+		args.SetInt(GRPC_ARG_MAX_RECONNECT_BACKOFF_MS, 30000);
+
+		TUniquePtr<FgRPCChannelSlot> Slot = MakeUnique<FgRPCChannelSlot>();
+		Slot->Channel = grpc::CreateCustomChannel(Target, Creds, args);
+		Slot->Stub = ConvaiService::NewStub(Slot->Channel);
+		Slot->OnStateChangeDelegate = FgRPC_Delegate::CreateRaw(this, &FgRPCClient::OnStateChange, i);
+		Channels.Add(MoveTemp(Slot));
+	}
 }
 
-void FgRPCClient::OnStateChange(bool ok)
+void FgRPCClient::ConnectChannels()
 {
-	grpc_connectivity_state state;
-	
-	if (Channel)
-		state = Channel->GetState(true);
-	else
-		state = grpc_connectivity_state::GRPC_CHANNEL_SHUTDOWN;
+	for (int32 i = 0; i < Channels.Num(); i++)
+	{
+		FgRPCChannelSlot& Slot = *Channels[i];
+		Slot.ConnectStartCycles = FPlatformTime::Cycles64();
+
+		// Passing true starts connecting right away instead of on the first call
+		grpc_connectivity_state state = Slot.Channel->GetState(true);
+		Slot.State = state;
+		WatchChannelState(i, state);
+	}
+}
+
+void FgRPCClient::WatchChannelState(int32 ChannelIndex, grpc_connectivity_state LastState)
+{
+	if (!bIsRunning || !Workers.Num() || !Channels.IsValidIndex(ChannelIndex))
+	{
+		return;
+	}
+
+	FgRPCChannelSlot& Slot = *Channels[ChannelIndex];
+	if (!Slot.Channel)
+	{
+		return;
+	}
+
+	// The watch only completes on a state change, Exit destroys the channels to complete the pending ones so the queues can drain.
+	// Channels are watched on different queues so their reconnect handling does not pile up on one thread
+	std::chrono::system_clock::time_point deadline = std::chrono::system_clock::time_point().max();
+	Slot.Channel->NotifyOnStateChange(LastState, deadline, Workers[ChannelIndex % Workers.Num()]->GetCompletionQueue(), (void*)&Slot.OnStateChangeDelegate);
+}
 
+void FgRPCClient::OnStateChange(bool ok, int32 ChannelIndex)
+{
+	// Exit destroys the channels under the same lock
+	FScopeLock Lock(&CriticalSection);
 
-	if (state == grpc_connectivity_state::GRPC_CHANNEL_SHUTDOWN)
+	// ok is false when the watch was cut short by the shutdown, there is nothing left to watch
+	if (!ok || !bIsRunning || !Channels.IsValidIndex(ChannelIndex) || !Channels[ChannelIndex]->Channel)
 	{
-		if (!bIsRunning)
+		return;
+	}
+
+	FgRPCChannelSlot& Slot = *Channels[ChannelIndex];
+	grpc_connectivity_state PreviousState = (grpc_connectivity_state)Slot.State.load();
+	grpc_connectivity_state state = Slot.Channel->GetState(false);
+
+	// The state may have changed and come back before we got to read it, keep watching from where it is now
+	if (state == PreviousState)
+	{
+		WatchChannelState(ChannelIndex, state);
+		return;
+	}
+
+	Slot.State = state;
+
+	switch (state)
+	{
+	case grpc_connectivity_state::GRPC_CHANNEL_READY:
+	{
+		const uint64 StartCycles = Slot.ConnectStartCycles.exchange(0);
+		if (StartCycles)
 		{
-			UE_LOG(ConvaiSubsystemLog, Warning, TEXT("gRPC channel state changed to %s... Attempting to reconnect"), *FString(grpc_connectivity_state_str[state]));
-			CreateChannel();
+			Slot.TimeToReadyMs = FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - StartCycles);
 		}
-		else
+		UE_LOG(ConvaiSubsystemLog, Log, TEXT("gRPC channel %d state changed to %s | Time to ready: %.1f ms"), ChannelIndex, *FString(grpc_connectivity_state_str[state]), Slot.TimeToReadyMs.load());
+		break;
+	}
+	case grpc_connectivity_state::GRPC_CHANNEL_IDLE:
+		// The connection was dropped (e.g. server GOAWAY), reconnect straight away so the next call does not pay for it
+		UE_LOG(ConvaiSubsystemLog, Log, TEXT("gRPC channel %d state changed to %s... Reconnecting"), ChannelIndex, *FString(grpc_connectivity_state_str[state]));
+		Slot.Reconnects.Increment();
+		Slot.ConnectStartCycles = FPlatformTime::Cycles64();
+		state = Slot.Channel->GetState(true);
+		Slot.State = state;
+		break;
+	case grpc_connectivity_state::GRPC_CHANNEL_CONNECTING:
+		if (PreviousState == grpc_connectivity_state::GRPC_CHANNEL_READY)
 		{
-			UE_LOG(ConvaiSubsystemLog, Log, TEXT("gRPC channel state changed to %s... Closing"), *FString(grpc_connectivity_state_str[state]));
+			Slot.Reconnects.Increment();
 		}
-		//Channel->NotifyOnStateChange(state, std::chrono::system_clock::time_point().max(), &cq_, (void*)&OnStateChangeDelegate);
-	}
-	else
-	{
-		UE_LOG(ConvaiSubsystemLog, Log, TEXT("gRPC channel state changed to %s"), *FString(grpc_connectivity_state_str[state]));
-		Channel->NotifyOnStateChange(state, std::chrono::system_clock::time_point().max(), &cq_, (void*)&OnStateChangeDelegate);
+		if (!Slot.ConnectStartCycles)
+		{
+			Slot.ConnectStartCycles = FPlatformTime::Cycles64();
+		}
+		UE_LOG(ConvaiSubsystemLog, Log, TEXT("gRPC channel %d state changed to %s"), ChannelIndex, *FString(grpc_connectivity_state_str[state]));
+		break;
+	case grpc_connectivity_state::GRPC_CHANNEL_TRANSIENT_FAILURE:
+		// gRPC keeps retrying in the background using the reconnect backoff set on the channel
+		UE_LOG(ConvaiSubsystemLog, Warning, TEXT("gRPC channel %d state changed to %s... Retrying with backoff"), ChannelIndex, *FString(grpc_connectivity_state_str[state]));
+		break;
+	case grpc_connectivity_state::GRPC_CHANNEL_SHUTDOWN:
+		UE_LOG(ConvaiSubsystemLog, Log, TEXT("gRPC channel %d state changed to %s... Closing"), ChannelIndex, *FString(grpc_connectivity_state_str[state]));
+		return;
 	}
+
+	WatchChannelState(ChannelIndex, state);
 }
 
 void FgRPCClient::Exit()
@@ -285,21 +469,32 @@ void FgRPCClient::Exit()
 	bIsRunning = false;
 	{
 		FScopeLock Lock(&CriticalSection);
-		cq_.Shutdown();
+		for (TUniquePtr<FgRPCCompletionQueueWorker>& Worker : Workers)
+		{
+			Worker->Shutdown();
+		}
+
+		// Destroying a channel disconnects it, which completes its pending state watch. Running calls keep their own reference
+		for (TUniquePtr<FgRPCChannelSlot>& Slot : Channels)
+		{
+			Slot->Stub.reset();
+			Slot->Channel.reset();
+		}
 	}
 }
 
 FgRPCClient::FgRPCClient(std::string InTarget,
 	const std::shared_ptr<grpc::ChannelCredentials>& InCreds)
 	: bIsRunning(false),
+	CompletionQueuePolicy(EConvaiCompletionQueuePolicy::LeastLoaded),
 	Creds(InCreds),
 	Target(InTarget)
 {
 }
 
-std::unique_ptr<ConvaiService::Stub> FgRPCClient::GetNewStub()
+ConvaiService::Stub* FgRPCClient::AcquireStub(int32& OutChannelIndex)
 {
-	FScopeLock Lock(&CriticalSection);
+	OutChannelIndex = INDEX_NONE;
 
 	// # TODO (Mohamed): Handling Mic permissions requires refactoring and a unified pipeline for all platforms
 	// Delaying asking for permission for MacOS due to a crash
@@ -307,18 +502,153 @@ std::unique_ptr<ConvaiService::Stub> FgRPCClient::GetNewStub()
     GetAppleMicPermission();
 	#endif
 
-	grpc_connectivity_state state = Channel->GetState(false);
+	// Exit resets the channels under the same lock, a stub handed out here was not torn down yet
+	FScopeLock Lock(&CriticalSection);
+
+	if (!bIsRunning || !Channels.Num())
+	{
+		return nullptr;
+	}
+
+	// Pick the ready channel with the fewest running calls, starting at a rotating offset to break ties
+	const int32 Offset = (uint32)NextChannel.Increment() % (uint32)Channels.Num();
+	int32 LowestLoad = MAX_int32;
+	for (int32 i = 0; i < Channels.Num(); i++)
+	{
+		const int32 Index = (Offset + i) % Channels.Num();
+		// Channels that are still connecting are only used when no ready channel is available
+		const bool IsReady = Channels[Index]->State.load() == grpc_connectivity_state::GRPC_CHANNEL_READY;
+		const int32 Load = Channels[Index]->ActiveStreams.GetValue() + (IsReady ? 0 : 1 << 16);
+		if (Load < LowestLoad)
+		{
+			LowestLoad = Load;
+			OutChannelIndex = Index;
+		}
+	}
+
+	FgRPCChannelSlot& Slot = *Channels[OutChannelIndex];
+	if (!Slot.Channel || !Slot.Stub)
+	{
+		OutChannelIndex = INDEX_NONE;
+		return nullptr;
+	}
+
+	grpc_connectivity_state state = Slot.Channel->GetState(false);
 
 	if (state != grpc_connectivity_state::GRPC_CHANNEL_READY)
 	{
-		UE_LOG(ConvaiSubsystemLog, Warning, TEXT("gRPC channel not ready yet.. Current State: %s"), *FString(grpc_connectivity_state_str[state]));
+		UE_LOG(ConvaiSubsystemLog, Warning, TEXT("gRPC channel %d not ready yet.. Current State: %s"), OutChannelIndex, *FString(grpc_connectivity_state_str[state]));
 	}
-	return ConvaiService::NewStub(Channel);
+
+	Slot.ActiveStreams.Increment();
+	return Slot.Stub.get();
 }
 
-CompletionQueue* FgRPCClient::GetCompletionQueue()
+void FgRPCClient::ReleaseStub(int32 ChannelIndex)
 {
-	return &cq_;
+	if (Channels.IsValidIndex(ChannelIndex))
+	{
+		Channels[ChannelIndex]->ActiveStreams.Decrement();
+	}
+}
+
+CompletionQueue* FgRPCClient::AcquireCompletionQueue(int32& OutQueueIndex, uint32 AffinityKey)
+{
+	OutQueueIndex = INDEX_NONE;
+
+	if (!bIsRunning || !Workers.Num())
+	{
+		return nullptr;
+	}
+
+	if (AffinityKey != 0)
+	{
+		// Follow the queue the other running streams of this owner are on, their callbacks rely on not running concurrently
+		FScopeLock Lock(&CriticalSection);
+		FQueueAffinity& Affinity = QueueAffinities.FindOrAdd(AffinityKey);
+		if (Affinity.NumStreams == 0)
+		{
+			Affinity.QueueIndex = PickCompletionQueue();
+		}
+		Affinity.NumStreams++;
+		OutQueueIndex = Affinity.QueueIndex;
+	}
+	else
+	{
+		OutQueueIndex = PickCompletionQueue();
+	}
+
+	Workers[OutQueueIndex]->AddStream();
+	return Workers[OutQueueIndex]->GetCompletionQueue();
+}
+
+int32 FgRPCClient::PickCompletionQueue()
+{
+	if (CompletionQueuePolicy == EConvaiCompletionQueuePolicy::RoundRobin)
+	{
+		return (uint32)NextCompletionQueue.Increment() % (uint32)Workers.Num();
+	}
+
+	// Start the scan at a rotating offset so ties do not always land on the first queue
+	const int32 Offset = (uint32)NextCompletionQueue.Increment() % (uint32)Workers.Num();
+	int32 LowestLoad = MAX_int32;
+	int32 QueueIndex = Offset;
+	for (int32 i = 0; i < Workers.Num(); i++)
+	{
+		const int32 Index = (Offset + i) % Workers.Num();
+		const int32 Load = Workers[Index]->GetAssignedStreams();
+		if (Load < LowestLoad)
+		{
+			LowestLoad = Load;
+			QueueIndex = Index;
+		}
+	}
+	return QueueIndex;
+}
+
+void FgRPCClient::ReleaseCompletionQueue(int32 QueueIndex, uint32 AffinityKey)
+{
+	if (!Workers.IsValidIndex(QueueIndex))
+	{
+		return;
+	}
+
+	Workers[QueueIndex]->RemoveStream();
+
+	if (AffinityKey != 0)
+	{
+		FScopeLock Lock(&CriticalSection);
+		FQueueAffinity* Affinity = QueueAffinities.Find(AffinityKey);
+		if (Affinity && --Affinity->NumStreams <= 0)
+		{
+			QueueAffinities.Remove(AffinityKey);
+		}
+	}
+}
+
+void FgRPCClient::GetChannelStats(TArray<FConvaiChannelStats>& OutStats) const
+{
+	OutStats.Reset(Channels.Num());
+	for (int32 i = 0; i < Channels.Num(); i++)
+	{
+		const FgRPCChannelSlot& Slot = *Channels[i];
+		FConvaiChannelStats Stats;
+		Stats.ChannelIndex = i;
+		Stats.State = FString(grpc_connectivity_state_str[Slot.State.load()]);
+		Stats.ActiveStreams = Slot.ActiveStreams.GetValue();
+		Stats.TimeToReadyMs = Slot.TimeToReadyMs;
+		Stats.Reconnects = Slot.Reconnects.GetValue();
+		OutStats.Add(Stats);
+	}
+}
+
+void FgRPCClient::GetCompletionQueueStats(TArray<FConvaiCompletionQueueStats>& OutStats) const
+{
+	OutStats.Reset(Workers.Num());
+	for (const TUniquePtr<FgRPCCompletionQueueWorker>& Worker : Workers)
+	{
+		OutStats.Add(Worker->GetStats());
+	}
 }
 
 UConvaiSubsystem::UConvaiSubsystem()
@@ -375,6 +705,24 @@ void UConvaiSubsystem::Deinitialize()
 	UE_LOG(ConvaiSubsystemLog, Log, TEXT("UConvaiSubsystem Stopped"));
 }
 
+void UConvaiSubsystem::GetCompletionQueueStats(TArray<FConvaiCompletionQueueStats>& OutStats) const
+{
+	OutStats.Reset();
+	if (gRPC_Runnable.IsValid())
+	{
+		gRPC_Runnable->GetCompletionQueueStats(OutStats);
+	}
+}
+
+void UConvaiSubsystem::GetChannelStats(TArray<FConvaiChannelStats>& OutStats) const
+{
+	OutStats.Reset();
+	if (gRPC_Runnable.IsValid())
+	{
+		gRPC_Runnable->GetChannelStats(OutStats);
+	}
+}
+
 void UConvaiSubsystem::GetAndroidMicPermission()
 {
 	if (!UConvaiAndroid::ConvaiAndroidHasMicrophonePermission())
@@ -2,6 +2,7 @@
 
 
 #include "ConvaiUtils.h"
+#include "ConvaiBlendshapeMap.h"
 #include "Misc/FileHelper.h"
 #include "Http.h"
 #include "Containers/UnrealString.h"
@@ -921,39 +922,275 @@ int UConvaiUtils::LevenshteinDistance(const FString& s, const FString& t)
 	return v1[t.Len()];
 }
 
-TArray<FAnimationFrame> UConvaiUtils::ParseJsonToBlendShapeData(const FString& JsonString)
+namespace
 {
-	TArray<FAnimationFrame> AnimationFrames;
-
-	TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(JsonString);
-	TSharedPtr<FJsonValue> JsonParsed;
-	if (FJsonSerializer::Deserialize(Reader, JsonParsed) && JsonParsed.IsValid() && JsonParsed->Type == EJson::Array)
+	// Minimal scanner for the blendshape payload: [{"FrameIndex":0,"BlendShapes":[{"name":"browDownLeft","score":0.1},...]},...]
+	struct FBlendShapeJsonScanner
 	{
-		TArray<TSharedPtr<FJsonValue>> FrameArray = JsonParsed->AsArray();
-		for (auto FrameVal : FrameArray)
+		const ANSICHAR* Cur;
+		const ANSICHAR* End;
+
+		void SkipWhitespace()
+		{
+			while (Cur < End && (*Cur == ' ' || *Cur == '\n' || *Cur == '\r' || *Cur == '\t'))
+			{
+				Cur++;
+			}
+		}
+
+		bool Peek(ANSICHAR C)
+		{
+			SkipWhitespace();
+			return Cur < End && *Cur == C;
+		}
+
+		bool Consume(ANSICHAR C)
+		{
+			if (!Peek(C))
+			{
+				return false;
+			}
+			Cur++;
+			return true;
+		}
+
+		// Returns the raw bytes between the quotes, escapes are skipped over but not decoded
+		bool ReadString(const ANSICHAR*& OutStart, int32& OutLen)
+		{
+			if (!Consume('"'))
+			{
+				return false;
+			}
+			OutStart = Cur;
+			while (Cur < End && *Cur != '"')
+			{
+				Cur += (*Cur == '\\') ? 2 : 1;
+			}
+			if (Cur >= End)
+			{
+				return false;
+			}
+			OutLen = int32(Cur - OutStart);
+			Cur++;
+			return true;
+		}
+
+		bool ReadNumber(double& OutValue)
+		{
+			SkipWhitespace();
+			const ANSICHAR* Start = Cur;
+			while (Cur < End && ((*Cur >= '0' && *Cur <= '9') || *Cur == '-' || *Cur == '+' || *Cur == '.' || *Cur == 'e' || *Cur == 'E'))
+			{
+				Cur++;
+			}
+
+			// Copied out since the payload is not null terminated
+			ANSICHAR Buffer[64];
+			const int32 Len = int32(Cur - Start);
+			if (Len == 0 || Len >= UE_ARRAY_COUNT(Buffer))
+			{
+				return false;
+			}
+			FMemory::Memcpy(Buffer, Start, Len);
+			Buffer[Len] = 0;
+			OutValue = FCStringAnsi::Atod(Buffer);
+			return true;
+		}
+
+		bool SkipValue()
+		{
+			SkipWhitespace();
+			if (Cur >= End)
+			{
+				return false;
+			}
+
+			if (*Cur == '"')
+			{
+				const ANSICHAR* Start;
+				int32 Len;
+				return ReadString(Start, Len);
+			}
+
+			if (*Cur == '{' || *Cur == '[')
+			{
+				int32 Depth = 0;
+				while (Cur < End)
+				{
+					if (*Cur == '"')
+					{
+						const ANSICHAR* Start;
+						int32 Len;
+						if (!ReadString(Start, Len))
+						{
+							return false;
+						}
+						continue;
+					}
+					if (*Cur == '{' || *Cur == '[')
+					{
+						Depth++;
+					}
+					else if (*Cur == '}' || *Cur == ']')
+					{
+						Depth--;
+					}
+					Cur++;
+					if (Depth == 0)
+					{
+						return true;
+					}
+				}
+				return false;
+			}
+
+			// Numbers, true, false and null
+			while (Cur < End && *Cur != ',' && *Cur != '}' && *Cur != ']')
+			{
+				Cur++;
+			}
+			return true;
+		}
+
+		static bool KeyEquals(const ANSICHAR* Key, int32 KeyLen, const ANSICHAR* Expected)
 		{
-			TSharedPtr<FJsonObject> FrameObj = FrameVal->AsObject();
-			FAnimationFrame NewFrame;
+			return FCStringAnsi::Strlen(Expected) == KeyLen && FCStringAnsi::Strncmp(Key, Expected, KeyLen) == 0;
+		}
 
-			NewFrame.FrameIndex = FrameObj->GetIntegerField("FrameIndex");
+		bool ParseCurve(FAnimationFrame& Frame, int32 CurveOrder)
+		{
+			if (!Consume('{'))
+			{
+				return false;
+			}
 
-			TArray<TSharedPtr<FJsonValue>> BlendShapeArray = FrameObj->GetArrayField("BlendShapes");
-			for (auto BlendShapeVal : BlendShapeArray)
+			const ANSICHAR* Name = nullptr;
+			int32 NameLen = 0;
+			double Score = 0;
+			while (!Consume('}'))
 			{
-				TSharedPtr<FJsonObject> BlendShapeObj = BlendShapeVal->AsObject();
-				FName name = FName(BlendShapeObj->GetStringField("name"));
-				double score;
-				bool Success = BlendShapeObj->TryGetNumberField("score", score);
+				const ANSICHAR* Key;
+				int32 KeyLen;
+				if (!ReadString(Key, KeyLen) || !Consume(':'))
+				{
+					return false;
+				}
+
+				bool Success;
+				if (KeyEquals(Key, KeyLen, "name"))
+				{
+					Success = ReadString(Name, NameLen);
+				}
+				else if (KeyEquals(Key, KeyLen, "score"))
+				{
+					Success = ReadNumber(Score) || SkipValue();
+				}
+				else
+				{
+					Success = SkipValue();
+				}
+
 				if (!Success)
-					score = 0;
+				{
+					return false;
+				}
+				Consume(',');
+			}
 
-				NewFrame.BlendShapes.Add(name, score);
+			if (Name)
+			{
+				const int32 Index = FConvaiFaceCurveSet::FindCurveIndex(EConvaiFaceCurveSet::ARKit, Name, NameLen, CurveOrder);
+				if (Index != INDEX_NONE)
+				{
+					Frame.CurveValues[Index] = float(Score);
+				}
+				else
+				{
+					// Curves outside the set are rare, they keep the by-name path
+					FUTF8ToTCHAR CurveName(Name, NameLen);
+					Frame.BlendShapes.Add(FName(*FString(CurveName.Length(), CurveName.Get())), float(Score));
+				}
+			}
+			return true;
+		}
+
+		bool ParseFrame(FAnimationFrame& Frame)
+		{
+			if (!Consume('{'))
+			{
+				return false;
 			}
 
-			AnimationFrames.Add(NewFrame);
+			Frame.InitCurveSet(EConvaiFaceCurveSet::ARKit);
+			while (!Consume('}'))
+			{
+				const ANSICHAR* Key;
+				int32 KeyLen;
+				if (!ReadString(Key, KeyLen) || !Consume(':'))
+				{
+					return false;
+				}
+
+				if (KeyEquals(Key, KeyLen, "FrameIndex"))
+				{
+					double FrameIndex;
+					if (!ReadNumber(FrameIndex))
+					{
+						return false;
+					}
+					Frame.FrameIndex = int32(FrameIndex);
+				}
+				else if (KeyEquals(Key, KeyLen, "BlendShapes") && Peek('['))
+				{
+					Consume('[');
+					int32 CurveOrder = 0;
+					while (!Consume(']'))
+					{
+						if (!ParseCurve(Frame, CurveOrder++))
+						{
+							return false;
+						}
+						Consume(',');
+					}
+				}
+				else if (!SkipValue())
+				{
+					return false;
+				}
+				Consume(',');
+			}
+			return true;
 		}
+	};
+}
+
+bool UConvaiUtils::ParseBlendShapeData(const ANSICHAR* Json, int32 JsonLen, TArray<FAnimationFrame>& OutFrames)
+{
+	FBlendShapeJsonScanner Scanner{ Json, Json + JsonLen };
+	if (!Scanner.Consume('['))
+	{
+		return false;
 	}
 
+	// Malformed payloads add no frames at all
+	const int32 NumFramesBefore = OutFrames.Num();
+	while (!Scanner.Consume(']'))
+	{
+		if (Scanner.Cur >= Scanner.End || !Scanner.ParseFrame(OutFrames.AddDefaulted_GetRef()))
+		{
+			OutFrames.SetNum(NumFramesBefore);
+			return false;
+		}
+		Scanner.Consume(',');
+	}
+	return true;
+}
+
+TArray<FAnimationFrame> UConvaiUtils::ParseJsonToBlendShapeData(const FString& JsonString)
+{
+	TArray<FAnimationFrame> AnimationFrames;
+	FTCHARToUTF8 Json(*JsonString);
+	ParseBlendShapeData(Json.Get(), Json.Length(), AnimationFrames);
 	return AnimationFrames;
 }
 
@@ -971,6 +1208,8 @@ bool UConvaiUtils::ParseVisemeValuesToAnimationFrame(const FString& VisemeValues
 		return false;
 	}
 
+	AnimationFrame.InitCurveSet(EConvaiFaceCurveSet::Visemes);
+
 	float ValuesSum = 0.0f; // Used to check if all blendshapes are zeros
 
 	bool ignore = true;
@@ -982,7 +1221,7 @@ bool UConvaiUtils::ParseVisemeValuesToAnimationFrame(const FString& VisemeValues
 		if (StringValues[Index].TrimStartAndEnd().IsNumeric())
 		{
 			Value = FCString::Atof(*StringValues[Index]);
-			AnimationFrame.BlendShapes.Add(*ConvaiConstants::VisemeNames[Index], Value);
+			AnimationFrame.CurveValues[Index] = Value;
 			if (Value > 0.03)
 				ignore = false;
 			ValuesSum += Value; // Add the value to the sum
@@ -992,7 +1231,7 @@ bool UConvaiUtils::ParseVisemeValuesToAnimationFrame(const FString& VisemeValues
 			// Log a warning message if a string value is not numeric
 			//UE_LOG(LogTemp, Warning, TEXT("Invalid numeric value: %s"), *StringValues[Index])
 			Value = 0;
-			AnimationFrame.BlendShapes.Add(*ConvaiConstants::VisemeNames[Index], Value);
+			AnimationFrame.CurveValues[Index] = Value;
 		}
 	}
 
@@ -1001,7 +1240,7 @@ bool UConvaiUtils::ParseVisemeValuesToAnimationFrame(const FString& VisemeValues
 	{
 		if (ConvaiConstants::VisemeNames.Num() > 0)
 		{
-			AnimationFrame.BlendShapes[*ConvaiConstants::VisemeNames[0]] = 1.0f;
+			AnimationFrame.CurveValues[0] = 1.0f;
 			return false;
 		}
 	}
@@ -1032,77 +1271,44 @@ void UConvaiUtils::ConvaiAnimationSequenceFromJson(const FString& JsonString, FA
 
 TMap<FName, float> UConvaiUtils::MapBlendshapes(const TMap<FName, float>& InputBlendshapes, const TMap<FName, FConvaiBlendshapeParameters>& BlendshapeMap, float GlobalMultiplier, float GlobalOffset)
 {
-	TMap<FName, float> OutputMap;
-
-	// Generate arrays for original blendshape names and values
-	TArray<FName> OriginalNames;
-	TArray<float> OriginalValues;
-	InputBlendshapes.GenerateKeyArray(OriginalNames);
-	InputBlendshapes.GenerateValueArray(OriginalValues);
-
-	// Loop through each original blendshape
-	for (int i = 0; i < OriginalNames.Num(); i++)
+	TArray<FName, TInlineAllocator<64>> SourceNames;
+	TArray<float, TInlineAllocator<64>> SourceValues;
+	SourceNames.Reserve(InputBlendshapes.Num());
+	SourceValues.Reserve(InputBlendshapes.Num());
+	for (const auto& Elem : InputBlendshapes)
 	{
-		FName OriginalName = OriginalNames[i];
-		float OriginalValue = OriginalValues[i];
-
-		// Check if the original name has a mapped parameter
-		const FConvaiBlendshapeParameters* MappedParameter = BlendshapeMap.Find(OriginalName);
-
-		if (MappedParameter)
-		{
-			float Multiplier = MappedParameter->Multiplyer;
-			float Offset = MappedParameter->Offset;
-			bool UseOverrideValue = MappedParameter->UseOverrideValue;
-			float OverrideValue = MappedParameter->OverrideValue;
-			float ClampMinValue = MappedParameter->ClampMinValue;
-			float ClampMaxValue = MappedParameter->ClampMaxValue;
-			bool IgnoreGlobalModifiers = MappedParameter->IgnoreGlobalModifiers;
-
-			// Loop through each target name specified in the mapped parameter
-			for (FName TargetName : MappedParameter->TargetNames)
-			{
-				if (UseOverrideValue)
-				{
-					// Use the override value if specified
-					OutputMap.Add(TargetName, OverrideValue);
-				}
-				else
-				{
-					// Calculate the final blendshape value using the multiplier and offset
-					float CalculatedValue;
-					if (IgnoreGlobalModifiers)
-					{
-						CalculatedValue = Multiplier * OriginalValue + Offset;
-					}
-					else
-					{
-						CalculatedValue = Multiplier * OriginalValue * GlobalMultiplier + Offset + GlobalOffset;
-					}
-
-					CalculatedValue = CalculatedValue > ClampMaxValue ? ClampMaxValue : CalculatedValue;
-					CalculatedValue = CalculatedValue < ClampMinValue ? ClampMinValue : CalculatedValue;
-
-					// If this curve appeared before then choose the higher value
-					if (float* PreviousValue = OutputMap.Find(TargetName))
-					{
-						if (CalculatedValue <= *PreviousValue)
-						{
-							continue;
-						}
-					}
+		SourceNames.Add(Elem.Key);
+		SourceValues.Add(Elem.Value);
+	}
 
-					OutputMap.Add(TargetName, CalculatedValue);
-				}
-			}
-		}
-		else
+	// The remap is compiled once per remap content and input layout and reused by every later call.
+	// Blueprints pass the same remap every frame, so the last one is checked first without hashing it or taking the cache lock
+	static TSharedPtr<const FConvaiCompiledBlendshapeMap, ESPMode::ThreadSafe> LastGameThreadMap;
+	TSharedPtr<const FConvaiCompiledBlendshapeMap, ESPMode::ThreadSafe> CompiledMap;
+	if (IsInGameThread() && LastGameThreadMap.IsValid() && LastGameThreadMap->Matches(BlendshapeMap, SourceNames))
+	{
+		CompiledMap = LastGameThreadMap;
+	}
+	else
+	{
+		CompiledMap = FConvaiCompiledBlendshapeMap::FindOrCompile(BlendshapeMap, SourceNames);
+		if (IsInGameThread())
 		{
-			// If no mapped parameter exists for the original name, keep the original value
-			OutputMap.Add(OriginalName, OriginalValue);
+			LastGameThreadMap = CompiledMap;
 		}
 	}
+	const TArray<FName>& TargetNames = CompiledMap->GetTargetNames();
 
+	TArray<float, TInlineAllocator<64>> TargetValues;
+	TargetValues.SetNumUninitialized(TargetNames.Num());
+	CompiledMap->Evaluate(SourceValues.GetData(), GlobalMultiplier, GlobalOffset, TargetValues.GetData());
+
+	TMap<FName, float> OutputMap;
+	OutputMap.Reserve(TargetNames.Num());
+	for (int32 Index = 0; Index < TargetNames.Num(); Index++)
+	{
+		OutputMap.Add(TargetNames[Index], TargetValues[Index]);
+	}
 	return OutputMap;
 }
 
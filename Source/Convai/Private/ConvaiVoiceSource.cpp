@@ -0,0 +1,229 @@
+// Copyright 2022 Convai Inc. All Rights Reserved.
+
+#include "ConvaiVoiceSource.h"
+#include "ConvaiPlaybackClock.h"
+#include "Misc/ScopeLock.h"
+
+DEFINE_LOG_CATEGORY(ConvaiVoiceSourceLog);
+
+namespace
+{
+	// Voice the ring holds before new audio spills into the backlog
+	constexpr int32 RingCapacitySecs = 4;
+
+	class FConvaiVoiceGenerator : public ISoundGenerator
+	{
+	public:
+		explicit FConvaiVoiceGenerator(const TSharedPtr<FConvaiVoiceSource, ESPMode::ThreadSafe>& InVoiceSource)
+			: VoiceSource(InVoiceSource)
+		{
+		}
+
+		virtual int32 OnGenerateAudio(float* OutAudio, int32 NumSamples) override
+		{
+			VoiceSource->Render(OutAudio, NumSamples);
+			return NumSamples;
+		}
+
+		// Keeps rendering silence between talks, so the next one starts without restarting the sound
+		virtual bool IsFinished() const override { return false; }
+
+	private:
+		TSharedPtr<FConvaiVoiceSource, ESPMode::ThreadSafe> VoiceSource;
+	};
+}
+
+FConvaiVoiceSource::FConvaiVoiceSource(int32 InOutputSampleRate, const TSharedPtr<FConvaiPlaybackClock, ESPMode::ThreadSafe>& InPlaybackClock)
+	: OutputSampleRate(FMath::Max(InOutputSampleRate, 1))
+	, PlaybackClock(InPlaybackClock)
+	, Ring(OutputSampleRate * RingCapacitySecs)
+{
+	check(PlaybackClock.IsValid());
+}
+
+void FConvaiVoiceSource::QueueAudio(const int16* Samples, int32 NumFrames, int32 SampleRate, int32 NumChannels)
+{
+	if (!Samples || NumFrames <= 0 || SampleRate <= 0 || NumChannels <= 0)
+	{
+		return;
+	}
+
+	FScopeLock Lock(&ProducerCriticalSection);
+
+	// Matching rates still go through the resampler, a single tap table that only downmixes
+	if (!Resampler.IsInit() || Resampler.GetInputSampleRate() != SampleRate)
+	{
+		Resampler.Init(SampleRate, OutputSampleRate);
+	}
+
+	ResampledBuffer.SetNumUninitialized(Resampler.GetNumOutputFrames(NumFrames), false);
+	const int32 NumOutput = Resampler.Process(Samples, NumFrames, NumChannels, ResampledBuffer.GetData(), ResampledBuffer.Num());
+	Push(ResampledBuffer.GetData(), NumOutput);
+}
+
+void FConvaiVoiceSource::Push(const float* Frames, int32 NumFrames)
+{
+	if (NumFrames <= 0)
+	{
+		return;
+	}
+
+	// The clock is moved first, so the render thread cannot play past the start it computes
+	const int64 StartFrame = FMath::Max(QueuedFrames, PlayedFrames.load(std::memory_order_acquire));
+	QueuedFrames = StartFrame + NumFrames;
+	PlaybackClock->LastQueuedStartSeconds.store(double(StartFrame) / OutputSampleRate, std::memory_order_release);
+	PlaybackClock->QueuedSeconds.store(double(QueuedFrames) / OutputSampleRate, std::memory_order_release);
+
+	// Once something waits in the backlog everything after it has to wait too, to keep the order
+	int32 Written = 0;
+	if (Backlog.Num() == BacklogOffset)
+	{
+		Written = Ring.Write(Frames, NumFrames);
+	}
+
+	if (Written < NumFrames)
+	{
+		Backlog.Append(Frames + Written, NumFrames - Written);
+		BacklogFrames.store(Backlog.Num() - BacklogOffset, std::memory_order_release);
+	}
+}
+
+void FConvaiVoiceSource::Pump()
+{
+	FScopeLock Lock(&ProducerCriticalSection);
+
+	if (Backlog.Num() == BacklogOffset)
+	{
+		return;
+	}
+
+	BacklogOffset += Ring.Write(Backlog.GetData() + BacklogOffset, Backlog.Num() - BacklogOffset);
+	if (Backlog.Num() == BacklogOffset)
+	{
+		Backlog.Reset();
+		BacklogOffset = 0;
+	}
+	BacklogFrames.store(Backlog.Num() - BacklogOffset, std::memory_order_release);
+}
+
+void FConvaiVoiceSource::Reset()
+{
+	FScopeLock Lock(&ProducerCriticalSection);
+
+	Backlog.Reset();
+	BacklogOffset = 0;
+	BacklogFrames.store(0, std::memory_order_release);
+
+	// The producer cannot move the read position, the render thread skips the dropped audio on its next callback
+	DiscardIndex.store(Ring.GetWriteIndex(), std::memory_order_release);
+
+	Resampler.Reset();
+
+	QueuedFrames = PlayedFrames.load(std::memory_order_acquire);
+	const double PlayedSeconds = double(QueuedFrames) / OutputSampleRate;
+	PlaybackClock->QueuedSeconds.store(PlayedSeconds, std::memory_order_release);
+	PlaybackClock->LastQueuedStartSeconds.store(PlayedSeconds, std::memory_order_release);
+}
+
+void FConvaiVoiceSource::BeginStream()
+{
+	StreamOpen.store(true, std::memory_order_relaxed);
+}
+
+void FConvaiVoiceSource::EndStream()
+{
+	StreamOpen.store(false, std::memory_order_relaxed);
+}
+
+void FConvaiVoiceSource::Render(float* Out, int32 NumSamples)
+{
+	if (NumSamples <= 0)
+	{
+		return;
+	}
+
+	const uint64 Discard = DiscardIndex.load(std::memory_order_acquire);
+	const uint64 ReadIndex = Ring.GetReadIndex();
+	if (Discard > ReadIndex)
+	{
+		// Stopped on purpose, running out right after is not an underrun
+		Ring.Skip(uint32(Discard - ReadIndex));
+		RenderedAudioLastCallback = false;
+	}
+
+	const int32 NumRead = Ring.Read(Out, NumSamples);
+	if (NumRead < NumSamples)
+	{
+		FMemory::Memzero(Out + NumRead, (NumSamples - NumRead) * sizeof(float));
+		SilentFrames.fetch_add(NumSamples - NumRead, std::memory_order_relaxed);
+
+		// Running out after the last audio of the response is the normal end of the talk
+		if ((NumRead > 0 || RenderedAudioLastCallback) && StreamOpen.load(std::memory_order_relaxed))
+		{
+			NumUnderruns.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+	RenderedAudioLastCallback = NumRead == NumSamples;
+
+	if (NumRead > 0)
+	{
+		const int64 Played = PlayedFrames.fetch_add(NumRead, std::memory_order_acq_rel) + NumRead;
+		PlaybackClock->PlayedSeconds.store(double(Played) / OutputSampleRate, std::memory_order_release);
+	}
+}
+
+void FConvaiVoiceSource::ConsumeWithoutAudioDevice(float DeltaTime)
+{
+	const int32 NumFrames = FMath::CeilToInt(DeltaTime * OutputSampleRate);
+	if (NumFrames <= 0)
+	{
+		return;
+	}
+
+	DiscardBuffer.SetNumUninitialized(NumFrames);
+	Render(DiscardBuffer.GetData(), NumFrames);
+}
+
+bool FConvaiVoiceSource::HasPendingAudio() const
+{
+	// Read in the order Pump and Push publish, so audio moving from the backlog into the ring is never missed
+	if (BacklogFrames.load(std::memory_order_acquire) > 0)
+	{
+		return true;
+	}
+
+	const uint64 ReadIndex = FMath::Max(Ring.GetReadIndex(), DiscardIndex.load(std::memory_order_acquire));
+	return Ring.GetWriteIndex() > ReadIndex;
+}
+
+FConvaiVoiceSourceStats FConvaiVoiceSource::GetStats() const
+{
+	FConvaiVoiceSourceStats Stats;
+	Stats.OutputSampleRate = OutputSampleRate;
+	Stats.BacklogFrames = BacklogFrames.load(std::memory_order_acquire);
+	Stats.FramesQueued = int64(Ring.GetWriteIndex()) + Stats.BacklogFrames;
+	Stats.FramesPlayed = PlayedFrames.load(std::memory_order_acquire);
+	Stats.SilentFrames = SilentFrames.load(std::memory_order_relaxed);
+	Stats.NumUnderruns = NumUnderruns.load(std::memory_order_relaxed);
+	return Stats;
+}
+
+void UConvaiVoiceSoundWave::SetVoiceSource(const TSharedPtr<FConvaiVoiceSource, ESPMode::ThreadSafe>& InVoiceSource)
+{
+	VoiceSource = InVoiceSource;
+}
+
+ISoundGeneratorPtr UConvaiVoiceSoundWave::CreateSoundGenerator(const FSoundGeneratorInitParams& InParams)
+{
+	if (!VoiceSource.IsValid())
+	{
+		return nullptr;
+	}
+
+	if (InParams.SampleRate != VoiceSource->GetOutputSampleRate())
+	{
+		UE_LOG(ConvaiVoiceSourceLog, Warning, TEXT("CreateSoundGenerator: Voice is rendered at %d Hz but the audio device runs at %d Hz"), VoiceSource->GetOutputSampleRate(), int32(InParams.SampleRate));
+	}
+
+	return MakeShared<FConvaiVoiceGenerator, ESPMode::ThreadSafe>(VoiceSource);
+}
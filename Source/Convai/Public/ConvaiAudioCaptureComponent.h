@@ -7,12 +7,27 @@
 #include "Components/SynthComponent.h"
 #include "AudioCaptureCore.h"
 #include "AudioCaptureDeviceInterface.h"
+#include "ConvaiSpscRingBuffer.h"
+#include <atomic>
 #include "ConvaiAudioCaptureComponent.generated.h"
 
 DECLARE_LOG_CATEGORY_EXTERN(ConvaiAudioLog, Log, All);
 
 namespace Audio
 {
+	struct FConvaiAudioCaptureSynthStats
+	{
+		/* Interleaved samples written into the capture ring by the device callback */
+		int64 SamplesCaptured = 0;
+
+		/* Device buffers dropped because the ring was full */
+		int32 NumOverflows = 0;
+		int64 SamplesDropped = 0;
+
+		/* Callbacks in which the capture device itself reported an overflow */
+		int32 NumDeviceOverflows = 0;
+	};
+
 	/** Class which contains an FAudioCapture object and performs analysis on the audio stream, only outputing audio if it matches a detection criteria. */
 	class FConvaiAudioCaptureSynth
 	{
@@ -55,15 +70,22 @@ namespace Audio
 		// This returns audio only if there was non-zero audio since this function was last called.
 		bool GetAudioData(TArray<float>& OutAudioData);
 
+		// Exposes the captured samples in place as two spans, the second one is set where the ring wraps around.
+		// Only the thread generating the synth audio may read, ConsumeAudioData then releases the samples it used.
+		int32 PeekAudioData(const float*& OutFirst, int32& OutFirstNum, const float*& OutSecond, int32& OutSecondNum);
+		void ConsumeAudioData(int32 NumSamples);
+
 		// Returns the number of samples enqueued in the capture synth
-		int32 GetNumSamplesEnqueued();
+		int32 GetNumSamplesEnqueued() const;
+
+		FConvaiAudioCaptureSynthStats GetStats() const;
 
 		FAudioCapture* GetAudioCapture();
 
 	private:
 
-		// Number of samples enqueued
-		int32 NumSamplesEnqueued;
+		// Device callback, copies a buffer into the capture ring without locking or allocating
+		void OnCapture(const float* AudioData, int32 NumFrames, int32 NumChannels, bool bOverFlow);
 
 		// Information about the default capture device we're going to use
 		FCaptureDeviceInfo CaptureInfo;
@@ -71,17 +93,19 @@ namespace Audio
 		// Audio capture object dealing with getting audio callbacks
 		FAudioCapture AudioCapture;
 
-		// Critical section to prevent reading and writing from the captured buffer at the same time
-		FCriticalSection CaptureCriticalSection;
-
-		// Buffer of audio capture data, yet to be copied to the output 
-		TArray<float> AudioCaptureData;
+		// Audio capture data yet to be copied to the output, written by the device callback and read by the synth
+		TConvaiSpscRingBuffer<float> AudioCaptureData;
 
 		// If the object has been initialized
 		bool bInitialized;
 
 		// If we're capturing data
-		bool bIsCapturing;
+		std::atomic<bool> bIsCapturing;
+
+		std::atomic<int64> SamplesCaptured{ 0 };
+		std::atomic<int32> NumOverflows{ 0 };
+		std::atomic<int64> SamplesDropped{ 0 };
+		std::atomic<int32> NumDeviceOverflows{ 0 };
 	};
 
 };
@@ -133,7 +157,6 @@ private:
 	int32 SelectedDeviceIndex;
 
 	Audio::FConvaiAudioCaptureSynth CaptureSynth;
-	TArray<float> CaptureAudioData;
 	int32 CapturedAudioDataSamples;
 
 	bool bSuccessfullyInitialized;
@@ -141,7 +164,6 @@ private:
 	bool bIsStreamOpen;
 	int32 CaptureChannels;
 	int32 FramesSinceStarting;
-	int32 ReadSampleIndex;
 	FThreadSafeBool bIsDestroying;
 	FThreadSafeBool bIsNotReadyForForFinishDestroy;
 };
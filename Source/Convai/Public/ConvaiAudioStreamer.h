@@ -5,6 +5,11 @@
 // #undef UpdateResource
 #include "Components/AudioComponent.h"
 #include "ConvaiDefinitions.h"
+#include "ConvaiLatencyTracing.h"
+#include "ConvaiJitterBuffer.h"
+#include "ConvaiVoiceSource.h"
+#include "ConvaiPCMChunk.h"
+#include "ConvaiResampler.h"
 #include "Misc/ScopeLock.h"
 #include "Interfaces/VoiceCodec.h"
 
@@ -19,7 +24,7 @@
 
 DECLARE_LOG_CATEGORY_EXTERN(ConvaiAudioStreamerLog, Log, All);
 
-class USoundWaveProcedural;
+class FConvaiPlaybackClock;
 class IConvaiLipSyncInterface;
 class IConvaiLipSyncExtendedInterface;
 class IConvaiVisionInterface;
@@ -322,24 +327,25 @@ private:
 
 struct ConvaiAudioChunk
 {
-	TArray<uint8> AudioData;
+	// Shared with whoever else holds the chunk, never copied
+	FConvaiPCMChunkPtr AudioData;
 	float AudioDuration;
 	uint32 NumChannels;
 	uint32 SampleRate;
 	uint8 SampleSizeBytes;
 
 	// Constructor using initializer list
-	ConvaiAudioChunk(const TArray<uint8>& InAudioData, float InAudioDuration, uint32 InNumChannels, uint32 InSampleRate, uint8 InSampleSizeBytes)
+	ConvaiAudioChunk(const FConvaiPCMChunkRef& InAudioData)
 		: AudioData(InAudioData),
-		AudioDuration(InAudioDuration),
-		NumChannels(InNumChannels),
-		SampleRate(InSampleRate),
-		SampleSizeBytes(InSampleSizeBytes)
+		AudioDuration(InAudioData->GetDuration()),
+		NumChannels(InAudioData->GetNumChannels()),
+		SampleRate(InAudioData->GetSampleRate()),
+		SampleSizeBytes(sizeof(int16))
 	{
 	}
 
 	ConvaiAudioChunk()
-		: AudioData(TArray<uint8>()),
+		: AudioData(nullptr),
 		AudioDuration(0),
 		NumChannels(-1),
 		SampleRate(-1),
@@ -509,9 +515,13 @@ public:
 	virtual void OnServerAudioReceived(uint8* VoiceData, uint32 VoiceDataSize, bool ContainsHeaderData = true, uint32 SampleRate = 21000, uint32 NumChannels = 1) {};
 
 	void PlayVoiceSynced(uint8* VoiceData, uint32 VoiceDataSize, bool ContainsHeaderData=true, uint32 SampleRate=21000, uint32 NumChannels=1);
+
+	void PlayVoiceSynced(const FConvaiPCMChunkRef& VoiceChunk);
 	
 	void PlayVoiceData(uint8* VoiceData, uint32 VoiceDataSize, bool ContainsHeaderData=true, uint32 SampleRate=21000, uint32 NumChannels=1);
 
+	void PlayVoiceData(const FConvaiPCMChunkRef& VoiceChunk);
+
 	void PlayVoiceData(uint8* VoiceData, uint32 VoiceDataSize, bool ContainsHeaderData, FAnimationSequence FaceSequence, uint32 SampleRate = 21000, uint32 NumChannels = 1);
 
 	//UFUNCTION(BlueprintCallable, Category = "Convai")
@@ -531,7 +541,8 @@ public:
 
 	bool IsVoiceCurrentlyFading();
 
-	void ClearAudioFinishedTimer();
+	/** Starts and finishes talking as the audio renderer plays the queued voice */
+	void UpdateVoicePlayback(float DeltaTime);
 
 	bool IsLocal();
 
@@ -567,6 +578,9 @@ public:
 
 	bool ReplicateVoiceToNetwork;
 
+	// Set when the current response was requested without face data, the voice is then played without waiting for face frames
+	bool FaceDataSkipped = false;
+
 public:
 	// UActorComponent interface
 	virtual void BeginPlay() override;
@@ -577,17 +591,36 @@ public:
 
 public:
 
-	FTimerHandle AudioFinishedTimerHandle;
 	FTimerHandle LypSyncTimeoutTimerHandle;
-	bool IsTalking = false;
+
+	// Set by PlayVoiceData, which can run on the stream thread, and read on the game thread
+	std::atomic<bool> IsTalking{ false };
+
+	// Position of the voice actually played, shared with the lipsync component
+	TSharedPtr<FConvaiPlaybackClock, ESPMode::ThreadSafe> PlaybackClock;
+
+	// Played time at which the current talk started, published before TalkStartPending
+	std::atomic<double> TalkingStartSeconds{ 0 };
+
+	// Set when a talk was queued, OnStartedTalking fires once its first sample is played
+	std::atomic<bool> TalkStartPending{ false };
 	float TotalVoiceFadeOutTime;
 	float RemainingVoiceFadeOutTime;
 
 	UPROPERTY()
-	USoundWaveProcedural* SoundWaveProcedural;
+	UConvaiVoiceSoundWave* VoiceSoundWave;
+
+	// Voice queue read by the audio renderer
+	TSharedPtr<FConvaiVoiceSource, ESPMode::ThreadSafe> VoiceSource;
 
 	TArray<uint8> AudioDataBuffer;
 	TArray<uint8> ReceivedEncodedAudioDataBuffer;
+
+	// Brings voice sent to other clients down to the encoder's mono 24 kHz, keeps its filter state across chunks
+	FConvaiResampler EncoderResampler;
+
+	// Set once the current response went through EncoderResampler, its tail is sent when the response ends
+	bool EncoderResamplerHasTail = false;
  
 	IConvaiLipSyncInterface* ConvaiLipSync;
 	IConvaiLipSyncExtendedInterface* ConvaiLipSyncExtended;
@@ -632,6 +665,9 @@ public:
 	// Should be called in the game thread
 	void AddPCMDataToSend(TArray<uint8> PCMDataToAdd, bool ContainsHeaderData = true, uint32 SampleRate = 21000, uint32 NumChannels = 1);
 
+	// Should be called in the game thread, the chunk is played or encoded without being copied
+	void AddPCMChunkToSend(const FConvaiPCMChunkRef& PCMChunk);
+
 	virtual void onAudioStarted();
 	virtual void onAudioFinished();
 
@@ -654,8 +690,45 @@ protected:
 	//UFUNCTION(BlueprintPure, Category = "Convai|LipSync", Meta = (Tooltip = "Calculates the lowest estimated time remaining until the next pause in the character's speech during lip-syncing. Returns true if the time could be determined"))
 	bool HasSufficentLipsyncFrames(float& InSyncTimeRemaining);
 
+	// Upper bound of the voice pre-roll, the pre-roll itself is sized by JitterBuffer
 	float LipSyncThresholdSecs = -1;
 	float VoiceTimeFactor = -1;
+
+	FConvaiJitterBuffer JitterBuffer;
+
+	// A response starts streaming in, the voice running out counts as an underrun until EndVoiceResponse
+	void BeginVoiceResponse();
+
+	// All the audio of the response was received or the voice was stopped
+	void EndVoiceResponse();
+
+public:
+	/** Arrival jitter and underrun counters of the voice and face data */
+	FConvaiJitterStats GetJitterStats() const { return JitterBuffer.GetStats(); }
+
+	/** Queued, played and underrun counters of the voice playback */
+	FConvaiVoiceSourceStats GetVoiceStats() const;
+
+protected:
+
+	// Starts timing a new conversation turn, committing the previous one if it was still open
+	void BeginLatencyTrace(const FString& CharacterID, const FString& SessionID);
+
+	// Returns the trace of the current turn, null outside of a turn
+	FConvaiTurnTracePtr GetLatencyTrace();
+
+	void MarkLatency(EConvaiLatencySpan Span);
+
+	// Moves the current turn into the latency aggregates, should be called in the game thread
+	// If OnlyIfCurrent is set, nothing is done unless it is still the current turn
+	void CommitLatencyTrace(const FConvaiTurnTrace* OnlyIfCurrent = nullptr);
+
+	FConvaiLatencyTrace LastLatencyTrace;
+
+private:
+	FConvaiTurnTracePtr LatencyTrace;
+	FCriticalSection LatencyTraceSection;
+
 private:
 
 	bool InitEncoder(int32 InSampleRate, int32 InNumChannels, EAudioEncodeHint EncodeHint);
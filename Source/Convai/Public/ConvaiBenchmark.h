@@ -0,0 +1,173 @@
+// Copyright 2022 Convai Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/Object.h"
+#include "Engine/EngineTypes.h"
+#include "ConvaiLatencyTracing.h"
+#include "ConvaiBenchmark.generated.h"
+
+DECLARE_LOG_CATEGORY_EXTERN(ConvaiBenchmarkLog, Log, All);
+
+class UConvaiChatbotComponent;
+class UConvaiPlayerComponent;
+
+USTRUCT(BlueprintType)
+struct CONVAI_API FConvaiBenchmarkResults
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly, Category = "Convai|Benchmark")
+	int32 NumPairs = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Convai|Benchmark")
+	int32 NumTurnsCompleted = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Convai|Benchmark")
+	int32 NumTurnsTimedOut = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Convai|Benchmark")
+	float DurationSeconds = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Convai|Benchmark")
+	float TurnsPerSecond = 0;
+
+	/** Process CPU time per completed turn, integrated from the sampled process CPU usage */
+	UPROPERTY(BlueprintReadOnly, Category = "Convai|Benchmark")
+	float CpuMsPerTurn = 0;
+
+	/** Highest process physical memory use sampled during the run */
+	UPROPERTY(BlueprintReadOnly, Category = "Convai|Benchmark")
+	float PeakUsedPhysicalMB = 0;
+
+	/** Growth of the physical memory use over the memory use at the start of the run */
+	UPROPERTY(BlueprintReadOnly, Category = "Convai|Benchmark")
+	float PeakGrowthMB = 0;
+
+	/** Percentiles of the full turn time, from sending the text until the character is done talking */
+	UPROPERTY(BlueprintReadOnly, Category = "Convai|Benchmark")
+	float TurnP50Ms = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Convai|Benchmark")
+	float TurnP95Ms = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Convai|Benchmark")
+	float TurnP99Ms = 0;
+
+	/** Percentiles of each turn milestone, see FConvaiLatencyTracer */
+	UPROPERTY(BlueprintReadOnly, Category = "Convai|Benchmark")
+	TArray<FConvaiLatencySpanStats> LatencyStats;
+
+	FString ToString() const;
+};
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FConvaiBenchmarkFinishedSignature, const FConvaiBenchmarkResults&, Results);
+
+/**
+ * Drives N chatbot/player pairs through text turns back to back and reports throughput, CPU, memory and latency.
+ * Meant to run headless against the local stand-in service (see FConvaiLocalService) or a staging server set through CustomURL.
+ */
+UCLASS()
+class CONVAI_API UConvaiBenchmark : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	/** Character ID every spawned chatbot uses, latency stats are aggregated under it */
+	static const FString BenchmarkCharacterID;
+
+	/** Spawns the pairs and starts the first turn of each, returns nullptr if a benchmark is already running */
+	UFUNCTION(BlueprintCallable, Category = "Convai|Benchmark", meta = (WorldContext = "WorldContextObject"))
+	static UConvaiBenchmark* StartConvaiBenchmark(UObject* WorldContextObject, int32 NumPairs = 8, int32 TurnsPerPair = 10, bool InVoiceResponse = true, float InTurnTimeoutSeconds = 30);
+
+	/** Stops the running benchmark early and reports what was measured so far */
+	UFUNCTION(BlueprintCallable, Category = "Convai|Benchmark")
+	static void StopConvaiBenchmark();
+
+	UPROPERTY(BlueprintAssignable, Category = "Convai|Benchmark")
+	FConvaiBenchmarkFinishedSignature OnFinished;
+
+	UFUNCTION(BlueprintPure, Category = "Convai|Benchmark")
+	bool IsRunning() const { return Running; }
+
+	/**
+	 * Evaluates NumFaces face sync components NumTicks times and returns the average calling thread cost of one component tick in microseconds.
+	 * Batched goes through UConvaiFaceSyncSubsystem::EvaluateFaceSyncs, otherwise each component is evaluated in turn like with component ticks.
+	 */
+	static float RunFaceSyncBenchmark(int32 NumFaces, int32 NumTicks, bool Blendshapes, bool WithBlendshapeMap = false, bool Batched = false);
+
+	/**
+	 * Pushes NumChunks chunks of ChunkBytes through a voice capture ring the way the player and chatbot components do, one chunk in and
+	 * everything out per iteration, and returns the average cost of one iteration in nanoseconds.
+	 * SpscRing uses TConvaiSpscRingBuffer, otherwise the TRingBuffer it replaced.
+	 */
+	static float RunRingBufferBenchmark(int32 ChunkBytes, int32 NumChunks, bool SpscRing);
+
+	/** Streams NumChunks chunks of ChunkBytes from a producer thread through a blocking TConvaiSpscRingBuffer and returns the throughput in MB/s */
+	static float RunSpscRingThreadedBenchmark(int32 ChunkBytes, int32 NumChunks);
+
+	/**
+	 * Converts NumChunks chunks of ChunkMs of 16 bit noise to mono at OutputSampleRate, like the mic and replicated voice paths do,
+	 * and returns the average cost of one chunk in microseconds. Polyphase uses FConvaiResampler, otherwise UConvaiUtils::ResampleAudio.
+	 */
+	static float RunResamplerBenchmark(int32 InputSampleRate, int32 OutputSampleRate, int32 NumChannels, int32 ChunkMs, int32 NumChunks, bool Polyphase);
+
+	/**
+	 * Converts NumChunks chunks of ChunkMs of float mic noise to 16 kHz mono 16 bit PCM in a voice capture ring, like the player does
+	 * every tick while talking, and returns the average cost of one chunk in microseconds.
+	 * Fused converts straight into the ring storage, otherwise through the int16 sample buffer and array copies it replaced.
+	 */
+	static float RunCaptureConversionBenchmark(int32 InputSampleRate, int32 NumChannels, int32 ChunkMs, int32 NumChunks, bool Fused);
+
+	/**
+	 * Builds and parses the GetResponse messages of NumTurns turns, the config, WritesPerTurn mic writes and ReadsPerTurn voice replies,
+	 * and returns the average cost of one turn in microseconds. OutAllocationsPerTurn is the heap allocations the calling thread made per turn.
+	 * Arena uses per-stream arenas like UConvaiGRPCGetResponseProxy, otherwise the raw allocations it replaced.
+	 */
+	static float RunProtoArenaBenchmark(int32 NumTurns, int32 WritesPerTurn, int32 ReadsPerTurn, bool Arena, float& OutAllocationsPerTurn);
+
+private:
+	bool Begin(UWorld* World, int32 NumPairs, int32 TurnsPerPair, bool InVoiceResponse, float InTurnTimeoutSeconds);
+
+	void Tick();
+
+	void SampleUsage();
+
+	void Finish();
+
+	UPROPERTY()
+	TArray<AActor*> Actors;
+
+	UPROPERTY()
+	TArray<UConvaiChatbotComponent*> Chatbots;
+
+	UPROPERTY()
+	TArray<UConvaiPlayerComponent*> Players;
+
+	struct FPairState
+	{
+		int32 TurnsLeft = 0;
+		bool InTurn = false;
+		bool SeenActive = false;
+		double TurnStartTime = 0;
+	};
+	TArray<FPairState> PairStates;
+
+	TWeakObjectPtr<UWorld> WorldPtr;
+	FTimerHandle TickTimerHandle;
+
+	bool Running = false;
+	bool VoiceResponse = true;
+	float TurnTimeoutSeconds = 30;
+
+	double StartTime = 0;
+	double LastSampleTime = 0;
+	double CpuSeconds = 0;
+	uint64 StartUsedPhysical = 0;
+	uint64 PeakUsedPhysical = 0;
+	TArray<float> TurnTimesMs;
+	int32 NumTurnsTimedOut = 0;
+
+	static UConvaiBenchmark* RunningBenchmark;
+};
@@ -0,0 +1,68 @@
+// Copyright 2022 Convai Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ConvaiDefinitions.h"
+
+/**
+ * UConvaiUtils::MapBlendshapes compiled against a fixed source curve layout.
+ * The name lookups and merge decisions are resolved once, evaluation is a loop over float arrays with no allocation.
+ */
+class CONVAI_API FConvaiCompiledBlendshapeMap
+{
+public:
+	FConvaiCompiledBlendshapeMap(const TMap<FName, FConvaiBlendshapeParameters>& InBlendshapeMap, TArrayView<const FName> InSourceNames);
+
+	/** Identifies the content of a remap together with the source layout it is applied to */
+	static uint32 ComputeHash(const TMap<FName, FConvaiBlendshapeParameters>& BlendshapeMap, TArrayView<const FName> SourceNames);
+
+	/** Returns a compiled map shared by every caller with the same remap content and source layout, can be called from any thread */
+	static TSharedRef<const FConvaiCompiledBlendshapeMap, ESPMode::ThreadSafe> FindOrCompile(const TMap<FName, FConvaiBlendshapeParameters>& BlendshapeMap, TArrayView<const FName> SourceNames);
+
+	uint32 GetHash() const { return Hash; }
+
+	/** Whether this was compiled from the same remap content for the same source layout, the hash alone can collide */
+	bool Matches(const TMap<FName, FConvaiBlendshapeParameters>& InBlendshapeMap, TArrayView<const FName> InSourceNames) const;
+
+	const TArray<FName>& GetSourceNames() const { return SourceNames; }
+
+	/** Output curve names, in the order Evaluate writes them */
+	const TArray<FName>& GetTargetNames() const { return TargetNames; }
+
+	/** SourceValues follows GetSourceNames() and OutTargetValues must hold GetTargetNames().Num() floats */
+	void Evaluate(const float* SourceValues, float GlobalMultiplier, float GlobalOffset, float* OutTargetValues) const;
+
+private:
+	enum class EOpType : uint8
+	{
+		// Source curve without a mapping, passed through
+		Copy,
+		Override,
+		Scale
+	};
+
+	struct FOp
+	{
+		int32 SourceIndex;
+		int32 TargetIndex;
+		float Multiplier;
+		float Offset;
+		float ClampMinValue;
+		float ClampMaxValue;
+		float OverrideValue;
+		EOpType Type;
+		bool IgnoreGlobalModifiers;
+
+		// No earlier op writes the target, otherwise scaled values keep the highest of the two
+		bool FirstWrite;
+	};
+
+	// Kept to tell apart remaps whose hashes collide
+	TMap<FName, FConvaiBlendshapeParameters> BlendshapeMap;
+
+	TArray<FName> SourceNames;
+	TArray<FName> TargetNames;
+	TArray<FOp> Ops;
+	uint32 Hash;
+};
@@ -38,6 +38,7 @@ class UConvaiPlayerComponent;
 class USoundWaveProcedural;
 class UConvaiGRPCGetResponseProxy;
 class UConvaiChatBotGetDetailsProxy;
+struct FConvaiGRPCGetResponseParams;
 
 UCLASS(Blueprintable, BlueprintType, meta = (BlueprintSpawnableComponent), DisplayName = "Convai Chatbot")
 class CONVAI_API UConvaiChatbotComponent : public UConvaiAudioStreamer
@@ -67,6 +68,12 @@ public:
 	UFUNCTION(BlueprintPure, BlueprintCallable, Category = "Convai")
 	bool IsListening();
 
+	/**
+	* Returns true, if the player's audio is piling up because the network or the server is not keeping up with the upload.
+	*/
+	UFUNCTION(BlueprintPure, BlueprintCallable, Category = "Convai")
+	bool IsAudioUplinkBackpressured();
+
 	/**
 	* Returns true, if the character is currently talking.
 	*/
@@ -305,6 +312,9 @@ public:
 public:
 	//UFUNCTION(BlueprintCallable, DisplayName = "Begin Transmission")
 	void StartGetResponseStream(UConvaiPlayerComponent* InConvaiPlayerComponent, FString InputText, UConvaiEnvironment* InEnvironment, bool InGenerateActions, bool InVoiceResponse, bool ReplicateVoiceToNetwork, bool UseOverrideAuthKey, FString OverrideAuthKey, FString OverrideAuthHeader, uint32 InToken);
+
+	// Called by the player talking to this character as soon as it finishes talking, the turn's latency is measured from here
+	void MarkPlayerFinishedTalking(UConvaiPlayerComponent* InConvaiPlayerComponent);
 	
 	UFUNCTION(BlueprintCallable, Category = "Convai", meta = (DisplayName = "Invoke Speech"))
 	void ExecuteNarrativeTrigger(FString TriggerMessage, UConvaiEnvironment* InEnvironment, bool InGenerateActions, bool InVoiceResponse, bool InReplicateOnNetwork);
@@ -314,6 +324,28 @@ public:
 
 	void InvokeTrigger_Internal(FString TriggerName, FString TriggerMessage, UConvaiEnvironment* InEnvironment, bool InGenerateActions, bool InVoiceResponse, bool InReplicateOnNetwork);
 
+	// Opens a response stream and sends its configuration ahead of time, so that the next talk, text or trigger request skips the stream setup.
+	// Call it when the player is about to talk to the character (e.g. looking at or approaching it).
+	// The prepared stream is only used if the request settings still match, and it is dropped if not used within 'TimeoutSeconds'.
+	UFUNCTION(BlueprintCallable, Category = "Convai", meta = (DisplayName = "Prepare Response Stream"))
+	void PrepareGetResponseStream(UConvaiEnvironment* InEnvironment, bool InGenerateActions, bool InVoiceResponse, float TimeoutSeconds = 10);
+
+	// Returns the milestones of the last completed conversation turn
+	UFUNCTION(BlueprintPure, Category = "Convai|Latency")
+	FConvaiLatencyTrace GetLastLatencyTrace() const;
+
+	// Returns the p50/p95 latency of each milestone over the recent turns of this character
+	UFUNCTION(BlueprintCallable, Category = "Convai|Latency")
+	void GetLatencyStats(TArray<FConvaiLatencySpanStats>& OutStats) const;
+
+	// Drops the prepared response stream if there is one
+	UFUNCTION(BlueprintCallable, Category = "Convai", meta = (DisplayName = "Cancel Prepared Response Stream"))
+	void CancelPreparedGetResponseStream();
+
+	// Returns true if a prepared response stream is waiting to be used
+	UFUNCTION(BlueprintPure, Category = "Convai")
+	bool HasPreparedGetResponseStream() const;
+
 	// Interrupts the current speech with a provided fade-out duration. 
 	// The fade-out duration is controlled by the parameter 'InVoiceFadeOutDuration'.
 	UFUNCTION(BlueprintCallable, Category = "Convai")
@@ -370,6 +402,15 @@ private:
 private:
 	void Start_GRPC_Request(bool UseOverrideAuthKey, FString OverrideAuthKey, FString OverrideAuthHeader, FString TriggerName = "", FString TriggerMessage = "");
 
+	void Make_GRPC_Request_Params(FConvaiGRPCGetResponseParams& OutParams, bool InGenerateActions, bool InVoiceResponse, bool UseOverrideAuthKey, FString OverrideAuthKey, FString OverrideAuthHeader, bool CaptureVision);
+
+	// Hands the prepared stream over as the current request if it was opened with matching settings, drops it otherwise
+	bool TryAttachPreparedStream(const FConvaiGRPCGetResponseParams& Params);
+
+	void DropPreparedStream();
+
+	void OnPreparedStreamClosed();
+
 	void Bind_GRPC_Request_Delegates();
 
 	void Unbind_GRPC_Request_Delegates();
@@ -393,7 +434,7 @@ private:
 	void Broadcast_onEmotionReceived(const FString& ReceivedEmotionResponse, bool MultipleEmotions);
 
 	void OnTranscriptionReceived(FString Transcription, bool IsTranscriptionReady, bool IsFinal);
-	void onResponseDataReceived(const FString ReceivedText, const TArray<uint8>& ReceivedAudio, uint32 SampleRate, bool IsFinal);
+	void onResponseDataReceived(const FString ReceivedText, const FConvaiPCMChunkPtr& ReceivedAudio, uint32 SampleRate, bool IsFinal);
 	void OnFaceDataReceived(FAnimationSequence FaceDataAnimation);
 	void onSessionIDReceived(FString ReceivedSessionID);
 	void onInteractionIDReceived(FString ReceivedInteractionID);
@@ -419,6 +460,12 @@ private:
 	UPROPERTY()
 	UConvaiGRPCGetResponseProxy* ConvaiGRPCGetResponseProxy;
 
+	UPROPERTY()
+	UConvaiGRPCGetResponseProxy* PreparedGetResponseProxy; // Stream opened ahead of time, waiting for the next request
+
+	FConvaiEnvironmentDetails PreparedEnvironmentDetails; // Environment the prepared stream was configured with
+	FTimerHandle PreparedStreamTimerHandle; // Drops the prepared stream if it is not used in time
+
 	bool GenerateActions; // Should we generate actions
 	bool TextInput; // Whether  to use text or audio as input to the API
 	bool VoiceResponse; // Require audio response from the API
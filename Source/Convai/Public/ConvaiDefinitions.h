@@ -260,23 +260,68 @@ struct FConvaiBlendshapeParameters
 		float ClampMaxValue = 1;
 };
 
+/** Fixed curve layouts a face frame can be stored in */
+UENUM()
+enum class EConvaiFaceCurveSet : uint8
+{
+	/** All the curves are stored by name in FAnimationFrame::BlendShapes */
+	Custom,
+	/** CurveValues follows ConvaiConstants::VisemeNames */
+	Visemes,
+	/** CurveValues follows ConvaiConstants::BlendShapesNames */
+	ARKit
+};
+
+struct CONVAI_API FConvaiFaceCurveSet
+{
+	/** Curve names of a set in CurveValues order, empty for Custom */
+	static const TArray<FName>& GetCurveNames(EConvaiFaceCurveSet CurveSet);
+
+	/** Returns INDEX_NONE if the curve is not part of the set */
+	static int32 FindCurveIndex(EConvaiFaceCurveSet CurveSet, FName CurveName);
+
+	/** Same as above for a UTF-8 name that is not null terminated, without creating an FName. Hint is checked first */
+	static int32 FindCurveIndex(EConvaiFaceCurveSet CurveSet, const ANSICHAR* CurveName, int32 CurveNameLen, int32 Hint = INDEX_NONE);
+};
+
 USTRUCT()
-struct FAnimationFrame
+struct CONVAI_API FAnimationFrame
 {
 	GENERATED_BODY()
 
 		UPROPERTY()
 		int32 FrameIndex = 0;
 
+	/** Curves that are not part of CurveSet, holds the whole frame for Custom frames */
 	UPROPERTY()
 		TMap<FName, float> BlendShapes;
 
-	FString ToString()
+	UPROPERTY()
+		EConvaiFaceCurveSet CurveSet = EConvaiFaceCurveSet::Custom;
+
+	/** One value per curve of CurveSet, in the order of FConvaiFaceCurveSet::GetCurveNames */
+	UPROPERTY()
+		TArray<float> CurveValues;
+
+	/** Switches the frame to a fixed layout with all the curves of the set at zero */
+	void InitCurveSet(EConvaiFaceCurveSet InCurveSet);
+
+	int32 NumCurves() const { return CurveValues.Num() + BlendShapes.Num(); }
+
+	/** Returns false if the frame does not have the curve */
+	bool FindCurveValue(FName CurveName, float& OutValue) const;
+
+	void SetCurveValue(FName CurveName, float Value);
+
+	/** Builds the by-name view of the frame, for Blueprint and lipsync components that work with curve names */
+	TMap<FName, float> GetBlendShapes() const;
+
+	FString ToString() const
 	{
 		FString Result;
 
 		// iterate over all elements in the TMap
-		for (const auto& Elem : BlendShapes)
+		for (const auto& Elem : GetBlendShapes())
 		{
 			// Append the key-value pair to the result string
 			Result += Elem.Key.ToString() + TEXT(": ") + FString::SanitizeFloat(Elem.Value) + TEXT(", ");
@@ -320,7 +365,7 @@ public:
 
 			// Convert BlendShapes to a JSON object
 			TSharedPtr<FJsonObject> JsonBlendShapes = MakeShareable(new FJsonObject);
-			for (const auto& Elem : Frame.BlendShapes)
+			for (const auto& Elem : Frame.GetBlendShapes())
 			{
 				JsonBlendShapes->SetNumberField(Elem.Key.ToString(), Elem.Value);
 			}
@@ -930,7 +975,9 @@ namespace ConvaiConstants
 		VoiceCaptureChunk = 2084,
 		VoiceStreamMaxChunk = 4096,
 		PlayerTimeOut = 2500 /* 2500 ms*/,
-		ChatbotTimeOut = 6000 /* 6000 ms*/
+		ChatbotTimeOut = 6000 /* 6000 ms*/,
+		ReplyArenaResetInterval = 32 /* Number of stream reads between protobuf reply arena resets */,
+		LatencyStatsWindow = 200 /* Number of recent turns kept per character for latency percentiles */
 	};
 
 	const TArray<FString> BlendShapesNames = { "browDownLeft", "browDownRight", "browInnerUp", "browOuterUpLeft", "browOuterUpRight", "cheekPuff", "cheekSquintLeft", "cheekSquintRight", "eyeBlinkLeft", "eyeBlinkRight", "eyeLookDownLeft", "eyeLookDownRight", "eyeLookInLeft", "eyeLookInRight", "eyeLookOutLeft", "eyeLookOutRight", "eyeLookUpLeft", "eyeLookUpRight", "eyeSquintLeft", "eyeSquintRight", "eyeWideLeft", "eyeWideRight", "jawForward", "jawLeft", "jawOpen", "jawRight", "mouthClose", "mouthDimpleLeft", "mouthDimpleRight", "mouthFrownLeft", "mouthFrownRight", "mouthFunnel", "mouthLeft", "mouthLowerDownLeft", "mouthLowerDownRight", "mouthPressLeft", "mouthPressRight", "mouthPucker", "mouthRight", "mouthRollLower", "mouthRollUpper", "mouthShrugLower", "mouthShrugUpper", "mouthSmileLeft", "mouthSmileRight", "mouthStretchLeft", "mouthStretchRight", "mouthUpperUpLeft", "mouthUpperUpRight", "noseSneerLeft", "noseSneerRight", "tongueOut", /*"headRoll", "headPitch", "headYaw"*/ };
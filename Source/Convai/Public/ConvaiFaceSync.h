@@ -6,13 +6,29 @@
 
 #include "Components/SceneComponent.h"
 #include "Containers/Map.h"
+#include "Containers/TripleBuffer.h"
+#include "Animation/CurveSourceInterface.h"
 #include "ConvaiDefinitions.h"
+#include "ConvaiBlendshapeMap.h"
 #include "ConvaiFaceSync.generated.h"
 
 DECLARE_LOG_CATEGORY_EXTERN(ConvaiFaceSyncLog, Log, All);
 
+UENUM(BlueprintType)
+enum class EConvaiFaceLOD : uint8
+{
+	/** Every curve, evaluated every frame */
+	Full,
+	/** Jaw, mouth and tongue curves only, evaluated at ReducedLODUpdateRate */
+	Reduced,
+	/** A few mouth shapes, evaluated at MinimalLODUpdateRate */
+	Minimal,
+	/** Face data is not requested for the next responses, the curves are no longer interpolated and stay at rest */
+	Off
+};
+
 UCLASS(meta = (BlueprintSpawnableComponent), DisplayName = "Convai Face Sync")
-class CONVAI_API UConvaiFaceSyncComponent : public USceneComponent, public IConvaiLipSyncExtendedInterface
+class CONVAI_API UConvaiFaceSyncComponent : public USceneComponent, public IConvaiLipSyncExtendedInterface, public ICurveSourceInterface
 {
 	GENERATED_BODY()
 public:
@@ -22,6 +38,7 @@ public:
 
 	// UActorComponent interface
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 	// virtual void OnRegister() override;
 	// virtual void OnUnregister() override;
 	virtual void TickComponent(float DeltaTime, enum ELevelTick TickType,
@@ -31,12 +48,7 @@ public:
 	// IConvaiLipSyncInterface
 	virtual void ConvaiProcessLipSync(uint8* InPCMData, uint32 InPCMDataSize, uint32 InSampleRate, uint32 InNumChannels) override { return; }
 	virtual void ConvaiStopLipSync() override;
-	virtual TArray<float> ConvaiGetVisemes() override 
-	{ 
-		TArray<float> VisemeValues;
-		CurrentBlendShapesMap.GenerateValueArray(VisemeValues);
-		return VisemeValues;
-	}
+	virtual TArray<float> ConvaiGetVisemes() override { return CurrentCurveValues; }
 	virtual TArray<FString> ConvaiGetVisemeNames() override { return ConvaiConstants::VisemeNames; }
 	// End IConvaiLipSyncInterface interface
 
@@ -45,11 +57,40 @@ public:
 	virtual void ConvaiProcessLipSyncSingleFrame(FAnimationFrame FaceFrame, float Duration) override;
 	virtual bool RequiresPreGeneratedFaceData() override { return true; }
 	virtual bool GeneratesVisemesAsBlendshapes() override { return ToggleBlendshapeOrViseme; }
-	virtual TMap<FName, float> ConvaiGetFaceBlendshapes() override { return CurrentBlendShapesMap; }
+	virtual TMap<FName, float> ConvaiGetFaceBlendshapes() override { return GetCurrentFrame(); }
+	virtual void ConvaiSetPlaybackClock(TSharedPtr<const FConvaiPlaybackClock, ESPMode::ThreadSafe> InPlaybackClock) override;
+	virtual bool ConvaiShouldRequestFaceData() override { return ShouldRequestFaceData(); }
 	// End IConvaiLipSyncExtendedInterface interface
 
-	virtual void Apply_StartEndFrames_PostProcessing(const int& CurrentFrameIndex, const int& NextFrameIndex, float& Alpha, TMap<FName, float>& StartFrame, TMap<FName, float>& EndFrame){}
-	virtual void ApplyPostProcessing() {}
+	// ICurveSourceInterface, read by the Curve Source anim node on the animation worker threads
+	virtual FName GetBindingName_Implementation() const override { return CurveSourceBindingName; }
+	virtual float GetCurveValue_Implementation(FName CurveName) const override;
+	virtual void GetCurves_Implementation(TArray<FNamedCurveValue>& OutCurves) const override;
+	// End ICurveSourceInterface interface
+
+	// StartFrame and EndFrame are in the order of GetCurveNames()
+	virtual void Apply_StartEndFrames_CurvePostProcessing(const int& CurrentFrameIndex, const int& NextFrameIndex, float& Alpha, TArray<float>& StartFrame, TArray<float>& EndFrame){}
+
+	// Runs on CurrentCurveValues after the frames are blended
+	virtual void ApplyCurvePostProcessing() {}
+
+	// Still called after the curve hook, the frames are built by name for it. Overrides must not call the base version, reaching it turns the by-name path off
+	UE_DEPRECATED(3.3, "Override Apply_StartEndFrames_CurvePostProcessing, which works on arrays in the order of GetCurveNames()")
+	virtual void Apply_StartEndFrames_PostProcessing(const int& CurrentFrameIndex, const int& NextFrameIndex, float& Alpha, TMap<FName, float>& StartFrame, TMap<FName, float>& EndFrame) { bUsesStartEndFramesMapPostProcessing = false; }
+
+	// Still called after the curve hook with CurrentBlendShapesMap up to date, its edits are copied back to CurrentCurveValues. Overrides must not call the base version
+	UE_DEPRECATED(3.3, "Override ApplyCurvePostProcessing, which works on CurrentCurveValues")
+	virtual void ApplyPostProcessing() { bUsesMapPostProcessing = false; }
+
+	// Advances the buffered sequence, evaluates CurrentCurveValues and fires OnVisemesDataReady, called every tick
+	void EvaluateLipSync();
+
+	// EvaluateLipSync without the Blueprint event, safe to run on a worker thread. Returns true when OnVisemesDataReady should fire
+	// Subclasses overriding the post processing hooks must keep them thread safe as well
+	bool EvaluateCurves();
+
+	// ConvaiStopLipSync without the Blueprint event
+	void ResetLipSync();
 
 	// UFUNCTION(BlueprintCallable, Category = "Convai|LipSync")
 	void StartRecordingLipSync();
@@ -65,23 +106,31 @@ public:
 	bool IsPlaying();
 
 	// Record the current time if this is the first LipSync sequence to be received after silence
-	void CalculateStartingTime();
+	// Sequences following the playback clock start where their voice starts and then advance with the voice actually played
+	void CalculateStartingTime(bool FollowPlaybackClock = false);
 
 	void ClearMainSequence();
 
 	TMap<FName, float> InterpolateFrames(const TMap<FName, float>& StartFrame, const TMap<FName, float>& EndFrame, float Alpha);
 
+	// Vectorized lerp of Num curves, Result can alias Start or End
+	static void InterpolateCurves(const float* Start, const float* End, float Alpha, float* Result, int32 Num);
+
+	EConvaiFaceCurveSet GetCurveSet() { return GeneratesVisemesAsBlendshapes() ? EConvaiFaceCurveSet::ARKit : EConvaiFaceCurveSet::Visemes; }
+
+	const TArray<FName>& GetCurveNames() { return FConvaiFaceCurveSet::GetCurveNames(GetCurveSet()); }
+
+	// Copies the curves of a frame in the order of GetCurveNames(), OutCurves must already have the right size
+	void CopyFrameCurves(const FAnimationFrame& Frame, TArray<float>& OutCurves);
+
 	TMap<FName, float> GenerateZeroFrame() { return GeneratesVisemesAsBlendshapes() ? ZeroBlendshapeFrame : ZeroVisemeFrame; }
 
-	void SetCurrentFrametoZero() 
-	{ 
-		if (GeneratesVisemesAsBlendshapes()) 
-			CurrentBlendShapesMap = ZeroBlendshapeFrame; 
-		else 
-			CurrentBlendShapesMap = ZeroVisemeFrame;
-	}
+	const TArray<float>& GetZeroCurveValues();
 
-	TMap<FName, float> GetCurrentFrame() { return CurrentBlendShapesMap; }
+	void SetCurrentFrametoZero();
+
+	// Builds the by-name view of CurrentCurveValues when it changed since the last call
+	TMap<FName, float> GetCurrentFrame();
 
 	const static TMap<FName, float> ZeroBlendshapeFrame;
 	const static TMap<FName, float> ZeroVisemeFrame;
@@ -92,9 +141,117 @@ public:
 	UPROPERTY(EditAnywhere, Category = "Convai|LipSync")
 	bool ToggleBlendshapeOrViseme = false;
 
+	/** Name a Curve Source anim node binds to, to read the face curves without going through Blueprint */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Convai|LipSync|Curve Source")
+	FName CurveSourceBindingName = ICurveSourceInterface::DefaultBinding;
+
+	/** Remapping applied to the curves handed to the Curve Source anim node, same as UConvaiUtils::MapBlendshapes. Change it at runtime through SetCurveSourceBlendshapeMap */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Convai|LipSync|Curve Source")
+	TMap<FName, FConvaiBlendshapeParameters> CurveSourceBlendshapeMap;
+
+	UFUNCTION(BlueprintCallable, Category = "Convai|LipSync|Curve Source")
+	void SetCurveSourceBlendshapeMap(const TMap<FName, FConvaiBlendshapeParameters>& InBlendshapeMap);
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Convai|LipSync|Curve Source")
+	float CurveSourceGlobalMultiplier = 1;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Convai|LipSync|Curve Source")
+	float CurveSourceGlobalOffset = 0;
+
+	/** Let UConvaiFaceSyncSubsystem pick the LOD from the distance to the local viewers and whether the owner was recently rendered */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Convai|LipSync|LOD")
+	bool AutomaticFaceLOD = true;
+
+	/** Distances are for a 90 degrees field of view and scale with the viewer zoom */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Convai|LipSync|LOD", meta = (ClampMin = "0"))
+	float ReducedLODDistance = 1500;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Convai|LipSync|LOD", meta = (ClampMin = "0"))
+	float MinimalLODDistance = 4000;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Convai|LipSync|LOD", meta = (ClampMin = "0"))
+	float OffLODDistance = 10000;
+
+	/** Lowest detail used while the owner is not rendered */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Convai|LipSync|LOD")
+	EConvaiFaceLOD OffscreenLOD = EConvaiFaceLOD::Minimal;
+
+	/** Evaluations per second at the Reduced LOD */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Convai|LipSync|LOD", meta = (ClampMin = "1"))
+	float ReducedLODUpdateRate = 30;
+
+	/** Evaluations per second at the Minimal LOD, the Off LOD only follows the sequence timing at this rate */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Convai|LipSync|LOD", meta = (ClampMin = "1"))
+	float MinimalLODUpdateRate = 15;
+
+	UFUNCTION(BlueprintPure, Category = "Convai|LipSync|LOD")
+	EConvaiFaceLOD GetFaceLOD() const { return FaceLOD; }
+
+	/** Called by UConvaiFaceSyncSubsystem when AutomaticFaceLOD is set, can be called directly to drive the LOD from custom significance */
+	UFUNCTION(BlueprintCallable, Category = "Convai|LipSync|LOD")
+	void SetFaceLOD(EConvaiFaceLOD InFaceLOD);
+
+	EConvaiFaceLOD ComputeFaceLOD(float ViewDistance, bool RecentlyRendered) const;
+
+	/** False at the Off LOD, read when the chatbot builds the next GetResponse request */
+	bool ShouldRequestFaceData() const { return FaceLOD != EConvaiFaceLOD::Off; }
+
+	/** Returns true when the LOD update rate allows an evaluation at Now, and consumes it */
+	bool ConsumeEvaluation(double Now);
+
+	/** Called by UConvaiFaceSyncSubsystem, the component tick function stays unregistered while the subsystem evaluates the component */
+	void SetEvaluatedBySubsystem(bool InEvaluatedBySubsystem);
+
+	bool IsEvaluatedBySubsystem() const { return EvaluatedBySubsystem; }
+
+	/** Whether the subsystem should evaluate the component at WorldTime, follows the active state, tick enabled state and tick interval like the component tick would */
+	bool ConsumeSubsystemTick(double WorldTime);
+
 protected:
+	virtual void RegisterComponentTickFunctions(bool bRegister) override;
+
 	float CurrentSequenceTimePassed;
+
+	// Evaluated curves in the order of GetCurveNames()
+	TArray<float> CurrentCurveValues;
+	TArray<float> StartFrameCurves;
+	TArray<float> EndFrameCurves;
+
 	TMap<FName, float> CurrentBlendShapesMap;
+	bool CurrentBlendShapesMapDirty;
+
+	// Cleared the first time the default implementation of a deprecated by-name hook runs, i.e. it is not overridden
+	bool bUsesStartEndFramesMapPostProcessing = true;
+	bool bUsesMapPostProcessing = true;
+
+	// Runs the deprecated by-name hooks and copies their edits back to the curve arrays
+	void ApplyStartEndFramesMapPostProcessing(int CurrentFrameIndex, int NextFrameIndex, float& Alpha);
+	void ApplyMapPostProcessing();
+
+	// Copies the remapped CurrentCurveValues to the snapshot the Curve Source readers see
+	void PublishCurveSnapshot();
+
+	// Compiled from CurveSourceBlendshapeMap on BeginPlay and SetCurveSourceBlendshapeMap, and again when the curve set changes
+	void CompileCurveSourceMap();
+	TSharedPtr<const FConvaiCompiledBlendshapeMap, ESPMode::ThreadSafe> CompiledCurveSourceMap;
+	EConvaiFaceCurveSet CompiledCurveSourceSet = EConvaiFaceCurveSet::Custom;
+	TArray<float> RemappedCurveValues;
+
+	// Written by the evaluating thread and read by the animation threads without blocking the writer
+	mutable TTripleBuffer<TArray<FNamedCurveValue>> CurveSnapshot;
+
+	// Only serializes concurrent readers of the snapshot, e.g. several meshes bound to the same face
+	mutable FCriticalSection CurveSnapshotReadCriticalSection;
+
+	// Drops the curves the current LOD does not keep
+	void ApplyFaceLODCurves();
+
+	EConvaiFaceLOD FaceLOD = EConvaiFaceLOD::Full;
+	double NextEvaluationTime = 0;
+
+	bool EvaluatedBySubsystem = false;
+	double NextSubsystemTickTime = 0;
+
 	FAnimationSequence MainSequenceBuffer;
 	FAnimationSequence RecordedSequenceBuffer;
 	FCriticalSection SequenceCriticalSection;
@@ -103,6 +260,20 @@ protected:
 	bool IsRecordingLipSync;
 
 private:
+	// Appends to the main sequence, FollowPlaybackClock is false for sequences played without the streamed voice
+	void AppendSequence(const FAnimationSequence& FaceSequence, bool FollowPlaybackClock);
+
+	// Current time on the clock the main sequence is played with
+	double GetSequenceTime() const;
+
 	double StartTime;
 	bool bIsPlaying;
+
+	// Sequence time and world time at which the sequence clock last moved while waiting for the voice to start
+	double LastWaitingSequenceTime = -1;
+	double LastWaitingProgressTime = 0;
+
+	// Set by the audio streamer, guarded by SequenceCriticalSection
+	TSharedPtr<const FConvaiPlaybackClock, ESPMode::ThreadSafe> PlaybackClock;
+	bool SequenceFollowsPlaybackClock = false;
 };
\ No newline at end of file
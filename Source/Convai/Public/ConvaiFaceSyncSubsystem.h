@@ -0,0 +1,82 @@
+// Copyright 2022 Convai Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/EngineBaseTypes.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "ConvaiFaceSyncSubsystem.generated.h"
+
+DECLARE_LOG_CATEGORY_EXTERN(ConvaiFaceSyncSubsystemLog, Log, All);
+
+class UConvaiFaceSyncComponent;
+class UConvaiFaceSyncSubsystem;
+
+USTRUCT()
+struct FConvaiFaceSyncTickFunction : public FTickFunction
+{
+	GENERATED_BODY()
+
+	UConvaiFaceSyncSubsystem* Subsystem = nullptr;
+
+	virtual void ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent) override;
+
+	virtual FString DiagnosticMessage() override { return TEXT("FConvaiFaceSyncTickFunction"); }
+};
+
+template<>
+struct TStructOpsTypeTraits<FConvaiFaceSyncTickFunction> : public TStructOpsTypeTraitsBase2<FConvaiFaceSyncTickFunction>
+{
+	enum
+	{
+		WithCopy = false
+	};
+};
+
+/**
+ * Tracks the face sync components of the world and picks their face LOD a few times per second, see UConvaiFaceSyncComponent::AutomaticFaceLOD.
+ * With convai.FaceSync.Batched, off by default, also evaluates them once per frame in parallel instead of one component tick each.
+ * Batched evaluation runs in TG_PrePhysics ahead of the skeletal meshes of the registered owners, so the curves they read during animation are from this frame.
+ * Components register themselves on BeginPlay, batched ones keep their active state, tick enabled state and tick interval.
+ */
+UCLASS()
+class CONVAI_API UConvaiFaceSyncSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	/** Returns null when the world has no subsystem, e.g. outside of game worlds */
+	static UConvaiFaceSyncSubsystem* Get(const UWorld* World);
+
+	// USubsystem interface
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+	// End USubsystem interface
+
+	void RegisterFaceSync(UConvaiFaceSyncComponent* FaceSync);
+
+	void UnregisterFaceSync(UConvaiFaceSyncComponent* FaceSync);
+
+	int32 GetNumFaceSyncs() const { return FaceSyncs.Num(); }
+
+	/** Evaluates the curves of the components in parallel, then fires their Blueprint events on the calling thread */
+	static void EvaluateFaceSyncs(const TArray<UConvaiFaceSyncComponent*>& InFaceSyncs);
+
+private:
+	friend struct FConvaiFaceSyncTickFunction;
+
+	void Tick();
+
+	void UpdateFaceLODs();
+
+	UPROPERTY()
+	TArray<UConvaiFaceSyncComponent*> FaceSyncs;
+
+	// Components evaluated this frame, kept to reuse the allocation
+	TArray<UConvaiFaceSyncComponent*> DueFaceSyncs;
+
+	double NextFaceLODUpdateTime = 0;
+
+	FConvaiFaceSyncTickFunction TickFunction;
+};
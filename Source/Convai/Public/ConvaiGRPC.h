@@ -10,6 +10,10 @@
 #include "Net/OnlineBlueprintCallProxyBase.h"
 #include "HAL/ThreadSafeBool.h"
 #include "ConvaiDefinitions.h"
+#include "ConvaiLatencyTracing.h"
+#include "ConvaiStreamRecording.h"
+#include "ConvaiPCMChunk.h"
+#include "Containers/Ticker.h"
 #include "Containers/Map.h"
 #include "ConvaiGRPC.generated.h"
 
@@ -25,7 +29,7 @@ struct FConvaiResultAction;
 
 DECLARE_DELEGATE_ThreeParams(FConvaiGRPCOnNarrativeDataSignature, const FString /*BT_Code*/, const FString /*BT_Constants*/, const FString /*NarrativeSectionID*/);
 DECLARE_DELEGATE_ThreeParams(FConvaiGRPCOnTranscriptionSignature, const FString /*Transcription*/, bool /*IsTranscriptionReady*/, bool /*IsFinal*/);
-DECLARE_DELEGATE_FourParams(FConvaiGRPCOnDataSignature, const FString /*ReceivedText*/, const TArray<uint8>& /*ReceivedAudio*/, uint32 /*SampleRate*/, bool /*IsFinal*/);
+DECLARE_DELEGATE_FourParams(FConvaiGRPCOnDataSignature, const FString /*ReceivedText*/, const FConvaiPCMChunkPtr& /*ReceivedAudio*/, uint32 /*SampleRate*/, bool /*IsFinal*/);
 DECLARE_DELEGATE_OneParam(FConvaiGRPCOnFaceDataSignature, FAnimationSequence /*FaceData*/);
 DECLARE_DELEGATE_OneParam(FConvaiGRPCOnActionsSignature, const TArray<FConvaiResultAction>& /*ActionSequence*/);
 DECLARE_DELEGATE_ThreeParams(FConvaiGRPCOnEmotionSignature, FString /*EmotionResponse*/, FAnimationFrame /*EmotionBlendshapes*/, bool /*MultipleEmotions*/);
@@ -69,6 +73,9 @@ struct FConvaiGRPCGetResponseParams
 
 	bool GeneratesVisemesAsBlendshapes;
 
+	// The face asked not to get face data, RequireFaceData was cleared for it
+	bool FaceDataSkipped;
+
 	FString SessionID;
 
 	UConvaiEnvironment* Environment;
@@ -83,6 +90,9 @@ struct FConvaiGRPCGetResponseParams
 
 	TMap<FString, FString> Narrative_Template_Keys;
 
+	// Timing of the conversation turn this request belongs to, can be null
+	FConvaiTurnTracePtr LatencyTrace;
+
 	FConvaiGRPCGetResponseParams()
 		: UserQuery(TEXT(""))
 		, TriggerName(TEXT(""))
@@ -91,6 +101,7 @@ struct FConvaiGRPCGetResponseParams
 		, VoiceResponse(false)
 		, RequireFaceData(false)
 		, GeneratesVisemesAsBlendshapes(false)
+		, FaceDataSkipped(false)
 		, SessionID(TEXT(""))
 		, Environment(nullptr)
 		, GenerateActions(false)
@@ -143,10 +154,43 @@ public:
 
 	void Activate();
 
+	/**
+	 * Opens the stream and sends the configuration ahead of time, then holds off sending any data until Attach is called.
+	 * Used to hide the stream setup round trip before the player starts talking.
+	 */
+	void Prepare();
+
+	/** Returns true if this is a prepared stream that is still open and waiting for Attach */
+	bool IsAwaitingAttach() const;
+
+	/**
+	 * Returns true if a prepared stream was opened with a configuration compatible with these params.
+	 * The environment is not compared, the caller checks its contents since a prepared stream holds its own copy
+	 */
+	bool CanAttach(const FConvaiGRPCGetResponseParams& InParams) const;
+
+	/** Supplies the user input of the request for a prepared stream and lets it start sending data */
+	void Attach(const FConvaiGRPCGetResponseParams& InParams);
+
+	/** Cancels the stream, the pending operations will complete with a failure */
+	void Cancel();
+
 	void WriteAudioDataToSend(uint8* Buffer, uint32 Length, bool LastWrite);
 
+	/**
+	 * Hands over a chunk of audio without copying it when the send buffer is empty, by swapping the arrays.
+	 * InOutAudioData comes back empty, holding a previously used allocation that the caller can refill.
+	 */
+	void WriteAudioDataToSend(TArray<uint8>& InOutAudioData, bool LastWrite);
+
 	void FinishWriting();
 
+	/** True while more unsent mic audio is queued than the configured backpressure threshold */
+	bool IsUplinkBackpressured() const;
+
+	/** Duration of the mic audio waiting to be sent */
+	int32 GetUplinkBacklogMs() const;
+
 	//~ Begin UObject Interface.
 	virtual void BeginDestroy() override;
 	//~ End UObject Interface.
@@ -155,7 +199,11 @@ private:
 
 	void CallFinish();
 
-	TArray<uint8> ConsumeFromAudioBuffer(bool& IsThisTheFinalWrite);
+	// Moves the next whole frames of pending audio into SendAudioBuffer, returns false if there was nothing to send yet
+	bool ConsumeFromAudioBuffer(bool& IsThisTheFinalWrite);
+
+	// Caller holds m_mutex
+	void UpdateUplinkBackpressure(int32 BacklogBytes);
 
 	void LogAndEcecuteFailure(FString FuncName);
 
@@ -167,6 +215,11 @@ private:
 	void OnStreamWriteDone(bool ok);
 	void OnStreamFinish(bool ok);
 
+	// Feeds the responses of the capture that are due through OnStreamRead, runs on the core ticker and returns false once done
+	bool TickReplay(float DeltaTime);
+
+	void StopReplay();
+
 	FgRPC_Delegate OnInitStreamDelegate;
 	FgRPC_Delegate OnStreamReadDelegate;
 	FgRPC_Delegate OnStreamWriteDelegate;
@@ -177,8 +230,20 @@ private:
 	// https://groups.google.com/g/grpc-io/c/R0NTqKaHLdE 
 	FgRPC_Delegate OnStreamFinishDelegate;
 
-	service::GetResponseRequest request;
-	std::unique_ptr<service::GetResponseResponse> reply;
+	// Backs the request and its sub-messages for the lifetime of the stream
+	google::protobuf::Arena RequestArena;
+
+	// Backs the reply, reset every few reads since each read allocates new response sub-messages on it
+	google::protobuf::Arena ReplyArena;
+	int32 ReadsSinceReplyArenaReset = 0;
+	int32 NumReplyArenaResets = 0;
+
+	// Both owned by their arena
+	service::GetResponseRequest* request = nullptr;
+	service::GetResponseResponse* reply = nullptr;
+
+	// Data message taken back from the request after each write so its allocations are reused by the next one, owned by RequestArena
+	service::GetResponseRequest_GetResponseData* ReusableResponseData = nullptr;
 
 	// Context for the client. It could be used to convey extra information to
 	// the server and/or tweak certain RPC behaviors.
@@ -196,33 +261,83 @@ private:
 
 	bool FailAlreadyExecuted = false;
 
-	std::unique_ptr<service::ConvaiService::Stub> stub_;
+	// Shared stub owned by the subsystem's channel pool
+	service::ConvaiService::Stub* stub_ = nullptr;
 
 	grpc::CompletionQueue* cq_;
 
+	// Channel and completion queue slots this stream was assigned from the subsystem's pools
+	TWeakPtr<FgRPCClient> gRPC_Client;
+	int32 ChannelIndex = INDEX_NONE;
+	int32 CompletionQueueIndex = INDEX_NONE;
+
+	// Streams of the same owner share a completion queue so its callbacks are serialized on one thread
+	uint32 CompletionQueueAffinity = 0;
+
+	void ReleasePooledResources();
+
 	uint32 NumberOfAudioBytesSent = 0;
 
+	// Captures the stream traffic when convai.GetResponse.RecordDirectory is set
+	TUniquePtr<FConvaiStreamRecorder> Recorder;
+
+	// Played back instead of the network when convai.GetResponse.ReplayFile is set
+	TSharedPtr<const FConvaiStreamReplay, ESPMode::ThreadSafe> Replay;
+#if ENGINE_MAJOR_VERSION < 5
+	FDelegateHandle ReplayTickerHandle;
+#else
+	FTSTicker::FDelegateHandle ReplayTickerHandle;
+#endif
+	FThreadSafeBool ReplayCancelled;
+	int32 ReplayRecordIndex = 0;
+
+	// Negative until the user input is attached and playback starts
+	double ReplayStartTime = -1;
+
 private:
 	// Inputs
 	FConvaiGRPCGetResponseParams ConvaiGRPCGetResponseParams;
 
+	// Keeps the environment of the params alive for as long as the stream reads from it, e.g. the copy a prepared stream was built from
+	UPROPERTY()
+	UConvaiEnvironment* EnvironmentRef = nullptr;
+
 
 private:
 	// becomes true if we receive a non-ok header
 	FThreadSafeBool InformOnDataReceived;
 
-	// Stores the audio data to be streamed to the API
+	// Stores the audio data to be streamed to the API, filled by the game thread
 	TArray<uint8> AudioBuffer;
 
+	// Audio being sent by the current write, swapped with AudioBuffer so it is only accessed by the writer
+	TArray<uint8> SendAudioBuffer;
+
 	// True when we are informed that the "AudioBuffer" is complete and no more audio will be received
 	FThreadSafeBool LastWriteReceived;
 
-	// Used to regulate access to the AudioBuffer to prevent racing condition
+	// Uplink pacing, audio is sent in whole frames with at most UplinkMaxWriteBytes per write (gRPC allows a single write in flight)
+	int32 UplinkFrameBytes = 0;
+	int32 UplinkMaxWriteBytes = MAX_int32;
+	int32 UplinkBackpressureBytes = MAX_int32;
+	FThreadSafeCounter UplinkBacklogBytes;
+	FThreadSafeBool UplinkBackpressured;
+
+	// Used to regulate access to the AudioBuffer and LastWriteReceived to prevent racing condition
 	FCriticalSection m_mutex;
 
 	// Used to prevent early execution of the Init delegate 
 	FCriticalSection GPRCInitSection;
 
+	// True while a prepared stream is waiting for Attach before sending data
+	bool AwaitingAttach = false;
+
+	// Set when a write completed while the stream was waiting for Attach
+	bool WriteDeferredUntilAttach = false;
+
+	// Regulates access to AwaitingAttach and WriteDeferredUntilAttach
+	FCriticalSection AttachSection;
+
 	// Pointer to the world
 	TWeakObjectPtr<UWorld> WorldPtr;
 
@@ -303,7 +418,15 @@ private:
 	// the server and/or tweak certain RPC behaviors.
 	grpc::ClientContext client_context;
 
-	std::unique_ptr<service::ConvaiService::Stub> stub_;
+	// Shared stub owned by the subsystem's channel pool
+	service::ConvaiService::Stub* stub_ = nullptr;
 
 	grpc::CompletionQueue* cq_;
+
+	// Channel and completion queue slots this request was assigned from the subsystem's pools
+	TWeakPtr<FgRPCClient> gRPC_Client;
+	int32 ChannelIndex = INDEX_NONE;
+	int32 CompletionQueueIndex = INDEX_NONE;
+
+	void ReleasePooledResources();
 };
\ No newline at end of file
@@ -0,0 +1,92 @@
+// Copyright 2022 Convai Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+DECLARE_LOG_CATEGORY_EXTERN(ConvaiJitterBufferLog, Log, All);
+
+struct CONVAI_API FConvaiJitterStats
+{
+	/* Current voice pre-roll waiting for face data */
+	float PreRollSecs = 0;
+
+	/* Smoothed inter-arrival jitter of the audio and face chunks, RFC 3550 style */
+	float AudioJitterSecs = 0;
+	float FaceJitterSecs = 0;
+
+	/* Latest a chunk arrived after it was due in the last finished response */
+	float LastPeakLatenessSecs = 0;
+
+	int32 NumSessions = 0;
+
+	/* Voice paused because the face data ran out */
+	int32 NumFaceUnderruns = 0;
+
+	/* Voice ran dry and more audio of the same response arrived afterwards */
+	int32 NumAudioUnderruns = 0;
+};
+
+/**
+ * Adaptive playout buffer sizing the pre-roll that holds the voice back until enough face data is buffered.
+ * Every response is a session. Chunks are scheduled from the first audio chunk at the media rate, and the lateness of each
+ * audio and face chunk against that schedule is what a pre-roll has to absorb.
+ * The pre-roll follows the worst lateness of recent responses, jumps up on underruns and decays back on clean responses,
+ * between MinPreRollSecs and MaxPreRollSecs. Can be fed from any thread.
+ */
+class CONVAI_API FConvaiJitterBuffer
+{
+public:
+	void SetPreRollLimits(float InMinPreRollSecs, float InMaxPreRollSecs);
+
+	/** Closes the current response and starts measuring the next one */
+	void BeginSession();
+
+	void OnAudioArrived(float Duration);
+
+	void OnFaceArrived(float Duration);
+
+	/** The voice was paused waiting for face data */
+	void OnFaceUnderrun();
+
+	/** The voice queue ran dry, counted as an underrun if it happens before the end of the response and more audio of it arrives */
+	void OnPlayoutDrained();
+
+	/** The last audio of the response was received or the voice was stopped, later drains are the normal end of playback */
+	void OnEndOfResponse();
+
+	float GetPreRollSecs() const;
+
+	FConvaiJitterStats GetStats() const;
+
+private:
+	struct FArrivalTrack
+	{
+		double LastArrivalTime = -1;
+		double LastMediaTime = 0;
+		double MediaTime = 0;
+		float JitterSecs = 0;
+	};
+
+	void OnArrived(FArrivalTrack& Track, float Duration, double Now);
+
+	void RaisePreRoll(float Secs);
+
+	mutable FCriticalSection CriticalSection;
+
+	float MinPreRollSecs = 0.05f;
+	float MaxPreRollSecs = 0.7f;
+	float PreRollSecs = 0.3f;
+
+	// Schedule origin of the current session, the arrival of its first audio chunk
+	double SessionStartTime = -1;
+	float SessionPeakLatenessSecs = 0;
+	bool SessionHadUnderrun = false;
+	bool PlayoutDrained = false;
+	bool SessionEnded = false;
+
+	FArrivalTrack AudioTrack;
+	FArrivalTrack FaceTrack;
+
+	FConvaiJitterStats Stats;
+};
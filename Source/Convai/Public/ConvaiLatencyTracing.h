@@ -0,0 +1,129 @@
+// Copyright 2022 Convai Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Kismet/BlueprintFunctionLibrary.h"
+#include <atomic>
+#include "ConvaiLatencyTracing.generated.h"
+
+DECLARE_LOG_CATEGORY_EXTERN(ConvaiLatencyLog, Log, All);
+
+/** Milestones of a conversation turn, in the order they are normally reached */
+UENUM(BlueprintType)
+enum class EConvaiLatencySpan : uint8
+{
+	FinishTalking				UMETA(DisplayName = "Finish Talking"),
+	MicDrained					UMETA(DisplayName = "Mic Drained"),
+	LastAudioWritten			UMETA(DisplayName = "Last Audio Written"),
+	WritesDone					UMETA(DisplayName = "Writes Done"),
+	FirstPartialTranscript		UMETA(DisplayName = "First Partial Transcript"),
+	FinalTranscript				UMETA(DisplayName = "Final Transcript"),
+	FirstText					UMETA(DisplayName = "First Text"),
+	FirstAudio					UMETA(DisplayName = "First Audio"),
+	FirstFaceData				UMETA(DisplayName = "First Face Data"),
+	FirstAudioQueued			UMETA(DisplayName = "First Audio Queued"),
+	StartedTalking				UMETA(DisplayName = "Started Talking"),
+	Count						UMETA(Hidden)
+};
+
+CONVAI_API const TCHAR* LexToString(EConvaiLatencySpan Span);
+
+USTRUCT(BlueprintType)
+struct CONVAI_API FConvaiLatencyTrace
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly, Category = "Convai|Latency")
+	FString CharacterID;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Convai|Latency")
+	FString SessionID;
+
+	/** Milliseconds from the start of the turn to each milestone that was reached, for voice turns this includes the time the player was talking */
+	UPROPERTY(BlueprintReadOnly, Category = "Convai|Latency")
+	TMap<EConvaiLatencySpan, float> SpansMs;
+
+	/** Milliseconds from FinishTalking to each milestone that was reached after it, this is the latency the player perceives */
+	UPROPERTY(BlueprintReadOnly, Category = "Convai|Latency")
+	TMap<EConvaiLatencySpan, float> SinceFinishTalkingMs;
+};
+
+/** Percentiles of a milestone measured from FinishTalking, the FinishTalking entry itself is how long the player talked */
+USTRUCT(BlueprintType)
+struct CONVAI_API FConvaiLatencySpanStats
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly, Category = "Convai|Latency")
+	EConvaiLatencySpan Span = EConvaiLatencySpan::FinishTalking;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Convai|Latency")
+	int32 NumSamples = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Convai|Latency")
+	float P50Ms = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Convai|Latency")
+	float P95Ms = 0;
+};
+
+/** Timestamps of a single conversation turn, can be marked from any thread */
+class CONVAI_API FConvaiTurnTrace
+{
+public:
+	FConvaiTurnTrace(const FString& InCharacterID, const FString& InSessionID);
+
+	/** Records the milestone if it was not reached yet */
+	void Mark(EConvaiLatencySpan Span);
+
+	/** Records the milestone, overwriting an earlier time */
+	void MarkLatest(EConvaiLatencySpan Span);
+
+	FConvaiLatencyTrace ToLatencyTrace() const;
+
+	const FString CharacterID;
+	const FString SessionID;
+
+private:
+	const double StartTime;
+
+	// Seconds since StartTime, negative until reached
+	std::atomic<double> SpanTimes[(int32)EConvaiLatencySpan::Count];
+};
+
+typedef TSharedPtr<FConvaiTurnTrace, ESPMode::ThreadSafe> FConvaiTurnTracePtr;
+
+/** Collects finished turns and keeps a window of recent samples per character to compute percentiles */
+class CONVAI_API FConvaiLatencyTracer
+{
+public:
+	static FConvaiLatencyTracer& Get();
+
+	/** Adds a finished turn to the aggregates and writes it to the CSV profiler */
+	void Submit(const FConvaiLatencyTrace& Trace);
+
+	void GetStats(const FString& CharacterID, TArray<FConvaiLatencySpanStats>& OutStats) const;
+
+	void Reset();
+
+private:
+	mutable FCriticalSection CriticalSection;
+
+	// Per character, per span
+	TMap<FString, TArray<TArray<float>>> Samples;
+};
+
+UCLASS()
+class CONVAI_API UConvaiLatencyTracing : public UBlueprintFunctionLibrary
+{
+	GENERATED_BODY()
+
+public:
+	/** Returns the p50/p95 latency of each milestone over the recent turns of a character */
+	UFUNCTION(BlueprintCallable, Category = "Convai|Latency")
+	static void GetLatencyStats(FString CharacterID, TArray<FConvaiLatencySpanStats>& OutStats);
+
+	UFUNCTION(BlueprintCallable, Category = "Convai|Latency")
+	static void ResetLatencyStats();
+};
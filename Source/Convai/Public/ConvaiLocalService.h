@@ -0,0 +1,80 @@
+// Copyright 2022 Convai Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/ThreadSafeCounter.h"
+
+DECLARE_LOG_CATEGORY_EXTERN(ConvaiLocalServiceLog, Log, All);
+
+/** Shape of the synthetic responses produced by the local stand-in service */
+struct CONVAI_API FConvaiLocalServiceOptions
+{
+	/* Port the service listens on, bound to localhost only */
+	int32 Port = 50051;
+
+	/* Delay between the end of the user input and the first response chunk */
+	int32 FirstResponseDelayMs = 300;
+
+	/* Delay between consecutive response chunks */
+	int32 ChunkIntervalMs = 50;
+
+	/* Number of text/audio chunks in each response */
+	int32 NumChunks = 8;
+
+	/* Length of the audio carried by each chunk */
+	int32 AudioChunkMs = 250;
+
+	/* Sample rate of the synthetic audio */
+	int32 SampleRate = 24000;
+
+	/* Number of face frames sent with each chunk when face data is requested */
+	int32 FaceFramesPerChunk = 8;
+
+	/* Send an action string at the end of the response when actions are requested */
+	bool SendActions = true;
+};
+
+/**
+ * In-process stand-in for service::ConvaiService, used to exercise and load test the plugin without the live service.
+ * Point CustomURL at "localhost:<Port>" and enable AllowInsecureConnection to route the plugin traffic to it.
+ */
+class CONVAI_API FConvaiLocalService
+{
+public:
+	static FConvaiLocalService& Get();
+
+	~FConvaiLocalService();
+
+	bool Start(const FConvaiLocalServiceOptions& InOptions);
+
+	void Stop();
+
+	bool IsRunning() const;
+
+	FString GetAddress() const;
+
+	FConvaiLocalServiceOptions GetOptions() const;
+
+	/* Reads options from a "Port=50051 DelayMs=300 ChunkMs=50 Chunks=8 AudioChunkMs=250 SampleRate=24000 FaceFrames=8 Actions=true" string */
+	static FConvaiLocalServiceOptions ParseOptions(const FString& Params);
+
+	/* Number of GetResponse streams served since the service was started */
+	int32 GetNumStreamsServed() const { return NumStreamsServed.GetValue(); }
+
+	/* Called by the service implementation */
+	void OnStreamServed() { NumStreamsServed.Increment(); }
+
+private:
+	FConvaiLocalService() = default;
+
+	mutable FCriticalSection CriticalSection;
+
+	FConvaiLocalServiceOptions Options;
+
+	FThreadSafeCounter NumStreamsServed;
+
+	// Hidden to keep the gRPC headers out of this header
+	struct FImpl;
+	TUniquePtr<FImpl> Impl;
+};
@@ -0,0 +1,77 @@
+// Copyright 2022 Convai Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include <string>
+
+class FConvaiPCMChunk;
+
+DECLARE_LOG_CATEGORY_EXTERN(ConvaiPCMChunkLog, Log, All);
+
+typedef TSharedRef<const FConvaiPCMChunk, ESPMode::ThreadSafe> FConvaiPCMChunkRef;
+typedef TSharedPtr<const FConvaiPCMChunk, ESPMode::ThreadSafe> FConvaiPCMChunkPtr;
+
+/** Process wide counters of the PCM chunks, to check how often voice audio is allocated and copied on its way to playback */
+struct CONVAI_API FConvaiPCMChunkStats
+{
+	/* Chunks created, each is a single allocation holding the chunk and its reference count */
+	int64 NumChunks = 0;
+
+	/* Bytes whose storage was taken over without copying, e.g. strings released from a response message */
+	int64 BytesAdopted = 0;
+
+	/* Copies of PCM made into new storage, each one an allocation too */
+	int64 NumCopies = 0;
+	int64 BytesCopied = 0;
+
+	FString ToString() const;
+};
+
+/**
+ * Immutable block of interleaved 16 bit PCM shared by handle.
+ * It takes over the storage it was made from, so audio released from a response message is passed down to the voice queue
+ * without being copied. Can be shared between threads.
+ */
+class CONVAI_API FConvaiPCMChunk
+{
+public:
+	/** Takes over the storage, the first Offset bytes (e.g. a header) are skipped */
+	FConvaiPCMChunk(std::string&& InStorage, int32 Offset, int32 InSampleRate, int32 InNumChannels);
+	FConvaiPCMChunk(TArray<uint8>&& InStorage, int32 Offset, int32 InSampleRate, int32 InNumChannels);
+
+	FConvaiPCMChunk(const FConvaiPCMChunk&) = delete;
+	FConvaiPCMChunk& operator=(const FConvaiPCMChunk&) = delete;
+
+	static FConvaiPCMChunkRef Create(std::string&& InStorage, int32 Offset, int32 InSampleRate, int32 InNumChannels);
+	static FConvaiPCMChunkRef Create(TArray<uint8>&& InStorage, int32 Offset, int32 InSampleRate, int32 InNumChannels);
+
+	/** For audio the caller does not own, this is the one path that copies */
+	static FConvaiPCMChunkRef CreateCopy(const uint8* InData, int32 InNumBytes, int32 InSampleRate, int32 InNumChannels);
+
+	const uint8* GetData() const { return Data; }
+
+	/** Whole frames only, a trailing partial frame is ignored */
+	int32 GetNumBytes() const { return GetNumFrames() * NumChannels * int32(sizeof(int16)); }
+
+	const int16* GetSamples() const { return reinterpret_cast<const int16*>(Data); }
+	int32 GetNumFrames() const { return NumBytes / (NumChannels * int32(sizeof(int16))); }
+
+	int32 GetSampleRate() const { return SampleRate; }
+	int32 GetNumChannels() const { return NumChannels; }
+
+	float GetDuration() const { return SampleRate > 0 ? float(GetNumFrames()) / SampleRate : 0.0f; }
+
+	static FConvaiPCMChunkStats GetStats();
+	static void ResetStats();
+
+private:
+	// Only one of them holds the audio
+	std::string StringStorage;
+	TArray<uint8> ArrayStorage;
+
+	const uint8* Data = nullptr;
+	int32 NumBytes = 0;
+	int32 SampleRate = 0;
+	int32 NumChannels = 1;
+};
@@ -0,0 +1,31 @@
+// Copyright 2022 Convai Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include <atomic>
+
+/**
+ * Playback position of a voice stream, advanced as the audio renderer consumes the queued samples.
+ * Lipsync and the talking events key off it, so they follow the voice that is actually heard and stall with it on underruns.
+ * Only FConvaiVoiceSource moves it, it can be read from any thread.
+ */
+class CONVAI_API FConvaiPlaybackClock
+{
+public:
+	/** Seconds of voice consumed by the audio renderer since the clock was created */
+	double GetPlayedSeconds() const { return PlayedSeconds.load(std::memory_order_acquire); }
+
+	/** Position on the played timeline at which the most recently queued audio starts */
+	double GetLastQueuedStartSeconds() const { return LastQueuedStartSeconds.load(std::memory_order_acquire); }
+
+	/** Seconds of voice queued but not played yet */
+	double GetRemainingSeconds() const { return FMath::Max(QueuedSeconds.load(std::memory_order_acquire) - GetPlayedSeconds(), 0.0); }
+
+private:
+	friend class FConvaiVoiceSource;
+
+	std::atomic<double> PlayedSeconds{ 0 };
+	std::atomic<double> QueuedSeconds{ 0 };
+	std::atomic<double> LastQueuedStartSeconds{ 0 };
+};
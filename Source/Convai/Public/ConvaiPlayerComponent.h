@@ -4,20 +4,21 @@
 
 #include "CoreMinimal.h"
 #include "Components/AudioComponent.h"
-#include "RingBuffer.h"
+#include "ConvaiSpscRingBuffer.h"
 #include "ConvaiAudioStreamer.h"
 #include "Net/OnlineBlueprintCallProxyBase.h"
 #include "DSP/BufferVectorOperations.h"
+#include "ConvaiSubmixCapture.h"
+#include "ConvaiResampler.h"
 #include "ConvaiPlayerComponent.generated.h"
 
-#define TIME_BETWEEN_VOICE_UPDATES_SECS 0.01
-
 DECLARE_LOG_CATEGORY_EXTERN(ConvaiPlayerLog, Log, All);
 
 DECLARE_DELEGATE(FonDataReceived_Delegate);
 
 // class IVoiceCapture;
 class UConvaiAudioCaptureComponent;
+class UConvaiChatbotComponent;
 
 // UENUM(BlueprintType)
 // enum class EHardwareInputFeatureBP : uint8
@@ -212,6 +213,7 @@ public:
 
 	// UActorComponent interface
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
 
 	bool ConsumeStreamingBuffer(TArray<uint8>& Buffer);
@@ -268,21 +270,33 @@ private:
 	// Buffer used with recording
 	TArray<uint8> VoiceCaptureBuffer;
 
-	// Buffer used with streaming
-	// TODO (Mohamed): use TCircularAudioBuffer instead
-	TRingBuffer<uint8> VoiceCaptureRingBuffer;
+	// Buffer used with streaming, new mic data is dropped and counted if the consumer falls behind
+	TConvaiSpscRingBuffer<uint8> VoiceCaptureRingBuffer;
+	uint64 LastLoggedVoiceBytesDropped = 0;
 
 	UPROPERTY()
 	UConvaiAudioCaptureComponent* AudioCaptureComponent;
 
+	// Character being talked to, told when the player finishes talking so its turn latency is measured from there
+	TWeakObjectPtr<UConvaiChatbotComponent> TalkingToChatbot;
+
+	// Mic audio pushed by the capture submix, drained every tick while recording or talking
+	TSharedPtr<FConvaiSubmixCapture, ESPMode::ThreadSafe> SubmixCapture;
+	FConvaiResampler VoiceCaptureResampler;
+	int32 LastLoggedCaptureOverflows = 0;
+
 	void UpdateVoiceCapture(float DeltaTime);
-	void StartVoiceChunkCapture(float ExpectedRecordingTime = 0.01);
-	void StopVoiceChunkCapture();
-	void ReadRecordedBuffer(Audio::AlignedFloatBuffer& RecordedBuffer, float& OutNumChannels, float& OutSampleRate);
+	void StartVoiceCapture();
+	void StopVoiceCapture();
+	void ProcessCapturedVoice();
+	void RegisterSubmixCapture();
+	void UnregisterSubmixCapture();
 
 	void StartAudioCaptureComponent();
 	void StopAudioCaptureComponent();
 
+	void MarkChatbotFinishTalking();
+
 
 	FonDataReceived_Delegate onDataReceived_Delegate;
 
@@ -291,8 +305,6 @@ private:
 	bool IsInit = false;
 	bool bShouldMuteGlobal;
 
-	float RemainingTimeUntilNextUpdate = 0;
-
 	// Used by a consumer (e.g. chatbot component) to validate if this player component is still streaming audio data to it
 	uint32 Token;
 
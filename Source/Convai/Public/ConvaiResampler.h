@@ -0,0 +1,87 @@
+// Copyright 2022 Convai Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FConvaiResamplerTable;
+
+DECLARE_LOG_CATEGORY_EXTERN(ConvaiResamplerLog, Log, All);
+
+/**
+ * Streaming sample rate converter that downmixes interleaved audio to mono and resamples it with a polyphase FIR.
+ * The filter is a Kaiser windowed sinc with its cutoff below the lower of both Nyquist frequencies. The phase and the input
+ * history carry over between calls, so audio fed in chunks of any size comes out as if converted in one go.
+ * Filter tables are shared between all resamplers of the same ratio, the common mic and voice ratios are built up front.
+ * One resampler serves one stream on one thread at a time.
+ */
+class CONVAI_API FConvaiResampler
+{
+public:
+	FConvaiResampler() = default;
+	FConvaiResampler(int32 InInputSampleRate, int32 InOutputSampleRate);
+
+	/** Sets the rates and resets the stream, keeps the table if the ratio did not change */
+	void Init(int32 InInputSampleRate, int32 InOutputSampleRate);
+
+	/** Forgets the history and phase, e.g. before an unrelated stream */
+	void Reset();
+
+	bool IsInit() const { return InputSampleRate > 0 && OutputSampleRate > 0; }
+
+	int32 GetInputSampleRate() const { return InputSampleRate; }
+	int32 GetOutputSampleRate() const { return OutputSampleRate; }
+
+	/** Frames Process writes for NumInputFrames more input when given room for all of them, including output owed from earlier calls */
+	int32 GetNumOutputFrames(int32 NumInputFrames) const;
+
+	/**
+	 * Downmixes and resamples interleaved frames, writing at most MaxOutputFrames mono frames to Out.
+	 * Input that could not be written for lack of room is kept and comes out on the next call, Out may be null when there is no room.
+	 * Returns the frames written.
+	 */
+	int32 Process(const float* In, int32 NumFrames, int32 NumChannels, float* Out, int32 MaxOutputFrames);
+
+	/** Same for 16 bit PCM, the output is rounded and clamped */
+	int32 Process(const int16* In, int32 NumFrames, int32 NumChannels, int16* Out, int32 MaxOutputFrames);
+
+	/**
+	 * Float capture frames straight to 16 bit mono PCM, e.g. into a ring or a send buffer. Downmix, resampling, rounding and clamping
+	 * happen in one pass, only the mono mix goes through the filter history. Out may be split over calls, pass no input to continue
+	 * with the output owed.
+	 */
+	int32 Process(const float* In, int32 NumFrames, int32 NumChannels, int16* Out, int32 MaxOutputFrames);
+
+	/** 16 bit PCM to float mono, e.g. received voice into a float ring */
+	int32 Process(const int16* In, int32 NumFrames, int32 NumChannels, float* Out, int32 MaxOutputFrames);
+
+	/** Drops the output owed from earlier calls, e.g. when its destination was full. Returns the frames dropped */
+	int32 DiscardOutput();
+
+	/** Int16 convenience for callers with arrays, replaces the contents of OutSamples */
+	void Process(const int16* In, int32 NumFrames, int32 NumChannels, TArray<int16>& OutSamples);
+
+	/** Ends the stream, replaces the contents of OutSamples with the output still held back by the filter and resets */
+	void Flush(TArray<int16>& OutSamples);
+
+private:
+	/** Appends the mono mix of the frames to the filter input */
+	template<typename SampleType>
+	void AddInput(const SampleType* In, int32 NumFrames, int32 NumChannels);
+
+	/** Runs the filter over the buffered input, calling Emit with each output sample. Returns the frames produced */
+	template<typename EmitType>
+	int32 Filter(int32 MaxOutputFrames, EmitType&& Emit);
+
+	int32 InputSampleRate = 0;
+	int32 OutputSampleRate = 0;
+
+	TSharedPtr<const FConvaiResamplerTable, ESPMode::ThreadSafe> Table;
+
+	// Mono filter input, the first samples are the history kept from the previous call
+	TArray<float> Input;
+
+	// Index into Input of the oldest tap of the next output, and its filter phase
+	int32 InputPosition = 0;
+	int32 Phase = 0;
+};
@@ -0,0 +1,301 @@
+// Copyright 2022 Convai Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/PlatformProcess.h"
+#include <atomic>
+#include <type_traits>
+
+/** What Enqueue does with items that do not fit */
+enum class EConvaiRingOverflowPolicy : uint8
+{
+	/* The producer waits for the consumer to make room, producer and consumer must be different threads */
+	Block,
+
+	/* The items that do not fit are dropped */
+	DropNew,
+
+	/* The oldest items are dropped to make room, a consumer reading them at the time finds out on Commit */
+	DropOld,
+};
+
+/**
+ * Fixed capacity lock-free ring for one producer thread and one consumer thread, e.g. a network thread and the audio render thread.
+ * The capacity is rounded up to a power of two. Read and write positions are free running 64 bit counters, so they double as
+ * totals of the items ever written and read, and are kept on separate cache lines so both sides do not contend.
+ * Items are copied with memcpy and must be trivially copyable.
+ *
+ * Write writes what fits and leaves the rest to the caller, Enqueue applies the overflow policy and counts what overflowed.
+ * Both sides can also work on the storage in place through PeekWrite/CommitWrite and PeekRead/PeekContiguous/Commit.
+ */
+template<typename T>
+class TConvaiSpscRingBuffer
+{
+	static_assert(std::is_trivially_copyable<T>::value, "TConvaiSpscRingBuffer items are copied with memcpy");
+
+public:
+	TConvaiSpscRingBuffer() = default;
+
+	explicit TConvaiSpscRingBuffer(uint32 MinCapacity, EConvaiRingOverflowPolicy InOverflowPolicy = EConvaiRingOverflowPolicy::DropNew)
+	{
+		Init(MinCapacity, InOverflowPolicy);
+	}
+
+	TConvaiSpscRingBuffer(const TConvaiSpscRingBuffer&) = delete;
+	TConvaiSpscRingBuffer& operator=(const TConvaiSpscRingBuffer&) = delete;
+
+	/** Allocates the storage and empties the ring, neither side may be using it */
+	void Init(uint32 MinCapacity, EConvaiRingOverflowPolicy InOverflowPolicy = EConvaiRingOverflowPolicy::DropNew)
+	{
+		const uint32 Capacity = FMath::RoundUpToPowerOfTwo(FMath::Max<uint32>(MinCapacity, 1));
+		Buffer.SetNumZeroed(Capacity);
+		Mask = Capacity - 1;
+		OverflowPolicy = InOverflowPolicy;
+		WriteIndex.store(0, std::memory_order_relaxed);
+		ReadIndex.store(0, std::memory_order_relaxed);
+		PeekedReadIndex = 0;
+		NumOverflows.store(0, std::memory_order_relaxed);
+		NumDropped.store(0, std::memory_order_relaxed);
+	}
+
+	uint32 GetCapacity() const { return uint32(Buffer.Num()); }
+
+	EConvaiRingOverflowPolicy GetOverflowPolicy() const { return OverflowPolicy; }
+
+	/** Items readable, exact on the consumer and a lower bound on the producer */
+	uint32 Num() const
+	{
+		return uint32(WriteIndex.load(std::memory_order_acquire) - ReadIndex.load(std::memory_order_acquire));
+	}
+
+	/** Items writable, exact on the producer and a lower bound on the consumer */
+	uint32 NumFree() const
+	{
+		return GetCapacity() - Num();
+	}
+
+	/** Total items written and read since Init, items dropped by DropOld count as read */
+	uint64 GetWriteIndex() const { return WriteIndex.load(std::memory_order_acquire); }
+	uint64 GetReadIndex() const { return ReadIndex.load(std::memory_order_acquire); }
+
+	/** Times Enqueue ran out of room, with Block these are the times the producer had to wait */
+	uint64 GetNumOverflows() const { return NumOverflows.load(std::memory_order_relaxed); }
+
+	/** Items Enqueue dropped, new or old depending on the policy */
+	uint64 GetNumDropped() const { return NumDropped.load(std::memory_order_relaxed); }
+
+	/** Producer only. Writes as many items as fit and returns how many */
+	uint32 Write(const T* Items, uint32 Count)
+	{
+		T* First;
+		T* Second;
+		uint32 FirstCount;
+		uint32 SecondCount;
+		Count = FMath::Min(Count, PeekWrite(First, FirstCount, Second, SecondCount));
+		if (Count == 0)
+		{
+			return 0;
+		}
+
+		const uint32 FirstPart = FMath::Min(Count, FirstCount);
+		FMemory::Memcpy(First, Items, FirstPart * sizeof(T));
+		FMemory::Memcpy(Second, Items + FirstPart, (Count - FirstPart) * sizeof(T));
+
+		CommitWrite(Count);
+		return Count;
+	}
+
+	/** Producer only. Writes all items, or as many as the overflow policy keeps, and returns how many were written */
+	uint32 Enqueue(const T* Items, uint32 Count)
+	{
+		uint32 Written = Write(Items, Count);
+		if (Written == Count)
+		{
+			return Written;
+		}
+
+		NumOverflows.fetch_add(1, std::memory_order_relaxed);
+
+		switch (OverflowPolicy)
+		{
+		case EConvaiRingOverflowPolicy::Block:
+			while (Written < Count)
+			{
+				FPlatformProcess::Yield();
+				Written += Write(Items + Written, Count - Written);
+			}
+			break;
+
+		case EConvaiRingOverflowPolicy::DropNew:
+			NumDropped.fetch_add(Count - Written, std::memory_order_relaxed);
+			break;
+
+		case EConvaiRingOverflowPolicy::DropOld:
+		{
+			// More than fits at all, only the newest part of the items is kept
+			const uint32 Remaining = Count - Written;
+			const uint32 Kept = FMath::Min(Remaining, GetCapacity());
+			const uint32 Skipped = Remaining - Kept;
+			NumDropped.fetch_add(Skipped, std::memory_order_relaxed);
+
+			const uint64 CurrentWrite = WriteIndex.load(std::memory_order_relaxed);
+			uint64 CurrentRead = ReadIndex.load(std::memory_order_acquire);
+			for (;;)
+			{
+				const uint32 Free = GetCapacity() - uint32(CurrentWrite - CurrentRead);
+				if (Free >= Kept)
+				{
+					break;
+				}
+				if (ReadIndex.compare_exchange_weak(CurrentRead, CurrentRead + (Kept - Free), std::memory_order_acq_rel, std::memory_order_acquire))
+				{
+					NumDropped.fetch_add(Kept - Free, std::memory_order_relaxed);
+					break;
+				}
+			}
+
+			Written += Skipped + Write(Items + Written + Skipped, Kept);
+			break;
+		}
+		}
+
+		return Written;
+	}
+
+	/**
+	 * Producer only. Exposes the free space in place as two spans, the second one is where the ring wraps around and may be empty.
+	 * Nothing is published until CommitWrite is called with the number of items written. Returns the total number of items.
+	 */
+	uint32 PeekWrite(T*& OutFirst, uint32& OutFirstCount, T*& OutSecond, uint32& OutSecondCount)
+	{
+		const uint64 CurrentWrite = WriteIndex.load(std::memory_order_relaxed);
+		const uint32 Count = GetCapacity() - uint32(CurrentWrite - ReadIndex.load(std::memory_order_acquire));
+
+		const uint32 Start = uint32(CurrentWrite) & Mask;
+		OutFirstCount = FMath::Min(Count, GetCapacity() - Start);
+		OutSecondCount = Count - OutFirstCount;
+		OutFirst = Buffer.GetData() + Start;
+		OutSecond = Buffer.GetData();
+		return Count;
+	}
+
+	/** Producer only. Publishes Count items written through PeekWrite */
+	void CommitWrite(uint32 Count)
+	{
+		WriteIndex.store(WriteIndex.load(std::memory_order_relaxed) + Count, std::memory_order_release);
+	}
+
+	/** Producer only. Counts an overflow of Count items the caller could not fit through PeekWrite, as DropNew would */
+	void CountDropped(uint32 Count)
+	{
+		if (Count > 0)
+		{
+			NumOverflows.fetch_add(1, std::memory_order_relaxed);
+			NumDropped.fetch_add(Count, std::memory_order_relaxed);
+		}
+	}
+
+	/** Consumer only. Reads up to Count items and returns how many */
+	uint32 Read(T* OutItems, uint32 Count)
+	{
+		for (;;)
+		{
+			const T* First;
+			const T* Second;
+			uint32 FirstCount;
+			uint32 SecondCount;
+			const uint32 NumRead = FMath::Min(Count, PeekRead(First, FirstCount, Second, SecondCount));
+			if (NumRead == 0)
+			{
+				return 0;
+			}
+
+			const uint32 FirstPart = FMath::Min(NumRead, FirstCount);
+			FMemory::Memcpy(OutItems, First, FirstPart * sizeof(T));
+			FMemory::Memcpy(OutItems + FirstPart, Second, (NumRead - FirstPart) * sizeof(T));
+
+			// Read again if the producer dropped these items while they were copied
+			if (Commit(NumRead))
+			{
+				return NumRead;
+			}
+		}
+	}
+
+	/**
+	 * Consumer only. Exposes the readable items in place as two spans, the second one is where the ring wraps around and may be empty.
+	 * Nothing is consumed until Commit is called with the number of items used. Returns the total number of items.
+	 */
+	uint32 PeekRead(const T*& OutFirst, uint32& OutFirstCount, const T*& OutSecond, uint32& OutSecondCount)
+	{
+		PeekedReadIndex = ReadIndex.load(std::memory_order_acquire);
+		const uint32 Count = uint32(WriteIndex.load(std::memory_order_acquire) - PeekedReadIndex);
+
+		const uint32 Start = uint32(PeekedReadIndex) & Mask;
+		OutFirstCount = FMath::Min(Count, GetCapacity() - Start);
+		OutSecondCount = Count - OutFirstCount;
+		OutFirst = Buffer.GetData() + Start;
+		OutSecond = Buffer.GetData();
+		return Count;
+	}
+
+	/** Consumer only. Exposes the readable items up to where the ring wraps around, see PeekRead */
+	uint32 PeekContiguous(const T*& OutItems)
+	{
+		const T* Second;
+		uint32 FirstCount;
+		uint32 SecondCount;
+		PeekRead(OutItems, FirstCount, Second, SecondCount);
+		return FirstCount;
+	}
+
+	/**
+	 * Consumer only. Releases Count items of the last peek.
+	 * Returns false if DropOld dropped them in the meantime, they may have been overwritten and nothing is released.
+	 */
+	bool Commit(uint32 Count)
+	{
+		uint64 Expected = PeekedReadIndex;
+		if (!ReadIndex.compare_exchange_strong(Expected, PeekedReadIndex + Count, std::memory_order_acq_rel, std::memory_order_acquire))
+		{
+			return false;
+		}
+		PeekedReadIndex += Count;
+		return true;
+	}
+
+	/** Consumer only. Drops up to Count items and returns how many */
+	uint32 Skip(uint32 Count)
+	{
+		uint64 CurrentRead = ReadIndex.load(std::memory_order_acquire);
+		for (;;)
+		{
+			const uint32 NumSkipped = FMath::Min(Count, uint32(WriteIndex.load(std::memory_order_acquire) - CurrentRead));
+			if (ReadIndex.compare_exchange_weak(CurrentRead, CurrentRead + NumSkipped, std::memory_order_acq_rel, std::memory_order_acquire))
+			{
+				return NumSkipped;
+			}
+		}
+	}
+
+	/** Consumer only. Drops everything readable */
+	void Empty()
+	{
+		Skip(MAX_uint32);
+	}
+
+private:
+	TArray<T> Buffer;
+	uint32 Mask = 0;
+	EConvaiRingOverflowPolicy OverflowPolicy = EConvaiRingOverflowPolicy::DropNew;
+
+	alignas(PLATFORM_CACHE_LINE_SIZE) std::atomic<uint64> WriteIndex{ 0 };
+	alignas(PLATFORM_CACHE_LINE_SIZE) std::atomic<uint64> ReadIndex{ 0 };
+
+	// Consumer side, where the last peek started reading
+	uint64 PeekedReadIndex = 0;
+
+	std::atomic<uint64> NumOverflows{ 0 };
+	std::atomic<uint64> NumDropped{ 0 };
+};
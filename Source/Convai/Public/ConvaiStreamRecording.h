@@ -0,0 +1,89 @@
+// Copyright 2022 Convai Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include <string>
+
+DECLARE_LOG_CATEGORY_EXTERN(ConvaiStreamRecordingLog, Log, All);
+
+namespace google { namespace protobuf { class MessageLite; } }
+
+class FArchive;
+
+enum class EConvaiStreamRecordType : uint8
+{
+	Request = 0,
+	Response = 1,
+	WritesDone = 2,
+	// Payload is the final status code as a little endian int32
+	Finish = 3,
+};
+
+/**
+ * Captures the traffic of a GetResponse stream to a file so it can be replayed later without the network.
+ * File layout: "CVRS", uint32 version, then records of [uint8 type][uint32 microseconds since the previous record][uint32 length][serialized message].
+ */
+class CONVAI_API FConvaiStreamRecorder
+{
+public:
+	/** Directory set through convai.GetResponse.RecordDirectory, empty when recording is off */
+	static FString GetRecordDirectory();
+
+	/** Returns null if the file could not be created */
+	static TUniquePtr<FConvaiStreamRecorder> Create(const FString& FilePath);
+
+	~FConvaiStreamRecorder();
+
+	/** Can be called from any thread */
+	void Record(EConvaiStreamRecordType Type, const google::protobuf::MessageLite* Message = nullptr);
+
+	/** Writes the final record and closes the file, later records are dropped */
+	void RecordFinish(int32 StatusCode);
+
+private:
+	FConvaiStreamRecorder(FArchive* InWriter, const FString& InFilePath);
+
+	void WriteRecord(EConvaiStreamRecordType Type, const uint8* Payload, uint32 Length);
+
+	FCriticalSection CriticalSection;
+	TUniquePtr<FArchive> Writer;
+	const FString FilePath;
+	double LastRecordTime;
+	int32 NumRecords = 0;
+
+	// Reused across records to avoid an allocation per message
+	std::string SerializeBuffer;
+};
+
+struct FConvaiStreamRecord
+{
+	EConvaiStreamRecordType Type;
+
+	// Seconds since the start of the stream
+	double Time;
+
+	// Location of the payload in FConvaiStreamReplay::Data
+	int32 Offset;
+	int32 Length;
+};
+
+/** A capture loaded in memory, shared between all the streams replaying it */
+class CONVAI_API FConvaiStreamReplay
+{
+public:
+	/** File set through convai.GetResponse.ReplayFile, empty when replay is off */
+	static FString GetReplayFile();
+
+	/** Playback rate from convai.GetResponse.ReplaySpeed, 1 is real-time and 0 is as fast as possible */
+	static float GetReplaySpeed();
+
+	/** Loads and parses a capture, the last few files are cached so repeated replays do not hit the disk. Returns null on failure */
+	static TSharedPtr<const FConvaiStreamReplay, ESPMode::ThreadSafe> Load(const FString& FilePath);
+
+	const uint8* GetPayload(const FConvaiStreamRecord& Record) const { return Data.GetData() + Record.Offset; }
+
+	TArray<FConvaiStreamRecord> Records;
+
+	TArray<uint8> Data;
+};
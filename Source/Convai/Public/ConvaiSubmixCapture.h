@@ -0,0 +1,81 @@
+// Copyright 2022 Convai Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AudioDevice.h"
+#include "Runtime/Launch/Resources/Version.h"
+#include "ConvaiSpscRingBuffer.h"
+#include <atomic>
+
+class USoundSubmix;
+
+DECLARE_LOG_CATEGORY_EXTERN(ConvaiSubmixCaptureLog, Log, All);
+
+struct CONVAI_API FConvaiSubmixCaptureStats
+{
+	/* Interleaved samples written into the ring by the audio render thread */
+	int64 SamplesCaptured = 0;
+
+	/* Submix buffers dropped because the ring was full, each one is a gap in the captured voice */
+	int32 NumOverflows = 0;
+	int64 SamplesDropped = 0;
+};
+
+/**
+ * Listener on the microphone submix that streams every mixed buffer into a preallocated lock-free ring.
+ * It stays registered for the lifetime of the player, capturing is switched on and off with SetCapturing, so there is no
+ * recording to start and stop per chunk and no sample is lost in between. The audio render thread only copies into the ring,
+ * the game thread works on it in place with PeekRead and Commit. Buffers are written whole or not at all, so the ring always
+ * holds complete frames.
+ */
+class CONVAI_API FConvaiSubmixCapture : public ISubmixBufferListener
+{
+public:
+	FConvaiSubmixCapture();
+
+	/** Starts listening on the submix, the capture must stay referenced until Unregister */
+	static void Register(const TSharedRef<FConvaiSubmixCapture, ESPMode::ThreadSafe>& Capture, FAudioDevice* AudioDevice, USoundSubmix* Submix);
+
+	/** Stops listening, the audio thread keeps a reference until it no longer calls the capture */
+	static void Unregister(const TSharedRef<FConvaiSubmixCapture, ESPMode::ThreadSafe>& Capture, FAudioDevice* AudioDevice, USoundSubmix* Submix);
+
+	/** Submix buffers are dropped while not capturing */
+	void SetCapturing(bool bInCapturing);
+	bool IsCapturing() const { return bCapturing.load(std::memory_order_acquire); }
+
+	/** Game thread only. Drops everything captured so far */
+	void Flush();
+
+	/**
+	 * Game thread only. Exposes all complete frames captured so far in place as two spans of interleaved floats, the second one is
+	 * where the ring wraps around and may be empty. The wrap around splits a frame when the channel count is not a power of two.
+	 * Nothing is consumed until Commit is called with the number of samples used. Returns the total number of samples.
+	 */
+	int32 PeekRead(const float*& OutFirst, int32& OutFirstSamples, const float*& OutSecond, int32& OutSecondSamples, int32& OutNumChannels, int32& OutSampleRate);
+
+	/** Game thread only. Releases NumSamples samples of the last PeekRead */
+	void Commit(int32 NumSamples);
+
+	FConvaiSubmixCaptureStats GetStats() const;
+
+	//~ Begin ISubmixBufferListener Interface.
+	virtual void OnNewSubmixBuffer(const USoundSubmix* OwningSubmix, float* AudioData, int32 InNumSamples, int32 InNumChannels, const int32 InSampleRate, double AudioClock) override;
+#if ENGINE_MAJOR_VERSION == 5 && ENGINE_MINOR_VERSION >= 4
+	virtual const FString& GetListenerName() const override;
+#endif
+	//~ End ISubmixBufferListener Interface.
+
+private:
+	TConvaiSpscRingBuffer<float> Ring;
+
+	std::atomic<bool> bCapturing{ false };
+
+	// Format of the submix, stored before the samples it describes are published
+	std::atomic<int32> NumChannels{ 0 };
+	std::atomic<int32> SampleRate{ 0 };
+
+	std::atomic<int64> SamplesCaptured{ 0 };
+	std::atomic<int32> NumOverflows{ 0 };
+	std::atomic<int64> SamplesDropped{ 0 };
+};
@@ -7,6 +7,9 @@
 #include "Subsystems/GameInstanceSubsystem.h"
 #include "HAL/Runnable.h"
 #include "HAL/ThreadSafeBool.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "../Convai.h"
+#include <atomic>
 
 THIRD_PARTY_INCLUDES_START
 #include "Proto/service.grpc.pb.h"
@@ -64,51 +67,206 @@ DECLARE_LOG_CATEGORY_EXTERN(ConvaiSubsystemLog, Log, All);
 
 DECLARE_DELEGATE_OneParam(FgRPC_Delegate, bool);
 
-class FgRPCClient : public FRunnable {
+USTRUCT(BlueprintType)
+struct FConvaiCompletionQueueStats
+{
+	GENERATED_BODY()
+
+	/* Index of the completion queue in the pool */
+	UPROPERTY(BlueprintReadOnly, Category = "Convai|gRPC")
+	int32 QueueIndex = 0;
+
+	/* Number of streams currently assigned to this queue, their tags are the ones this queue drains. This is not the number of tags waiting in the queue */
+	UPROPERTY(BlueprintReadOnly, Category = "Convai|gRPC")
+	int32 AssignedStreams = 0;
+
+	/* Total number of tags drained from this queue */
+	UPROPERTY(BlueprintReadOnly, Category = "Convai|gRPC")
+	int64 TagsProcessed = 0;
+
+	/* Average time spent handling a single tag (ms) */
+	UPROPERTY(BlueprintReadOnly, Category = "Convai|gRPC")
+	float AverageTagLatencyMs = 0;
+
+	/* Longest time spent handling a single tag (ms) */
+	UPROPERTY(BlueprintReadOnly, Category = "Convai|gRPC")
+	float MaxTagLatencyMs = 0;
+};
+
+/**
+ * Owns a single completion queue and the thread that drains it.
+ */
+class FgRPCCompletionQueueWorker : public FRunnable {
 public:
-	FgRPCClient(std::string target, const std::shared_ptr<grpc::ChannelCredentials>& creds);
+	FgRPCCompletionQueueWorker(int32 InQueueIndex);
+
+	virtual ~FgRPCCompletionQueueWorker();
 
-    std::unique_ptr<service::ConvaiService::Stub> GetNewStub();
+	void Start();
+
+	void Shutdown();
 
 	grpc::CompletionQueue* GetCompletionQueue();
 
+	int32 GetAssignedStreams() const;
+
+	void AddStream();
+
+	void RemoveStream();
+
+	FConvaiCompletionQueueStats GetStats() const;
+
+public:
+	/**
+	 * FRunnable Interface
+	 * Loop while listening for completed responses.
+	 */
+	virtual uint32 Run() override;
+
+private:
+	int32 QueueIndex;
+
+	FThreadSafeBool bIsRunning;
+
+	TUniquePtr<FRunnableThread> Thread;
+
+	FThreadSafeCounter AssignedStreams;
+
+	// Tag handling counters, only written from the worker thread
+	std::atomic<uint64> TagsProcessed;
+	std::atomic<uint64> TotalTagCycles;
+	std::atomic<uint64> MaxTagCycles;
+
+	// The producer-consumer queue we use to communicate asynchronously with the
+	// gRPC runtime.
+	grpc::CompletionQueue cq_;
+};
+
+USTRUCT(BlueprintType)
+struct FConvaiChannelStats
+{
+	GENERATED_BODY()
+
+	/* Index of the channel in the pool */
+	UPROPERTY(BlueprintReadOnly, Category = "Convai|gRPC")
+	int32 ChannelIndex = 0;
+
+	/* Last observed connectivity state */
+	UPROPERTY(BlueprintReadOnly, Category = "Convai|gRPC")
+	FString State;
+
+	/* Number of calls currently running on this channel */
+	UPROPERTY(BlueprintReadOnly, Category = "Convai|gRPC")
+	int32 ActiveStreams = 0;
+
+	/* Time it took the channel to become ready on its last (re)connect (ms), negative if it never got ready */
+	UPROPERTY(BlueprintReadOnly, Category = "Convai|gRPC")
+	float TimeToReadyMs = -1;
+
+	/* Number of times the channel went back to connecting after having been ready */
+	UPROPERTY(BlueprintReadOnly, Category = "Convai|gRPC")
+	int32 Reconnects = 0;
+};
+
+/**
+ * A single channel (and therefore HTTP/2 connection) together with the stub that is reused for every call on it.
+ */
+struct FgRPCChannelSlot
+{
+	std::shared_ptr<grpc::Channel> Channel;
+
+	// Out of the Channel comes the stub, stored here, our view of the
+	// server's exposed services. Stubs are thread-safe and shared by all calls on the channel.
+	std::unique_ptr<service::ConvaiService::Stub> Stub;
+
+	// Number of calls currently running on this channel
+	FThreadSafeCounter ActiveStreams;
+
+	// Tag used to watch connectivity state transitions of this channel
+	FgRPC_Delegate OnStateChangeDelegate;
+
+	// Last observed grpc_connectivity_state, updated from the watching completion queue thread
+	std::atomic<int32> State{ 0 };
+
+	// When the current connection attempt started, zero when not connecting
+	std::atomic<uint64> ConnectStartCycles{ 0 };
+
+	std::atomic<float> TimeToReadyMs{ -1.f };
+
+	FThreadSafeCounter Reconnects;
+};
+
+class FgRPCClient {
 public:
-    /**
-     * FRunnable Interface
-     * Loop while listening for completed responses.
-     */
-    virtual uint32 Run() override;
+	FgRPCClient(std::string target, const std::shared_ptr<grpc::ChannelCredentials>& creds);
+
+	/**
+	 * Returns the shared stub of the least busy channel. The stub is owned by the client and must not be deleted.
+	 * The returned index must be handed back through ReleaseStub once the call is done.
+	 */
+	service::ConvaiService::Stub* AcquireStub(int32& OutChannelIndex);
+
+	void ReleaseStub(int32 ChannelIndex);
+
+	/**
+	 * Picks a completion queue for a new stream according to the configured policy.
+	 * Streams acquired with the same non zero AffinityKey while any of them is still running share one queue, so the callbacks
+	 * of one owner (e.g. a chatbot component with a prepared and an active stream) never run on two threads at once.
+	 * The returned index must be handed back through ReleaseCompletionQueue with the same key once the stream is done.
+	 */
+	grpc::CompletionQueue* AcquireCompletionQueue(int32& OutQueueIndex, uint32 AffinityKey = 0);
 
+	void ReleaseCompletionQueue(int32 QueueIndex, uint32 AffinityKey = 0);
+
+	void GetCompletionQueueStats(TArray<FConvaiCompletionQueueStats>& OutStats) const;
+
+	void GetChannelStats(TArray<FConvaiChannelStats>& OutStats) const;
+
+public:
     void StartStub();
 
-	void CreateChannel();
+	void CreateChannels();
+
+	/** Kicks off the connection of every channel and starts watching their state, so the first call finds a warm connection */
+	void ConnectChannels();
 
-	void OnStateChange(bool ok);
+	void OnStateChange(bool ok, int32 ChannelIndex);
 
-    virtual void Exit() override;
+	void WatchChannelState(int32 ChannelIndex, grpc_connectivity_state LastState);
+
+    void Exit();
 
 private: 
     mutable FCriticalSection CriticalSection;
     FThreadSafeBool bIsRunning;
 
-    TUniquePtr<FRunnableThread> Thread;
+	TArray<TUniquePtr<FgRPCCompletionQueueWorker>> Workers;
+
+	EConvaiCompletionQueuePolicy CompletionQueuePolicy;
+
+	FThreadSafeCounter NextCompletionQueue;
+
+	struct FQueueAffinity
+	{
+		int32 QueueIndex = INDEX_NONE;
+		int32 NumStreams = 0;
+	};
 
+	// Queue pinned to each affinity key while it has running streams, guarded by CriticalSection
+	TMap<uint32, FQueueAffinity> QueueAffinities;
+
+	int32 PickCompletionQueue();
 
 private:
 
-    // Out of the passed in Channel comes the stub, stored here, our view of the
-    // server's exposed services.
-    std::unique_ptr<service::ConvaiService::Stub> stub_;
+	// Created once in StartStub and never resized afterwards, so it can be read without locking.
+	// Exit releases the channels of the slots, after that only the counters are valid
+	TArray<TUniquePtr<FgRPCChannelSlot>> Channels;
+
+	FThreadSafeCounter NextChannel;
 
-    std::shared_ptr<grpc::Channel> Channel;
 	std::shared_ptr<grpc::ChannelCredentials> Creds;
 	std::string Target;
-
-	FgRPC_Delegate OnStateChangeDelegate;
-
-    // The producer-consumer queue we use to communicate asynchronously with the
-    // gRPC runtime.
-	grpc::CompletionQueue cq_;
 };
 
 
@@ -128,6 +286,14 @@ public:
 
 	void GetAndroidMicPermission();
 
+	/* Returns per completion queue assigned streams and tag handling latency */
+	UFUNCTION(BlueprintPure, Category = "Convai|gRPC")
+	void GetCompletionQueueStats(TArray<FConvaiCompletionQueueStats>& OutStats) const;
+
+	/* Returns per channel connectivity state, load and time-to-ready */
+	UFUNCTION(BlueprintPure, Category = "Convai|gRPC")
+	void GetChannelStats(TArray<FConvaiChannelStats>& OutStats) const;
+
 public:
     TSharedPtr<FgRPCClient> gRPC_Runnable;
 };
@@ -114,6 +114,9 @@ public:
 
 	static TArray<FAnimationFrame> ParseJsonToBlendShapeData(const FString& JsonString);
 
+	// Decodes the UTF-8 blendshape JSON of a GetResponse reply into ARKit frames, without building a JSON object tree
+	static bool ParseBlendShapeData(const ANSICHAR* Json, int32 JsonLen, TArray<FAnimationFrame>& OutFrames);
+
 	static bool ParseVisemeValuesToAnimationFrame(const FString& VisemeValuesString, FAnimationFrame& AnimationFrame);
 
 	// UFUNCTION(BlueprintCallable, Category = "ActorFuncions", meta = (WorldContext = WorldContextObject))
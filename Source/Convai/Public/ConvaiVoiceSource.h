@@ -0,0 +1,126 @@
+// Copyright 2022 Convai Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Sound/SoundGenerator.h"
+#include "Sound/SoundWaveProcedural.h"
+#include "ConvaiSpscRingBuffer.h"
+#include "ConvaiResampler.h"
+#include <atomic>
+#include "ConvaiVoiceSource.generated.h"
+
+class FConvaiPlaybackClock;
+
+DECLARE_LOG_CATEGORY_EXTERN(ConvaiVoiceSourceLog, Log, All);
+
+struct CONVAI_API FConvaiVoiceSourceStats
+{
+	int32 OutputSampleRate = 0;
+
+	/* Frames at the output rate queued and handed to the audio renderer */
+	int64 FramesQueued = 0;
+	int64 FramesPlayed = 0;
+
+	/* Frames of silence rendered because nothing was queued */
+	int64 SilentFrames = 0;
+
+	/* Times the voice ran out while a streamed response was still open, see FConvaiVoiceSource::BeginStream */
+	int32 NumUnderruns = 0;
+
+	/* Frames waiting for room in the ring */
+	int32 BacklogFrames = 0;
+};
+
+/**
+ * Voice queue rendered by the audio renderer through FConvaiVoiceGenerator.
+ * Incoming 16 bit PCM of any sample rate and channel count is downmixed and resampled to the output rate on the producer side,
+ * so a format change needs no restart of the audio component. The render thread reads a lock-free ring and advances the
+ * FConvaiPlaybackClock by exactly the frames it played. Audio that does not fit the ring waits in a backlog until Pump is called.
+ * Any thread can queue, Render runs on the audio render thread.
+ */
+class CONVAI_API FConvaiVoiceSource
+{
+public:
+	FConvaiVoiceSource(int32 InOutputSampleRate, const TSharedPtr<FConvaiPlaybackClock, ESPMode::ThreadSafe>& InPlaybackClock);
+
+	/** Queues interleaved 16 bit PCM and moves the end of the clock timeline */
+	void QueueAudio(const int16* Samples, int32 NumFrames, int32 SampleRate, int32 NumChannels);
+
+	/** Moves the backlog into the ring as room frees up, should be called regularly, e.g. on tick */
+	void Pump();
+
+	/** Drops everything queued, the clock then has nothing left to play */
+	void Reset();
+
+	/** A streamed response starts, running out of voice counts as an underrun until EndStream */
+	void BeginStream();
+
+	/** The last audio of the response was queued, running out of voice afterwards is its normal end */
+	void EndStream();
+
+	/** Audio render thread only. Fills Out with mono voice at the output rate, padding with silence */
+	void Render(float* Out, int32 NumSamples);
+
+	/** Renders DeltaTime worth of voice into nothing, for when there is no audio device to pull it */
+	void ConsumeWithoutAudioDevice(float DeltaTime);
+
+	/** True while part of the queued voice is still waiting to be played */
+	bool HasPendingAudio() const;
+
+	int32 GetOutputSampleRate() const { return OutputSampleRate; }
+
+	FConvaiVoiceSourceStats GetStats() const;
+
+private:
+	void Push(const float* Frames, int32 NumFrames);
+
+	const int32 OutputSampleRate;
+
+	TSharedPtr<FConvaiPlaybackClock, ESPMode::ThreadSafe> PlaybackClock;
+
+	TConvaiSpscRingBuffer<float> Ring;
+
+	// Serializes the producers, the render thread never takes it
+	FCriticalSection ProducerCriticalSection;
+
+	// Frames before BacklogOffset already went into the ring
+	TArray<float> Backlog;
+	int32 BacklogOffset = 0;
+	std::atomic<int32> BacklogFrames{ 0 };
+
+	// Ring position the render thread skips to, everything written before a Reset
+	std::atomic<uint64> DiscardIndex{ 0 };
+
+	// Frames on the clock timeline, QueuedFrames belongs to the producers and PlayedFrames to the render thread
+	int64 QueuedFrames = 0;
+	std::atomic<int64> PlayedFrames{ 0 };
+
+	// Downmixes and converts the voice to the output rate, its history carries over between chunks of the same sample rate
+	FConvaiResampler Resampler;
+
+	TArray<float> ResampledBuffer;
+	TArray<float> DiscardBuffer;
+
+	std::atomic<int64> SilentFrames{ 0 };
+	std::atomic<int32> NumUnderruns{ 0 };
+	std::atomic<bool> StreamOpen{ false };
+	bool RenderedAudioLastCallback = false;
+};
+
+/** Procedural sound wave that hands the audio renderer a generator pulling from an FConvaiVoiceSource */
+UCLASS()
+class CONVAI_API UConvaiVoiceSoundWave : public USoundWaveProcedural
+{
+	GENERATED_BODY()
+
+public:
+	void SetVoiceSource(const TSharedPtr<FConvaiVoiceSource, ESPMode::ThreadSafe>& InVoiceSource);
+
+	//~ Begin USoundWave Interface.
+	virtual ISoundGeneratorPtr CreateSoundGenerator(const FSoundGeneratorInitParams& InParams) override;
+	//~ End USoundWave Interface.
+
+private:
+	TSharedPtr<FConvaiVoiceSource, ESPMode::ThreadSafe> VoiceSource;
+};
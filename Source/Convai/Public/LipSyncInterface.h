@@ -9,6 +9,8 @@
 
 DECLARE_DELEGATE(FOnVisemesDataReadySignature);
 
+class FConvaiPlaybackClock;
+
 UINTERFACE()
 class CONVAI_API UConvaiLipSyncInterface : public UInterface
 {
@@ -44,4 +46,10 @@ public:
 	virtual bool RequiresPreGeneratedFaceData() = 0;
 	virtual bool GeneratesVisemesAsBlendshapes() = 0;
 	virtual TMap<FName, float> ConvaiGetFaceBlendshapes() = 0;
+
+	/** Read when the next response is requested, returning false skips its face data even though RequiresPreGeneratedFaceData is set */
+	virtual bool ConvaiShouldRequestFaceData() { return true; }
+
+	/** Clock of the voice the face data is played with, face sequences can follow it instead of the wall clock */
+	virtual void ConvaiSetPlaybackClock(TSharedPtr<const FConvaiPlaybackClock, ESPMode::ThreadSafe> PlaybackClock) {}
 };
\ No newline at end of file